@@ -0,0 +1,605 @@
+/**
+ * @file      fluidBench.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Headless benchmark of FluidSolver and FluidSolverMultiUser.
+ *
+ * Runs the solvers without a window or a sensor, driven by synthetic people walking
+ * in front of the wall or by a recording made with fluidWall -record. Every
+ * combination of the swept options is run for a fixed number of frames and written
+ * as one CSV line: frames per second, frame time, per stage cost in ns per cell and 
+ * the memory the solver took. Run with -h for the options.
+ */
+
+#include "FluidSolver.h"
+#include "FluidSolverMultiUser.h"
+#include "FluidKernels.h"
+#include "Profiler.h"
+#include "Threading.h"
+#include "CaptureStream.h"
+#include "GridDownsampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <psapi.h>
+	#pragma comment(lib, "psapi.lib")
+#else
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+//solver settings of the wall, see fluidWall.cpp
+static const float DT             = 0.1f;
+static const float SOR_RELAXATION = 1.5f;
+static const float TOLERANCE      = 0.01f;
+static const float ABS_TOLERANCE  = 1e-6f;
+static const int   MAX_USERS      = 6;		//user labels of a recording, as the sensor tracks
+
+//sources at the silhouettes, like the wall's splashes
+static const float EDGE_DENSITY   = 20.0f;
+static const float EDGE_LIFT      = 1.0f;
+
+//solver stages reported per cell, with their column names
+static const ProfileStage CELL_STAGES[] = {
+	PROFILE_SOLVER_ADD_SOURCE,
+	PROFILE_SOLVER_DIFFUSE,
+	PROFILE_SOLVER_ADVECT,
+	PROFILE_SOLVER_PROJECT,
+	PROFILE_SOLVER_LINEAR_SOLVE,
+	PROFILE_SOLVER_SET_BOUNDS
+};
+static const char* CELL_STAGE_COLUMNS[] = {
+	"ns_cell_add_source",
+	"ns_cell_diffuse",
+	"ns_cell_advect",
+	"ns_cell_project",
+	"ns_cell_linear_solve",
+	"ns_cell_set_bounds"
+};
+static const int NUM_CELL_STAGES = sizeof(CELL_STAGES) / sizeof(CELL_STAGES[0]);
+
+//FluidSolverMultiUser::DensityStorage names, in enum order
+static const char* DENSITY_NAMES[] = { "float", "half", "unorm16" };
+
+/**
+ * One benchmark run.
+ */
+struct BenchConfig {
+	bool        multiUser;
+	FluidSolverMultiUser::DensityStorage density;
+	int         width, height;
+	int         users;        //people in the synthetic scene, 0 for a recording
+	string      solver;       //gs, sor, jacobi or mg
+	const FluidKernels* kernels;
+	bool        tiles;
+	int         velocity;     //velocity downsampling factor
+	string      advection;    //sl, mc (MacCormack density) or mcv (and velocity)
+};
+
+struct GridSize {
+	int width, height;
+};
+
+struct BenchOptions {
+	vector<GridSize> sizes;
+	vector<int>    users;
+	vector<string> models;
+	vector<string> densities;
+	vector<string> solvers;
+	vector<string> kernels;
+	vector<string> tiles;
+	vector<int>    velocities;
+	vector<string> advections;
+	int            frames;
+	int            warmup;
+	int            iterations;
+	const char*    playPath;
+	const char*    outPath;
+};
+
+static CapturePlayer player;
+
+
+
+/**
+ * Resident memory of the process, in bytes. The growth over a run is the solver's
+ * footprint. Fields of grids from N = 256 up are mappings of their own and counted
+ * exactly; smaller ones may reuse heap freed by an earlier run and read low.
+ */
+static size_t residentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+#else
+	long pages = 0, resident = 0;
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+	if (fscanf(file, "%ld %ld", &pages, &resident) != 2)
+		resident = 0;
+	fclose(file);
+	return (size_t)resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+
+
+static vector<string> splitList(const char* list)
+{
+	vector<string> items;
+	string item;
+	for (const char* c = list; ; c++) {
+		if (*c == ',' || *c == '\0') {
+			if (!item.empty())
+				items.push_back(item);
+			item.clear();
+			if (*c == '\0')
+				break;
+		}
+		else
+			item += *c;
+	}
+	return items;
+}
+
+static vector<int> splitInts(const char* list)
+{
+	vector<string> items = splitList(list);
+	vector<int> values;
+	for (size_t k = 0; k < items.size(); k++)
+		values.push_back(atoi(items[k].c_str()));
+	return values;
+}
+
+/**
+ * Grid sizes, each either N for a square grid or WxH.
+ */
+static vector<GridSize> splitSizes(const char* list)
+{
+	vector<string> items = splitList(list);
+	vector<GridSize> sizes;
+	for (size_t k = 0; k < items.size(); k++) {
+		GridSize size;
+		size.width = size.height = atoi(items[k].c_str());
+		size_t x = items[k].find('x');
+		if (x != string::npos)
+			size.height = atoi(items[k].c_str() + x + 1);
+		sizes.push_back(size);
+	}
+	return sizes;
+}
+
+
+
+/**
+ * Synthetic scene: people standing in a row, each swaying sideways at their own
+ * pace, drawn as a body and a head. Fills the bounds mask and the user labels in
+ * the layout of the wall's capture frames: row y-1 is grid row y, rows bottom to top.
+ * People are sized by the height of the grid and spread across its width.
+ */
+static void drawPeople(int width, int height, int users, int frame, vector<unsigned char>& bounds, 
+					   vector<unsigned char>& labels)
+{
+	bounds.assign(width * height, 0);
+	labels.assign(width * height, 0);
+
+	float bodyW = height / 16.0f, bodyH = height * 0.22f, bodyY = height * 0.25f;
+	float headR = height / 28.0f, headY = bodyY + bodyH + headR;
+
+	for (int k = 0; k < users; k++) {
+		float cx = width * (k + 1.0f) / (users + 1.0f) + 
+				   width * 0.15f / users * sinf(frame * 0.03f * (1.0f + 0.3f * k) + k);
+		int x0 = (int)(cx - bodyW - 1), x1 = (int)(cx + bodyW + 1);
+		int y1 = (int)(headY + headR + 1);
+
+		for (int y = 0; y < height && y <= y1; y++)
+			for (int x = x0 < 0 ? 0 : x0; x < width && x <= x1; x++) {
+				float bx = (x - cx) / bodyW, by = (y - bodyY) / bodyH;
+				float hx = x - cx, hy = y - headY;
+				if (bx * bx + by * by < 1.0f || hx * hx + hy * hy < headR * headR) {
+					bounds[x + width * y] = 1;
+					labels[x + width * y] = (unsigned char)(1 + k % MAX_USERS);
+				}
+			}
+	}
+}
+
+
+
+/**
+ * Next frame of the recording, reduced to the grid like the wall does.
+ */
+static void readRecording(GridDownsampler& downsampler, vector<unsigned char>& bounds, 
+						  vector<unsigned char>& labels)
+{
+	Mat image, users, mask;
+	int width = downsampler.getGridWidth(), height = downsampler.getGridHeight();
+
+	player.grabFrame();
+	downsampler.downsample(player.getDepthMat(), player.getUsersMat(), image, users, mask);
+
+	bounds.resize(width * height);
+	labels.resize(width * height);
+	for (int y = 0; y < height; y++) {
+		memcpy(&bounds[width * y], mask.ptr<unsigned char>(y), width);
+		memcpy(&labels[width * y], users.ptr<unsigned char>(y), width);
+	}
+}
+
+
+
+/**
+ * Feeds one frame of input: the silhouettes become bounds, and every open cell on
+ * top of one gets density of its user and an upward push.
+ */
+static void applyInput(FluidSolver* solver, FluidSolverMultiUser* multiUser, int width, int height,
+					   const vector<unsigned char>& bounds, const vector<unsigned char>& labels)
+{
+	solver->setBoundsFromMask(&bounds[0], width);
+
+	for (int y = 1; y < height; y++)
+		for (int x = 0; x < width; x++) {
+			int below = x + width * (y - 1);
+			if (bounds[x + width * y] || !bounds[below])
+				continue;
+			//cell (x + 1, y + 1) is open, the one under it is a person
+			int user = labels[below];
+			solver->addVertVelocityAt(x + 1, y + 1, EDGE_LIFT);
+			if (!multiUser)
+				solver->addDensityAt(x + 1, y + 1, EDGE_DENSITY);
+			else if (user > 0 && user <= MAX_USERS)
+				multiUser->addDensityAt(user, x + 1, y + 1, EDGE_DENSITY);
+		}
+}
+
+
+
+static void configureSolver(FluidSolver* solver, const BenchConfig& config, int iterations)
+{
+	solver->setRelaxation(SOR_RELAXATION);
+	solver->setTolerance(TOLERANCE, ABS_TOLERANCE);
+	solver->setMaxIterations(iterations);
+	solver->setKernels(*config.kernels);
+	solver->setActiveTileTracking(config.tiles);
+	solver->setVelocityDownsampling(config.velocity);
+	if (config.advection == "mc")
+		solver->setAdvectionScheme(FluidSolver::ADVECT_MACCORMACK);
+	else if (config.advection == "mcv")
+		solver->setAdvectionScheme(FluidSolver::ADVECT_MACCORMACK, FluidSolver::ADVECT_MACCORMACK);
+
+	if (config.solver == "gs")
+		solver->setSolverType(FluidSolver::GAUSS_SEIDEL);
+	else if (config.solver == "jacobi")
+		solver->setSolverType(FluidSolver::JACOBI);
+	else
+		solver->setSolverType(FluidSolver::RED_BLACK_SOR);
+	if (config.solver == "mg")
+		solver->setPressureSolver(FluidSolver::PRESSURE_MULTIGRID);
+}
+
+
+
+/**
+ * Largest density of any cell (of any user), a measure of how much advection
+ * smears the sources: sharper advection keeps higher peaks.
+ */
+static float densityPeak(FluidSolver* solver, FluidSolverMultiUser* multiUser)
+{
+	float peak = 0.0f;
+	for (int y = 1; y <= solver->getHeight(); y++)
+		for (int x = 1; x <= solver->getWidth(); x++) {
+			if (!multiUser) {
+				float d = solver->getDensityAt(x, y);
+				if (d > peak) peak = d;
+				continue;
+			}
+			//user 0 is the background
+			for (int k = 1; k <= MAX_USERS; k++) {
+				float d = multiUser->getDensityAt(k, x, y);
+				if (d > peak) peak = d;
+			}
+		}
+	return peak;
+}
+
+
+
+static void writeHeader(FILE* out)
+{
+	fprintf(out, "input,model,density,width,height,users,solver,kernels,tiles,velocity,advection,frames,fps,frame_ms,frame_p99_ms,"
+				 "input_ms,memory_bytes,grid_bytes,active_tiles,density_peak");
+	for (int s = 0; s < NUM_CELL_STAGES; s++)
+		fprintf(out, ",%s", CELL_STAGE_COLUMNS[s]);
+	fprintf(out, "\n");
+}
+
+
+
+/**
+ * Runs one configuration and writes its CSV line.
+ */
+static void runBench(FILE* out, const BenchConfig& config, const BenchOptions& options)
+{
+	int width = config.width, height = config.height;
+	vector<unsigned char> bounds, labels;
+	GridDownsampler* downsampler = NULL;
+	size_t memoryBefore = residentBytes();
+
+	FluidSolverMultiUser* multiUser = NULL;
+	FluidSolver* solver;
+	if (config.multiUser)
+		solver = multiUser = new FluidSolverMultiUser(MAX_USERS + 1, width, height, DT, 0.0f, 0.0f, config.density);
+	else
+		solver = new FluidSolver(width, height, DT, 0.0f, 0.0f);
+	solver->reset();
+	configureSolver(solver, config, options.iterations);
+
+	if (options.playPath) {
+		downsampler = new GridDownsampler(player.getWidth(), player.getHeight(), width, height);
+		player.rewind();
+	}
+
+	//every configuration sees the same frames, the warmup ones first
+	double solveMs = 0;
+	for (int frame = 0; frame < options.warmup + options.frames; frame++) {
+		if (frame == options.warmup) {
+			profileReset(PROFILE_GROUP_SIM);
+			solveMs = 0;
+		}
+
+		{
+			PROFILE_SCOPE(PROFILE_SIM_BOUNDS);
+			if (downsampler)
+				readRecording(*downsampler, bounds, labels);
+			else
+				drawPeople(width, height, config.users, frame, bounds, labels);
+			applyInput(solver, multiUser, width, height, bounds, labels);
+		}
+		double start = timeMs();
+		{
+			PROFILE_SCOPE(PROFILE_SIM_SOLVER);
+			solver->update();
+		}
+		solveMs += timeMs() - start;
+		profileEndFrame(PROFILE_GROUP_SIM);
+	}
+	size_t memoryAfter = residentBytes();
+
+	ProfileStats frameStats, inputStats, stats;
+	profileGetStats(PROFILE_SIM_SOLVER, &frameStats);
+	profileGetStats(PROFILE_SIM_BOUNDS, &inputStats);
+	double cells = (double)width * height;
+
+	fprintf(out, "%s,%s,%s,%d,%d,%d,%s,%s,%d,%d,%s,%d,%.2f,%.4f,%.4f,%.4f,%lu,%lu,%d,%.4f",
+			options.playPath ? "recorded" : "synthetic", config.multiUser ? "multi" : "single",
+			DENSITY_NAMES[config.density],
+			width, height, config.users, config.solver.c_str(), config.kernels->name, config.tiles ? 1 : 0,
+			config.velocity, config.advection.c_str(), options.frames, solveMs > 0 ? 1000.0 * options.frames / solveMs : 0.0,
+			solveMs / options.frames, frameStats.p99, inputStats.avg,
+			(unsigned long)(memoryAfter > memoryBefore ? memoryAfter - memoryBefore : 0),
+			(unsigned long)solver->getGridBytes(),
+			solver->getActiveTileCount(), densityPeak(solver, multiUser));
+	for (int s = 0; s < NUM_CELL_STAGES; s++) {
+		profileGetStats(CELL_STAGES[s], &stats);
+		fprintf(out, ",%.3f", stats.avg * 1e6 / cells);
+	}
+	fprintf(out, "\n");
+	fflush(out);
+
+	delete downsampler;
+	delete solver;
+}
+
+
+
+static const char* MODEL_NAMES[]     = { "single", "multi" };
+static const char* SOLVER_NAMES[]    = { "gs", "sor", "jacobi", "mg" };
+static const char* KERNEL_NAMES[]    = { "best", "scalar", "sse2", "avx", "all" };
+static const char* TILE_NAMES[]      = { "on", "off", "both" };
+static const char* ADVECTION_NAMES[] = { "sl", "mc", "mcv" };
+
+#define COUNT_OF(names) ((int)(sizeof(names) / sizeof(names[0])))
+
+
+
+/**
+ * Tells whether every value of a list option is one of names, reporting the first
+ * one that is not. A typo would otherwise run fewer configurations, or mislabel them.
+ */
+static bool checkNames(const char* option, const vector<string>& values, const char* const* names, int count)
+{
+	for (size_t k = 0; k < values.size(); k++) {
+		int n = 0;
+		while (n < count && values[k] != names[n])
+			n++;
+		if (n == count) {
+			fprintf(stderr, "Unknown %s value: %s\n", option, values[k].c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+static void printUsage(const char* name)
+{
+	fprintf(stderr, "usage : %s [options]\n", name);
+	fprintf(stderr, "where lists are comma separated and every combination is run:\n");
+	fprintf(stderr, "\t -n 128,256,512,1024   : grid sizes, N for N x N or WxH like 160x120\n");
+	fprintf(stderr, "\t -users 1,3,6          : people in the synthetic scene\n");
+	fprintf(stderr, "\t -model single,multi   : FluidSolver and/or FluidSolverMultiUser\n");
+	fprintf(stderr, "\t -density float        : user density storage of multi: float, half or unorm16\n");
+	fprintf(stderr, "\t -solver sor,mg        : gs, sor, jacobi, mg (red-black SOR with multigrid pressure)\n");
+	fprintf(stderr, "\t -kernels best         : best, scalar, sse2, avx or all\n");
+	fprintf(stderr, "\t -tiles on             : active tile tracking on, off or both\n");
+	fprintf(stderr, "\t -velocity 1           : velocity grid downsampling factors, e.g. 1,2,4\n");
+	fprintf(stderr, "\t -advect sl            : sl (semi-Lagrangian), mc (MacCormack density), mcv (and velocity)\n");
+	fprintf(stderr, "\t -frames 100           : timed frames per run\n");
+	fprintf(stderr, "\t -warmup 10            : untimed frames before them\n");
+	fprintf(stderr, "\t -iterations 20        : linear solver iteration budget\n");
+	fprintf(stderr, "\t -play file            : drive the solvers with a fluidWall -record file\n");
+	fprintf(stderr, "\t -o file               : write the CSV to file instead of stdout\n");
+	fprintf(stderr, "Stage costs need a build with FLUID_PROFILING, the default.\n");
+}
+
+
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	options.sizes      = splitSizes("128,256,512,1024");
+	options.users      = splitInts("1,3,6");
+	options.models     = splitList("single,multi");
+	options.densities  = splitList("float");
+	options.solvers    = splitList("sor,mg");
+	options.kernels    = splitList("best");
+	options.tiles      = splitList("on");
+	options.velocities = splitInts("1");
+	options.advections = splitList("sl");
+	options.frames     = 100;
+	options.warmup     = 10;
+	options.iterations = 20;
+	options.playPath   = NULL;
+	options.outPath    = NULL;
+
+	for (int k = 1; k < argc; k++) {
+		const char* arg   = argv[k];
+		const char* value = k + 1 < argc ? argv[k + 1] : NULL;
+		if (!value || arg[0] != '-' || !strcmp(arg, "-h")) {
+			printUsage(argv[0]);
+			return 1;
+		}
+		k++;
+		if      (!strcmp(arg, "-n"))          options.sizes      = splitSizes(value);
+		else if (!strcmp(arg, "-users"))      options.users      = splitInts(value);
+		else if (!strcmp(arg, "-model"))      options.models     = splitList(value);
+		else if (!strcmp(arg, "-density"))    options.densities  = splitList(value);
+		else if (!strcmp(arg, "-solver"))     options.solvers    = splitList(value);
+		else if (!strcmp(arg, "-kernels"))    options.kernels    = splitList(value);
+		else if (!strcmp(arg, "-tiles"))      options.tiles      = splitList(value);
+		else if (!strcmp(arg, "-velocity"))   options.velocities = splitInts(value);
+		else if (!strcmp(arg, "-advect"))     options.advections = splitList(value);
+		else if (!strcmp(arg, "-frames"))     options.frames     = atoi(value);
+		else if (!strcmp(arg, "-warmup"))     options.warmup     = atoi(value);
+		else if (!strcmp(arg, "-iterations")) options.iterations = atoi(value);
+		else if (!strcmp(arg, "-play"))       options.playPath   = value;
+		else if (!strcmp(arg, "-o"))          options.outPath    = value;
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	bool known = checkNames("-model",   options.models,     MODEL_NAMES,     COUNT_OF(MODEL_NAMES))
+			  && checkNames("-density", options.densities,  DENSITY_NAMES,   COUNT_OF(DENSITY_NAMES))
+			  && checkNames("-solver",  options.solvers,    SOLVER_NAMES,    COUNT_OF(SOLVER_NAMES))
+			  && checkNames("-kernels", options.kernels,    KERNEL_NAMES,    COUNT_OF(KERNEL_NAMES))
+			  && checkNames("-tiles",   options.tiles,      TILE_NAMES,      COUNT_OF(TILE_NAMES))
+			  && checkNames("-advect",  options.advections, ADVECTION_NAMES, COUNT_OF(ADVECTION_NAMES));
+	for (size_t v = 0; v < options.velocities.size() && known; v++)
+		if (options.velocities[v] < 1) {
+			fprintf(stderr, "Unknown -velocity value: %d\n", options.velocities[v]);
+			known = false;
+		}
+	if (!known) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (options.frames < 1)
+		options.frames = 1;
+
+	if (options.playPath) {
+		if (!player.open(options.playPath)) {
+			fprintf(stderr, "Cannot play %s\n", options.playPath);
+			return 1;
+		}
+		player.setPlayback(false, true);
+		//the people come from the recording
+		options.users.assign(1, 0);
+	}
+
+	vector<const FluidKernels*> kernels;
+	for (size_t k = 0; k < options.kernels.size(); k++) {
+		const string& name = options.kernels[k];
+		if (name == "best")                      kernels.push_back(&getFluidKernels());
+		if (name == "scalar" || name == "all")   kernels.push_back(&getScalarKernels());
+		if (name == "sse2"   || name == "all")   kernels.push_back(&getSse2Kernels());
+		if ((name == "avx"   || name == "all") && getAvxKernels())
+			kernels.push_back(getAvxKernels());
+		else if (name == "avx")
+			fprintf(stderr, "This build has no AVX kernels, skipping them\n");
+	}
+
+	vector<FluidSolverMultiUser::DensityStorage> densities;
+	for (size_t k = 0; k < options.densities.size(); k++)
+		for (int d = 0; d < COUNT_OF(DENSITY_NAMES); d++)
+			if (options.densities[k] == DENSITY_NAMES[d])
+				densities.push_back((FluidSolverMultiUser::DensityStorage) d);
+
+	vector<bool> tiles;
+	for (size_t k = 0; k < options.tiles.size(); k++) {
+		if (options.tiles[k] != "off") tiles.push_back(true);
+		if (options.tiles[k] != "on")  tiles.push_back(false);
+	}
+
+	FILE* out = options.outPath ? fopen(options.outPath, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "Cannot write %s\n", options.outPath);
+		return 1;
+	}
+	writeHeader(out);
+
+	BenchConfig config;
+	for (size_t kk = 0; kk < kernels.size(); kk++)
+	for (size_t t  = 0; t  < tiles.size(); t++)
+	for (size_t v  = 0; v  < options.velocities.size(); v++)
+	for (size_t a  = 0; a  < options.advections.size(); a++)
+	for (size_t s  = 0; s  < options.solvers.size(); s++)
+	for (size_t m  = 0; m  < options.models.size(); m++)
+	for (size_t d  = 0; d  < densities.size(); d++)
+	for (size_t n  = 0; n  < options.sizes.size(); n++)
+	for (size_t u  = 0; u  < options.users.size(); u++) {
+		config.kernels   = kernels[kk];
+		config.tiles     = tiles[t];
+		config.velocity  = options.velocities[v];
+		config.advection = options.advections[a];
+		config.solver    = options.solvers[s];
+		config.multiUser = options.models[m] == "multi";
+		config.density   = config.multiUser ? densities[d] : FluidSolverMultiUser::DENSITY_FLOAT;
+		config.width     = options.sizes[n].width;
+		config.height    = options.sizes[n].height;
+		config.users     = options.users[u];
+		//the single user solver has one storage, run it once
+		if (config.width >= 4 && config.height >= 4 && (config.multiUser || d == 0))
+			runBench(out, config, options);
+	}
+
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,394 @@
+/**
+ * @file      CaptureStream.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "CaptureStream.h"
+#include "Threading.h"
+#include <string.h>
+
+//file layout, all integers little endian:
+//  header  "FWCS", version, width, height                      4 x 4 bytes
+//  frame   time in ms (double), depth plane, users plane
+//  plane   size in bytes (4 bytes), then pairs of varints: bytes unchanged from
+//          the previous frame, bytes changed, followed by the changed bytes
+static const char  STREAM_MAGIC[4] = { 'F', 'W', 'C', 'S' };
+static const int   STREAM_VERSION  = 1;
+static const int   HEADER_BYTES    = 16;
+//unchanged bytes that end a run of changed ones; shorter gaps are stored inline,
+//which costs less than the two varints of a new pair
+static const int   MIN_SKIP        = 4;
+//real time playback further behind than this starts its clock over
+static const double MAX_LAG_MS     = 1000.0;
+
+
+
+static void putU32(vector<uchar>& out, unsigned value)
+{
+	for (int k = 0; k < 4; k++)
+		out.push_back((uchar)(value >> (8 * k)));
+}
+
+static unsigned getU32(const uchar* in)
+{
+	return in[0] | (in[1] << 8) | (in[2] << 16) | ((unsigned)in[3] << 24);
+}
+
+static void putVarint(vector<uchar>& out, size_t value)
+{
+	while (value >= 0x80) {
+		out.push_back((uchar)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uchar)value);
+}
+
+/**
+ * Reads a varint from data[pos, end).
+ * @return False if it runs past end.
+ */
+static bool getVarint(const uchar* data, size_t& pos, size_t end, size_t& value)
+{
+	value = 0;
+	for (int shift = 0; pos < end && shift < 64; shift += 7) {
+		uchar b = data[pos++];
+		value |= (size_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+
+
+CaptureRecorder::CaptureRecorder(void)
+{
+	file_    = NULL;
+	width_   = 0;
+	height_  = 0;
+	frames_  = 0;
+	startMs_ = 0;
+}
+
+
+
+CaptureRecorder::~CaptureRecorder(void)
+{
+	close();
+}
+
+
+
+bool CaptureRecorder::open(const char* path, int width, int height)
+{
+	close();
+	file_ = fopen(path, "wb");
+	if (!file_)
+		return false;
+
+	width_  = width;
+	height_ = height;
+	frames_ = 0;
+	//the first frame is stored against black images
+	prevDepth_.assign(width * height, 0);
+	prevUsers_.assign(width * height, 0);
+
+	encoded_.clear();
+	encoded_.insert(encoded_.end(), STREAM_MAGIC, STREAM_MAGIC + 4);
+	putU32(encoded_, STREAM_VERSION);
+	putU32(encoded_, width);
+	putU32(encoded_, height);
+	fwrite(&encoded_[0], 1, encoded_.size(), file_);
+	return true;
+}
+
+
+
+void CaptureRecorder::writeFrame(const Mat& depth, const Mat& users, double timeMs)
+{
+	if (!file_ || depth.cols != width_ || depth.rows != height_ || 
+		users.cols != width_ || users.rows != height_)
+		return;
+
+	if (frames_ == 0)
+		startMs_ = timeMs;
+	double t = timeMs - startMs_;
+
+	encoded_.resize(sizeof(double));
+	memcpy(&encoded_[0], &t, sizeof(double));
+	encodePlane(depth, prevDepth_);
+	encodePlane(users, prevUsers_);
+	fwrite(&encoded_[0], 1, encoded_.size(), file_);
+	frames_++;
+}
+
+
+
+void CaptureRecorder::encodePlane(const Mat& image, vector<uchar>& prev)
+{
+	Mat plane = image.isContinuous() ? image : image.clone();
+	const uchar* cur = plane.ptr<uchar>();
+	size_t size = prev.size();
+	size_t sizePos = encoded_.size();
+	size_t i = 0;
+
+	putU32(encoded_, 0);
+	while (i < size) {
+		size_t skipStart = i;
+		while (i < size && cur[i] == prev[i])
+			i++;
+
+		//changed bytes run until MIN_SKIP unchanged ones in a row
+		size_t literalStart = i, literalEnd = i, same = 0;
+		while (i < size) {
+			if (cur[i] != prev[i]) {
+				same = 0;
+				literalEnd = i + 1;
+			}
+			else if (++same == MIN_SKIP)
+				break;
+			i++;
+		}
+		i = literalEnd;
+
+		putVarint(encoded_, literalStart - skipStart);
+		putVarint(encoded_, literalEnd - literalStart);
+		encoded_.insert(encoded_.end(), cur + literalStart, cur + literalEnd);
+		memcpy(&prev[literalStart], cur + literalStart, literalEnd - literalStart);
+	}
+
+	unsigned bytes = (unsigned)(encoded_.size() - sizePos - 4);
+	for (int k = 0; k < 4; k++)
+		encoded_[sizePos + k] = (uchar)(bytes >> (8 * k));
+}
+
+
+
+void CaptureRecorder::close()
+{
+	if (file_)
+		fclose(file_);
+	file_ = NULL;
+}
+
+
+
+bool CaptureRecorder::isOpen()
+{
+	return file_ != NULL;
+}
+
+
+
+int CaptureRecorder::getFrameCount()
+{
+	return frames_;
+}
+
+
+
+CapturePlayer::CapturePlayer(void)
+{
+	width_     = 0;
+	height_    = 0;
+	current_   = -1;
+	realTime_  = true;
+	loop_      = true;
+	startMs_   = 0;
+	frameTime_ = 0;
+}
+
+
+
+bool CapturePlayer::open(const char* path)
+{
+	data_.clear();
+	offsets_.clear();
+	current_ = -1;
+
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (length > 0) {
+		data_.resize(length);
+		if (fread(&data_[0], 1, length, file) != (size_t)length)
+			data_.clear();
+	}
+	fclose(file);
+
+	if (data_.size() < (size_t)HEADER_BYTES || memcmp(&data_[0], STREAM_MAGIC, 4) != 0 ||
+		getU32(&data_[4]) != STREAM_VERSION) {
+		printf("%s is not a capture recording\n", path);
+		data_.clear();
+		return false;
+	}
+	width_  = getU32(&data_[8]);
+	height_ = getU32(&data_[12]);
+
+	//index the frames; a truncated last frame, from a recording cut short, is dropped
+	size_t pos = HEADER_BYTES;
+	while (pos + sizeof(double) <= data_.size()) {
+		size_t frame = pos;
+		int plane;
+		pos += sizeof(double);
+		for (plane = 0; plane < 2 && pos + 4 <= data_.size(); plane++)
+			pos += 4 + getU32(&data_[pos]);
+		if (plane < 2 || pos > data_.size())
+			break;
+		offsets_.push_back(frame);
+	}
+
+	depth_ = Mat::zeros(height_, width_, CV_8UC1);
+	users_ = Mat::zeros(height_, width_, CV_8UC1);
+	return !offsets_.empty();
+}
+
+
+
+void CapturePlayer::setPlayback(bool realTime, bool loop)
+{
+	realTime_ = realTime;
+	loop_     = loop;
+}
+
+
+
+void CapturePlayer::rewind()
+{
+	current_ = -1;
+}
+
+
+
+bool CapturePlayer::grabFrame()
+{
+	int next = current_ + 1;
+	if (next >= (int)offsets_.size()) {
+		if (!loop_ || offsets_.empty())
+			return false;
+		next = 0;
+	}
+	if (next == 0) {
+		depth_.setTo(Scalar::all(0));
+		users_.setTo(Scalar::all(0));
+	}
+
+	size_t pos = offsets_[next];
+	memcpy(&frameTime_, &data_[pos], sizeof(double));
+	pos += sizeof(double);
+
+	if (realTime_) {
+		double now = timeMs();
+		if (next == 0 || now - (startMs_ + frameTime_) > MAX_LAG_MS)
+			startMs_ = now - frameTime_;
+		double wait = startMs_ + frameTime_ - now;
+		if (wait > 0)
+			sleepMs((int)wait);
+	}
+
+	pos = decodePlane(pos, depth_);
+	if (pos)
+		pos = decodePlane(pos, users_);
+	if (!pos) {
+		printf("Capture recording is damaged at frame %d\n", next);
+		offsets_.resize(next);
+		current_ = -1;
+		return false;
+	}
+	current_ = next;
+	return true;
+}
+
+
+
+size_t CapturePlayer::decodePlane(size_t pos, Mat& image)
+{
+	const uchar* data = &data_[0];
+	size_t end = pos + 4 + getU32(data + pos);
+	size_t size = image.rows * image.cols;
+	uchar* out = image.ptr<uchar>();
+	size_t i = 0;
+
+	pos += 4;
+	while (pos < end) {
+		size_t skip, count;
+		if (!getVarint(data, pos, end, skip) || !getVarint(data, pos, end, count))
+			return 0;
+		if (i + skip + count > size || pos + count > end)
+			return 0;
+		i += skip;
+		memcpy(out + i, data + pos, count);
+		i   += count;
+		pos += count;
+	}
+	return end;
+}
+
+
+
+const Mat& CapturePlayer::getDepthMat() const
+{
+	return depth_;
+}
+
+
+
+const Mat& CapturePlayer::getUsersMat() const
+{
+	return users_;
+}
+
+
+
+int CapturePlayer::getFrameCount()
+{
+	return (int)offsets_.size();
+}
+
+
+
+int CapturePlayer::getFrameIndex()
+{
+	return current_;
+}
+
+
+
+double CapturePlayer::getFrameTime()
+{
+	return frameTime_;
+}
+
+
+
+int CapturePlayer::getWidth()
+{
+	return width_;
+}
+
+
+
+int CapturePlayer::getHeight()
+{
+	return height_;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file      CaptureStream.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <cv.h>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * A source of sensor frames: a depth image and a user label image of the same size,
+ * both CV_8UC1, as KinectController produces them.
+ */
+class CaptureSource
+{
+public:
+	virtual ~CaptureSource() {}
+
+	/**
+	 * Moves to the next frame.
+	 * @return False if there is none; the matrices then keep the last frame.
+	 */
+	virtual bool grabFrame() = 0;
+
+	/** Depth of the current frame, overwritten by the next grabFrame(). */
+	virtual const Mat& getDepthMat() const = 0;
+	/** User labels of the current frame, overwritten by the next grabFrame(). */
+	virtual const Mat& getUsersMat() const = 0;
+};
+
+
+
+/**
+ * Writes capture frames to a file for CapturePlayer.
+ *
+ * The file starts with a header holding the frame size. Every frame holds its time
+ * and both images, each stored as the difference to the same image of the previous
+ * frame: runs of unchanged bytes are skipped and changed bytes stored as they are.
+ * A person moving in front of the wall changes a small part of each frame, so a
+ * session is a few percent of its raw size.
+ */
+class CaptureRecorder
+{
+public:
+	CaptureRecorder(void);
+	~CaptureRecorder(void);
+
+	/**
+	 * Creates the file, replacing any existing one.
+	 * @return False if it could not be created.
+	 */
+	bool open(const char* path, int width, int height);
+
+	/**
+	 * Appends a frame. Frames of another size than the one passed to open() are skipped.
+	 * @param timeMs  capture time, on any clock; stored relative to the first frame
+	 */
+	void writeFrame(const Mat& depth, const Mat& users, double timeMs);
+
+	void close();
+
+	bool isOpen();
+
+	/**
+	 * Accessor: frames written since open().
+	 */
+	int getFrameCount();
+
+protected:
+	FILE*         file_;
+	int           width_;
+	int           height_;
+	int           frames_;
+	double        startMs_;
+	vector<uchar> prevDepth_;
+	vector<uchar> prevUsers_;
+	vector<uchar> encoded_;
+
+	void encodePlane(const Mat& image, vector<uchar>& prev);
+};
+
+
+
+/**
+ * Plays a file written by CaptureRecorder back as a CaptureSource.
+ *
+ * The file is read into memory by open(), so playback does no disk access. In real 
+ * time mode grabFrame() waits until a frame is due, keeping the recorded pace; 
+ * otherwise it returns the next frame right away, for benchmarks. The same file 
+ * always gives the same frames in the same order.
+ */
+class CapturePlayer : public CaptureSource
+{
+public:
+	CapturePlayer(void);
+
+	/**
+	 * Loads a recording.
+	 * @return False if the file could not be read or is not a recording.
+	 */
+	bool open(const char* path);
+
+	/**
+	 * @param realTime  wait for each frame's recorded time
+	 * @param loop      start over after the last frame instead of stopping
+	 */
+	void setPlayback(bool realTime, bool loop);
+
+	/**
+	 * Goes back to the first frame.
+	 */
+	void rewind();
+
+	bool grabFrame();
+	const Mat& getDepthMat() const;
+	const Mat& getUsersMat() const;
+
+	/** Accessor: frames in the recording. */
+	int getFrameCount();
+	/** Accessor: index of the current frame, -1 before the first grabFrame(). */
+	int getFrameIndex();
+	/** Accessor: recorded time of the current frame, from the first frame. */
+	double getFrameTime();
+
+	int getWidth();
+	int getHeight();
+
+protected:
+	vector<uchar>  data_;
+	vector<size_t> offsets_;   //start of every frame in data_
+	int            width_;
+	int            height_;
+	int            current_;
+	bool           realTime_;
+	bool           loop_;
+	double         startMs_;   //wall time frame 0 was due
+	double         frameTime_;
+	Mat            depth_;
+	Mat            users_;
+
+	/**
+	 * Applies the plane starting at data_[pos] to image.
+	 * @return Position after the plane, 0 if it is damaged.
+	 */
+	size_t decodePlane(size_t pos, Mat& image);
+};
@@ -0,0 +1,249 @@
+/**
+ * @file      EmitterPool.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "EmitterPool.h"
+
+
+
+EmitterPool::EmitterPool(int capacity, OverflowPolicy policy, float mergeDistance)
+{
+	capacity_      = capacity > 0 ? capacity : 1;
+	count_         = 0;
+	policy_        = policy;
+	mergeDistance_ = mergeDistance;
+	overflows_     = 0;
+	serial_        = 0;
+
+	x_.resize(capacity_);
+	y_.resize(capacity_);
+	u_.resize(capacity_);
+	v_.resize(capacity_);
+	lifespan_.resize(capacity_);
+	elapsed_.resize(capacity_);
+	radius_.resize(capacity_);
+	userNo_.resize(capacity_);
+	born_.resize(capacity_);
+}
+
+
+
+void EmitterPool::spawn(int x, int y, float u, float v, int lifespan, int radius, int userNo)
+{
+	int k = count_;
+
+	if (count_ == capacity_) {
+		overflows_++;
+		k = makeRoom(x, y, u, v, lifespan, radius, userNo);
+		if (k < 0)
+			return;
+	}
+	else
+		count_++;
+
+	set(k, x, y, u, v, lifespan, radius, userNo);
+}
+
+
+
+int EmitterPool::makeRoom(int x, int y, float u, float v, int lifespan, int radius, int userNo)
+{
+	int k, best = -1;
+
+	if (policy_ == MERGE_NEAREST) {
+		float bestDist = mergeDistance_ * mergeDistance_;
+		for (k = 0; k < count_; k++) {
+			if (userNo_[k] != userNo) continue;
+			float dx = (float)(x_[k] - x), dy = (float)(y_[k] - y);
+			float dist = dx * dx + dy * dy;
+			if (dist <= bestDist) {
+				bestDist = dist;
+				best     = k;
+			}
+		}
+
+		if (best >= 0) {
+			u_[best]        = 0.5f * (u_[best] + u);
+			v_[best]        = 0.5f * (v_[best] + v);
+			lifespan_[best] = lifespan > lifespan_[best] ? lifespan : lifespan_[best];
+			radius_[best]   = radius > radius_[best] ? radius : radius_[best];
+			elapsed_[best]  = 0;
+			return -1;
+		}
+	}
+
+	//serials only grow, so the oldest emitter has the smallest one (modulo wrap)
+	best = 0;
+	for (k = 1; k < count_; k++)
+		if ((int)(born_[k] - born_[best]) < 0)
+			best = k;
+	return best;
+}
+
+
+
+void EmitterPool::set(int k, int x, int y, float u, float v, int lifespan, int radius, int userNo)
+{
+	x_[k]        = x;
+	y_[k]        = y;
+	u_[k]        = u;
+	v_[k]        = v;
+	lifespan_[k] = lifespan;
+	elapsed_[k]  = 0;
+	radius_[k]   = radius;
+	userNo_[k]   = userNo;
+	born_[k]     = serial_++;
+}
+
+
+
+void EmitterPool::remove(int k)
+{
+	if (k < 0 || k >= count_)
+		return;
+
+	int last = --count_;
+	x_[k]        = x_[last];
+	y_[k]        = y_[last];
+	u_[k]        = u_[last];
+	v_[k]        = v_[last];
+	lifespan_[k] = lifespan_[last];
+	elapsed_[k]  = elapsed_[last];
+	radius_[k]   = radius_[last];
+	userNo_[k]   = userNo_[last];
+	born_[k]     = born_[last];
+}
+
+
+
+void EmitterPool::removeExpired()
+{
+	int k = 0;
+
+	//a removed slot receives the last emitter, which has to be tested too
+	while (k < count_) {
+		if (elapsed_[k] >= lifespan_[k])
+			remove(k);
+		else
+			k++;
+	}
+}
+
+
+
+void EmitterPool::age()
+{
+	for (int k = 0; k < count_; k++)
+		elapsed_[k]++;
+}
+
+
+
+void EmitterPool::clear()
+{
+	count_     = 0;
+	overflows_ = 0;
+}
+
+
+
+void EmitterPool::setOverflowPolicy(OverflowPolicy policy, float mergeDistance)
+{
+	policy_        = policy;
+	mergeDistance_ = mergeDistance;
+}
+
+
+
+//accessors
+int EmitterPool::size()
+{
+	return count_;
+}
+
+
+
+int EmitterPool::getCapacity()
+{
+	return capacity_;
+}
+
+
+
+int EmitterPool::getOverflowCount()
+{
+	return overflows_;
+}
+
+
+
+const int* EmitterPool::getCenterX()
+{
+	return &x_[0];
+}
+
+
+
+const int* EmitterPool::getCenterY()
+{
+	return &y_[0];
+}
+
+
+
+const float* EmitterPool::getVelocityX()
+{
+	return &u_[0];
+}
+
+
+
+const float* EmitterPool::getVelocityY()
+{
+	return &v_[0];
+}
+
+
+
+const int* EmitterPool::getLifespan()
+{
+	return &lifespan_[0];
+}
+
+
+
+const int* EmitterPool::getLifeElapsed()
+{
+	return &elapsed_[0];
+}
+
+
+
+const int* EmitterPool::getRadius()
+{
+	return &radius_[0];
+}
+
+
+
+const int* EmitterPool::getUserNo()
+{
+	return &userNo_[0];
+}
@@ -0,0 +1,135 @@
+/**
+ * @file      EmitterPool.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+
+using namespace std;
+
+/**
+ * Fixed capacity set of splash emitters, stored one array per property.
+ *
+ * Spawning appends and removal moves the last emitter into the freed slot, so
+ * both are O(1) and emitters are not kept in any particular order. Once the pool
+ * is full, a spawn either replaces the oldest emitter or is merged into a nearby
+ * emitter of the same user; either way the pool, and the work done per step, 
+ * never grows past its capacity.
+ */
+class EmitterPool
+{
+public:
+	/**
+	 * What spawn() does when the pool is full.
+	 *
+	 * DROP_OLDEST replaces the emitter spawned first. MERGE_NEAREST folds the new
+	 * emitter into the closest one of the same user within the merge distance,
+	 * averaging their velocities and restarting its life, and falls back to 
+	 * DROP_OLDEST when there is none.
+	 */
+	enum OverflowPolicy {
+		DROP_OLDEST,
+		MERGE_NEAREST
+	};
+
+	/**
+	 * @param capacity       maximum number of live emitters
+	 * @param policy         behavior of spawn() on a full pool
+	 * @param mergeDistance  largest center distance, in cells, for MERGE_NEAREST
+	 */
+	EmitterPool(int capacity, OverflowPolicy policy = DROP_OLDEST, float mergeDistance = 3.0f);
+
+	/**
+	 * Adds an emitter. O(1) while the pool has room, O(capacity) when it is full.
+	 *
+	 * @param x, y      center cell
+	 * @param u, v      velocity added at the rim of the emitter
+	 * @param lifespan  steps the emitter lives
+	 * @param radius    half width of the emitter's square footprint, in cells
+	 * @param userNo    user the density is added for, in the multi user modes
+	 */
+	void spawn(int x, int y, float u, float v, int lifespan, int radius, int userNo);
+
+	/**
+	 * Removes emitter k by moving the last emitter into its place.
+	 */
+	void remove(int k);
+
+	/**
+	 * Removes every emitter that has lived its whole lifespan.
+	 */
+	void removeExpired();
+
+	/**
+	 * Advances the life of every emitter by one step.
+	 */
+	void age();
+
+	void clear();
+
+	void setOverflowPolicy(OverflowPolicy policy, float mergeDistance);
+
+	int size();
+	int getCapacity();
+
+	/**
+	 * Accessor: spawns that found the pool full since the last clear().
+	 */
+	int getOverflowCount();
+
+	/**
+	 * Accessors: one entry per live emitter, 0 .. size()-1. Valid until the next
+	 * spawn, remove or clear.
+	 */
+	const int*   getCenterX();
+	const int*   getCenterY();
+	const float* getVelocityX();
+	const float* getVelocityY();
+	const int*   getLifespan();
+	const int*   getLifeElapsed();
+	const int*   getRadius();
+	const int*   getUserNo();
+
+protected:
+	int   capacity_;
+	int   count_;
+	OverflowPolicy policy_;
+	float mergeDistance_;
+	int   overflows_;
+	unsigned serial_;            //spawn counter, orders emitters by age
+
+	vector<int>      x_;
+	vector<int>      y_;
+	vector<float>    u_;
+	vector<float>    v_;
+	vector<int>      lifespan_;
+	vector<int>      elapsed_;
+	vector<int>      radius_;
+	vector<int>      userNo_;
+	vector<unsigned> born_;      //serial_ at spawn
+
+	/**
+	 * Picks the slot a spawn on a full pool overwrites, or merges into it.
+	 * @return Slot to overwrite, or -1 when the new emitter was merged.
+	 */
+	int makeRoom(int x, int y, float u, float v, int lifespan, int radius, int userNo);
+
+	void set(int k, int x, int y, float u, float v, int lifespan, int radius, int userNo);
+};
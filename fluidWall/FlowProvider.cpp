@@ -0,0 +1,150 @@
+/**
+ * @file      FlowProvider.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FlowProvider.h"
+#include <opencv2/video/tracking.hpp>
+
+
+
+/*
+  ----------------------------------------------------------------------
+   FarnebackFlowProvider
+  ----------------------------------------------------------------------
+*/
+
+FarnebackFlowProvider::FarnebackFlowProvider(int changeThreshold, int margin, 
+											 int coldIterations, int warmIterations)
+{
+	changeThreshold_ = changeThreshold;
+	margin_          = margin;
+	coldIterations_  = coldIterations;
+	warmIterations_  = warmIterations;
+	warm_            = false;
+}
+
+
+
+void FarnebackFlowProvider::computeFlow(const Mat& prev, const Mat& next, Mat& flow)
+{
+	roi_ = findRoi(prev, next);
+	bool warm = warm_ && roi_.area() > 0 && flow.size() == next.size() && flow.type() == CV_32FC2;
+
+	if(warm)
+		flow(roi_).copyTo(roiFlow_);
+	flow.create(next.size(), CV_32FC2);
+	flow.setTo(Scalar::all(0));
+	if(roi_.area() == 0)
+		return;
+
+	calcOpticalFlowFarneback(prev(roi_), next(roi_), roiFlow_, 0.5, 3, 15, 
+							 warm ? warmIterations_ : coldIterations_, 5, 1.2, 
+							 warm ? OPTFLOW_USE_INITIAL_FLOW : 0);
+
+	//a header on the region, so the copy lands in flow itself
+	Mat flowDst = flow(roi_);
+	roiFlow_.copyTo(flowDst);
+	warm_ = true;
+}
+
+
+
+void FarnebackFlowProvider::reset()
+{
+	warm_ = false;
+}
+
+
+
+const char* FarnebackFlowProvider::getName()
+{
+	return "dense";
+}
+
+
+
+Rect FarnebackFlowProvider::getLastRoi()
+{
+	return roi_;
+}
+
+
+
+Rect FarnebackFlowProvider::findRoi(const Mat& prev, const Mat& next)
+{
+	int x, y;
+	int x0 = next.cols, y0 = next.rows, x1 = -1, y1 = -1;
+
+	absdiff(prev, next, diff_);
+	for(y = 0; y < diff_.rows; y++) {
+		const uchar* row = diff_.ptr<uchar>(y);
+		for(x = 0; x < diff_.cols; x++)
+			if(row[x] > changeThreshold_) {
+				x0 = min(x0, x); x1 = max(x1, x);
+				y0 = min(y0, y); y1 = max(y1, y);
+			}
+	}
+	if(x1 < 0)
+		return Rect();
+
+	x0 = max(x0 - margin_, 0);
+	y0 = max(y0 - margin_, 0);
+	x1 = min(x1 + margin_, next.cols - 1);
+	y1 = min(y1 + margin_, next.rows - 1);
+	return Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+
+
+/*
+  ----------------------------------------------------------------------
+   LucasKanadeFlowProvider
+  ----------------------------------------------------------------------
+*/
+
+vector<Point2f>& LucasKanadeFlowProvider::getPoints()
+{
+	return points_;
+}
+
+
+
+void LucasKanadeFlowProvider::computeFlow(const Mat& prev, const Mat& next, Mat& flow)
+{
+	flow.create(next.size(), CV_32FC2);
+	flow.setTo(Scalar::all(0));
+	if(points_.empty())
+		return;
+
+	calcOpticalFlowPyrLK(prev, next, points_, nextPoints_, status_, error_);
+	for(size_t k = 0; k < points_.size(); k++) {
+		const Point2f& p = points_[k];
+		int x = (int)p.x, y = (int)p.y;
+		if(status_[k] && x >= 0 && y >= 0 && x < flow.cols && y < flow.rows)
+			flow.at<Point2f>(y, x) = nextPoints_[k] - p;
+	}
+}
+
+
+
+const char* LucasKanadeFlowProvider::getName()
+{
+	return "sparse";
+}
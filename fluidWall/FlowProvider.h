@@ -0,0 +1,127 @@
+/**
+ * @file      FlowProvider.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <cv.h>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Optical flow between two consecutive frames of the grid sized sensor image.
+ *
+ * Frames are grid sized CV_8UC1, the flow is the same size in CV_32FC2, holding the displacement of
+ * each pixel from prev to next, in pixels. Pixels a provider does not estimate are
+ * zero. Row y-1 of the flow belongs to grid row y, like the bounds mask.
+ */
+class FlowProvider
+{
+public:
+	virtual ~FlowProvider() {}
+
+	/**
+	 * @param prev  earlier frame
+	 * @param next  current frame
+	 * @param flow  output; holds the previous result, which providers may use as a guess
+	 */
+	virtual void computeFlow(const Mat& prev, const Mat& next, Mat& flow) = 0;
+
+	/**
+	 * Forgets what was carried over from earlier frames.
+	 */
+	virtual void reset() {}
+
+	virtual const char* getName() = 0;
+};
+
+
+
+/**
+ * Dense Farneback flow, restricted to the part of the frame that changed.
+ *
+ * The region is the bounding box of the pixels whose value changed by more than a
+ * threshold, grown by a margin of about one flow window. Outside it the flow is zero.
+ * When the last result is available it is used as the initial guess, and fewer
+ * iterations are run.
+ */
+class FarnebackFlowProvider : public FlowProvider
+{
+public:
+	/**
+	 * @param changeThreshold  pixel difference that counts as motion
+	 * @param margin           pixels the motion box is grown by on every side
+	 * @param coldIterations   Farneback iterations from a zero guess
+	 * @param warmIterations   iterations when starting from the previous flow
+	 */
+	FarnebackFlowProvider(int changeThreshold = 8, int margin = 16, 
+						  int coldIterations = 3, int warmIterations = 1);
+
+	void computeFlow(const Mat& prev, const Mat& next, Mat& flow);
+	void reset();
+	const char* getName();
+
+	/**
+	 * Accessor: the region the last computeFlow() ran on, empty if nothing moved.
+	 */
+	Rect getLastRoi();
+
+protected:
+	int  changeThreshold_;
+	int  margin_;
+	int  coldIterations_;
+	int  warmIterations_;
+	bool warm_;          //the flow passed in is our last result
+	Rect roi_;
+	Mat  diff_;
+	Mat  roiFlow_;
+
+	/**
+	 * Finds the grown bounding box of the changed pixels.
+	 * @return  Box to compute flow in, empty when nothing changed.
+	 */
+	Rect findRoi(const Mat& prev, const Mat& next);
+};
+
+
+
+/**
+ * Sparse pyramidal Lucas-Kanade flow at a given set of points, typically the
+ * silhouette cells splashes are emitted from. Much cheaper than dense flow; every
+ * other pixel of the flow is zero.
+ */
+class LucasKanadeFlowProvider : public FlowProvider
+{
+public:
+	/**
+	 * Accessor: the pixels the next computeFlow() tracks, for the caller to fill in place.
+	 */
+	vector<Point2f>& getPoints();
+
+	void computeFlow(const Mat& prev, const Mat& next, Mat& flow);
+	const char* getName();
+
+protected:
+	vector<Point2f> points_;
+	vector<Point2f> nextPoints_;
+	vector<uchar>   status_;
+	vector<float>   error_;
+};
@@ -0,0 +1,271 @@
+/**
+ * @file      FlowProviderGPU.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FlowProviderGPU.h"
+#include <stdio.h>
+#include <string.h>
+
+
+
+//one refinement pass: solve the window's Lucas-Kanade system at the current estimate.
+//Intensities are in 0..1, the flow in pixels.
+static const char* LUCAS_KANADE_SHADER =
+	"#version 130\n"
+	"uniform sampler2D prev, next, flow;\n"
+	"uniform ivec2 size;\n"
+	"uniform int radius;\n"
+	"float img(sampler2D s, vec2 p) { return texture(s, (p + 0.5) / vec2(size)).r; }\n"
+	"void main() {\n"
+	"	ivec2 c = ivec2(gl_FragCoord.xy);\n"
+	"	vec2 d = texelFetch(flow, c, 0).rg;\n"
+	"	float gxx = 0.0, gxy = 0.0, gyy = 0.0, bx = 0.0, by = 0.0;\n"
+	"	for (int dy = -radius; dy <= radius; dy++)\n"
+	"		for (int dx = -radius; dx <= radius; dx++) {\n"
+	"			vec2 p = vec2(c + ivec2(dx, dy));\n"
+	"			float ix = 0.5 * (img(prev, p + vec2(1.0, 0.0)) - img(prev, p - vec2(1.0, 0.0)));\n"
+	"			float iy = 0.5 * (img(prev, p + vec2(0.0, 1.0)) - img(prev, p - vec2(0.0, 1.0)));\n"
+	"			float it = img(next, p + d) - img(prev, p);\n"
+	"			gxx += ix * ix; gxy += ix * iy; gyy += iy * iy;\n"
+	"			bx  += ix * it; by  += iy * it;\n"
+	"		}\n"
+	//flat windows have no defined flow, leave them where they are (zero on the first pass)
+	"	float det = gxx * gyy - gxy * gxy;\n"
+	"	vec2 step = det > 1e-6 ? vec2(gxy * by - gyy * bx, gxy * bx - gxx * by) / det : vec2(0.0);\n"
+	"	gl_FragColor = vec4(d + clamp(step, -float(radius), float(radius)), 0.0, 0.0);\n"
+	"}\n";
+
+
+
+GpuFlowProvider::GpuFlowProvider(int radius, int iterations)
+{
+	radius_      = radius;
+	iterations_  = iterations;
+	width_       = 0;
+	height_      = 0;
+	glReady_     = false;
+	glFailed_    = false;
+	program_     = 0;
+	framebuffer_ = 0;
+	cur_         = 0;
+	memset(frames_, 0, sizeof(frames_));
+	memset(flow_,   0, sizeof(flow_));
+}
+
+
+
+GpuFlowProvider::~GpuFlowProvider(void)
+{
+	releaseGl();
+}
+
+
+
+bool GpuFlowProvider::isSupported()
+{
+	return loadGlExtensions();
+}
+
+
+
+void GpuFlowProvider::computeFlow(const Mat& prev, const Mat& next, Mat& flow)
+{
+	flow.create(next.size(), CV_32FC2);
+
+	if ((!glReady_ || width_ != next.cols || height_ != next.rows) && !glFailed_)
+		glFailed_ = !initGl(next.cols, next.rows);
+	if (glFailed_) {
+		flow.setTo(Scalar::all(0));
+		return;
+	}
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glPushAttrib(GL_VIEWPORT_BIT | GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+	glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);  glPushMatrix(); glLoadIdentity();
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glViewport(0, 0, width_, height_);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+	uploadFrame(frames_[0], prev);
+	uploadFrame(frames_[1], next);
+
+	//every frame starts from zero, so flat areas never keep a stale flow
+	fwglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, flow_[cur_], 0);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	fwglUseProgram(program_);
+	fwglUniform2i(fwglGetUniformLocation(program_, "size"), width_, height_);
+	fwglUniform1i(fwglGetUniformLocation(program_, "radius"), radius_);
+	fwglUniform1i(fwglGetUniformLocation(program_, "prev"), 0);
+	fwglUniform1i(fwglGetUniformLocation(program_, "next"), 1);
+	fwglUniform1i(fwglGetUniformLocation(program_, "flow"), 2);
+	fwglActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, frames_[0]);
+	fwglActiveTexture(GL_TEXTURE0 + 1); glBindTexture(GL_TEXTURE_2D, frames_[1]);
+	fwglActiveTexture(GL_TEXTURE0 + 2);
+
+	for (int k = 0; k < iterations_; k++) {
+		int back = 1 - cur_;
+		glBindTexture(GL_TEXTURE_2D, flow_[cur_]);
+		fwglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, flow_[back], 0);
+
+		glBegin(GL_QUADS);
+			glVertex2f(-1.0f, -1.0f);
+			glVertex2f( 1.0f, -1.0f);
+			glVertex2f( 1.0f,  1.0f);
+			glVertex2f(-1.0f,  1.0f);
+		glEnd();
+		cur_ = back;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//the latest estimate is attached to the framebuffer, read it from there
+	Mat& dst = flow.isContinuous() ? flow : readback_;
+	dst.create(height_, width_, CV_32FC2);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width_, height_, GL_RG, GL_FLOAT, dst.data);
+	if (&dst != &flow)
+		readback_.copyTo(flow);
+
+	fwglUseProgram(0);
+	fwglActiveTexture(GL_TEXTURE0 + 1); glBindTexture(GL_TEXTURE_2D, 0);
+	fwglActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, 0);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glMatrixMode(GL_PROJECTION); glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);  glPopMatrix();
+	glPopAttrib();
+}
+
+
+
+const char* GpuFlowProvider::getName()
+{
+	return "GPU";
+}
+
+
+
+bool GpuFlowProvider::hasFailed()
+{
+	return glFailed_;
+}
+
+
+
+GLuint GpuFlowProvider::getFlowTexture()
+{
+	return glReady_ ? flow_[cur_] : 0;
+}
+
+
+
+void GpuFlowProvider::contextChanged()
+{
+	program_     = 0;
+	framebuffer_ = 0;
+	memset(frames_, 0, sizeof(frames_));
+	memset(flow_,   0, sizeof(flow_));
+	glReady_     = false;
+	glFailed_    = false;
+}
+
+
+
+bool GpuFlowProvider::initGl(int width, int height)
+{
+	releaseGl();
+	if (!isSupported())
+		return false;
+
+	program_ = compileFragmentProgram(LUCAS_KANADE_SHADER, "lucasKanade");
+	if (!program_)
+		return false;
+
+	width_  = width;
+	height_ = height;
+
+	//frames are sampled between pixels while warping, the flow only at texels
+	for (int k = 0; k < 2; k++) {
+		glGenTextures(1, &frames_[k]);
+		glBindTexture(GL_TEXTURE_2D, frames_[k]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+
+		glGenTextures(1, &flow_[k]);
+		glBindTexture(GL_TEXTURE_2D, flow_[k]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, NULL);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	fwglGenFramebuffers(1, &framebuffer_);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+	fwglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, flow_[0], 0);
+	GLenum status = fwglCheckFramebufferStatus(GL_FRAMEBUFFER);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("GPU optical flow: float render targets are not supported (status 0x%x)\n", status);
+		releaseGl();
+		return false;
+	}
+
+	printf("Optical flow running on the GPU: %s\n", (const char*) glGetString(GL_RENDERER));
+	cur_     = 0;
+	glReady_ = true;
+	return true;
+}
+
+
+
+void GpuFlowProvider::releaseGl()
+{
+	if (program_)     fwglDeleteProgram(program_);
+	if (frames_[0])   glDeleteTextures(2, frames_);
+	if (flow_[0])     glDeleteTextures(2, flow_);
+	if (framebuffer_) fwglDeleteFramebuffers(1, &framebuffer_);
+
+	program_     = 0;
+	framebuffer_ = 0;
+	memset(frames_, 0, sizeof(frames_));
+	memset(flow_,   0, sizeof(flow_));
+	glReady_     = false;
+}
+
+
+
+void GpuFlowProvider::uploadFrame(GLuint tex, const Mat& frame)
+{
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)frame.step);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RED, GL_UNSIGNED_BYTE, frame.data);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
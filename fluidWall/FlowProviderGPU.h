@@ -0,0 +1,97 @@
+/**
+ * @file      FlowProviderGPU.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "FlowProvider.h"
+#include "GlExtensions.h"
+
+/**
+ * Dense Lucas-Kanade flow computed in fragment shaders.
+ *
+ * Every pixel solves the Lucas-Kanade system over a square window, refined over a
+ * few warped iterations, all in textures on the graphics card. The result is read 
+ * back into the flow Mat and also stays available as a texture, so a FluidSolverGPU 
+ * can add it to its velocity sources without another upload. A single pyramid level
+ * is used, which tracks motions up to about the window radius per frame; at grid 
+ * resolution and sensor rate that covers people moving in front of the wall.
+ *
+ * Every method needs the OpenGL context to be current, and the flow is computed on
+ * the thread that owns it. The textures are created on the first computeFlow().
+ */
+class GpuFlowProvider : public FlowProvider
+{
+public:
+	/**
+	 * @param radius      half width of the Lucas-Kanade window, in pixels
+	 * @param iterations  warped refinement passes per frame
+	 */
+	GpuFlowProvider(int radius = 4, int iterations = 3);
+	~GpuFlowProvider(void);
+
+	/**
+	 * Tests whether the current OpenGL context can run the provider.
+	 */
+	static bool isSupported();
+
+	void computeFlow(const Mat& prev, const Mat& next, Mat& flow);
+	const char* getName();
+
+	/**
+	 * Accessor: RG32F texture with the last flow, texel (x, y) for pixel (x, y). 
+	 * 0 before the first computeFlow().
+	 */
+	GLuint getFlowTexture();
+
+	/**
+	 * Accessor: true once the textures or program could not be created. computeFlow()
+	 * then only returns zero flow.
+	 */
+	bool hasFailed();
+
+	/**
+	 * Forgets all OpenGL objects without deleting them, for when their context is gone.
+	 */
+	void contextChanged();
+
+protected:
+	int    radius_;
+	int    iterations_;
+	int    width_;
+	int    height_;
+	bool   glReady_;
+	bool   glFailed_;
+	GLuint program_;
+	GLuint framebuffer_;
+	GLuint frames_[2];   //prev, next
+	GLuint flow_[2];     //ping-pong flow estimates
+	int    cur_;         //flow_ texture holding the latest estimate
+	Mat    readback_;    //for flow Mats that are not continuous
+
+	/**
+	 * Creates or resizes the textures and compiles the program.
+	 * @return False if anything failed; the error has been printed.
+	 */
+	bool initGl(int width, int height);
+
+	void releaseGl();
+
+	void uploadFrame(GLuint tex, const Mat& frame);
+};
@@ -0,0 +1,539 @@
+/**
+ * @file      FluidKernels.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * Scalar and SSE2 kernels, CPU feature detection and aligned allocation. The AVX
+ * kernels live in FluidKernelsAVX.cpp, which is the only file built with /arch:AVX.
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FluidKernels.h"
+#include "PackedFormats.h"
+#include <stdlib.h>
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#include <malloc.h>
+#else
+	#include <cpuid.h>
+#endif
+
+
+/*
+  ----------------------------------------------------------------------
+   scalar reference kernels
+  ----------------------------------------------------------------------
+*/
+
+static void addSourceScalar(float* x, const float* s, float dt, int count)
+{
+	for (int k = 0; k < count; k++)
+		x[k] += dt * s[k];
+}
+
+
+
+static void addInterleavedScalar(float* u, float* v, const float* uv, float scale, int count)
+{
+	for (int k = 0; k < count; k++) {
+		u[k] += scale * uv[2*k];
+		v[k] += scale * uv[2*k + 1];
+	}
+}
+
+
+
+static void advectRowScalar(float* d, const float* d0, const float* u, const float* v,
+							int j, int iBegin, int iEnd, int stride, float dt0, float maxX, float maxY)
+{
+	for (int i = iBegin; i <= iEnd; i++) {
+		int c = i + stride * j;
+
+		// calculate new coordinates based on existing velocity grids
+		float x = i - dt0 * u[c];
+		float y = j - dt0 * v[c];
+
+		//limit coordinates to fall within the grid
+		if (x < 0.5f)     x = 0.5f;
+		if (x > maxX)     x = maxX;
+		if (y < 0.5f)     y = 0.5f;
+		if (y > maxY)     y = maxY;
+
+		int i0 = (int)x;
+		int j0 = (int)y;
+		float s1 = x - i0, s0 = 1 - s1;
+		float t1 = y - j0, t0 = 1 - t1;
+
+		int c00 = i0 + stride * j0;
+		d[c] = s0 * (t0 * d0[c00]     + t1 * d0[c00 + stride]) +
+			   s1 * (t0 * d0[c00 + 1] + t1 * d0[c00 + 1 + stride]);
+	}
+}
+
+
+
+static void divergenceRowScalar(float* div, float* p, const float* u, const float* v,
+								int j, int width, int stride, float scale)
+{
+	for (int i = 1; i <= width; i++) {
+		int c = i + stride * j;
+		div[c] = scale * (u[c + 1] - u[c - 1] + v[c + stride] - v[c - stride]);
+		p[c]   = 0;
+	}
+}
+
+
+
+static void gradientRowScalar(float* u, float* v, const float* p,
+							  int j, int width, int stride, float scale)
+{
+	for (int i = 1; i <= width; i++) {
+		int c = i + stride * j;
+		u[c] -= scale * (p[c + 1] - p[c - 1]);
+		v[c] -= scale * (p[c + stride] - p[c - stride]);
+	}
+}
+
+
+
+static void addSourceHalfScalar(unsigned short* d, const unsigned short* x, const float* s, float dt, int count)
+{
+	for (int k = 0; k < count; k++)
+		d[k] = HalfFormat::encode(HalfFormat::decode(x[k]) + dt * s[k]);
+}
+
+
+
+static void addSourceUnorm16Scalar(unsigned short* d, const unsigned short* x, const float* s, float dt, int count)
+{
+	for (int k = 0; k < count; k++)
+		d[k] = Unorm16Format::encode(Unorm16Format::decode(x[k]) + dt * s[k]);
+}
+
+
+
+static void packHalfScalar(unsigned short* d, const float* x, int count)
+{
+	for (int k = 0; k < count; k++)
+		d[k] = HalfFormat::encode(x[k]);
+}
+
+
+
+static void packUnorm16Scalar(unsigned short* d, const float* x, int count)
+{
+	for (int k = 0; k < count; k++)
+		d[k] = Unorm16Format::encode(x[k]);
+}
+
+
+
+/*
+  ----------------------------------------------------------------------
+   SSE2 kernels
+  ----------------------------------------------------------------------
+*/
+
+static void addSourceSse2(float* x, const float* s, float dt, int count)
+{
+	int k = 0;
+	__m128 vdt = _mm_set1_ps(dt);
+
+	for (; k + 4 <= count; k += 4)
+		_mm_storeu_ps(x + k, _mm_add_ps(_mm_loadu_ps(x + k), _mm_mul_ps(vdt, _mm_loadu_ps(s + k))));
+	addSourceScalar(x + k, s + k, dt, count - k);
+}
+
+
+
+static void addInterleavedSse2(float* u, float* v, const float* uv, float scale, int count)
+{
+	int k = 0;
+	__m128 vscale = _mm_set1_ps(scale);
+
+	for (; k + 4 <= count; k += 4) {
+		//split {u0 v0 u1 v1} {u2 v2 u3 v3} into {u0 u1 u2 u3} and {v0 v1 v2 v3}
+		__m128 lo = _mm_loadu_ps(uv + 2*k);
+		__m128 hi = _mm_loadu_ps(uv + 2*k + 4);
+		__m128 su = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 sv = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(u + k, _mm_add_ps(_mm_loadu_ps(u + k), _mm_mul_ps(vscale, su)));
+		_mm_storeu_ps(v + k, _mm_add_ps(_mm_loadu_ps(v + k), _mm_mul_ps(vscale, sv)));
+	}
+	addInterleavedScalar(u + k, v + k, uv + 2*k, scale, count - k);
+}
+
+
+
+static void advectRowSse2(float* d, const float* d0, const float* u, const float* v,
+						  int j, int iBegin, int iEnd, int stride, float dt0, float maxX, float maxY)
+{
+	int i = iBegin;
+	__m128 vdt0  = _mm_set1_ps(dt0);
+	__m128 vlo   = _mm_set1_ps(0.5f);
+	__m128 vhiX  = _mm_set1_ps(maxX);
+	__m128 vhiY  = _mm_set1_ps(maxY);
+	__m128 vone  = _mm_set1_ps(1.0f);
+	__m128 vj    = _mm_set1_ps((float)j);
+	__m128 vstep = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+
+	for (; i + 3 <= iEnd; i += 4) {
+		int c = i + stride * j;
+
+		//backtrace and clamp four cells at once
+		__m128 x = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)i), vstep), _mm_mul_ps(vdt0, _mm_loadu_ps(u + c)));
+		__m128 y = _mm_sub_ps(vj, _mm_mul_ps(vdt0, _mm_loadu_ps(v + c)));
+		x = _mm_min_ps(_mm_max_ps(x, vlo), vhiX);
+		y = _mm_min_ps(_mm_max_ps(y, vlo), vhiY);
+
+		__m128i i0 = _mm_cvttps_epi32(x);
+		__m128i j0 = _mm_cvttps_epi32(y);
+		__m128 s1 = _mm_sub_ps(x, _mm_cvtepi32_ps(i0)), s0 = _mm_sub_ps(vone, s1);
+		__m128 t1 = _mm_sub_ps(y, _mm_cvtepi32_ps(j0)), t0 = _mm_sub_ps(vone, t1);
+
+		//SSE2 has no gather, fetch the four corners of each sample with scalar loads
+		int ii[4], jj[4];
+		_mm_storeu_si128((__m128i*)ii, i0);
+		_mm_storeu_si128((__m128i*)jj, j0);
+
+		float a00[4], a01[4], a10[4], a11[4];
+		for (int k = 0; k < 4; k++) {
+			const float* src = d0 + ii[k] + stride * jj[k];
+			a00[k] = src[0];
+			a01[k] = src[stride];
+			a10[k] = src[1];
+			a11[k] = src[1 + stride];
+		}
+
+		__m128 left  = _mm_add_ps(_mm_mul_ps(t0, _mm_loadu_ps(a00)), _mm_mul_ps(t1, _mm_loadu_ps(a01)));
+		__m128 right = _mm_add_ps(_mm_mul_ps(t0, _mm_loadu_ps(a10)), _mm_mul_ps(t1, _mm_loadu_ps(a11)));
+		_mm_storeu_ps(d + c, _mm_add_ps(_mm_mul_ps(s0, left), _mm_mul_ps(s1, right)));
+	}
+	advectRowScalar(d, d0, u, v, j, i, iEnd, stride, dt0, maxX, maxY);
+}
+
+
+
+static void divergenceRowSse2(float* div, float* p, const float* u, const float* v,
+							  int j, int width, int stride, float scale)
+{
+	int i = 1;
+	__m128 vscale = _mm_set1_ps(scale);
+	__m128 vzero  = _mm_setzero_ps();
+
+	for (; i + 3 <= width; i += 4) {
+		int c = i + stride * j;
+		__m128 du = _mm_sub_ps(_mm_loadu_ps(u + c + 1), _mm_loadu_ps(u + c - 1));
+		__m128 sum = _mm_sub_ps(_mm_add_ps(du, _mm_loadu_ps(v + c + stride)), _mm_loadu_ps(v + c - stride));
+		_mm_storeu_ps(div + c, _mm_mul_ps(vscale, sum));
+		_mm_storeu_ps(p + c, vzero);
+	}
+	for (; i <= width; i++) {
+		int c = i + stride * j;
+		div[c] = scale * (u[c + 1] - u[c - 1] + v[c + stride] - v[c - stride]);
+		p[c]   = 0;
+	}
+}
+
+
+
+static void gradientRowSse2(float* u, float* v, const float* p,
+							int j, int width, int stride, float scale)
+{
+	int i = 1;
+	__m128 vscale = _mm_set1_ps(scale);
+
+	for (; i + 3 <= width; i += 4) {
+		int c = i + stride * j;
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(p + c + 1), _mm_loadu_ps(p + c - 1));
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(p + c + stride), _mm_loadu_ps(p + c - stride));
+		_mm_storeu_ps(u + c, _mm_sub_ps(_mm_loadu_ps(u + c), _mm_mul_ps(vscale, dx)));
+		_mm_storeu_ps(v + c, _mm_sub_ps(_mm_loadu_ps(v + c), _mm_mul_ps(vscale, dy)));
+	}
+	for (; i <= width; i++) {
+		int c = i + stride * j;
+		u[c] -= scale * (p[c + 1] - p[c - 1]);
+		v[c] -= scale * (p[c + stride] - p[c - stride]);
+	}
+}
+
+
+
+/**
+ * (mask & a) | (~mask & b), SSE2 has no blend.
+ */
+static inline __m128i selectSse2(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+
+
+/**
+ * Packs eight values in [0, 65535] to unsigned shorts. SSE2 only packs with 
+ * signed saturation, so the range is moved to signed and back.
+ */
+static inline __m128i packUnsignedSse2(__m128i lo, __m128i hi)
+{
+	__m128i bias = _mm_set1_epi32(32768);
+	__m128i pack = _mm_packs_epi32(_mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias));
+	return _mm_xor_si128(pack, _mm_set1_epi16((short)0x8000));
+}
+
+
+
+//HalfFormat::decode, four at a time; h holds one half per 32 bit lane
+static inline __m128 halfToFloatSse2(__m128i h)
+{
+	__m128i f        = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+	__m128i exponent = _mm_and_si128(f, _mm_set1_epi32(0x7c00 << 13));
+	f = _mm_add_epi32(f, _mm_set1_epi32((127 - 15) << 23));
+
+	__m128i isInf = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7c00 << 13));
+	f = _mm_add_epi32(f, _mm_and_si128(isInf, _mm_set1_epi32((128 - 16) << 23)));
+
+	__m128i isDenormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+	__m128  denormal   = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(f, _mm_set1_epi32(1 << 23))),
+									_mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+	f = selectSse2(isDenormal, _mm_castps_si128(denormal), f);
+
+	return _mm_castsi128_ps(_mm_or_si128(f, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16)));
+}
+
+
+
+//HalfFormat::encode, four at a time; returns one half per 32 bit lane
+static inline __m128i floatToHalfSse2(__m128 value)
+{
+	__m128i bits  = _mm_castps_si128(value);
+	__m128i sign  = _mm_and_si128(bits, _mm_set1_epi32(0x80000000));
+	__m128i abs   = _mm_xor_si128(bits, sign);
+	__m128i magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+
+	//every lane takes all three paths, then picks its own
+	__m128i isBig = _mm_cmpgt_epi32(abs, _mm_set1_epi32(((127 + 16) << 23) - 1));
+	__m128i isNan = _mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7f800000));
+	__m128i big   = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(isNan, _mm_set1_epi32(0x0200)));
+
+	__m128i isDenormal = _mm_cmplt_epi32(abs, _mm_set1_epi32((127 - 14) << 23));
+	__m128i denormal   = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(abs), _mm_castsi128_ps(magic))), magic);
+
+	__m128i odd    = _mm_and_si128(_mm_srli_epi32(abs, 13), _mm_set1_epi32(1));
+	__m128i normal = _mm_add_epi32(abs, _mm_set1_epi32((int)(((unsigned int)(15 - 127) << 23) + 0xfff)));
+	normal = _mm_srli_epi32(_mm_add_epi32(normal, odd), 13);
+
+	__m128i h = selectSse2(isBig, big, selectSse2(isDenormal, denormal, normal));
+	return _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+}
+
+
+
+//Unorm16Format::encode, four at a time; not a number goes to 0 like there
+static inline __m128i floatToUnorm16Sse2(__m128 value)
+{
+	__m128 scaled = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(65535.0f / FLUID_UNORM16_RANGE)), _mm_set1_ps(0.5f));
+	scaled = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+	return _mm_cvttps_epi32(scaled);
+}
+
+
+
+static void addSourceHalfSse2(unsigned short* d, const unsigned short* x, const float* s, float dt, int count)
+{
+	int k = 0;
+	__m128  vdt  = _mm_set1_ps(dt);
+	__m128i zero = _mm_setzero_si128();
+
+	for (; k + 8 <= count; k += 8) {
+		__m128i packed = _mm_loadu_si128((const __m128i*)(x + k));
+		__m128  lo = _mm_add_ps(halfToFloatSse2(_mm_unpacklo_epi16(packed, zero)), _mm_mul_ps(vdt, _mm_loadu_ps(s + k)));
+		__m128  hi = _mm_add_ps(halfToFloatSse2(_mm_unpackhi_epi16(packed, zero)), _mm_mul_ps(vdt, _mm_loadu_ps(s + k + 4)));
+		_mm_storeu_si128((__m128i*)(d + k), packUnsignedSse2(floatToHalfSse2(lo), floatToHalfSse2(hi)));
+	}
+	addSourceHalfScalar(d + k, x + k, s + k, dt, count - k);
+}
+
+
+
+static void addSourceUnorm16Sse2(unsigned short* d, const unsigned short* x, const float* s, float dt, int count)
+{
+	int k = 0;
+	__m128  vdt   = _mm_set1_ps(dt);
+	__m128  vstep = _mm_set1_ps(FLUID_UNORM16_RANGE / 65535.0f);
+	__m128i zero  = _mm_setzero_si128();
+
+	for (; k + 8 <= count; k += 8) {
+		__m128i packed = _mm_loadu_si128((const __m128i*)(x + k));
+		__m128  lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, zero)), vstep);
+		__m128  hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(packed, zero)), vstep);
+		lo = _mm_add_ps(lo, _mm_mul_ps(vdt, _mm_loadu_ps(s + k)));
+		hi = _mm_add_ps(hi, _mm_mul_ps(vdt, _mm_loadu_ps(s + k + 4)));
+
+		_mm_storeu_si128((__m128i*)(d + k), packUnsignedSse2(floatToUnorm16Sse2(lo), floatToUnorm16Sse2(hi)));
+	}
+	addSourceUnorm16Scalar(d + k, x + k, s + k, dt, count - k);
+}
+
+
+
+static void packHalfSse2(unsigned short* d, const float* x, int count)
+{
+	int k = 0;
+	for (; k + 8 <= count; k += 8)
+		_mm_storeu_si128((__m128i*)(d + k), packUnsignedSse2(floatToHalfSse2(_mm_loadu_ps(x + k)), 
+															 floatToHalfSse2(_mm_loadu_ps(x + k + 4))));
+	packHalfScalar(d + k, x + k, count - k);
+}
+
+
+
+static void packUnorm16Sse2(unsigned short* d, const float* x, int count)
+{
+	int k = 0;
+	for (; k + 8 <= count; k += 8)
+		_mm_storeu_si128((__m128i*)(d + k), packUnsignedSse2(floatToUnorm16Sse2(_mm_loadu_ps(x + k)), 
+															 floatToUnorm16Sse2(_mm_loadu_ps(x + k + 4))));
+	packUnorm16Scalar(d + k, x + k, count - k);
+}
+
+
+
+/*
+  ----------------------------------------------------------------------
+   kernel selection
+  ----------------------------------------------------------------------
+*/
+
+static void cpuid(int regs[4], int leaf)
+{
+#if defined(_MSC_VER)
+	__cpuid(regs, leaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid(leaf, a, b, c, d);
+	regs[0] = a; regs[1] = b; regs[2] = c; regs[3] = d;
+#endif
+}
+
+
+
+/**
+ * AVX needs both the instruction set and an operating system that saves the
+ * upper halves of the YMM registers on a context switch.
+ */
+static bool cpuSupportsAvx()
+{
+	int regs[4];
+	cpuid(regs, 1);
+
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx     = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return false;
+
+#if defined(_MSC_VER)
+	unsigned long long xcr0 = _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ __volatile__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	unsigned long long xcr0 = ((unsigned long long)hi << 32) | lo;
+#endif
+	return (xcr0 & 6) == 6;
+}
+
+
+
+static bool cpuSupportsSse2()
+{
+	int regs[4];
+	cpuid(regs, 1);
+	return (regs[3] & (1 << 26)) != 0;
+}
+
+
+
+const FluidKernels& getScalarKernels()
+{
+	static const FluidKernels kernels = {
+		"scalar", addSourceScalar, addInterleavedScalar, advectRowScalar, divergenceRowScalar, gradientRowScalar,
+		addSourceHalfScalar, addSourceUnorm16Scalar, packHalfScalar, packUnorm16Scalar
+	};
+	return kernels;
+}
+
+
+
+const FluidKernels& getSse2Kernels()
+{
+	static const FluidKernels kernels = {
+		"SSE2", addSourceSse2, addInterleavedSse2, advectRowSse2, divergenceRowSse2, gradientRowSse2,
+		addSourceHalfSse2, addSourceUnorm16Sse2, packHalfSse2, packUnorm16Sse2
+	};
+	return kernels;
+}
+
+
+
+const FluidKernels& getFluidKernels()
+{
+	static const FluidKernels* selected = NULL;
+
+	if (!selected) {
+		const FluidKernels* avx = getAvxKernels();
+
+		if (avx && cpuSupportsAvx())
+			selected = avx;
+		else if (cpuSupportsSse2())
+			selected = &getSse2Kernels();
+		else
+			selected = &getScalarKernels();
+	}
+	return *selected;
+}
+
+
+
+/*
+  ----------------------------------------------------------------------
+   aligned allocation
+  ----------------------------------------------------------------------
+*/
+
+void* fluidAlignedAlloc(size_t bytes)
+{
+#if defined(_MSC_VER)
+	return _aligned_malloc(bytes, FLUID_GRID_ALIGNMENT);
+#else
+	void* ptr = NULL;
+	if (posix_memalign(&ptr, FLUID_GRID_ALIGNMENT, bytes) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+
+
+void fluidAlignedFree(void* ptr)
+{
+#if defined(_MSC_VER)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
@@ -0,0 +1,105 @@
+/**
+ * @file      FluidKernels.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <stddef.h>
+
+//alignment of every solver grid, in bytes (one cache line, two AVX registers)
+#define FLUID_GRID_ALIGNMENT 64
+//row strides are padded to a multiple of this many floats
+#define FLUID_ROW_ALIGNMENT  (FLUID_GRID_ALIGNMENT / sizeof(float))
+
+/**
+ * Inner loops of the FluidSolver, one row at a time, in scalar, SSE2 and AVX flavors.
+ *
+ * All arrays use the FluidSolver layout, addressed as i + stride * j. The vector
+ * versions produce the same results as the scalar ones; they only differ in speed.
+ * getFluidKernels() picks the widest set the CPU and operating system support.
+ */
+struct FluidKernels
+{
+	const char* name;
+
+	/**
+	 * x[k] += dt * s[k] for k in [0, count).
+	 */
+	void (*addSource)(float* x, const float* s, float dt, int count);
+
+	/**
+	 * u[k] += scale * uv[2k], v[k] += scale * uv[2k+1] for k in [0, count).
+	 * uv holds interleaved pairs, like a row of a CV_32FC2 Mat.
+	 */
+	void (*addInterleaved)(float* u, float* v, const float* uv, float scale, int count);
+
+	/**
+	 * Semi-Lagrangian backtrace of cells iBegin..iEnd (inclusive) of row j.
+	 *
+	 * @param dt0      timestep in cells (dt * N)
+	 * @param maxX     upper clamp of the backtraced x position (width + 0.5)
+	 * @param maxY     upper clamp of the backtraced y position (height + 0.5)
+	 */
+	void (*advectRow)(float* d, const float* d0, const float* u, const float* v,
+					  int j, int iBegin, int iEnd, int stride, float dt0, float maxX, float maxY);
+
+	/**
+	 * div = scale * (du/dx + dv/dy) with central differences and p = 0, for cells 1..width of row j.
+	 */
+	void (*divergenceRow)(float* div, float* p, const float* u, const float* v,
+						  int j, int width, int stride, float scale);
+
+	/**
+	 * u -= scale * dp/dx, v -= scale * dp/dy with central differences, for cells 1..width of row j.
+	 */
+	void (*gradientRow)(float* u, float* v, const float* p,
+						int j, int width, int stride, float scale);
+
+	/**
+	 * d[k] = x[k] + dt * s[k] for k in [0, count), with d and x in one of the 16 bit
+	 * formats of PackedFormats.h. The sum is computed in float, then rounded.
+	 */
+	void (*addSourceHalf)   (unsigned short* d, const unsigned short* x, const float* s, float dt, int count);
+	void (*addSourceUnorm16)(unsigned short* d, const unsigned short* x, const float* s, float dt, int count);
+
+	/**
+	 * d[k] = x[k] rounded to one of the 16 bit formats, for k in [0, count).
+	 */
+	void (*packHalf)   (unsigned short* d, const float* x, int count);
+	void (*packUnorm16)(unsigned short* d, const float* x, int count);
+};
+
+/**
+ * Returns the kernel set best suited to this CPU. Detection runs once.
+ */
+const FluidKernels& getFluidKernels();
+
+/**
+ * Kernel sets, exposed so benchmarks can compare them directly.
+ * getAvxKernels() returns NULL when the build has no AVX support.
+ */
+const FluidKernels& getScalarKernels();
+const FluidKernels& getSse2Kernels();
+const FluidKernels* getAvxKernels();
+
+/**
+ * Allocates and frees memory aligned to FLUID_GRID_ALIGNMENT.
+ */
+void* fluidAlignedAlloc(size_t bytes);
+void  fluidAlignedFree(void* ptr);
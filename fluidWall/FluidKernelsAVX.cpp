@@ -0,0 +1,212 @@
+/**
+ * @file      FluidKernelsAVX.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * AVX versions of the FluidSolver kernels. This is the only file compiled with
+ * /arch:AVX; nothing here runs unless getFluidKernels() found AVX support at runtime.
+ * Every kernel clears the upper register halves before returning to SSE code.
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FluidKernels.h"
+#include <stdlib.h>
+
+#if defined(_MSC_VER) || defined(__AVX__)
+#include <immintrin.h>
+
+static void addSourceAvx(float* x, const float* s, float dt, int count)
+{
+	int k = 0;
+	__m256 vdt = _mm256_set1_ps(dt);
+
+	for (; k + 8 <= count; k += 8)
+		_mm256_storeu_ps(x + k, _mm256_add_ps(_mm256_loadu_ps(x + k), _mm256_mul_ps(vdt, _mm256_loadu_ps(s + k))));
+	for (; k < count; k++)
+		x[k] += dt * s[k];
+	_mm256_zeroupper();
+}
+
+
+
+static void addInterleavedAvx(float* u, float* v, const float* uv, float scale, int count)
+{
+	int k = 0;
+	__m256 vscale = _mm256_set1_ps(scale);
+
+	for (; k + 8 <= count; k += 8) {
+		//AVX shuffles stay within 128 bit lanes, so regroup the lanes first
+		__m256 a  = _mm256_loadu_ps(uv + 2*k);
+		__m256 b  = _mm256_loadu_ps(uv + 2*k + 8);
+		__m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+		__m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+		__m256 su = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 sv = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm256_storeu_ps(u + k, _mm256_add_ps(_mm256_loadu_ps(u + k), _mm256_mul_ps(vscale, su)));
+		_mm256_storeu_ps(v + k, _mm256_add_ps(_mm256_loadu_ps(v + k), _mm256_mul_ps(vscale, sv)));
+	}
+	for (; k < count; k++) {
+		u[k] += scale * uv[2*k];
+		v[k] += scale * uv[2*k + 1];
+	}
+	_mm256_zeroupper();
+}
+
+
+
+static void advectRowAvx(float* d, const float* d0, const float* u, const float* v,
+						 int j, int iBegin, int iEnd, int stride, float dt0, float maxX, float maxY)
+{
+	int i = iBegin;
+	__m256 vdt0  = _mm256_set1_ps(dt0);
+	__m256 vlo   = _mm256_set1_ps(0.5f);
+	__m256 vhiX  = _mm256_set1_ps(maxX);
+	__m256 vhiY  = _mm256_set1_ps(maxY);
+	__m256 vone  = _mm256_set1_ps(1.0f);
+	__m256 vj    = _mm256_set1_ps((float)j);
+	__m256 vstep = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+
+	for (; i + 7 <= iEnd; i += 8) {
+		int c = i + stride * j;
+
+		//backtrace and clamp eight cells at once
+		__m256 x = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps((float)i), vstep), _mm256_mul_ps(vdt0, _mm256_loadu_ps(u + c)));
+		__m256 y = _mm256_sub_ps(vj, _mm256_mul_ps(vdt0, _mm256_loadu_ps(v + c)));
+		x = _mm256_min_ps(_mm256_max_ps(x, vlo), vhiX);
+		y = _mm256_min_ps(_mm256_max_ps(y, vlo), vhiY);
+
+		__m256i i0 = _mm256_cvttps_epi32(x);
+		__m256i j0 = _mm256_cvttps_epi32(y);
+		__m256 s1 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i0)), s0 = _mm256_sub_ps(vone, s1);
+		__m256 t1 = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j0)), t0 = _mm256_sub_ps(vone, t1);
+
+		//hardware gathers are no faster than scalar loads on most of our machines
+		//and need AVX2, so the corners are fetched one sample at a time
+		int ii[8], jj[8];
+		_mm256_storeu_si256((__m256i*)ii, i0);
+		_mm256_storeu_si256((__m256i*)jj, j0);
+
+		float a00[8], a01[8], a10[8], a11[8];
+		for (int k = 0; k < 8; k++) {
+			const float* src = d0 + ii[k] + stride * jj[k];
+			a00[k] = src[0];
+			a01[k] = src[stride];
+			a10[k] = src[1];
+			a11[k] = src[1 + stride];
+		}
+
+		__m256 left  = _mm256_add_ps(_mm256_mul_ps(t0, _mm256_loadu_ps(a00)), _mm256_mul_ps(t1, _mm256_loadu_ps(a01)));
+		__m256 right = _mm256_add_ps(_mm256_mul_ps(t0, _mm256_loadu_ps(a10)), _mm256_mul_ps(t1, _mm256_loadu_ps(a11)));
+		_mm256_storeu_ps(d + c, _mm256_add_ps(_mm256_mul_ps(s0, left), _mm256_mul_ps(s1, right)));
+	}
+
+	for (; i <= iEnd; i++) {
+		int c = i + stride * j;
+		float x = i - dt0 * u[c];
+		float y = j - dt0 * v[c];
+
+		if (x < 0.5f)     x = 0.5f;
+		if (x > maxX)     x = maxX;
+		if (y < 0.5f)     y = 0.5f;
+		if (y > maxY)     y = maxY;
+
+		int i0 = (int)x;
+		int j0 = (int)y;
+		float s1 = x - i0, s0 = 1 - s1;
+		float t1 = y - j0, t0 = 1 - t1;
+
+		int c00 = i0 + stride * j0;
+		d[c] = s0 * (t0 * d0[c00]     + t1 * d0[c00 + stride]) +
+			   s1 * (t0 * d0[c00 + 1] + t1 * d0[c00 + 1 + stride]);
+	}
+	_mm256_zeroupper();
+}
+
+
+
+static void divergenceRowAvx(float* div, float* p, const float* u, const float* v,
+							 int j, int width, int stride, float scale)
+{
+	int i = 1;
+	__m256 vscale = _mm256_set1_ps(scale);
+	__m256 vzero  = _mm256_setzero_ps();
+
+	for (; i + 7 <= width; i += 8) {
+		int c = i + stride * j;
+		__m256 du  = _mm256_sub_ps(_mm256_loadu_ps(u + c + 1), _mm256_loadu_ps(u + c - 1));
+		__m256 sum = _mm256_sub_ps(_mm256_add_ps(du, _mm256_loadu_ps(v + c + stride)), _mm256_loadu_ps(v + c - stride));
+		_mm256_storeu_ps(div + c, _mm256_mul_ps(vscale, sum));
+		_mm256_storeu_ps(p + c, vzero);
+	}
+	for (; i <= width; i++) {
+		int c = i + stride * j;
+		div[c] = scale * (u[c + 1] - u[c - 1] + v[c + stride] - v[c - stride]);
+		p[c]   = 0;
+	}
+	_mm256_zeroupper();
+}
+
+
+
+static void gradientRowAvx(float* u, float* v, const float* p,
+						   int j, int width, int stride, float scale)
+{
+	int i = 1;
+	__m256 vscale = _mm256_set1_ps(scale);
+
+	for (; i + 7 <= width; i += 8) {
+		int c = i + stride * j;
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(p + c + 1), _mm256_loadu_ps(p + c - 1));
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(p + c + stride), _mm256_loadu_ps(p + c - stride));
+		_mm256_storeu_ps(u + c, _mm256_sub_ps(_mm256_loadu_ps(u + c), _mm256_mul_ps(vscale, dx)));
+		_mm256_storeu_ps(v + c, _mm256_sub_ps(_mm256_loadu_ps(v + c), _mm256_mul_ps(vscale, dy)));
+	}
+	for (; i <= width; i++) {
+		int c = i + stride * j;
+		u[c] -= scale * (p[c + 1] - p[c - 1]);
+		v[c] -= scale * (p[c + stride] - p[c - stride]);
+	}
+	_mm256_zeroupper();
+}
+
+
+
+const FluidKernels* getAvxKernels()
+{
+	static FluidKernels kernels = {
+		"AVX", addSourceAvx, addInterleavedAvx, advectRowAvx, divergenceRowAvx, gradientRowAvx,
+		NULL, NULL, NULL, NULL
+	};
+
+	//AVX has no 256 bit integer instructions, the 16 bit formats gain nothing from it
+	if (!kernels.addSourceHalf) {
+		kernels.addSourceHalf    = getSse2Kernels().addSourceHalf;
+		kernels.addSourceUnorm16 = getSse2Kernels().addSourceUnorm16;
+		kernels.packHalf         = getSse2Kernels().packHalf;
+		kernels.packUnorm16      = getSse2Kernels().packUnorm16;
+	}
+	return &kernels;
+}
+
+#else
+
+const FluidKernels* getAvxKernels()
+{
+	return NULL;
+}
+
+#endif
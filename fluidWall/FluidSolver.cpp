@@ -1,406 +1,1568 @@
-/**
- * @file      FluidSolver.cpp
- * @author    Austin Hines <futurelightstudios@gmail.com>
- * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
- * @version	  1.0.0
- * 
- * This file is part of Fluid Wall. You can redistribute it and/or modify            
- * it under the terms of the GNU Lesser General Public License as published  
- * by the Free Software Foundation, either version 3 of the License, or     
- * (at your option) any later version.                                       
- *                                                                             
- * Fluid Wall is distributed in the hope that it will be useful,                 
- * but WITHOUT ANY WARRANTY; without even the implied warranty of            
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
- * GNU Lesser General Public License for more details.                       
- *                                                                            
- * You should have received a copy of the GNU Lesser General Public License  
- * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
- *
- */
-
-#include "FluidSolver.h"
-#include <stdlib.h>
-#include <stdio.h>
-
-
-#define ROW_WIDTH N_+2
-#define IX(i,j) ((i)+(ROW_WIDTH)*(j))
-#define FOR_EACH_CELL for (i=1 ; i<=N_ ; i++) { for (j=1 ; j<=N_ ; j++) {
-#define END_FOR }}
-#define SWAP(x0,x) { float* tmp=x0; x0=x; x=tmp; }
-
-
-
-FluidSolver::FluidSolver(void)
-{
-	FluidSolver(128, 0.1f, 0.00f, 0.0f);
-}
-
-
-
-FluidSolver::FluidSolver(int N, float dt, float diff, float visc)
-{
-	N_      = N;
-	dt_     = dt;
-	diff_   = diff;
-	visc_   = visc;
-
-	int size = getSize();
-
-	u_			= (float *) malloc(size * sizeof(float));
-	v_			= (float *) malloc(size * sizeof(float));
-	u_prev_		= (float *) malloc(size * sizeof(float));
-	v_prev_		= (float *) malloc(size * sizeof(float));
-	dens_		= (float *) malloc(size * sizeof(float));	
-	dens_prev_	= (float *) malloc(size * sizeof(float));
-	bounds_	    = (bool  *) malloc(size * sizeof(bool) ); 
-
-}
-
-
-
-FluidSolver::~FluidSolver(void)
-{
-	if ( u_ ) free ( u_ );
-	if ( v_ ) free ( v_ );
-	if ( u_prev_ ) free ( u_prev_ );
-	if ( v_prev_ ) free ( v_prev_ );
-	if ( dens_ ) free ( dens_ );
-	if ( bounds_ ) free ( bounds_ );
-	if ( dens_prev_ ) free ( dens_prev_ );
-}
-
-
-
-void FluidSolver::reset()
-{
-	for (int i=0 ; i < getSize() ; i++) {
-		u_[i] = v_[i] = u_prev_[i] = v_prev_[i] = dens_[i] = dens_prev_[i] = 0.0f;
-		bounds_[i] = false;
-	}
-}
-
-
-
-void FluidSolver::update()
-{
-	computeDensityStep(dens_, dens_prev_, u_, v_);
-	computeVelocityStep(u_, v_, u_prev_, v_prev_);
-
-	//reset u_prev_, v_prev_, and dens_prev
-	for (int i=0 ; i < getSize() ; i++) 
-		u_prev_[i] = v_prev_[i] = dens_prev_[i] = 0.0f;
-}
-
-
-
-//TODO: Can increase efficiency by only testing valid coordinates 
-//      when emitters are created.
-void FluidSolver::addVertVelocityAt(int x, int y, float value)
-{
-	if(isValidCoordinate(x, y))
-		v_prev_[IX(x,y)] += value;
-}
-
-
-
-void FluidSolver::addHorzVelocityAt(int x, int y, float value)
-{
-	if(isValidCoordinate(x, y))
-		u_prev_[IX(x,y)] += value;
-}
-
-
-
-void FluidSolver::addDensityAt(int x, int y, float value)
-{
-	if(isValidCoordinate(x, y))
-		dens_prev_[IX(x,y)] += value;
-}
-
-
-
-void FluidSolver::setBoundAt(int x, int y, bool isBound)
-{
-	if(isValidCoordinate(x, y))
-		bounds_[IX(x,y)] = isBound;
-}
-
-
-
-//accessors
-bool FluidSolver::isBoundAt(int x, int y)
-{
-	return bounds_[IX(x,y)];
-}
-
-
-
-float FluidSolver::getDensityAt(int x, int y)
-{
-	return dens_[IX(x,y)];
-}
-
-
-
-float FluidSolver::getVertVelocityAt(int x, int y)
-{
-	return v_[IX(x,y)];
-}
-
-
-
-float FluidSolver::getHorzVelocityAt(int x, int y)
-{
-	return u_[IX(x,y)];
-}
-
-
-
-///protected functions
-int FluidSolver::getSize()
-{
-	return (ROW_WIDTH) * (ROW_WIDTH);
-}
-
-
-
-bool FluidSolver::isValidCoordinate(int x, int y)
-{
-	bool xIsValid = (x >= 1) && (x <= N_);
-	bool yIsValid = (y >= 1) && (y <= N_);
-
-	if(xIsValid && yIsValid)
-		return true;
-	else
-		return false;
-}
-
-
-
-void FluidSolver::addSource(float* x, float* s)
-{
-	int i;
-	for (i=0 ; i<getSize() ; i++) 
-		x[i] += dt_*s[i];
-}
-
-
-
-void FluidSolver::setBounds(int boundsFlag, float* x)
-{
-	int i, j;
-
-	//free slip boundary edges
-	for ( i=1 ; i<=N_; i++ ) {
-		//reverse velocity component on vertical walls (u)
-		x[IX(0  ,i)]  = boundsFlag==1 ? -x[IX(1,i)] : x[IX(1,i)];
-		x[IX(N_+1,i)] = boundsFlag==1 ? -x[IX(N_,i)] : x[IX(N_,i)];
-		
-		//reverse velocity component on horizontal (top and bottom) walls (v)
-		x[IX(i,0  )]  = boundsFlag==2 ? -x[IX(i,1)] : x[IX(i,1)];
-		x[IX(i,N_+1)] = boundsFlag==2 ? -x[IX(i,N_)] : x[IX(i,N_)];
-	}
-	
-	FOR_EACH_CELL
-		//detect bounds changes for each cell and reverse velocity components
-		//set current value to a negative average of surrounding values
-		if(bounds_[IX(i,j)]) {
-			//set current value to a negative average of surrounding values
-			x[IX(i,j)] = 0;
-
-			//vertical (v)
-			//if bounds are about to turn off, velocity component of off cell becomes positive.
-			if(!bounds_[IX(i,j+1)]) 
-				x[IX(i,j)] = boundsFlag==2 ? -x[IX(i,j+1)] : x[IX(i,j+1)]; 
-
-			//horizontal (u)
-			//if bounds change from on to off, velocity component of off cell becomes positive.
-			if(!bounds_[IX(i+1,j)]) 
-				x[IX(i,j)] = boundsFlag==1 ? -x[IX(i+1,j)] : x[IX(i+1,j)]; 
-		}
-		else {
-			//vertical (v)
-			//if bounds change from off to on, velocity component of off cell becomes negative.
-			if(bounds_[IX(i,j+1)]) 
-				x[IX(i,j+1)] = boundsFlag==2 ? -x[IX(i,j)] : x[IX(i,j)];
-			
-			//horizontal (u)
-			//if bounds change from off to on, velocity component of off cell becomes negative.
-			if( bounds_[IX(i+1,j)]) 
-				x[IX(i+1,j)] = boundsFlag==1 ? -x[IX(i,j)] : x[IX(i,j)]; 
-			
-		}
-	END_FOR
-
-	//handle corner conditions of objects
-	FOR_EACH_CELL
-		// X = cell in question | 0 = open cell | * = closed cell (with a boundary)
-
-		// * 0
-		// X *
-		if(bounds_[IX(i,j)] && bounds_[IX(i+1, j)] && bounds_[IX(i, j+1)] && !bounds_[IX(i+1, j+1)])
-			x[IX(i, j)] = 0.5 *(x[IX(i+1, j)] + x[IX(i, j+1)]);
-		// X * 
-		// * 0
-		else if(bounds_[IX(i,j)] && bounds_[IX(i+1, j)] && bounds_[IX(i, j-1)] && !bounds_[IX(i+1, j-1)])
-			x[IX(i, j)] = 0.5 *(x[IX(i+1, j)] + x[IX(i, j-1)]);
-		// * X 
-		// 0 *
-		else if(bounds_[IX(i,j)] && bounds_[IX(i-1, j)] && bounds_[IX(i, j-1)] && !bounds_[IX(i-1, j-1)])
-			x[IX(i, j)] = 0.5 *(x[IX(i-1, j)] + x[IX(i, j-1)]);
-		// 0 * 
-		// * X
-		else if(bounds_[IX(i,j)] && bounds_[IX(i-1, j)] && bounds_[IX(i, j+1)] && !bounds_[IX(i-1, j+1)])
-			x[IX(i, j)] = 0.5 *(x[IX(i-1, j)] + x[IX(i, j+1)]);
-	END_FOR
-
-	//corner conditions
-	x[IX(0,      0     )] = 0.5f * (x[IX(1,  0   )] + x[IX(0,      1 )]);
-	x[IX(0,      N_ + 1)] = 0.5f * (x[IX(1,  N_+1)] + x[IX(0,      N_)]);
-	x[IX(N_ + 1, 0     )] = 0.5f * (x[IX(N_, 0   )] + x[IX(N_ + 1, 1 )]);
-	x[IX(N_ + 1, N_ + 1)] = 0.5f * (x[IX(N_, N_+1)] + x[IX(N_ + 1, N_)]);
-}
-
-
-
-void FluidSolver::linearSolve( int boundsFlag, float* x, float* x0, float a, float c)
-{
-	int i, j, k;
-
-	//use 20 iterations of Gauss-Sidel to find a convergence of values
-	for ( k=0 ; k<20 ; k++ ) {
-		FOR_EACH_CELL
-			//exchange values with neighbors
-			x[IX(i,j)] = (x0[IX(i,j)] + a*(x[IX(i-1,j)] + x[IX(i+1,j)] + x[IX(i,j-1)] + x[IX(i,j+1)])) / c;
-		END_FOR
-		// factor in boundary conditions with each solution iteration
-		
-		setBounds(boundsFlag, x); 
-	}
-}
-
-
-
-void FluidSolver::diffuse (int boundsFlag, float* x, float* x0)
-{
-	float diffusionPerCell = dt_ * diff_ * N_ * N_;
-	linearSolve ( boundsFlag, x, x0, diffusionPerCell, 1+4*diffusionPerCell);
-}
-
-
-
-void FluidSolver::advect (int boundsFlag, float* d, float* d0, 
-						  float* u, float* v)
-{
-	int i, j;
-	int i0; //new x cell coordinate based on velocity grid
-	int j0; //new y cell coordinate based on velocity grid
-	int i1; //x + 1 cell next to new cell coordinate
-	int j1; //y + 1 cell next to new cell coordinate
-	float x, y, s0, t0, s1, t1, dt0;
-
-	//initial time differential = dt * number of cells in a row
-	dt0 = dt_ * N_;
-
-	//back trace density and velocity values from the center of each cell
-	FOR_EACH_CELL
-
-		// calculate new coordinates based on existing velocity grids
-		x = i - dt0 * u[IX(i,j)]; 
-		y = j - dt0 * v[IX(i,j)];
-		
-		//limit x coordinate to fall within the grid 
-		if (x < 0.5f)      x = 0.5f; 
-		if (x > N_ + 0.5f) x = N_ + 0.5f; 
-		i0 = (int)x; 
-		i1 = i0 + 1;
-		
-		//limit y coordinate to fall within the grid
-		if (y < 0.5f)      y = 0.5f; 
-		if (y > N_ + 0.5f) y = N_ + 0.5f; 
-		j0 = (int)y; 
-		j1 = j0 + 1;
-
-		s1 = x - i0; //difference between calculated x position and limited x position
-		s0 = 1 - s1; //calculate relative x distance from center of this cell
-
-		t1 = y - j0;  
-		t0 = 1 - t1;
-		
-		//blend several values from the velocity grid together, based on where in the cell 
-		//the new coordinate valls
-		d[IX(i,j)] = s0 * (t0 * d0[IX(i0,j0)] + t1 * d0[IX(i0,j1)]) +
-					 s1 * (t0 * d0[IX(i1,j0)] + t1 * d0[IX(i1,j1)]);
-	END_FOR
-	setBounds(boundsFlag, d);
-}
-
-
-
-void FluidSolver::project( float* u, float* v, float* p, float* div)
-{
-	int i, j;
-
-	float h = 1.0 / N_; //calculate unit length of each cell relative to the whole grid.
-
-	FOR_EACH_CELL
-		//calculate initial solution to gradient field based on the difference in velocities of
-		//surrounding cells.
-		div[IX(i, j)] = -0.5f * h * (u[IX(i + 1, j)] - u[IX(i - 1, j)] + v[IX(i, j + 1)] - v[IX(i, j - 1)]);
-		//set projected solution values to be zero
-		p[IX(i, j)] = 0; 
-	END_FOR	
-
-	//set bounds for diffusion
-	setBounds(0, div); 
-	setBounds(0, p);
-
-	// calculate gradient (height) field
-	linearSolve (0, p, div, 1, 4);
-
-	FOR_EACH_CELL
-		//subtract gradient field from current velocities
-		u[IX(i, j)] -= 0.5f * N_ * (p[IX(i + 1, j)] - p[IX(i - 1, j)]);
-		v[IX(i, j)] -= 0.5f * N_ * (p[IX(i, j + 1)] - p[IX(i, j - 1)]);
-	END_FOR
-
-	//set boundaries for velocity
-	setBounds(1, u); 
-	setBounds(2, v);
-}
-
-
-
-void FluidSolver::computeDensityStep( float* x, float* x0, float* u, float* v )
-{
-	addSource (x, x0);
-	SWAP(x0, x); 
-	diffuse(0, x, x0);
-	SWAP(x0, x); 
-	advect(0, x, x0, u, v);
-}
-
-
-
-void FluidSolver::computeVelocityStep (float* u, float* v, float* u0, float* v0)
-{
-	addSource(u, u0); 
-	addSource(v, v0);
-	//diffuse horizontal 
-	SWAP(u0, u); 
-	diffuse(1, u, u0);
-
-	//diffuse vertical
-	SWAP(v0, v); 
-	diffuse(2, v, v0);
-	project (u, v, u0, v0);
-	SWAP(u0, u); 
-	SWAP (v0, v);
-
-	//advect velocities
-	advect(1, u, u0, u0, v0); 
-	advect(2, v, v0, u0, v0);
-	project(u, v, u0, v0);
-}
+/**
+ * @file      FluidSolver.cpp
+ * @author    Austin Hines <futurelightstudios@gmail.com>
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ * 
+ * This file is part of Fluid Wall. You can redistribute it and/or modify            
+ * it under the terms of the GNU Lesser General Public License as published  
+ * by the Free Software Foundation, either version 3 of the License, or     
+ * (at your option) any later version.                                       
+ *                                                                             
+ * Fluid Wall is distributed in the hope that it will be useful,                 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
+ * GNU Lesser General Public License for more details.                       
+ *                                                                            
+ * You should have received a copy of the GNU Lesser General Public License  
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
+ *
+ */
+
+#include "FluidSolver.h"
+#include "MultigridSolver.h"
+#include "FluidKernels.h"
+#include "Profiler.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+
+#define ROW_WIDTH stride_
+#define IX(i,j) ((i)+(ROW_WIDTH)*(j))
+//rows in the outer loop so the inner loop walks memory contiguously
+#define FOR_EACH_CELL for (j=1 ; j<=NY_ ; j++) { for (i=1 ; i<=NX_ ; i++) {
+#define END_FOR }}
+#define SWAP(x0,x) { float* tmp=x0; x0=x; x=tmp; }
+
+//sweeps between residual tests once early termination is enabled
+#define RESIDUAL_CHECK_INTERVAL 4
+//V-cycles per pressure solve when multigrid is enabled
+#define MAX_MULTIGRID_CYCLES    4
+
+
+
+FluidSolver::FluidSolver(void)
+{
+	init(128, 128, 0.1f, 0.00f, 0.0f);
+}
+
+
+
+FluidSolver::FluidSolver(int N, float dt, float diff, float visc)
+{
+	init(N, N, dt, diff, visc);
+}
+
+
+
+FluidSolver::FluidSolver(int width, int height, float dt, float diff, float visc)
+{
+	init(width, height, dt, diff, visc);
+}
+
+
+
+void FluidSolver::init(int width, int height, float dt, float diff, float visc)
+{
+	dt_       = dt;
+	sourceDt_ = dt;
+	diff_     = diff;
+	visc_   = visc;
+
+	solverType_       = GAUSS_SEIDEL;
+	pressureSolver_   = PRESSURE_RELAXATION;
+	densityAdvection_  = ADVECT_SEMI_LAGRANGIAN;
+	velocityAdvection_ = ADVECT_SEMI_LAGRANGIAN;
+	multigrid_        = NULL;
+	velocityFactor_   = 1;
+	coarse_           = NULL;
+	relaxation_       = 1.0f;
+	maxIterations_    = 20;
+	tolerance_        = 0.0f;
+	absTolerance_     = 0.0f;
+
+	kernels_ = &getFluidKernels();
+
+	halo_           = NULL;
+	haloEverySweep_ = true;
+	haloSkip_       = false;
+	haloTag_        = 0;
+
+	trackTiles_   = false;
+	tileEpsilon_  = 1e-4f;
+	maxSpeed_     = 0.0f;
+
+	setGridSize(width, height);
+	allocateGrids();
+}
+
+
+
+FluidSolver::~FluidSolver(void)
+{
+	delete multigrid_;
+	delete coarse_;
+}
+
+
+
+void FluidSolver::setGridSize(int width, int height)
+{
+	NX_ = width;
+	NY_ = height;
+	//the longer side is the unit length, so a square grid keeps its old scale
+	N_  = width > height ? width : height;
+
+	//pad rows to a whole number of cache lines so every row starts aligned
+	stride_  = (int)(((width + 2 + FLUID_ROW_ALIGNMENT - 1) / FLUID_ROW_ALIGNMENT) * FLUID_ROW_ALIGNMENT);
+
+	tilesX_ = (width  + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY_ = (height + TILE_SIZE - 1) / TILE_SIZE;
+	tileActive_.assign (tilesX_ * tilesY_, 0);
+	tileMarked_.assign (tilesX_ * tilesY_, 0);
+	tileStep_.assign   (tilesX_ * tilesY_, 1);
+	tileScratch_.assign(tilesX_ * tilesY_, 0);
+	tileMax_.assign    (tilesX_ * tilesY_, 0.0f);
+	tileSpeed_.assign  (tilesX_ * tilesY_, 0.0f);
+
+	boundsChanged_ = true;
+	boundsWords_   = (width + 2 + 31) / 32;
+	boundsBits_.assign((height + 2) * boundsWords_, 0);
+
+	//the multigrid hierarchy and the coarse velocity grid are sized for the grid, 
+	//rebuilt on next use
+	delete multigrid_;
+	multigrid_ = NULL;
+	delete coarse_;
+	coarse_ = NULL;
+}
+
+
+
+void FluidSolver::allocateGrids()
+{
+	arena_.clear();
+	addGrids(arena_);
+	arena_.commit();
+}
+
+
+
+void FluidSolver::addGrids(GridArena& arena)
+{
+	int size = getSize();
+
+	//read together by every step, kept in the order the kernels visit them
+	arena.addField(u_,         size);
+	arena.addField(v_,         size);
+	arena.addField(u_prev_,    size);
+	arena.addField(v_prev_,    size);
+	arena.addField(dens_,      size);
+	arena.addField(dens_prev_, size);
+	arena.addField(scratch_,   size);
+	arena.addField(bounds_,    size);
+}
+
+
+
+void FluidSolver::resize(int width, int height)
+{
+	setGridSize(width, height);
+	allocateGrids();
+	reset();
+}
+
+
+
+int FluidSolver::getWidth()
+{
+	return NX_;
+}
+
+
+
+int FluidSolver::getHeight()
+{
+	return NY_;
+}
+
+
+
+size_t FluidSolver::getGridBytes()
+{
+	return arena_.getCapacity() + (coarse_ ? coarse_->getGridBytes() : 0);
+}
+
+
+
+void FluidSolver::setTimestep(float dt, float sourceDt)
+{
+	dt_       = dt;
+	sourceDt_ = sourceDt > 0.0f ? sourceDt : dt;
+}
+
+
+
+float FluidSolver::getTimestep()
+{
+	return dt_;
+}
+
+
+
+float FluidSolver::getMaxSpeed()
+{
+	return maxSpeed_;
+}
+
+
+
+void FluidSolver::reset()
+{
+	for (int i=0 ; i < getSize() ; i++) {
+		u_[i] = v_[i] = u_prev_[i] = v_prev_[i] = dens_[i] = dens_prev_[i] = scratch_[i] = 0.0f;
+		bounds_[i] = false;
+	}
+	boundsChanged_ = true;
+	tileActive_.assign(tileActive_.size(), 0);
+	tileMarked_.assign(tileMarked_.size(), 0);
+	maxSpeed_ = 0.0f;
+	if (coarse_)
+		coarse_->reset();
+}
+
+
+
+void FluidSolver::update()
+{
+	solveStats_.clear();
+	beginHaloStep();
+
+	//nothing moves and nothing was added: every field is zero and stays zero
+	if (trackTiles_ && !buildStepTiles())
+		return;
+
+	computeDensityStep(dens_, dens_prev_, u_, v_);
+	stepVelocity();
+
+	clearSources(true);
+
+	if (trackTiles_)
+		refreshActiveTiles();
+	else
+		measureMaxSpeed();
+}
+
+
+
+void FluidSolver::setSolverType(SolverType type)
+{
+	solverType_ = type;
+}
+
+
+
+void FluidSolver::setPressureSolver(PressureSolver type)
+{
+	pressureSolver_ = type;
+}
+
+
+
+void FluidSolver::setAdvectionScheme(AdvectionScheme density, AdvectionScheme velocity)
+{
+	densityAdvection_  = density;
+	velocityAdvection_ = velocity;
+}
+
+
+
+void FluidSolver::setRelaxation(float omega)
+{
+	//SOR only converges for 0 < omega < 2
+	if (omega > 0.0f && omega < 2.0f)
+		relaxation_ = omega;
+}
+
+
+
+void FluidSolver::setMaxIterations(int iterations)
+{
+	maxIterations_ = iterations < 1 ? 1 : iterations;
+}
+
+
+
+int FluidSolver::getMaxIterations()
+{
+	return maxIterations_;
+}
+
+
+
+void FluidSolver::setTolerance(float tolerance, float absTolerance)
+{
+	tolerance_    = tolerance    < 0.0f ? 0.0f : tolerance;
+	absTolerance_ = absTolerance < 0.0f ? 0.0f : absTolerance;
+}
+
+
+
+const vector<FluidSolver::SolveStats>& FluidSolver::getSolveStats()
+{
+	return solveStats_;
+}
+
+
+
+void FluidSolver::setKernels(const FluidKernels& kernels)
+{
+	kernels_ = &kernels;
+}
+
+
+
+const FluidKernels& FluidSolver::getKernels()
+{
+	return *kernels_;
+}
+
+
+
+void FluidSolver::setVelocityDownsampling(int factor)
+{
+	if (factor < 1)
+		factor = 1;
+	if (factor == velocityFactor_)
+		return;
+
+	velocityFactor_ = factor;
+	delete coarse_;
+	coarse_ = NULL;
+}
+
+
+
+int FluidSolver::getVelocityDownsampling()
+{
+	return velocityFactor_;
+}
+
+
+
+void FluidSolver::setActiveTileTracking(bool enabled, float epsilon)
+{
+	//tiles would skip exchanges their neighbors make
+	if (halo_)
+		enabled = false;
+
+	//fields may hold anything when tracking starts, so the first update covers everything
+	if (enabled && !trackTiles_)
+		tileMarked_.assign(tileMarked_.size(), 1);
+	if (!enabled)
+		tileStep_.assign(tileStep_.size(), 1);
+
+	trackTiles_  = enabled;
+	tileEpsilon_ = epsilon < 0.0f ? 0.0f : epsilon;
+}
+
+
+
+void FluidSolver::setHaloExchange(HaloExchange* halo, bool everySweep)
+{
+	int i;
+
+	halo_           = halo;
+	haloEverySweep_ = everySweep;
+	if (halo)
+		setActiveTileTracking(false, tileEpsilon_);
+
+	//forget the neighbors' obstacles
+	for (i = 0; i <= NX_ + 1; i++)
+		bounds_[IX(i, 0)] = bounds_[IX(i, NY_ + 1)] = false;
+	for (i = 0; i <= NY_ + 1; i++)
+		bounds_[IX(0, i)] = bounds_[IX(NX_ + 1, i)] = false;
+	boundsChanged_ = true;
+}
+
+
+
+HaloExchange* FluidSolver::getHaloExchange()
+{
+	return halo_;
+}
+
+
+
+int FluidSolver::getTilesX()
+{
+	return tilesX_;
+}
+
+
+
+int FluidSolver::getTilesY()
+{
+	return tilesY_;
+}
+
+
+
+bool FluidSolver::isTileActive(int tx, int ty)
+{
+	if (!trackTiles_)
+		return true;
+	int t = tx + tilesX_ * ty;
+	return tileActive_[t] || tileMarked_[t];
+}
+
+
+
+int FluidSolver::getActiveTileCount()
+{
+	int count = 0;
+	for (int ty = 0; ty < tilesY_; ty++)
+		for (int tx = 0; tx < tilesX_; tx++)
+			if (isTileActive(tx, ty)) count++;
+	return count;
+}
+
+
+
+//TODO: Can increase efficiency by only testing valid coordinates 
+//      when emitters are created.
+void FluidSolver::addVertVelocityAt(int x, int y, float value)
+{
+	if(isValidCoordinate(x, y)) {
+		v_prev_[IX(x,y)] += value;
+		markTileAt(x, y);
+	}
+}
+
+
+
+void FluidSolver::addHorzVelocityAt(int x, int y, float value)
+{
+	if(isValidCoordinate(x, y)) {
+		u_prev_[IX(x,y)] += value;
+		markTileAt(x, y);
+	}
+}
+
+
+
+void FluidSolver::addDensityAt(int x, int y, float value)
+{
+	if(isValidCoordinate(x, y)) {
+		dens_prev_[IX(x,y)] += value;
+		markTileAt(x, y);
+	}
+}
+
+
+
+void FluidSolver::setBoundAt(int x, int y, bool isBound)
+{
+	if(isValidCoordinate(x, y) && bounds_[IX(x,y)] != isBound) {
+		bounds_[IX(x,y)] = isBound;
+		boundsChanged_   = true;
+		markTileAt(x, y);
+	}
+}
+
+
+
+void FluidSolver::setBoundsFromMask(const unsigned char* mask, int stride)
+{
+	int i, j;
+
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		const unsigned char* row = mask + (j - 1) * stride;
+		bool* b = bounds_ + IX(0, j);
+
+		for ( i=1 ; i<=NX_ ; i++ ) {
+			bool isBound = row[i - 1] != 0;
+			if (b[i] != isBound) {
+				b[i] = isBound;
+				boundsChanged_ = true;
+				markTileAt(i, j);
+			}
+		}
+	}
+}
+
+
+
+/**
+ * Tests whether a span of an input field adds anything, so that zero input
+ * does not wake up tiles at rest.
+ */
+static bool isNonzeroSpan(const float* x, int count, int step)
+{
+	for (int k = 0; k < count * step; k++)
+		if (x[k] != 0) return true;
+	return false;
+}
+
+
+
+void FluidSolver::addVelocityField(const float* uv, int stride, float scale)
+{
+	int i, j, n;
+
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		const float* row = (const float*)((const char*)uv + (j - 1) * stride);
+
+		//one kernel call per tile, so only tiles that receive something are marked
+		for ( i=1 ; i<=NX_ ; i+=TILE_SIZE ) {
+			n = (NX_ + 1 - i < TILE_SIZE) ? NX_ + 1 - i : TILE_SIZE;
+			const float* src = row + 2 * (i - 1);
+			if (!isNonzeroSpan(src, n, 2))
+				continue;
+
+			kernels_->addInterleaved(u_prev_ + IX(i,j), v_prev_ + IX(i,j), src, scale, n);
+			markTileAt(i, j);
+		}
+	}
+}
+
+
+
+void FluidSolver::addDensityField(const float* d, int stride, float scale)
+{
+	int i, j, n;
+
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		const float* row = (const float*)((const char*)d + (j - 1) * stride);
+
+		for ( i=1 ; i<=NX_ ; i+=TILE_SIZE ) {
+			n = (NX_ + 1 - i < TILE_SIZE) ? NX_ + 1 - i : TILE_SIZE;
+			const float* src = row + (i - 1);
+			if (!isNonzeroSpan(src, n, 1))
+				continue;
+
+			kernels_->addSource(dens_prev_ + IX(i,j), src, scale, n);
+			markTileAt(i, j);
+		}
+	}
+}
+
+
+
+void FluidSolver::addSplats(const Splat* splats, int count)
+{
+	int k, y, tx, ty;
+
+	//sort by the tile of the center, so splats sharing cache lines run back to back
+	splatOrder_.resize(count);
+	for ( k=0 ; k<count ; k++ ) {
+		int tile = isValidCoordinate(splats[k].x, splats[k].y) ?
+			(splats[k].x - 1) / TILE_SIZE + tilesX_ * ((splats[k].y - 1) / TILE_SIZE) : 0;
+		splatOrder_[k] = make_pair(tile, k);
+	}
+	sort(splatOrder_.begin(), splatOrder_.end());
+
+	for ( k=0 ; k<count ; k++ ) {
+		const Splat& s = splats[splatOrder_[k].second];
+		if (!s.stamp) continue;
+
+		int r = s.stamp->radius, width = 2 * r + 1;
+		int x0 = max(s.x - r, 1), x1 = min(s.x + r, NX_);
+		int y0 = max(s.y - r, 1), y1 = min(s.y + r, NY_);
+		if (x0 > x1 || y0 > y1) continue;
+
+		float  densityScale = s.density;
+		float* density      = getSplatDensityTarget(s.user, densityScale);
+		int    n            = x1 - x0 + 1;
+
+		for ( y=y0 ; y<=y1 ; y++ ) {
+			int c = (x0 - (s.x - r)) + width * (y - (s.y - r));
+			kernels_->addSource(u_prev_ + IX(x0,y), &s.stamp->u[c], s.u, n);
+			kernels_->addSource(v_prev_ + IX(x0,y), &s.stamp->v[c], s.v, n);
+			if (density)
+				kernels_->addSource(density + IX(x0,y), &s.stamp->density[c], densityScale, n);
+		}
+
+		for ( ty=(y0 - 1) / TILE_SIZE ; ty<=(y1 - 1) / TILE_SIZE ; ty++ )
+			for ( tx=(x0 - 1) / TILE_SIZE ; tx<=(x1 - 1) / TILE_SIZE ; tx++ )
+				tileMarked_[tx + tilesX_ * ty] = 1;
+	}
+}
+
+
+
+float* FluidSolver::getSplatDensityTarget(int user, float& scale)
+{
+	return dens_prev_;
+}
+
+
+
+//accessors
+bool FluidSolver::isBoundAt(int x, int y)
+{
+	return bounds_[IX(x,y)];
+}
+
+
+
+const float* FluidSolver::getDensityData()
+{
+	return dens_;
+}
+
+
+
+const float* FluidSolver::getHorzVelocityData()
+{
+	return u_;
+}
+
+
+
+const float* FluidSolver::getVertVelocityData()
+{
+	return v_;
+}
+
+
+
+const bool* FluidSolver::getBoundsData()
+{
+	return bounds_;
+}
+
+
+
+int FluidSolver::getStride()
+{
+	return stride_;
+}
+
+
+
+float FluidSolver::getDensityAt(int x, int y)
+{
+	return dens_[IX(x,y)];
+}
+
+
+
+float FluidSolver::getVertVelocityAt(int x, int y)
+{
+	return v_[IX(x,y)];
+}
+
+
+
+float FluidSolver::getHorzVelocityAt(int x, int y)
+{
+	return u_[IX(x,y)];
+}
+
+
+
+///protected functions
+int FluidSolver::getSize()
+{
+	return (ROW_WIDTH) * (NY_ + 2);
+}
+
+
+
+bool FluidSolver::isValidCoordinate(int x, int y)
+{
+	bool xIsValid = (x >= 1) && (x <= NX_);
+	bool yIsValid = (y >= 1) && (y <= NY_);
+
+	if(xIsValid && yIsValid)
+		return true;
+	else
+		return false;
+}
+
+
+
+void FluidSolver::markTileAt(int x, int y)
+{
+	tileMarked_[(x - 1) / TILE_SIZE + tilesX_ * ((y - 1) / TILE_SIZE)] = 1;
+}
+
+
+
+bool FluidSolver::buildStepTiles()
+{
+	int tx, ty, k;
+	int nx = tilesX_, ny = tilesY_;
+	bool any = false;
+
+	for (k = 0; k < nx * ny; k++) {
+		tileScratch_[k] = tileActive_[k] | tileMarked_[k];
+		any = any || tileScratch_[k];
+		tileMarked_[k] = 0;
+	}
+	if (!any) {
+		tileStep_.assign(tileStep_.size(), 0);
+		return false;
+	}
+
+	//values travel at most dt * N * maxSpeed cells per step; one extra tile covers
+	//velocity added this frame and the reach of the bilinear stencil
+	int r = 1 + (int)(dt_ * N_ * maxSpeed_ / TILE_SIZE);
+	if (r > max(nx, ny)) r = max(nx, ny);
+
+	//separable dilation, horizontal into tileStep_, then vertical back into tileScratch_
+	for (ty = 0; ty < ny; ty++)
+		for (tx = 0; tx < nx; tx++) {
+			unsigned char hit = 0;
+			for (k = tx - r; k <= tx + r && !hit; k++)
+				if (k >= 0 && k < nx) hit = tileScratch_[k + nx * ty];
+			tileStep_[tx + nx * ty] = hit;
+		}
+	for (ty = 0; ty < ny; ty++)
+		for (tx = 0; tx < nx; tx++) {
+			unsigned char hit = 0;
+			for (k = ty - r; k <= ty + r && !hit; k++)
+				if (k >= 0 && k < ny) hit = tileStep_[tx + nx * k];
+			tileScratch_[tx + nx * ty] = hit;
+		}
+	tileStep_.swap(tileScratch_);
+
+	return true;
+}
+
+
+
+void FluidSolver::refreshActiveTiles()
+{
+	int t;
+	int n = tilesX_, count = tilesX_ * tilesY_;
+	float maxSpeed = 0.0f;
+
+	measureTiles();
+	for (t = 0; t < count; t++) {
+		tileActive_[t] = tileMax_[t] > tileEpsilon_;
+		if (tileActive_[t]) {
+			if (tileSpeed_[t] > maxSpeed) maxSpeed = tileSpeed_[t];
+		}
+		else if (tileMax_[t] > 0.0f) {
+			//settle faint remainders (mostly far field pressure corrections) to zero
+			//so quiet tiles stay quiet
+			clearTile(u_, t % n, t / n);
+			clearTile(v_, t % n, t / n);
+			clearTile(dens_, t % n, t / n);
+		}
+	}
+	maxSpeed_ = maxSpeed;
+}
+
+
+
+void FluidSolver::measureMaxSpeed()
+{
+	int t;
+	float maxSpeed = 0.0f;
+
+	measureTiles();
+	for (t = 0; t < tilesX_ * tilesY_; t++)
+		if (tileSpeed_[t] > maxSpeed) maxSpeed = tileSpeed_[t];
+	maxSpeed_ = maxSpeed;
+}
+
+
+
+void FluidSolver::measureTiles()
+{
+	int t;
+	int n = tilesX_, count = tilesX_ * tilesY_;
+
+	//largest magnitude per tile; OpenMP 2.0 has no max reduction, so each tile 
+	//keeps its own and the callers combine them
+	#pragma omp parallel for schedule(static)
+	for (t = 0; t < count; t++) {
+		int tx = t % n, ty = t / n;
+		int iEnd = (tx + 1) * TILE_SIZE < NX_ ? (tx + 1) * TILE_SIZE : NX_;
+		int jEnd = (ty + 1) * TILE_SIZE < NY_ ? (ty + 1) * TILE_SIZE : NY_;
+		float speed = 0.0f, value = 0.0f;
+
+		for (int j = 1 + ty * TILE_SIZE; j <= jEnd; j++)
+			for (int i = 1 + tx * TILE_SIZE; i <= iEnd; i++) {
+				float au = fabs(u_[IX(i,j)]), av = fabs(v_[IX(i,j)]), ad = fabs(dens_[IX(i,j)]);
+				if (au > speed) speed = au;
+				if (av > speed) speed = av;
+				if (ad > value) value = ad;
+			}
+		tileSpeed_[t] = speed;
+		tileMax_[t]   = speed > value ? speed : value;
+	}
+}
+
+
+
+void FluidSolver::clearTile(float* x, int tx, int ty)
+{
+	int iBegin = 1 + tx * TILE_SIZE, iEnd = (tx + 1) * TILE_SIZE < NX_ ? (tx + 1) * TILE_SIZE : NX_;
+	int jBegin = 1 + ty * TILE_SIZE, jEnd = (ty + 1) * TILE_SIZE < NY_ ? (ty + 1) * TILE_SIZE : NY_;
+
+	//include the buffer ring next to edge tiles
+	if (iBegin == 1)   iBegin = 0;
+	if (iEnd   == NX_) iEnd   = NX_ + 1;
+	if (jBegin == 1)   jBegin = 0;
+	if (jEnd   == NY_) jEnd   = NY_ + 1;
+
+	for (int j = jBegin; j <= jEnd; j++)
+		memset(x + IX(iBegin, j), 0, (iEnd - iBegin + 1) * sizeof(float));
+}
+
+
+
+void FluidSolver::clearSources(bool density)
+{
+	int k;
+	int n = tilesX_, count = tilesX_ * tilesY_;
+
+	//the pressure solve leaves its fields in u_prev_ and v_prev_ all over the grid,
+	//unless it runs on coarse_, and diffusion spreads density anywhere. Otherwise 
+	//values stay in the step tiles, and the obstacle cells next to them.
+	bool tileVelocity = trackTiles_ && velocityFactor_ > 1 && !halo_;
+	bool tileDensity  = trackTiles_ && diff_ == 0.0f && density;
+
+	if (!tileVelocity) {
+		memset(u_prev_, 0, getSize() * sizeof(float));
+		memset(v_prev_, 0, getSize() * sizeof(float));
+	}
+	if (density && !tileDensity)
+		memset(dens_prev_, 0, getSize() * sizeof(float));
+	if (!tileVelocity && !tileDensity)
+		return;
+
+	//the step tiles grown by one tile
+	#pragma omp parallel for schedule(static)
+	for (k = 0; k < count; k++) {
+		int tx = k % n, ty = k / n;
+		bool reached = false;
+		for (int y = ty - 1; y <= ty + 1 && !reached; y++)
+			for (int x = tx - 1; x <= tx + 1 && !reached; x++)
+				reached = x >= 0 && x < n && y >= 0 && y < tilesY_ && tileStep_[x + n * y];
+		if (!reached)
+			continue;
+		if (tileVelocity) {
+			clearTile(u_prev_, tx, ty);
+			clearTile(v_prev_, tx, ty);
+		}
+		if (tileDensity)
+			clearTile(dens_prev_, tx, ty);
+	}
+}
+
+
+
+bool FluidSolver::isStepTile(int tx, int j)
+{
+	return !trackTiles_ || tileStep_[tx + tilesX_ * ((j - 1) / TILE_SIZE)] != 0;
+}
+
+
+
+void FluidSolver::addSource(float* x, float* s)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_ADD_SOURCE);
+	kernels_->addSource(x, s, sourceDt_, getSize());
+}
+
+
+
+void FluidSolver::setBounds(int boundsFlag, float* x)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_SET_BOUNDS);
+	int i, k;
+
+	if (boundsChanged_)
+		compileBounds();
+
+	//free slip boundary edges, on the sides without a neighbor tile
+	bool wallLeft   = !hasHaloNeighbor(HaloExchange::SIDE_LEFT);
+	bool wallRight  = !hasHaloNeighbor(HaloExchange::SIDE_RIGHT);
+	bool wallBottom = !hasHaloNeighbor(HaloExchange::SIDE_BOTTOM);
+	bool wallTop    = !hasHaloNeighbor(HaloExchange::SIDE_TOP);
+
+	//reverse velocity component on vertical walls (u)
+	for ( i=1 ; i<=NY_; i++ ) {
+		if (wallLeft)   x[IX(0  ,i)]   = boundsFlag==1 ? -x[IX(1,i)] : x[IX(1,i)];
+		if (wallRight)  x[IX(NX_+1,i)] = boundsFlag==1 ? -x[IX(NX_,i)] : x[IX(NX_,i)];
+	}
+		
+	//reverse velocity component on horizontal (top and bottom) walls (v)
+	for ( i=1 ; i<=NX_; i++ ) {
+		if (wallBottom) x[IX(i,0  )]   = boundsFlag==2 ? -x[IX(i,1)] : x[IX(i,1)];
+		if (wallTop)    x[IX(i,NY_+1)] = boundsFlag==2 ? -x[IX(i,NY_)] : x[IX(i,NY_)];
+	}
+
+	//obstacle cells take the value of the open cell to their right, or above,
+	//reversing the velocity component that points into the obstacle
+	float signRight = boundsFlag==1 ? -1.0f : 1.0f;
+	float signUp    = boundsFlag==2 ? -1.0f : 1.0f;
+
+	for ( k=0 ; k<(int)boundsZero_.size() ; k++ )
+		memset(x + boundsZero_[k].start, 0, boundsZero_[k].count * sizeof(float));
+
+	for ( k=0 ; k<(int)boundsCopyRight_.size() ; k++ )
+		x[boundsCopyRight_[k].dst] = signRight * x[boundsCopyRight_[k].src];
+
+	for ( k=0 ; k<(int)boundsCopyUp_.size() ; k++ )
+		x[boundsCopyUp_[k].dst] = signUp * x[boundsCopyUp_[k].src];
+
+	//edges are final now, trade them for the neighbors' edges
+	exchangeHalo(x, sizeof(float));
+
+	//inner corners average their two obstacle neighbors; some of those are
+	//corners themselves, so the list has to run in order
+	for ( k=0 ; k<(int)boundsCorners_.size() ; k++ ) {
+		const BoundsCorner& c = boundsCorners_[k];
+		x[c.dst] = 0.5f * (x[c.a] + x[c.b]);
+	}
+
+	//corner conditions
+	x[IX(0,       0      )] = 0.5f * (x[IX(1,   0    )] + x[IX(0,       1  )]);
+	x[IX(0,       NY_ + 1)] = 0.5f * (x[IX(1,   NY_+1)] + x[IX(0,       NY_)]);
+	x[IX(NX_ + 1, 0      )] = 0.5f * (x[IX(NX_, 0    )] + x[IX(NX_ + 1, 1  )]);
+	x[IX(NX_ + 1, NY_ + 1)] = 0.5f * (x[IX(NX_, NY_+1)] + x[IX(NX_ + 1, NY_)]);
+}
+
+
+
+void FluidSolver::compileBounds()
+{
+	int i, j, w;
+
+	//pack the mask, buffer cells included so neighbor tests need no range checks.
+	//Buffer cells only hold obstacles of neighbor tiles.
+	boundsBits_.assign(boundsBits_.size(), 0);
+	for ( j=0 ; j<=NY_+1 ; j++ ) {
+		const bool* b = bounds_ + IX(0, j);
+		unsigned int* bits = &boundsBits_[j * boundsWords_];
+		for ( i=0 ; i<=NX_+1 ; i++ )
+			if (b[i]) bits[i >> 5] |= 1u << (i & 31);
+	}
+
+	boundsCopyRight_.clear();
+	boundsCopyUp_.clear();
+	boundsZero_.clear();
+	boundsCorners_.clear();
+
+	//Rules are only made for interior cells, so the rules of the original per cell
+	//pass reduce to one assignment per obstacle cell. Its writes into obstacle 
+	//cells from their open neighbors were always overwritten by the cell itself.
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		const unsigned int* bits = &boundsBits_[j * boundsWords_];
+
+		for ( w=0 ; w<boundsWords_ ; w++ ) {
+			if (!bits[w]) continue;
+
+			for ( i=w*32 ; i<(w+1)*32 ; i++ ) {
+				if (!((bits[w] >> (i & 31)) & 1) || i < 1 || i > NX_) continue;
+
+				bool right = isBoundBit(i+1, j), left = isBoundBit(i-1, j);
+				bool up    = isBoundBit(i, j+1), down = isBoundBit(i, j-1);
+
+				if (!right) {
+					BoundsCopy c = { IX(i,j), IX(i+1,j) };
+					boundsCopyRight_.push_back(c);
+				}
+				else if (!up) {
+					BoundsCopy c = { IX(i,j), IX(i,j+1) };
+					boundsCopyUp_.push_back(c);
+				}
+				else if (!boundsZero_.empty() && 
+						 boundsZero_.back().start + boundsZero_.back().count == IX(i,j))
+					boundsZero_.back().count++;
+				else {
+					BoundsRun r = { IX(i,j), 1 };
+					boundsZero_.push_back(r);
+				}
+
+				// X = cell in question | 0 = open cell | * = closed cell (with a boundary)
+				BoundsCorner c = { IX(i,j), -1, -1 };
+
+				// * 0
+				// X *
+				if (right && up && !isBoundBit(i+1, j+1))
+					{ c.a = IX(i+1, j); c.b = IX(i, j+1); }
+				// X * 
+				// * 0
+				else if (right && down && !isBoundBit(i+1, j-1))
+					{ c.a = IX(i+1, j); c.b = IX(i, j-1); }
+				// * X 
+				// 0 *
+				else if (left && down && !isBoundBit(i-1, j-1))
+					{ c.a = IX(i-1, j); c.b = IX(i, j-1); }
+				// 0 * 
+				// * X
+				else if (left && up && !isBoundBit(i-1, j+1))
+					{ c.a = IX(i-1, j); c.b = IX(i, j+1); }
+
+				if (c.a >= 0)
+					boundsCorners_.push_back(c);
+			}
+		}
+	}
+
+	boundsChanged_ = false;
+}
+
+
+
+void FluidSolver::exchangeHalo(void* x, int elementSize)
+{
+	int j, s;
+	//left and right carry a column, bottom and top a row
+	int bytes[HaloExchange::SIDE_COUNT] = { NY_ * elementSize, NY_ * elementSize,
+											NX_ * elementSize, NX_ * elementSize };
+	char* cells = (char*)x;
+	const void* send[HaloExchange::SIDE_COUNT];
+	void*       recv[HaloExchange::SIDE_COUNT];
+	bool        linked[HaloExchange::SIDE_COUNT];
+
+	if (!halo_ || haloSkip_)
+		return;
+
+	for (s = 0; s < HaloExchange::SIDE_COUNT; s++) {
+		linked[s] = halo_->hasNeighbor((HaloExchange::Side)s);
+		haloSend_[s].resize(bytes[s]);
+		haloRecv_[s].resize(bytes[s]);
+		send[s] = &haloSend_[s][0];
+		recv[s] = &haloRecv_[s][0];
+	}
+
+	//rows are contiguous, columns are gathered a cell at a time
+	for (j = 1; j <= NY_; j++) {
+		if (linked[HaloExchange::SIDE_LEFT])
+			memcpy(&haloSend_[HaloExchange::SIDE_LEFT][(j - 1) * elementSize],  cells + IX(1, j)   * elementSize, elementSize);
+		if (linked[HaloExchange::SIDE_RIGHT])
+			memcpy(&haloSend_[HaloExchange::SIDE_RIGHT][(j - 1) * elementSize], cells + IX(NX_, j) * elementSize, elementSize);
+	}
+	if (linked[HaloExchange::SIDE_BOTTOM])
+		memcpy(&haloSend_[HaloExchange::SIDE_BOTTOM][0], cells + IX(1, 1)   * elementSize, bytes[HaloExchange::SIDE_BOTTOM]);
+	if (linked[HaloExchange::SIDE_TOP])
+		memcpy(&haloSend_[HaloExchange::SIDE_TOP][0],    cells + IX(1, NY_) * elementSize, bytes[HaloExchange::SIDE_TOP]);
+
+	halo_->exchange(send, recv, bytes, haloTag_++);
+
+	//a side whose link just closed keeps its last cells until the next setBounds()
+	//turns it into a wall
+	for (s = 0; s < HaloExchange::SIDE_COUNT; s++)
+		linked[s] = linked[s] && halo_->hasNeighbor((HaloExchange::Side)s);
+
+	for (j = 1; j <= NY_; j++) {
+		if (linked[HaloExchange::SIDE_LEFT])
+			memcpy(cells + IX(0, j)       * elementSize, &haloRecv_[HaloExchange::SIDE_LEFT][(j - 1) * elementSize],  elementSize);
+		if (linked[HaloExchange::SIDE_RIGHT])
+			memcpy(cells + IX(NX_ + 1, j) * elementSize, &haloRecv_[HaloExchange::SIDE_RIGHT][(j - 1) * elementSize], elementSize);
+	}
+	if (linked[HaloExchange::SIDE_BOTTOM])
+		memcpy(cells + IX(1, 0)       * elementSize, &haloRecv_[HaloExchange::SIDE_BOTTOM][0], bytes[HaloExchange::SIDE_BOTTOM]);
+	if (linked[HaloExchange::SIDE_TOP])
+		memcpy(cells + IX(1, NY_ + 1) * elementSize, &haloRecv_[HaloExchange::SIDE_TOP][0],    bytes[HaloExchange::SIDE_TOP]);
+}
+
+
+
+void FluidSolver::beginHaloStep()
+{
+	int i;
+
+	haloTag_ = 0;
+	if (!halo_)
+		return;
+
+	//the buffer ring of bounds_ holds the neighbors' edge obstacles
+	vector<bool> ring(2 * (NX_ + NY_));
+	for (i = 1; i <= NY_; i++) {
+		ring[2 * (i - 1)]     = bounds_[IX(0, i)];
+		ring[2 * (i - 1) + 1] = bounds_[IX(NX_ + 1, i)];
+	}
+	for (i = 1; i <= NX_; i++) {
+		ring[2 * (NY_ + i - 1)]     = bounds_[IX(i, 0)];
+		ring[2 * (NY_ + i - 1) + 1] = bounds_[IX(i, NY_ + 1)];
+	}
+
+	exchangeHalo(bounds_, sizeof(bool));
+
+	for (i = 1; i <= NY_ && !boundsChanged_; i++)
+		boundsChanged_ = ring[2 * (i - 1)]     != bounds_[IX(0, i)] ||
+						 ring[2 * (i - 1) + 1] != bounds_[IX(NX_ + 1, i)];
+	for (i = 1; i <= NX_ && !boundsChanged_; i++)
+		boundsChanged_ = ring[2 * (NY_ + i - 1)]     != bounds_[IX(i, 0)] ||
+						 ring[2 * (NY_ + i - 1) + 1] != bounds_[IX(i, NY_ + 1)];
+}
+
+
+
+void FluidSolver::linearSolve( int boundsFlag, float* x, float* x0, float a, float c)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_LINEAR_SOLVE);
+	int k;
+	float* xn = scratch_;
+	float residual = 0.0f, rhsNorm = 0.0f;
+	bool residualIsCurrent = false;
+	SolveStats stats = { 0, 0.0f };
+
+	for ( k=0 ; k<maxIterations_ ; k++ ) {
+		// without haloEverySweep_ only the last sweep trades cells with the
+		// neighbors, the exchange inside a red/black sweep included
+		haloSkip_ = !haloEverySweep_ && k + 1 < maxIterations_;
+		switch (solverType_) {
+			case RED_BLACK_SOR:
+				sweepRedBlack(x, x0, a, c);
+				break;
+			case JACOBI:
+				//write the next iterate into the other buffer, then trade places
+				sweepJacobi(xn, x, x0, a, c);
+				SWAP(xn, x);
+				break;
+			default:
+				sweepGaussSeidel(x, x0, a, c);
+				break;
+		}
+		// factor in boundary conditions with each solution iteration
+		setBounds(boundsFlag, x); 
+		haloSkip_ = false;
+		stats.iterations++;
+		residualIsCurrent = false;
+
+		//test after the first sweep so fields that are already converged 
+		//(quiet frames, zero diffusion) cost a single pass. Tiles never stop
+		//early, their neighbors expect the exchange of every sweep.
+		bool useTolerance = !halo_ && (tolerance_ > 0.0f || absTolerance_ > 0.0f);
+		if (useTolerance && (k == 0 || (k + 1) % RESIDUAL_CHECK_INTERVAL == 0)) {
+			residual          = computeResidual(x, x0, a, c, &rhsNorm);
+			residualIsCurrent = true;
+			if (residual <= tolerance_ * rhsNorm + absTolerance_)
+				break;
+		}
+	}
+
+	if (!residualIsCurrent)
+		residual = computeResidual(x, x0, a, c, &rhsNorm);
+	stats.residual = rhsNorm > 0.0f ? residual / rhsNorm : residual;
+	solveStats_.push_back(stats);
+
+	//an odd number of Jacobi sweeps leaves the solution in the scratch buffer
+	if (x == scratch_)
+		memcpy(xn, x, getSize() * sizeof(float));
+}
+
+
+
+void FluidSolver::sweepGaussSeidel( float* x, float* x0, float a, float c)
+{
+	int i, j;
+
+	FOR_EACH_CELL
+		//exchange values with neighbors
+		x[IX(i,j)] = (x0[IX(i,j)] + a*(x[IX(i-1,j)] + x[IX(i+1,j)] + x[IX(i,j-1)] + x[IX(i,j+1)])) / c;
+	END_FOR
+}
+
+
+
+void FluidSolver::sweepRedBlack( float* x, float* x0, float a, float c)
+{
+	int j, color;
+	float omega = relaxation_;
+	float invC  = 1.0f / c;
+
+	//cells of one color only read cells of the other, so each half sweep
+	//can be split across rows without changing the result
+	for ( color=0 ; color<2 ; color++ ) {
+		#pragma omp parallel for schedule(static)
+		for ( j=1 ; j<=NY_ ; j++ ) {
+			for ( int i = 1 + ((j + color) & 1) ; i<=NX_ ; i+=2 ) {
+				float gs = (x0[IX(i,j)] + a*(x[IX(i-1,j)] + x[IX(i+1,j)] + x[IX(i,j-1)] + x[IX(i,j+1)])) * invC;
+				x[IX(i,j)] += omega * (gs - x[IX(i,j)]);
+			}
+		}
+
+		//the second color reads the first on the neighbors' edges as well. Colors
+		//follow local indices, even tile sizes keep them in step across the seam.
+		if (color == 0)
+			exchangeHalo(x, sizeof(float));
+	}
+}
+
+
+
+void FluidSolver::sweepJacobi( float* xn, float* x, float* x0, float a, float c)
+{
+	int j;
+	float invC = 1.0f / c;
+
+	#pragma omp parallel for schedule(static)
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		for ( int i=1 ; i<=NX_ ; i++ )
+			xn[IX(i,j)] = (x0[IX(i,j)] + a*(x[IX(i-1,j)] + x[IX(i+1,j)] + x[IX(i,j-1)] + x[IX(i,j+1)])) * invC;
+	}
+}
+
+
+
+float FluidSolver::computeResidual( float* x, float* x0, float a, float c, float* rhsNorm)
+{
+	int j;
+	double sum = 0.0, rhs = 0.0;
+	float invC = 1.0f / c;
+
+	#pragma omp parallel for schedule(static) reduction(+:sum,rhs)
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		for ( int i=1 ; i<=NX_ ; i++ ) {
+			if (bounds_[IX(i,j)]) continue;
+			float b = x0[IX(i,j)] * invC;
+			float r = b + a*(x[IX(i-1,j)] + x[IX(i+1,j)] + x[IX(i,j-1)] + x[IX(i,j+1)]) * invC - x[IX(i,j)];
+			sum += r * r;
+			rhs += b * b;
+		}
+	}
+
+	*rhsNorm = (float) sqrt(rhs / (NX_ * NY_));
+	return (float) sqrt(sum / (NX_ * NY_));
+}
+
+
+
+void FluidSolver::diffuse (int boundsFlag, float* x, float* x0)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_DIFFUSE);
+	float diffusionPerCell = dt_ * diff_ * N_ * N_;
+	linearSolve ( boundsFlag, x, x0, diffusionPerCell, 1+4*diffusionPerCell);
+}
+
+
+
+void FluidSolver::advect (int boundsFlag, float* d, float* d0, 
+						  float* u, float* v)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_ADVECT);
+
+	//initial time differential = dt * number of cells per unit length
+	advectCells(d, d0, u, v, dt_ * N_);
+	setBounds(boundsFlag, d);
+}
+
+
+
+void FluidSolver::advectWith (AdvectionScheme scheme, int boundsFlag, float* d, float* d0, 
+							  float* u, float* v)
+{
+	if (scheme == ADVECT_MACCORMACK)
+		advectMacCormack(boundsFlag, d, d0, u, v);
+	else
+		advect(boundsFlag, d, d0, u, v);
+}
+
+
+
+void FluidSolver::advectMacCormack (int boundsFlag, float* d, float* d0, 
+									float* u, float* v)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_ADVECT);
+	float dt0 = dt_ * N_;
+
+	//forward into d, back again into scratch_; the backward pass samples the buffer
+	//ring of d, so d needs its bounds first
+	advectCells(d, d0, u, v, dt0);
+	setBounds(boundsFlag, d);
+	advectCells(scratch_, d, u, v, -dt0);
+
+	correctMacCormack(d, d0, scratch_, u, v);
+	setBounds(boundsFlag, d);
+}
+
+
+
+void FluidSolver::advectCells (float* d, const float* d0, const float* u, const float* v, float dt0)
+{
+	int j;
+
+	//back trace density and velocity values from the center of each cell. Rows are
+	//independent, so they are split across threads.
+	#pragma omp parallel for schedule(static)
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		//runs of tiles with the same state are handled in one call. Tiles without
+		//motion nearby would backtrace onto themselves, so they are copied.
+		int tx = 0;
+		while (tx < tilesX_) {
+			bool step = isStepTile(tx, j);
+			int  run  = tx + 1;
+			while (run < tilesX_ && isStepTile(run, j) == step)
+				run++;
+
+			int iBegin = 1 + tx * TILE_SIZE;
+			int iEnd   = run * TILE_SIZE < NX_ ? run * TILE_SIZE : NX_;
+			if (step)
+				kernels_->advectRow(d, d0, u, v, j, iBegin, iEnd, ROW_WIDTH, dt0, NX_ + 0.5f, NY_ + 0.5f);
+			else
+				memcpy(d + IX(iBegin, j), d0 + IX(iBegin, j), (iEnd - iBegin + 1) * sizeof(float));
+			tx = run;
+		}
+	}
+}
+
+
+
+void FluidSolver::correctMacCormack (float* d, const float* d0, const float* back, 
+									 const float* u, const float* v)
+{
+	float dt0  = dt_ * N_;
+	float maxX = NX_ + 0.5f, maxY = NY_ + 0.5f;
+	int j;
+
+	#pragma omp parallel for schedule(static)
+	for ( j=1 ; j<=NY_ ; j++ ) {
+		for (int i = 1; i <= NX_; i++) {
+			int c = IX(i,j);
+
+			//the forward backtrace again, same arithmetic as FluidKernels::advectRow
+			float x = i - dt0 * u[c];
+			float y = j - dt0 * v[c];
+			if (x < 0.5f) x = 0.5f;
+			if (x > maxX) x = maxX;
+			if (y < 0.5f) y = 0.5f;
+			if (y > maxY) y = maxY;
+
+			const float* src = d0 + IX((int)x, (int)y);
+			float lo = src[0], hi = src[0];
+			if (src[1] < lo)             lo = src[1];
+			if (src[1] > hi)             hi = src[1];
+			if (src[ROW_WIDTH] < lo)     lo = src[ROW_WIDTH];
+			if (src[ROW_WIDTH] > hi)     hi = src[ROW_WIDTH];
+			if (src[ROW_WIDTH + 1] < lo) lo = src[ROW_WIDTH + 1];
+			if (src[ROW_WIDTH + 1] > hi) hi = src[ROW_WIDTH + 1];
+
+			float r = d[c] + 0.5f * (d0[c] - back[c]);
+			d[c] = r < lo ? lo : r > hi ? hi : r;
+		}
+	}
+}
+
+
+
+void FluidSolver::project( float* u, float* v, float* p, float* div)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_PROJECT);
+	int i, j;
+
+	float h = 1.0 / N_; //calculate unit length of each cell relative to the whole grid.
+
+	//calculate initial solution to gradient field based on the difference in velocities of
+	//surrounding cells, and set projected solution values to be zero
+	#pragma omp parallel for schedule(static)
+	for ( j=1 ; j<=NY_ ; j++ )
+		kernels_->divergenceRow(div, p, u, v, j, NX_, ROW_WIDTH, -0.5f * h);
+
+	//set bounds for diffusion
+	setBounds(0, div); 
+	setBounds(0, p);
+
+	// calculate gradient (height) field
+	//multigrid has no halo on its coarse levels, tiles relax instead
+	if (pressureSolver_ == PRESSURE_MULTIGRID && !halo_) {
+		solvePressureMultigrid(p, div);
+
+		//multigrid treats every obstacle face as solid (zero pressure gradient), so
+		//solid neighbors take the value of the cell itself rather than the value 
+		//setBounds() copied into them
+		FOR_EACH_CELL
+			if (bounds_[IX(i, j)]) continue;
+			float pc = p[IX(i, j)];
+			float pe = bounds_[IX(i + 1, j)] ? pc : p[IX(i + 1, j)];
+			float pw = bounds_[IX(i - 1, j)] ? pc : p[IX(i - 1, j)];
+			float pn = bounds_[IX(i, j + 1)] ? pc : p[IX(i, j + 1)];
+			float ps = bounds_[IX(i, j - 1)] ? pc : p[IX(i, j - 1)];
+			u[IX(i, j)] -= 0.5f * N_ * (pe - pw);
+			v[IX(i, j)] -= 0.5f * N_ * (pn - ps);
+		END_FOR
+	}
+	else {
+		linearSolve (0, p, div, 1, 4);
+
+		//subtract gradient field from current velocities
+		#pragma omp parallel for schedule(static)
+		for ( j=1 ; j<=NY_ ; j++ )
+			kernels_->gradientRow(u, v, p, j, NX_, ROW_WIDTH, 0.5f * N_);
+	}
+
+	//set boundaries for velocity
+	setBounds(1, u); 
+	setBounds(2, v);
+}
+
+
+
+void FluidSolver::solvePressureMultigrid( float* p, float* div)
+{
+	SolveStats stats;
+
+	if (!multigrid_)
+		multigrid_ = new MultigridSolver(NX_, NY_);
+
+	stats.iterations = multigrid_->solve(p, div, bounds_, ROW_WIDTH, MAX_MULTIGRID_CYCLES, 
+										 tolerance_, &stats.residual);
+	setBounds(0, p);
+	solveStats_.push_back(stats);
+}
+
+
+
+void FluidSolver::computeDensityStep( float* x, float* x0, float* u, float* v )
+{
+	addSource (x, x0);
+	SWAP(x0, x); 
+	diffuse(0, x, x0);
+	SWAP(x0, x); 
+	advectWith(densityAdvection_, 0, x, x0, u, v);
+}
+
+
+
+void FluidSolver::computeVelocityStep (float* u, float* v, float* u0, float* v0)
+{
+	addSource(u, u0); 
+	addSource(v, v0);
+	//diffuse horizontal 
+	SWAP(u0, u); 
+	diffuse(1, u, u0);
+
+	//diffuse vertical
+	SWAP(v0, v); 
+	diffuse(2, v, v0);
+	project (u, v, u0, v0);
+	SWAP(u0, u); 
+	SWAP (v0, v);
+
+	//advect velocities
+	advectWith(velocityAdvection_, 1, u, u0, u0, v0); 
+	advectWith(velocityAdvection_, 2, v, v0, u0, v0);
+	project(u, v, u0, v0);
+}
+
+
+
+void FluidSolver::stepVelocity()
+{
+	//tiles trade full resolution halos, so they keep the full resolution velocity
+	if (velocityFactor_ > 1 && !halo_)
+		stepCoarseVelocity();
+	else
+		computeVelocityStep(u_, v_, u_prev_, v_prev_);
+}
+
+
+
+void FluidSolver::stepCoarseVelocity()
+{
+	int f  = velocityFactor_;
+	int cw = (NX_ + f - 1) / f, ch = (NY_ + f - 1) / f;
+	int J;
+
+	bool created = (coarse_ == NULL);
+	if (created) {
+		coarse_ = new FluidSolver(cw, ch, dt_, diff_, visc_);
+		//fresh arena fields are undefined, the seeding below only writes the interior
+		coarse_->reset();
+	}
+
+	FluidSolver& c = *coarse_;
+	c.dt_                = dt_;
+	c.sourceDt_          = sourceDt_;
+	c.diff_              = diff_;
+	c.visc_              = visc_;
+	c.solverType_        = solverType_;
+	c.pressureSolver_    = pressureSolver_;
+	c.velocityAdvection_ = velocityAdvection_;
+	c.kernels_           = kernels_;
+	c.relaxation_        = relaxation_;
+	c.maxIterations_     = maxIterations_;
+	c.tolerance_         = tolerance_;
+	c.absTolerance_      = absTolerance_;
+	c.solveStats_.clear();
+
+	//block averages of the sources, and of the velocity itself for a new grid. Only
+	//interior cells are written, addSource() reads the buffer ring too.
+	memset(c.u_prev_, 0, c.getSize() * sizeof(float));
+	memset(c.v_prev_, 0, c.getSize() * sizeof(float));
+	bool boundsChanged = false;
+
+	#pragma omp parallel for schedule(static) reduction(||:boundsChanged)
+	for (J = 1; J <= ch; J++) {
+		int jBegin = 1 + (J - 1) * f, jEnd = J * f < NY_ ? J * f : NY_;
+		for (int I = 1; I <= cw; I++) {
+			int iBegin = 1 + (I - 1) * f, iEnd = I * f < NX_ ? I * f : NX_;
+			float su = 0.0f, sv = 0.0f, du = 0.0f, dv = 0.0f;
+			int   solid = 0, cells = (iEnd - iBegin + 1) * (jEnd - jBegin + 1);
+
+			for (int j = jBegin; j <= jEnd; j++)
+				for (int i = iBegin; i <= iEnd; i++) {
+					su    += u_prev_[IX(i,j)];
+					sv    += v_prev_[IX(i,j)];
+					du    += u_[IX(i,j)];
+					dv    += v_[IX(i,j)];
+					solid += bounds_[IX(i,j)];
+				}
+
+			int   k = I + c.stride_ * J;
+			float w = 1.0f / cells;
+			c.u_prev_[k] = su * w;
+			c.v_prev_[k] = sv * w;
+			if (created) {
+				c.u_[k] = du * w;
+				c.v_[k] = dv * w;
+			}
+
+			bool bound = 2 * solid >= cells;
+			if (c.bounds_[k] != bound) {
+				c.bounds_[k]  = bound;
+				boundsChanged = true;
+			}
+		}
+	}
+	if (boundsChanged)
+		c.boundsChanged_ = true;
+
+	c.computeVelocityStep(c.u_, c.v_, c.u_prev_, c.v_prev_);
+	solveStats_.insert(solveStats_.end(), c.solveStats_.begin(), c.solveStats_.end());
+
+	//bilinear samples of the coarse velocity at the fine cell centers, clamped to
+	//the coarse buffer ring like advect()
+	float scale = 1.0f / f, maxX = cw + 0.5f, maxY = ch + 0.5f;
+	int   j;
+
+	#pragma omp parallel for schedule(static)
+	for (j = 1; j <= NY_; j++) {
+		float y  = (j - 0.5f) * scale + 0.5f;
+		if (y > maxY) y = maxY;
+		int   j0 = (int)y;
+		float t1 = y - j0, t0 = 1.0f - t1;
+		const float* u0 = c.u_ + c.stride_ * j0;
+		const float* v0 = c.v_ + c.stride_ * j0;
+		const float* u1 = u0 + c.stride_;
+		const float* v1 = v0 + c.stride_;
+
+		for (int i = 1; i <= NX_; i++) {
+			int k = IX(i,j);
+			if (bounds_[k]) {
+				u_[k] = v_[k] = 0.0f;
+				continue;
+			}
+
+			float x  = (i - 0.5f) * scale + 0.5f;
+			if (x > maxX) x = maxX;
+			int   i0 = (int)x;
+			float s1 = x - i0, s0 = 1.0f - s1;
+			u_[k] = t0 * (s0 * u0[i0] + s1 * u0[i0 + 1]) + t1 * (s0 * u1[i0] + s1 * u1[i0 + 1]);
+			v_[k] = t0 * (s0 * v0[i0] + s1 * v0[i0 + 1]) + t1 * (s0 * v1[i0] + s1 * v1[i0 + 1]);
+		}
+	}
+}
@@ -1,296 +1,937 @@
-/**
- * @file      FluidSolver.h
- * @author    Austin Hines <futurelightstudios@gmail.com>
- * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
- * @version	  1.0.0
- * 
- * This file is part of Fluid Wall. You can redistribute it and/or modify            
- * it under the terms of the GNU Lesser General Public License as published  
- * by the Free Software Foundation, either version 3 of the License, or     
- * (at your option) any later version.                                       
- *                                                                             
- * Fluid Wall is distributed in the hope that it will be useful,                 
- * but WITHOUT ANY WARRANTY; without even the implied warranty of            
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
- * GNU Lesser General Public License for more details.                       
- *                                                                            
- * You should have received a copy of the GNU Lesser General Public License  
- * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
- *
- */
-
-#pragma once
-#include <vector>
-
-using namespace std;
-
-/**
- * A 2D fluid simulation solver based on the Stable Fluids algorithm.
- *
- * This algorithm based on original C code from Jos Stam's 2001 paper, "Real Time Fluid
- * Dynamics for Games." I have adapted this code to C++ style and classes (vectors instead
- * of arrays, etc.) 
- * 
- */
-class FluidSolver
-{
-public:
-	//TODO: change all comments to reflect the switch to vectors.
-
-	/**
-	 * Default constructor.
-	 * 
-	 */
-	FluidSolver(void);
-
-	/**
-	 * Parameter constructor.
-	 * @param N      Width (and height) of the square fluid simulation grid
-	 * @param dt     Timestep size
-	 * @param diff   Diffusion coefficient
-	 * @param visc   Viscosity coefficient
-	 */
-	FluidSolver(int N, float dt, float diff, float visc);
-	~FluidSolver(void);
-
-	/**
-	 * Adds vertical velocity values at a particular coordinate. 
-	 *
-	 * The system is designed to add values from multiple other sources using this method, 
-	 * and then commit them to the simulation using update(). Valid indicies range from 
-	 * 1 to N. Indicies 0 and N+1 are buffer rows for algorithms.
-	 *
-	 * @param x     x-coordinate, valid values: 1 - N
-	 * @param y     y-coordinate, valid values: 1 - N
-	 * @param value New vertical velocity value
-	 */
-	void addVertVelocityAt(int x, int y, float value);
-
-
-	/**
-	 * Adds horizontal velocity values at a particular coordinate. 
-	 *
-	 * The system is designed to add values from multiple other sources using this method, 
-	 * and then commit them to the simulation using update(). Valid indicies range from 
-	 * 1 to N. Indicies 0 and N+1 are buffer rows for algorithms.
-	 *
-	 * @param x     x-coordinate, valid values: 1 - N
-	 * @param y     y-coordinate, valid values: 1 - N
-	 * @param value New horizontal velocity value
-	 */
-	void addHorzVelocityAt(int x, int y, float value);
-
-
-	/**
-	 * Adds density values at a particular coordinate. 
-	 *
-	 * The system is designed to add values from multiple other sources using this method, 
-	 * and then commit them to the simulation using update(). Valid indicies range from 
-	 * 1 to N. Indicies 0 and N+1 are buffer rows for algorithms.
-	 *
-	 * @param x     x-coordinate, valid values: 1 - N
-	 * @param y     y-coordinate, valid values: 1 - N
-	 * @param value Density value to be added
-	 */
-	void addDensityAt(int x, int y, float value);
-
-	/**
-	 * Sets bound condition at a given cell.
-	 *
-	 * @param x       x-coordinate, valid values: 1 - N
-	 * @param y       y-coordinate, valid values: 1 - N
-	 * @param isBound boolean true/false
-	 */
-	void setBoundAt(int x, int y, bool isBound);
-
-	/**
-	 * Accesor: returns boundary value at given cell.
-	 *
-	 * @param x       x-coordinate, valid values: 1 - N
-	 * @param y       y-coordinate, valid values: 1 - N
-	 * @return        boolean indicating boundary condition. 
-	 */
-	bool isBoundAt(int x, int y);
-
-	/**
-	 * Accessor: returns density value at a particular coordinate. Valid indicies range 
-	 * from 1 to N. Indicies 0 and N+1 are buffer rows for algorithms.
-	 *
-	 * @param x X-coordinate, valid values: 1 - N
-	 * @param y y-coordinate, valid values: 1 - N
-	 * @return  Density value at coordinate.
-	 */
-	float getDensityAt(int x, int y);
-
-
-	/**
-	 * Accessor: returns vertical velocity value at a particular coordinate. 
-	 * Valid indicies range from 1 to N. Indicies 0 and N+1 are buffer rows for 
-	 * algorithms.
-	 *
-	 * @param x X-coordinate, valid values: 1 - N
-	 * @param y y-coordinate, valid values: 1 - N
-	 * @return  Vertical velocity value at coordinate.
-	 */
-	float getVertVelocityAt(int x, int y);
-
-
-	/**
-	 * Accessor: returns horizontal velocity value at a particular coordinate. 
-	 * Valid indicies range from 1 to N. Indicies 0 and N+1 are buffer rows for 
-	 * algorithms.
-	 *
-	 * @param x X-coordinate, valid values: 1 - N
-	 * @param y y-coordinate, valid values: 1 - N
-	 * @return  Horizontal  velocity value at coordinate.
-	 */
-	float getHorzVelocityAt(int x, int y);
-
-
-	/**
-	 * Runs an iteration of the simulation, updating density and velocity values.
-	 * Also resets u_prev, v_prev, and dens_prev.
-	 *
-	 */
-	void update(); 
-
-
-	/**
-	 * Resets all public array values to zero.
-	 */
-	void reset();
-
-protected:
-	float* u_;
-	float* v_;
-	float* u_prev_;
-	float* v_prev_;
-	float* dens_;
-	float* dens_prev_;
-	bool*  bounds_;
-
-	int   N_;
-	float dt_;
-	float diff_;
-	float visc_;
-
-
-
-	/**
-	 * Calculates size, including buffer cells.
-	 * @return Total size of fluid simulation array, including buffer cells
-	 */
-	int getSize(); 
-
-
-
-	/**
-	 * Tests to see whether a coordinate is inside the valid range of fluid computation
-	 * cells. (1 - N)
-	 * @param x - y-coordinate
-	 * @param y - y-coordinate to test
-	 * @return True if the coordinate pair is within the valid range, false if not.
-	 */
-	bool isValidCoordinate(int x, int y);
-
-
-
-	/** 
-	 * Adds values to a matrix array, scaling the values by the timestep.
-	 * @param x - reference to a float matrix array that values will be added to
-	 * @param s - reference to a float matrix array representing how much value to add
-	 */
-	void addSource(float* x, float* s);
-
-
-
-	/**
-	 * Sets the boundaries the fluid will collide with. The horizontal component of the velocity should 
-	 * be zero on the vertical walls, while the vertical component of 
-	 * the velocity should be zero on the horizontal walls. 
-	 *
-	 * @param boundsFlag - flag value: - 
-					1 - calculate collision response for horizontal velocity component (u) cells.
-					2 - calculate collision response for vertical velocity component (v) cells.
-	 * @param *x - pointer to a float array representing the horizontal velocity components
-	 */
-	void setBounds(int boundsFlag, float* x);
-
-
-
-	/**
-	 * Use Gauss-Seidel relaxation on elements in the matrix to work backwards in time 
-	 * to find the or velocities densities we started with.
-	 *
-	 * @param b  - boundary condition flag
-	 * @param x  - pointer to an array containing final solution values
-	 * @param x0 - pointer to an array containing a guess of the initial solution
-	 * @param a  - coefficient of relaxation per cell (dt * diffusion rate * total number of cells)
-	 * @param c  - divide out least common denominator from fraction addition
-	 */
-	void linearSolve ( int boundsFlag, float* x, float* x0, float a, float c);
-
-
-
-	/**
-	 * Diffuse density values among surrounding cells
-	 * 
-	 * @param b    - boundary condition flag
-	 * @param x    - pointer to an array containing final density values
-	 * @param x0   - pointer to an array containing initial density values
-	 */
-	void diffuse ( int boundsFlag, float* x, float* x0);
-
-
-
-	/**
-	 * Move density or velocity values along a velocity field by treacting each cell center as 
-	 * a particle and using a simple linear backtrace. 
-	 * 
-	 * @param b    - boundary condition flag
-	 * @param d    - pointer to a matrix array containing final density or velocity values
-	 * @param d0   - pointer to a matrix array containing initial density or velocity values
-	 * @param u    - pointer to a matrix array containing horizontal velocity components
-	 * @param v    - pointer to a matrix array containing vertical velocity components
-	 */
-	void advect (int boundsFlag, float* d, float* d0, float* u, float* v);
-	
-
-
-	/**
-	 * Get the velocity field to conserve mass by using a Hodge decomposition.
-	 *
-	 * @param u    - pointer to a matrix array containing x components of velocity
-	 * @param v	   - pointer to a matrix array containing y components of velocity 
-	 * @param p	   - pointer to a matrix array containing projected solution
-	 * @param div  - pointer to a matrix array containing divergence values
-	 */
-	void project (float* u, float* v, float* p, float* div);
-
-
-
-	/**
-	 * Performs density calculations per timestep 
-	 *
-	 * @param x	   - pointer to a matrix array of final density values
-	 * @param x0   - pointer to a matrix array representing density values added this timestep
-	 * @param u    - pointer to a matrix array containing x components of velocity
-	 * @param v	   - pointer to a matrix array containing y components of velocity
-	 */
-	void computeDensityStep ( float* x, float* x0, float* u, float* v );
-
-
-
-	/**
-	 * Performs velocity calculations per timestep 
-	 *
-	 * @param u    - pointer to a matrix array containing x components of velocity
-	 * @param v	   - pointer to a matrix array containing y components of velocity
-	 * @param u0   - pointer to a matrix array containing x components of velocity to be added
-	 *				 this timestep.
-	 * @param u0   - pointer to a matrix array containing y components of velocity to be added
-	 *				 this timestep.
-	 */
-	void computeVelocityStep (float* u, float* v, float* u0, float* v0);
-};
-
+/**
+ * @file      FluidSolver.h
+ * @author    Austin Hines <futurelightstudios@gmail.com>
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ * 
+ * This file is part of Fluid Wall. You can redistribute it and/or modify            
+ * it under the terms of the GNU Lesser General Public License as published  
+ * by the Free Software Foundation, either version 3 of the License, or     
+ * (at your option) any later version.                                       
+ *                                                                             
+ * Fluid Wall is distributed in the hope that it will be useful,                 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
+ * GNU Lesser General Public License for more details.                       
+ *                                                                            
+ * You should have received a copy of the GNU Lesser General Public License  
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <utility>
+#include "GridArena.h"
+#include "HaloExchange.h"
+
+class MultigridSolver;
+struct FluidKernels;
+
+using namespace std;
+
+/**
+ * A 2D fluid simulation solver based on the Stable Fluids algorithm.
+ *
+ * This algorithm based on original C code from Jos Stam's 2001 paper, "Real Time Fluid
+ * Dynamics for Games." I have adapted this code to C++ style and classes (vectors instead
+ * of arrays, etc.) 
+ * 
+ */
+class FluidSolver
+{
+public:
+	//TODO: change all comments to reflect the switch to vectors.
+
+	/**
+	 * Relaxation schemes available to linearSolve().
+	 *
+	 * GAUSS_SEIDEL is the original in-place sweep. RED_BLACK_SOR updates the
+	 * checkerboard colors in two half-sweeps so every row of a color can be 
+	 * relaxed in parallel. JACOBI reads from one buffer and writes to another, 
+	 * which is fully parallel but converges more slowly per sweep.
+	 */
+	enum SolverType {
+		GAUSS_SEIDEL,
+		RED_BLACK_SOR,
+		JACOBI
+	};
+
+	/**
+	 * Solvers available for the pressure Poisson equation in project().
+	 *
+	 * PRESSURE_RELAXATION uses linearSolve() and the scheme set with setSolverType().
+	 * PRESSURE_MULTIGRID runs geometric multigrid V-cycles, whose cost grows linearly
+	 * with the number of cells. Use it for large grids.
+	 */
+	enum PressureSolver {
+		PRESSURE_RELAXATION,
+		PRESSURE_MULTIGRID
+	};
+
+	/**
+	 * Schemes available to advect().
+	 *
+	 * ADVECT_SEMI_LAGRANGIAN is the original single bilinear backtrace, which smears
+	 * sharp edges a little more every step. ADVECT_MACCORMACK advects forward, back
+	 * again, and corrects the forward result by half the error of the round trip,
+	 * clamped to the values the forward backtrace interpolated between so it cannot
+	 * overshoot. That is second order and keeps edges crisp at about twice the cost.
+	 */
+	enum AdvectionScheme {
+		ADVECT_SEMI_LAGRANGIAN,
+		ADVECT_MACCORMACK
+	};
+
+	/**
+	 * Convergence report for a single linearSolve() call.
+	 */
+	struct SolveStats {
+		int   iterations; //sweeps (or multigrid V-cycles) actually run
+		float residual;   //relative RMS residual over fluid cells after the last sweep, negative if not measured
+	};
+
+	/**
+	 * Weights of a square footprint of (2 * radius + 1)^2 cells around a center cell,
+	 * one plane per field. Entry (dx + radius) + (2 * radius + 1) * (dy + radius) 
+	 * is the weight at offset (dx, dy).
+	 */
+	struct SplatStamp {
+		int radius;
+		vector<float> u, v, density;
+
+		SplatStamp() : radius(0) {}
+	};
+
+	/**
+	 * One stamp placed on the grid, each plane scaled by its own factor.
+	 */
+	struct Splat {
+		int   x, y;              //center cell, valid values: 1 - width, 1 - height
+		float u, v, density;     //scale of the stamp planes
+		int   user;              //density channel, for FluidSolverMultiUser
+		const SplatStamp* stamp;
+	};
+
+	/**
+	 * Default constructor.
+	 * 
+	 */
+	FluidSolver(void);
+
+	/**
+	 * Parameter constructor.
+	 * @param N      Width (and height) of the square fluid simulation grid
+	 * @param dt     Timestep size
+	 * @param diff   Diffusion coefficient
+	 * @param visc   Viscosity coefficient
+	 */
+	FluidSolver(int N, float dt, float diff, float visc);
+
+	/**
+	 * Parameter constructor for a rectangular grid of square cells. The longer side
+	 * is one unit long, like the side of a square grid, so velocities and 
+	 * coefficients mean the same as for a square grid of that size.
+	 * @param width  Cells per row of the fluid simulation grid
+	 * @param height Rows of the fluid simulation grid
+	 * @param dt     Timestep size
+	 * @param diff   Diffusion coefficient
+	 * @param visc   Viscosity coefficient
+	 */
+	FluidSolver(int width, int height, float dt, float diff, float visc);
+	virtual ~FluidSolver(void);
+
+	/**
+	 * Adds vertical velocity values at a particular coordinate. 
+	 *
+	 * The system is designed to add values from multiple other sources using this method, 
+	 * and then commit them to the simulation using update(). Valid indicies range from 
+	 * 1 to width (or height). Indicies 0 and width+1 are buffer rows for algorithms.
+	 *
+	 * @param x     x-coordinate, valid values: 1 - width
+	 * @param y     y-coordinate, valid values: 1 - height
+	 * @param value New vertical velocity value
+	 */
+	void addVertVelocityAt(int x, int y, float value);
+
+
+	/**
+	 * Adds horizontal velocity values at a particular coordinate. 
+	 *
+	 * The system is designed to add values from multiple other sources using this method, 
+	 * and then commit them to the simulation using update(). Valid indicies range from 
+	 * 1 to width (or height). Indicies 0 and width+1 are buffer rows for algorithms.
+	 *
+	 * @param x     x-coordinate, valid values: 1 - width
+	 * @param y     y-coordinate, valid values: 1 - height
+	 * @param value New horizontal velocity value
+	 */
+	void addHorzVelocityAt(int x, int y, float value);
+
+
+	/**
+	 * Adds density values at a particular coordinate. 
+	 *
+	 * The system is designed to add values from multiple other sources using this method, 
+	 * and then commit them to the simulation using update(). Valid indicies range from 
+	 * 1 to width (or height). Indicies 0 and width+1 are buffer rows for algorithms.
+	 *
+	 * @param x     x-coordinate, valid values: 1 - width
+	 * @param y     y-coordinate, valid values: 1 - height
+	 * @param value Density value to be added
+	 */
+	void addDensityAt(int x, int y, float value);
+
+	/**
+	 * Sets bound condition at a given cell.
+	 *
+	 * @param x       x-coordinate, valid values: 1 - width
+	 * @param y       y-coordinate, valid values: 1 - height
+	 * @param isBound boolean true/false
+	 */
+	void setBoundAt(int x, int y, bool isBound);
+
+	/**
+	 * Sets the bound condition of every cell from a width x height mask, in one pass.
+	 * Same result as calling setBoundAt for each cell, without the per cell checks.
+	 *
+	 * @param mask   row y-1 holds cells (1..width, y); nonzero marks a bound cell
+	 * @param stride bytes from one mask row to the next
+	 */
+	void setBoundsFromMask(const unsigned char* mask, int stride);
+
+	/**
+	 * Adds a width x height velocity field in one pass, e.g. the CV_32FC2 output of an optical
+	 * flow. Same result as calling addHorzVelocityAt and addVertVelocityAt for each cell.
+	 *
+	 * @param uv     row y-1 holds (u, v) pairs for cells (1..width, y)
+	 * @param stride bytes from one row to the next
+	 * @param scale  factor applied to every value
+	 */
+	void addVelocityField(const float* uv, int stride, float scale = 1.0f);
+
+	/**
+	 * Adds a width x height density field in one pass, e.g. a CV_32F Mat. Same result as
+	 * calling addDensityAt for each cell.
+	 *
+	 * @param d      row y-1 holds cells (1..width, y)
+	 * @param stride bytes from one row to the next
+	 * @param scale  factor applied to every value
+	 */
+	void addDensityField(const float* d, int stride, float scale = 1.0f);
+
+	/**
+	 * Adds a batch of splats to the velocity and density sources, clipped to the grid.
+	 * Splats are applied in tile order so neighbors share cache lines, one vector 
+	 * add per stamp row and field. Every tile a footprint touches is marked.
+	 *
+	 * @param splats  splats to add
+	 * @param count   number of splats
+	 */
+	void addSplats(const Splat* splats, int count);
+
+	/**
+	 * Accesor: returns boundary value at given cell.
+	 *
+	 * @param x       x-coordinate, valid values: 1 - width
+	 * @param y       y-coordinate, valid values: 1 - height
+	 * @return        boolean indicating boundary condition. 
+	 */
+	bool isBoundAt(int x, int y);
+
+	/**
+	 * Accessor: returns density value at a particular coordinate. Valid indicies range 
+	 * from 1 to width (or height). Indicies 0 and width+1 are buffer rows for algorithms.
+	 *
+	 * @param x X-coordinate, valid values: 1 - width
+	 * @param y y-coordinate, valid values: 1 - height
+	 * @return  Density value at coordinate.
+	 */
+	float getDensityAt(int x, int y);
+
+
+	/**
+	 * Accessor: returns vertical velocity value at a particular coordinate. 
+	 * Valid indicies range from 1 to width (or height). Indicies 0 and width+1 are
+	 * buffer rows for algorithms.
+	 *
+	 * @param x X-coordinate, valid values: 1 - width
+	 * @param y y-coordinate, valid values: 1 - height
+	 * @return  Vertical velocity value at coordinate.
+	 */
+	float getVertVelocityAt(int x, int y);
+
+
+	/**
+	 * Accessor: returns horizontal velocity value at a particular coordinate. 
+	 * Valid indicies range from 1 to width (or height). Indicies 0 and width+1 are
+	 * buffer rows for algorithms.
+	 *
+	 * @param x X-coordinate, valid values: 1 - width
+	 * @param y y-coordinate, valid values: 1 - height
+	 * @return  Horizontal  velocity value at coordinate.
+	 */
+	float getHorzVelocityAt(int x, int y);
+
+
+	/**
+	 * Accessors: the whole fields, buffer cells included, for readers that walk
+	 * every cell. Cell (x, y) is at index x + getStride() * y. The pointers stay
+	 * valid until the next resize(). FluidSolverGPU only fills them in 
+	 * syncToHost().
+	 */
+	const float* getDensityData();
+	const float* getHorzVelocityData();
+	const float* getVertVelocityData();
+	const bool*  getBoundsData();
+	int          getStride();
+
+
+	/**
+	 * Runs an iteration of the simulation, updating density and velocity values.
+	 * Also resets u_prev, v_prev, and dens_prev. With tile tracking enabled, an
+	 * update of a grid at rest with nothing added does nothing.
+	 *
+	 */
+	virtual void update(); 
+
+
+	/**
+	 * Resets all public array values to zero.
+	 */
+	virtual void reset();
+
+
+	/**
+	 * Changes the grid to width x height cells and resets it. The grids keep their
+	 * memory when the new size fits in it, so going back and forth between sizes 
+	 * does not allocate. Pointers returned by the data accessors are invalidated.
+	 *
+	 * @param width   New number of cells per row
+	 * @param height  New number of rows
+	 */
+	virtual void resize(int width, int height);
+
+
+	/**
+	 * Accessors: cells per row and rows of the grid, buffer cells excluded.
+	 */
+	int getWidth();
+	int getHeight();
+
+
+	/**
+	 * Accessor: bytes allocated for the grids, padding included.
+	 */
+	size_t getGridBytes();
+
+
+	/**
+	 * Changes the timestep of the following updates. Sources added before an update
+	 * are scaled by sourceDt instead, so a frame split into substeps can add the
+	 * whole frame's sources in its first substep.
+	 *
+	 * @param dt        Timestep size
+	 * @param sourceDt  Timestep the sources are scaled by, 0 for dt
+	 */
+	void setTimestep(float dt, float sourceDt = 0.0f);
+
+
+	/**
+	 * Accessor: timestep of the next update.
+	 */
+	float getTimestep();
+
+
+	/**
+	 * Accessor: largest |u| or |v| after the last update, in grid lengths per unit 
+	 * of time; a step moves the fluid at most getTimestep() * getMaxSpeed() * 
+	 * max(width, height) cells. FluidSolverGPU keeps its velocity on the graphics
+	 * card and does not measure it, it reports 0.
+	 */
+	float getMaxSpeed();
+
+
+	/**
+	 * Selects the relaxation scheme used for the diffusion and pressure solves.
+	 *
+	 * @param type  One of GAUSS_SEIDEL, RED_BLACK_SOR or JACOBI
+	 */
+	void setSolverType(SolverType type);
+
+
+	/**
+	 * Sets the over-relaxation factor used by RED_BLACK_SOR. 1.0 is plain 
+	 * Gauss-Seidel, values between 1.0 and 2.0 converge in fewer sweeps.
+	 *
+	 * @param omega Relaxation factor, valid values: (0.0 - 2.0)
+	 */
+	void setRelaxation(float omega);
+
+
+	/**
+	 * Selects the solver used for the pressure solve in project().
+	 *
+	 * @param type  One of PRESSURE_RELAXATION or PRESSURE_MULTIGRID
+	 */
+	void setPressureSolver(PressureSolver type);
+
+
+	/**
+	 * Selects the advection schemes of the density (every user density in
+	 * FluidSolverMultiUser) and of the velocity. FluidSolverGPU ignores it.
+	 *
+	 * @param density   One of ADVECT_SEMI_LAGRANGIAN or ADVECT_MACCORMACK
+	 * @param velocity  The same, for the velocity self-advection
+	 */
+	void setAdvectionScheme(AdvectionScheme density, AdvectionScheme velocity = ADVECT_SEMI_LAGRANGIAN);
+
+
+	/**
+	 * Sets the maximum number of sweeps linearSolve() runs per call. Lowering this
+	 * trades accuracy for frame time when the frame budget is tight.
+	 *
+	 * @param iterations Maximum number of relaxation sweeps, at least 1.
+	 */
+	void setMaxIterations(int iterations);
+
+
+	/**
+	 * Accessor: returns the maximum number of sweeps per linearSolve() call.
+	 */
+	int getMaxIterations();
+
+
+	/**
+	 * Sets the residual at which linearSolve() stops early. A solve has converged 
+	 * once its RMS residual drops below tolerance * RMS(right hand side) + absTolerance,
+	 * so the absolute term lets nearly empty (quiet) fields exit after one sweep.
+	 * Both zero disables early termination and always runs the maximum number of sweeps.
+	 *
+	 * @param tolerance    Residual relative to the right hand side, e.g. 0.01
+	 * @param absTolerance Absolute residual floor, in units of the solved field
+	 */
+	void setTolerance(float tolerance, float absTolerance = 0.0f);
+
+
+	/**
+	 * Accessor: returns the convergence report of every linearSolve() call made
+	 * during the last update(), in call order.
+	 */
+	const vector<SolveStats>& getSolveStats();
+
+
+	/**
+	 * Enables tracking of active tiles, square blocks of TILE_SIZE cells. A tile is
+	 * active while any velocity or density value in it exceeds epsilon, or when
+	 * sources or bounds were written into it since the last update(). 
+	 *
+	 * While tracking, update() returns immediately when no tile is active, advect() 
+	 * only backtraces tiles near active ones, and tiles that fall below epsilon are
+	 * set to exactly zero. The pressure solve still covers the whole grid whenever 
+	 * anything moves.
+	 *
+	 * @param enabled  true to track tiles
+	 * @param epsilon  values at or below this magnitude count as empty
+	 */
+	void setActiveTileTracking(bool enabled, float epsilon = 1e-4f);
+
+
+	/**
+	 * Accessors for the tile grid. Tiles are numbered from 0 and tile (tx, ty) covers
+	 * cells 1 + tx * TILE_SIZE to (tx + 1) * TILE_SIZE horizontally, clipped to the
+	 * width, and likewise vertically. Without tracking, every tile reports active.
+	 */
+	int  getTilesX();
+	int  getTilesY();
+	bool isTileActive(int tx, int ty);
+	int  getActiveTileCount();
+
+
+	/**
+	 * Replaces the inner loop kernels, by default the best set for this CPU. For 
+	 * benchmarks; every set gives the same results.
+	 */
+	void setKernels(const FluidKernels& kernels);
+	const FluidKernels& getKernels();
+
+
+	/**
+	 * Runs the velocity and pressure steps on a grid factor times coarser in each
+	 * direction, while density is still advected at full resolution, along the
+	 * coarse velocity sampled bilinearly. Velocity sources are averaged onto the
+	 * coarse grid, and a coarse cell is solid when at least half of its cells are.
+	 * The velocity accessors return the upsampled field, zero in bound cells.
+	 * Ignored while a halo exchange is set, and by FluidSolverGPU.
+	 *
+	 * @param factor  1 for full resolution (the default), typically 2 or 4
+	 */
+	void setVelocityDownsampling(int factor);
+	int  getVelocityDownsampling();
+
+
+	/**
+	 * Makes this solver one tile of a larger grid. On every side the exchange has a
+	 * neighbor, setBounds() takes the buffer cells from the neighbor's edge instead of
+	 * mirroring its own, so fluid and obstacles carry across the seam. Bounds are
+	 * traded once at the start of each update().
+	 *
+	 * Neighbors have to make the same exchanges in the same order, so while an 
+	 * exchange is set linearSolve() always runs getMaxIterations() sweeps, tile 
+	 * tracking is turned off and pressure uses the relaxation solver. Every tile
+	 * needs the same size, timestep and iteration count, and the size has to be
+	 * even both ways so the red/black colors line up across the seams.
+	 * FluidSolverGPU ignores it.
+	 *
+	 * @param halo       exchange of this tile, NULL for a stand-alone grid
+	 * @param everySweep false trades the cells once per linearSolve() instead of
+	 *                   after every sweep, fewer messages for a softer seam
+	 */
+	void setHaloExchange(HaloExchange* halo, bool everySweep = true);
+	HaloExchange* getHaloExchange();
+
+	static const int TILE_SIZE = 16;
+
+protected:
+	float* u_;
+	float* v_;
+	float* u_prev_;
+	float* v_prev_;
+	float* dens_;
+	float* dens_prev_;
+	bool*  bounds_;
+	float* scratch_;    //second buffer for Jacobi iterations
+	GridArena arena_;   //the memory every grid above lives in
+
+	int   NX_;          //cells per row
+	int   NY_;          //rows
+	int   N_;           //cells along the longer side, which is one unit long
+	int   stride_;      //floats per row, NX_+2 padded to a whole number of cache lines
+	float dt_;
+	float sourceDt_;    //scales the sources of the next update
+	float diff_;
+	float visc_;
+
+	SolverType solverType_;
+	PressureSolver   pressureSolver_;
+	AdvectionScheme  densityAdvection_;
+	AdvectionScheme  velocityAdvection_;
+	MultigridSolver* multigrid_;     //created on first use
+	int          velocityFactor_;    //velocity grid is this many times coarser, 1 for none
+	FluidSolver* coarse_;            //velocity grid when velocityFactor_ > 1, created on first use
+	const FluidKernels* kernels_;    //best SIMD kernels for this CPU
+	float      relaxation_;
+	int        maxIterations_;
+	float      tolerance_;
+	float      absTolerance_;
+
+	vector<SolveStats> solveStats_;
+
+	bool  trackTiles_;
+	float tileEpsilon_;
+	float maxSpeed_;                     //largest |u| or |v| after the last update
+	int   tilesX_;
+	int   tilesY_;
+	vector<unsigned char> tileActive_;   //above epsilon after the last update
+	vector<unsigned char> tileMarked_;   //sources or bounds written since the last update
+	vector<unsigned char> tileStep_;     //tiles advected by the current update
+	vector<unsigned char> tileScratch_;
+	vector<float>         tileMax_;
+	vector<float>         tileSpeed_;
+	vector<pair<int,int> > splatOrder_;  //(tile, splat) pairs of the current addSplats()
+
+	HaloExchange* halo_;                 //neighbor tiles, NULL when stand-alone
+	bool          haloEverySweep_;
+	bool          haloSkip_;             //set for linearSolve() sweeps that skip the exchange
+	int           haloTag_;              //exchanges so far in this update()
+	vector<char>  haloSend_[HaloExchange::SIDE_COUNT];
+	vector<char>  haloRecv_[HaloExchange::SIDE_COUNT];
+
+	/**
+	 * setBounds() work for the current obstacle set, compiled by compileBounds().
+	 * Cells are stored as indices into the grids.
+	 */
+	struct BoundsCopy   { int dst, src; };       //x[dst] = +-x[src]
+	struct BoundsRun    { int start, count; };   //x[start .. start+count-1] = 0
+	struct BoundsCorner { int dst, a, b; };      //x[dst] = (x[a] + x[b]) / 2
+
+	bool boundsChanged_;                     //bounds_ differs from the lists below
+	int  boundsWords_;                       //32 bit words per row of boundsBits_
+	vector<unsigned int> boundsBits_;        //bounds_ packed one bit per cell
+	vector<BoundsCopy>   boundsCopyRight_;   //bound cells open to the right, mirror u
+	vector<BoundsCopy>   boundsCopyUp_;      //bound cells open above only, mirror v
+	vector<BoundsRun>    boundsZero_;        //bound cells with neither open
+	vector<BoundsCorner> boundsCorners_;     //inner corners, applied in row order
+
+
+
+	/**
+	 * Shared by the constructors.
+	 */
+	void init(int width, int height, float dt, float diff, float visc);
+
+
+
+	/**
+	 * Sets the grid size and everything sized by it except the grids: row stride, 
+	 * tiles and packed bounds. Drops the multigrid hierarchy.
+	 */
+	void setGridSize(int width, int height);
+
+
+
+	/**
+	 * Lays the grids out in the arena for the current size. Contents are undefined
+	 * afterwards. Solvers with grids of their own call it again from their
+	 * constructor, once the grids they add in addGrids() are sized.
+	 */
+	void allocateGrids();
+
+
+
+	/**
+	 * Registers the grids of this solver with the arena.
+	 */
+	virtual void addGrids(GridArena& arena);
+
+
+
+	/**
+	 * Calculates size, including buffer cells and row padding.
+	 * @return Total size of fluid simulation array, including buffer cells and padding
+	 */
+	int getSize(); 
+
+
+
+	/**
+	 * Tests to see whether a coordinate is inside the valid range of fluid computation
+	 * cells. (1 - width, 1 - height)
+	 * @param x - x-coordinate
+	 * @param y - y-coordinate to test
+	 * @return True if the coordinate pair is within the valid range, false if not.
+	 */
+	bool isValidCoordinate(int x, int y);
+
+
+
+	/**
+	 * Flags the tile containing a cell as written this frame.
+	 * @param x - x-coordinate, valid values: 1 - width
+	 * @param y - y-coordinate, valid values: 1 - height
+	 */
+	void markTileAt(int x, int y);
+
+
+
+	/**
+	 * Decides which tiles the coming update() advects: the active and marked tiles, 
+	 * grown by the distance the fastest velocity can carry values in one step.
+	 * Clears the marks.
+	 *
+	 * @return False when nothing is active or marked and the update can be skipped.
+	 */
+	bool buildStepTiles();
+
+
+
+	/**
+	 * Rescans velocity and density once update() finished. Tiles whose largest value
+	 * is at or below the tile epsilon are zeroed and become inactive.
+	 */
+	void refreshActiveTiles();
+
+
+
+	/**
+	 * Finds the largest |u| and |v| after an update() without tile tracking, the
+	 * speed refreshActiveTiles() measures otherwise.
+	 */
+	void measureMaxSpeed();
+
+
+
+	/**
+	 * Fills tileSpeed_ and tileMax_ with the largest speed, and the largest speed or
+	 * density, of every tile.
+	 */
+	void measureTiles();
+
+
+
+	/**
+	 * Sets every cell of a tile to zero, including the buffer cells next to it
+	 * for tiles on the edge of the grid.
+	 */
+	void clearTile(float* x, int tx, int ty);
+
+
+
+	/**
+	 * Zeroes the source fields at the end of update(): u_prev_ and v_prev_, and
+	 * dens_prev_ if density is set. With tile tracking a field that can only hold 
+	 * values in the step tiles is cleared there and in the tiles next to them.
+	 */
+	void clearSources(bool density);
+
+
+
+	/**
+	 * Tests whether the current update() advects tile column tx of grid row j. 
+	 * Cells outside these tiles have no motion and are copied through unchanged.
+	 * Always true without tracking.
+	 *
+	 * @param tx - tile column
+	 * @param j  - grid row, valid values: 1 - height
+	 */
+	bool isStepTile(int tx, int j);
+
+
+
+	/**
+	 * Picks the array a splat's density goes into.
+	 * @param user   - Splat::user of the splat
+	 * @param scale  - density scale of the splat, may be adjusted for the target
+	 * @return         source array, or NULL to drop the density
+	 */
+	virtual float* getSplatDensityTarget(int user, float& scale);
+
+
+
+	/** 
+	 * Adds values to a matrix array, scaling the values by the timestep.
+	 * @param x - reference to a float matrix array that values will be added to
+	 * @param s - reference to a float matrix array representing how much value to add
+	 */
+	void addSource(float* x, float* s);
+
+
+
+	/**
+	 * Sets the boundaries the fluid will collide with. The horizontal component of the velocity should 
+	 * be zero on the vertical walls, while the vertical component of 
+	 * the velocity should be zero on the horizontal walls. 
+	 *
+	 * @param boundsFlag - flag value: - 
+					1 - calculate collision response for horizontal velocity component (u) cells.
+					2 - calculate collision response for vertical velocity component (v) cells.
+	 * @param *x - pointer to a float array representing the horizontal velocity components
+	 */
+	void setBounds(int boundsFlag, float* x);
+
+
+
+	/**
+	 * Tests whether a side of the grid borders another tile rather than a wall.
+	 */
+	bool hasHaloNeighbor(HaloExchange::Side side)
+	{
+		return halo_ && halo_->hasNeighbor(side);
+	}
+
+
+
+	/**
+	 * Sends the edge cells of x to the neighbor tiles and stores theirs in the buffer
+	 * cells of x, on every side with a neighbor. Does nothing when stand-alone.
+	 *
+	 * @param x           - grid in the layout of the other fields, buffer cells included
+	 * @param elementSize - bytes per cell of x
+	 */
+	void exchangeHalo(void* x, int elementSize);
+
+
+
+	/**
+	 * Starts the exchanges of an update(): trades the obstacle edges and recompiles
+	 * the bounds when the neighbors' obstacles changed.
+	 */
+	void beginHaloStep();
+
+
+
+	/**
+	 * Packs bounds_ into boundsBits_ and rebuilds the setBounds() lists from it.
+	 * Runs on the first setBounds() after the obstacles changed, so once per frame at most.
+	 */
+	void compileBounds();
+
+
+
+	/**
+	 * Tests a cell of boundsBits_, buffer cells included.
+	 */
+	bool isBoundBit(int x, int y)
+	{
+		return ((boundsBits_[y * boundsWords_ + (x >> 5)] >> (x & 31)) & 1) != 0;
+	}
+
+
+
+	/**
+	 * Use Gauss-Seidel relaxation on elements in the matrix to work backwards in time 
+	 * to find the or velocities densities we started with. The relaxation scheme is
+	 * chosen with setSolverType().
+	 *
+	 * @param b  - boundary condition flag
+	 * @param x  - pointer to an array containing final solution values
+	 * @param x0 - pointer to an array containing a guess of the initial solution
+	 * @param a  - coefficient of relaxation per cell (dt * diffusion rate * total number of cells)
+	 * @param c  - divide out least common denominator from fraction addition
+	 */
+	void linearSolve ( int boundsFlag, float* x, float* x0, float a, float c);
+
+
+	/**
+	 * Single sweeps used by linearSolve(). Boundary conditions are not applied.
+	 * 
+	 * @param x  - pointer to an array containing the solution being relaxed
+	 * @param x0 - pointer to an array containing the right hand side
+	 * @param xn - pointer to an array receiving the next Jacobi iterate
+	 * @param a  - neighbor coefficient
+	 * @param c  - diagonal coefficient
+	 */
+	void sweepGaussSeidel ( float* x, float* x0, float a, float c);
+	void sweepRedBlack    ( float* x, float* x0, float a, float c);
+	void sweepJacobi      ( float* xn, float* x, float* x0, float a, float c);
+
+
+	/**
+	 * Computes the RMS of the Gauss-Seidel update over all non-boundary cells. 
+	 * Zero means x solves the system exactly.
+	 *
+	 * @param x       - pointer to an array containing the current solution
+	 * @param x0      - pointer to an array containing the right hand side
+	 * @param a       - neighbor coefficient
+	 * @param c       - diagonal coefficient
+	 * @param rhsNorm - receives the RMS of x0 / c over the same cells
+	 * @return          RMS residual
+	 */
+	float computeResidual ( float* x, float* x0, float a, float c, float* rhsNorm);
+
+
+
+	/**
+	 * Diffuse density values among surrounding cells
+	 * 
+	 * @param b    - boundary condition flag
+	 * @param x    - pointer to an array containing final density values
+	 * @param x0   - pointer to an array containing initial density values
+	 */
+	void diffuse ( int boundsFlag, float* x, float* x0);
+
+
+
+	/**
+	 * Move density or velocity values along a velocity field by treacting each cell center as 
+	 * a particle and using a simple linear backtrace. 
+	 * 
+	 * @param b    - boundary condition flag
+	 * @param d    - pointer to a matrix array containing final density or velocity values
+	 * @param d0   - pointer to a matrix array containing initial density or velocity values
+	 * @param u    - pointer to a matrix array containing horizontal velocity components
+	 * @param v    - pointer to a matrix array containing vertical velocity components
+	 */
+	void advect (int boundsFlag, float* d, float* d0, float* u, float* v);
+
+
+
+	/**
+	 * advect() with the scheme selected for the field: ADVECT_MACCORMACK runs
+	 * advectMacCormack(), anything else advect().
+	 */
+	void advectWith (AdvectionScheme scheme, int boundsFlag, float* d, float* d0, float* u, float* v);
+
+
+
+	/**
+	 * MacCormack advection of d0 into d. The backward pass goes through scratch_.
+	 * Parameters as advect().
+	 */
+	void advectMacCormack (int boundsFlag, float* d, float* d0, float* u, float* v);
+
+
+
+	/**
+	 * The backtrace of advect() with a timestep of dt0 cells, without bounds. Tiles
+	 * without motion nearby are copied.
+	 */
+	void advectCells (float* d, const float* d0, const float* u, const float* v, float dt0);
+
+
+
+	/**
+	 * MacCormack correction: d += (d0 - back) / 2 for every cell, clamped to the four
+	 * values of d0 the forward backtrace along (u, v) interpolated between.
+	 *
+	 * @param d     forward advection of d0, corrected in place
+	 * @param back  advection of d backward along the same velocity
+	 */
+	void correctMacCormack (float* d, const float* d0, const float* back, const float* u, const float* v);
+	
+
+
+	/**
+	 * Get the velocity field to conserve mass by using a Hodge decomposition.
+	 *
+	 * @param u    - pointer to a matrix array containing x components of velocity
+	 * @param v	   - pointer to a matrix array containing y components of velocity 
+	 * @param p	   - pointer to a matrix array containing projected solution
+	 * @param div  - pointer to a matrix array containing divergence values
+	 */
+	void project (float* u, float* v, float* p, float* div);
+
+
+
+	/**
+	 * Solves for pressure with multigrid and applies boundary conditions to the result.
+	 *
+	 * @param p	   - pointer to a matrix array receiving the pressure
+	 * @param div  - pointer to a matrix array containing divergence values
+	 */
+	void solvePressureMultigrid (float* p, float* div);
+
+
+
+	/**
+	 * Performs density calculations per timestep 
+	 *
+	 * @param x	   - pointer to a matrix array of final density values
+	 * @param x0   - pointer to a matrix array representing density values added this timestep
+	 * @param u    - pointer to a matrix array containing x components of velocity
+	 * @param v	   - pointer to a matrix array containing y components of velocity
+	 */
+	void computeDensityStep ( float* x, float* x0, float* u, float* v );
+
+
+
+	/**
+	 * Performs velocity calculations per timestep 
+	 *
+	 * @param u    - pointer to a matrix array containing x components of velocity
+	 * @param v	   - pointer to a matrix array containing y components of velocity
+	 * @param u0   - pointer to a matrix array containing x components of velocity to be added
+	 *				 this timestep.
+	 * @param u0   - pointer to a matrix array containing y components of velocity to be added
+	 *				 this timestep.
+	 */
+	void computeVelocityStep (float* u, float* v, float* u0, float* v0);
+
+
+
+	/**
+	 * Velocity step of update(): computeVelocityStep() on the solver's own grids, or 
+	 * stepCoarseVelocity() when the velocity is downsampled.
+	 */
+	void stepVelocity();
+
+
+
+	/**
+	 * Averages the velocity sources and bounds onto coarse_, runs its velocity step, 
+	 * and samples the result back into u_ and v_. A new coarse grid starts from the
+	 * average of the current velocity.
+	 */
+	void stepCoarseVelocity();
+};
+
@@ -0,0 +1,671 @@
+/**
+ * @file      FluidSolverGPU.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FluidSolverGPU.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define SWAP(x0,x) { GpuField* tmp=x0; x0=x; x=tmp; }
+
+
+
+/*
+  ----------------------------------------------------------------------
+   shaders
+  ----------------------------------------------------------------------
+*/
+
+//shared by every pass: cell (i, j) is texel (i, j), fetched with clamping to the grid.
+//N holds the cells per row and the rows, buffer ring excluded.
+#define SHADER_HEADER \
+	"#version 130\n" \
+	"uniform ivec2 N;\n" \
+	"ivec2 cell() { return ivec2(gl_FragCoord.xy); }\n" \
+	"float at(sampler2D s, ivec2 c) { return texelFetch(s, clamp(c, ivec2(0), ivec2(N + 1)), 0).r; }\n"
+
+static const char* ADD_SOURCE_SHADER = SHADER_HEADER
+	"uniform sampler2D x, s;\n"
+	"uniform float dt;\n"
+	"void main() {\n"
+	"	ivec2 c = cell();\n"
+	"	gl_FragColor = vec4(at(x, c) + dt * at(s, c));\n"
+	"}\n";
+
+static const char* JACOBI_SHADER = SHADER_HEADER
+	"uniform sampler2D x, x0;\n"
+	"uniform float a, invC;\n"
+	"void main() {\n"
+	"	ivec2 c = cell();\n"
+	"	float n = at(x, c + ivec2(-1, 0)) + at(x, c + ivec2(1, 0)) + at(x, c + ivec2(0, -1)) + at(x, c + ivec2(0, 1));\n"
+	"	gl_FragColor = vec4((at(x0, c) + a * n) * invC);\n"
+	"}\n";
+
+//FluidSolver::setBounds() as a gather. The obstacle loop of the CPU version only ever
+//reads fluid or buffer cells, so each solid cell can be computed independently.
+static const char* BOUNDS_SHADER = SHADER_HEADER
+	"uniform sampler2D x, bounds;\n"
+	"uniform int flag;\n"
+	"float sx, sy;\n"
+	"bool solid(ivec2 c) { return texelFetch(bounds, c, 0).r > 0.0; }\n"
+	//value after the buffer ring pass
+	"float ringValue(ivec2 c) {\n"
+	"	if (c.x == 0)     return sx * at(x, ivec2(1, c.y));\n"
+	"	if (c.x == N.x + 1) return sx * at(x, ivec2(N.x, c.y));\n"
+	"	if (c.y == 0)     return sy * at(x, ivec2(c.x, 1));\n"
+	"	if (c.y == N.y + 1) return sy * at(x, ivec2(c.x, N.y));\n"
+	"	return at(x, c);\n"
+	"}\n"
+	//value of a solid cell after the obstacle pass
+	"float solidValue(ivec2 c) {\n"
+	"	if (!solid(c + ivec2(1, 0))) return sx * ringValue(c + ivec2(1, 0));\n"
+	"	if (!solid(c + ivec2(0, 1))) return sy * ringValue(c + ivec2(0, 1));\n"
+	"	return 0.0;\n"
+	"}\n"
+	"void main() {\n"
+	"	ivec2 c = cell();\n"
+	"	sx = flag == 1 ? -1.0 : 1.0;\n"
+	"	sy = flag == 2 ? -1.0 : 1.0;\n"
+	"	bool ex = c.x == 0 || c.x == N.x + 1, ey = c.y == 0 || c.y == N.y + 1;\n"
+	"	float r;\n"
+	"	if (ex && ey)\n"
+	"		r = 0.5 * (ringValue(ivec2(c.x == 0 ? 1 : N.x, c.y)) + ringValue(ivec2(c.x, c.y == 0 ? 1 : N.y)));\n"
+	"	else if (ex || ey)\n"
+	"		r = ringValue(c);\n"
+	"	else if (!solid(c))\n"
+	"		r = at(x, c);\n"
+	"	else {\n"
+	"		ivec2 e = ivec2(1, 0), n = ivec2(0, 1);\n"
+	//corner fix-ups, in the same order as the CPU version
+	"		if      (solid(c + e) && solid(c + n) && !solid(c + e + n)) r = 0.5 * (solidValue(c + e) + solidValue(c + n));\n"
+	"		else if (solid(c + e) && solid(c - n) && !solid(c + e - n)) r = 0.5 * (solidValue(c + e) + solidValue(c - n));\n"
+	"		else if (solid(c - e) && solid(c - n) && !solid(c - e - n)) r = 0.5 * (solidValue(c - e) + solidValue(c - n));\n"
+	"		else if (solid(c - e) && solid(c + n) && !solid(c - e + n)) r = 0.5 * (solidValue(c - e) + solidValue(c + n));\n"
+	"		else r = solidValue(c);\n"
+	"	}\n"
+	"	gl_FragColor = vec4(r);\n"
+	"}\n";
+
+static const char* ADVECT_SHADER = SHADER_HEADER
+	"uniform sampler2D d0, u, v;\n"
+	"uniform float dt0;\n"
+	"void main() {\n"
+	"	ivec2 c = cell();\n"
+	"	vec2 maxCoord = vec2(N) + 0.5;\n"
+	"	float x = clamp(float(c.x) - dt0 * at(u, c), 0.5, maxCoord.x);\n"
+	"	float y = clamp(float(c.y) - dt0 * at(v, c), 0.5, maxCoord.y);\n"
+	"	ivec2 b = ivec2(int(x), int(y));\n"
+	"	float s1 = x - float(b.x), s0 = 1.0 - s1;\n"
+	"	float t1 = y - float(b.y), t0 = 1.0 - t1;\n"
+	"	gl_FragColor = vec4(s0 * (t0 * at(d0, b)               + t1 * at(d0, b + ivec2(0, 1))) +\n"
+	"	                    s1 * (t0 * at(d0, b + ivec2(1, 0)) + t1 * at(d0, b + ivec2(1, 1))));\n"
+	"}\n";
+
+static const char* DIVERGENCE_SHADER = SHADER_HEADER
+	"uniform sampler2D u, v;\n"
+	"uniform float scale;\n"
+	"void main() {\n"
+	"	ivec2 c = cell();\n"
+	"	gl_FragColor = vec4(scale * (at(u, c + ivec2(1, 0)) - at(u, c - ivec2(1, 0)) +\n"
+	"	                             at(v, c + ivec2(0, 1)) - at(v, c - ivec2(0, 1))));\n"
+	"}\n";
+
+static const char* GRADIENT_SHADER = SHADER_HEADER
+	"uniform sampler2D x, p;\n"
+	"uniform ivec2 dir;\n"
+	"uniform float scale;\n"
+	"void main() {\n"
+	"	ivec2 c = cell();\n"
+	"	gl_FragColor = vec4(at(x, c) - scale * (at(p, c + dir) - at(p, c - dir)));\n"
+	"}\n";
+
+//one component of a width x height flow texture, added to the interior cells
+static const char* ADD_FLOW_SHADER = SHADER_HEADER
+	"uniform sampler2D x, flow;\n"
+	"uniform int component;\n"
+	"uniform float scale;\n"
+	"void main() {\n"
+	"	ivec2 c = cell();\n"
+	"	float f = 0.0;\n"
+	"	if (all(greaterThanEqual(c, ivec2(1))) && all(lessThanEqual(c, ivec2(N)))) {\n"
+	"		vec4 t = texelFetch(flow, c - ivec2(1), 0);\n"
+	"		f = component == 0 ? t.r : t.g;\n"
+	"	}\n"
+	"	gl_FragColor = vec4(at(x, c) + scale * f);\n"
+	"}\n";
+
+//bilinear between cell centers, matching the per vertex colors of the quad renderer
+static const char* DISPLAY_SHADER = SHADER_HEADER
+	"uniform sampler2D dens, bounds;\n"
+	"uniform vec3 color;\n"
+	"uniform float offset;\n"
+	"float value(ivec2 c) { return texelFetch(bounds, c, 0).r > 0.0 ? 0.0 : offset + at(dens, c); }\n"
+	"void main() {\n"
+	"	vec2 p = clamp(gl_TexCoord[0].xy * vec2(N) + 0.5, vec2(1.0), vec2(N) + 1.0);\n"
+	"	ivec2 c = min(ivec2(p), ivec2(N));\n"
+	"	vec2 f = p - vec2(c);\n"
+	"	float d = mix(mix(value(c),               value(c + ivec2(1, 0)), f.x),\n"
+	"	              mix(value(c + ivec2(0, 1)), value(c + ivec2(1, 1)), f.x), f.y);\n"
+	"	gl_FragColor = vec4(color * d, 1.0);\n"
+	"}\n";
+
+
+
+/*
+  ----------------------------------------------------------------------
+   public methods
+  ----------------------------------------------------------------------
+*/
+
+FluidSolverGPU::FluidSolverGPU(int N, float dt, float diff, float visc) :
+	FluidSolver(N, dt, diff, visc)
+{
+	initGpuState();
+}
+
+
+
+FluidSolverGPU::FluidSolverGPU(int width, int height, float dt, float diff, float visc) :
+	FluidSolver(width, height, dt, diff, visc)
+{
+	initGpuState();
+}
+
+
+
+void FluidSolverGPU::initGpuState()
+{
+	glReady_     = false;
+	glFailed_    = false;
+	needsClear_  = true;
+	framebuffer_ = 0;
+	boundsTex_   = 0;
+	flowTex_     = 0;
+	flowScale_   = 0.0f;
+	memset(programs_, 0, sizeof(programs_));
+	memset(fields_,   0, sizeof(fields_));
+
+	gu_         = &fields_[0];
+	gv_         = &fields_[1];
+	gu_prev_    = &fields_[2];
+	gv_prev_    = &fields_[3];
+	gdens_      = &fields_[4];
+	gdens_prev_ = &fields_[5];
+}
+
+
+
+FluidSolverGPU::~FluidSolverGPU(void)
+{
+	releaseGl();
+}
+
+
+
+bool FluidSolverGPU::isSupported()
+{
+	return loadGlExtensions();
+}
+
+
+
+void FluidSolverGPU::update()
+{
+	solveStats_.clear();
+
+	if (!glReady_ && !glFailed_)
+		glFailed_ = !initGl();
+	if (glFailed_)
+		return;
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glPushAttrib(GL_VIEWPORT_BIT | GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+	glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);  glPushMatrix(); glLoadIdentity();
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glViewport(0, 0, NX_ + 2, NY_ + 2);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+	if (needsClear_) {
+		for (int f = 0; f < 6; f++)
+			for (int k = 0; k < 2; k++) {
+				fwglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fields_[f].tex[k], 0);
+				glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+				glClear(GL_COLOR_BUFFER_BIT);
+			}
+		needsClear_ = false;
+	}
+
+	//this frame's sources and obstacles
+	upload(gu_prev_,    u_prev_);
+	upload(gv_prev_,    v_prev_);
+	upload(gdens_prev_, dens_prev_);
+	glBindTexture(GL_TEXTURE_2D, boundsTex_);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, stride_);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX_ + 2, NY_ + 2, GL_RED, GL_UNSIGNED_BYTE, bounds_);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (flowTex_) {
+		gpuAddFlow(gu_prev_, 0);
+		gpuAddFlow(gv_prev_, 1);
+		flowTex_ = 0;
+	}
+
+	gpuDensityStep(gdens_, gdens_prev_, gu_, gv_);
+	gpuVelocityStep(gu_, gv_, gu_prev_, gv_prev_);
+
+	fwglUseProgram(0);
+	fwglActiveTexture(GL_TEXTURE0);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glMatrixMode(GL_PROJECTION); glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);  glPopMatrix();
+	glPopAttrib();
+
+	//reset u_prev_, v_prev_, and dens_prev
+	memset(u_prev_,    0, getSize() * sizeof(float));
+	memset(v_prev_,    0, getSize() * sizeof(float));
+	memset(dens_prev_, 0, getSize() * sizeof(float));
+}
+
+
+
+void FluidSolverGPU::addVelocityTexture(GLuint flow, float scale)
+{
+	flowTex_   = flow;
+	flowScale_ = scale;
+}
+
+
+
+void FluidSolverGPU::reset()
+{
+	FluidSolver::reset();
+	needsClear_ = true;
+}
+
+
+
+void FluidSolverGPU::syncToHost()
+{
+	if (!glReady_)
+		return;
+
+	glPixelStorei(GL_PACK_ROW_LENGTH, stride_);
+	glBindTexture(GL_TEXTURE_2D, gu_->tex[gu_->cur]);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, u_);
+	glBindTexture(GL_TEXTURE_2D, gv_->tex[gv_->cur]);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, v_);
+	glBindTexture(GL_TEXTURE_2D, gdens_->tex[gdens_->cur]);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, dens_);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+}
+
+
+
+void FluidSolverGPU::drawDensity(float r, float g, float b, float offset)
+{
+	if (!glReady_)
+		return;
+
+	GLuint program = programs_[PROGRAM_DISPLAY];
+	fwglUseProgram(program);
+	fwglUniform2i(fwglGetUniformLocation(program, "N"), NX_, NY_);
+	fwglUniform3f(fwglGetUniformLocation(program, "color"), r, g, b);
+	fwglUniform1f(fwglGetUniformLocation(program, "offset"), offset);
+	bindInput(PROGRAM_DISPLAY, "dens",   0, gdens_->tex[gdens_->cur]);
+	bindInput(PROGRAM_DISPLAY, "bounds", 1, boundsTex_);
+
+	glBegin(GL_QUADS);
+		glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
+		glTexCoord2f(1.0f, 0.0f); glVertex2f(1.0f, 0.0f);
+		glTexCoord2f(1.0f, 1.0f); glVertex2f(1.0f, 1.0f);
+		glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, 1.0f);
+	glEnd();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	fwglActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	fwglUseProgram(0);
+}
+
+
+
+void FluidSolverGPU::contextChanged()
+{
+	memset(programs_, 0, sizeof(programs_));
+	memset(fields_,   0, sizeof(fields_));
+	boundsTex_   = 0;
+	flowTex_     = 0;
+	framebuffer_ = 0;
+	glReady_     = false;
+	glFailed_    = false;
+	needsClear_  = true;
+}
+
+
+
+void FluidSolverGPU::resize(int width, int height)
+{
+	releaseGl();
+	FluidSolver::resize(width, height);
+}
+
+
+
+GLuint FluidSolverGPU::getDensityTexture()
+{
+	return glReady_ ? gdens_->tex[gdens_->cur] : 0;
+}
+
+
+
+GLuint FluidSolverGPU::getBoundsTexture()
+{
+	return boundsTex_;
+}
+
+
+
+/*
+  ----------------------------------------------------------------------
+   protected methods
+  ----------------------------------------------------------------------
+*/
+
+bool FluidSolverGPU::initGl()
+{
+	static const char* sources[PROGRAM_COUNT] = {
+		ADD_SOURCE_SHADER, JACOBI_SHADER, BOUNDS_SHADER, ADVECT_SHADER,
+		DIVERGENCE_SHADER, GRADIENT_SHADER, DISPLAY_SHADER, ADD_FLOW_SHADER
+	};
+	static const char* names[PROGRAM_COUNT] = {
+		"addSource", "jacobi", "bounds", "advect", "divergence", "gradient", "display", "addFlow"
+	};
+
+	if (!isSupported())
+		return false;
+
+	for (int p = 0; p < PROGRAM_COUNT; p++) {
+		programs_[p] = compileFragmentProgram(sources[p], names[p]);
+		if (!programs_[p]) {
+			releaseGl();
+			return false;
+		}
+	}
+
+	int w = NX_ + 2, h = NY_ + 2;
+	std::vector<float> zeros(w * h, 0.0f);
+	for (int f = 0; f < 6; f++)
+		for (int k = 0; k < 2; k++) {
+			glGenTextures(1, &fields_[f].tex[k]);
+			glBindTexture(GL_TEXTURE_2D, fields_[f].tex[k]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, &zeros[0]);
+		}
+
+	glGenTextures(1, &boundsTex_);
+	glBindTexture(GL_TEXTURE_2D, boundsTex_);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_FLOAT, &zeros[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//check once that a float texture can be rendered to
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	fwglGenFramebuffers(1, &framebuffer_);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+	fwglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fields_[0].tex[0], 0);
+	GLenum status = fwglCheckFramebufferStatus(GL_FRAMEBUFFER);
+	fwglBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("GPU solver: float render targets are not supported (status 0x%x)\n", status);
+		releaseGl();
+		return false;
+	}
+
+	printf("FluidSolver running on the GPU: %s\n", (const char*) glGetString(GL_RENDERER));
+	glReady_ = true;
+	return true;
+}
+
+
+
+void FluidSolverGPU::releaseGl()
+{
+	for (int p = 0; p < PROGRAM_COUNT; p++)
+		if (programs_[p]) fwglDeleteProgram(programs_[p]);
+	for (int f = 0; f < 6; f++)
+		if (fields_[f].tex[0]) glDeleteTextures(2, fields_[f].tex);
+	if (boundsTex_)   glDeleteTextures(1, &boundsTex_);
+	if (framebuffer_) fwglDeleteFramebuffers(1, &framebuffer_);
+
+	memset(programs_, 0, sizeof(programs_));
+	memset(fields_,   0, sizeof(fields_));
+	boundsTex_   = 0;
+	framebuffer_ = 0;
+	glReady_     = false;
+}
+
+
+
+void FluidSolverGPU::upload(GpuField* f, const float* x)
+{
+	glBindTexture(GL_TEXTURE_2D, f->tex[f->cur]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, stride_);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX_ + 2, NY_ + 2, GL_RED, GL_FLOAT, x);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+
+
+void FluidSolverGPU::bindInput(Program p, const char* sampler, int unit, GLuint tex)
+{
+	fwglActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	fwglUniform1i(fwglGetUniformLocation(programs_[p], sampler), unit);
+}
+
+
+
+void FluidSolverGPU::runPass(GpuField* target)
+{
+	int back = 1 - target->cur;
+	fwglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->tex[back], 0);
+
+	glBegin(GL_QUADS);
+		glVertex2f(-1.0f, -1.0f);
+		glVertex2f( 1.0f, -1.0f);
+		glVertex2f( 1.0f,  1.0f);
+		glVertex2f(-1.0f,  1.0f);
+	glEnd();
+
+	target->cur = back;
+}
+
+
+
+/**
+ * Selects a program and sets the grid size every shader needs.
+ */
+static GLuint useProgram(GLuint program, int width, int height)
+{
+	fwglUseProgram(program);
+	fwglUniform2i(fwglGetUniformLocation(program, "N"), width, height);
+	return program;
+}
+
+
+
+void FluidSolverGPU::gpuAddSource(GpuField* x, GpuField* s)
+{
+	GLuint program = useProgram(programs_[PROGRAM_ADD_SOURCE], NX_, NY_);
+	fwglUniform1f(fwglGetUniformLocation(program, "dt"), sourceDt_);
+	bindInput(PROGRAM_ADD_SOURCE, "x", 0, x->tex[x->cur]);
+	bindInput(PROGRAM_ADD_SOURCE, "s", 1, s->tex[s->cur]);
+	runPass(x);
+}
+
+
+
+void FluidSolverGPU::gpuAddFlow(GpuField* x, int component)
+{
+	GLuint program = useProgram(programs_[PROGRAM_ADD_FLOW], NX_, NY_);
+	fwglUniform1i(fwglGetUniformLocation(program, "component"), component);
+	fwglUniform1f(fwglGetUniformLocation(program, "scale"), flowScale_);
+	bindInput(PROGRAM_ADD_FLOW, "x",    0, x->tex[x->cur]);
+	bindInput(PROGRAM_ADD_FLOW, "flow", 1, flowTex_);
+	runPass(x);
+}
+
+
+
+void FluidSolverGPU::gpuSetBounds(int boundsFlag, GpuField* x)
+{
+	GLuint program = useProgram(programs_[PROGRAM_BOUNDS], NX_, NY_);
+	fwglUniform1i(fwglGetUniformLocation(program, "flag"), boundsFlag);
+	bindInput(PROGRAM_BOUNDS, "x",      0, x->tex[x->cur]);
+	bindInput(PROGRAM_BOUNDS, "bounds", 1, boundsTex_);
+	runPass(x);
+}
+
+
+
+void FluidSolverGPU::gpuLinearSolve(int boundsFlag, GpuField* x, GpuField* x0, float a, float c)
+{
+	for (int k = 0; k < maxIterations_; k++) {
+		GLuint program = useProgram(programs_[PROGRAM_JACOBI], NX_, NY_);
+		fwglUniform1f(fwglGetUniformLocation(program, "a"), a);
+		fwglUniform1f(fwglGetUniformLocation(program, "invC"), 1.0f / c);
+		bindInput(PROGRAM_JACOBI, "x",  0, x->tex[x->cur]);
+		bindInput(PROGRAM_JACOBI, "x0", 1, x0->tex[x0->cur]);
+		runPass(x);
+
+		gpuSetBounds(boundsFlag, x);
+	}
+
+	//reading the residual back would stall the pipeline, only the sweeps are known
+	SolveStats stats;
+	stats.iterations = maxIterations_;
+	stats.residual   = -1.0f;
+	solveStats_.push_back(stats);
+}
+
+
+
+void FluidSolverGPU::gpuDiffuse(int boundsFlag, GpuField* x, GpuField* x0)
+{
+	float diffusionPerCell = dt_ * diff_ * N_ * N_;
+	gpuLinearSolve(boundsFlag, x, x0, diffusionPerCell, 1 + 4 * diffusionPerCell);
+}
+
+
+
+void FluidSolverGPU::gpuAdvect(int boundsFlag, GpuField* d, GpuField* d0, GpuField* u, GpuField* v)
+{
+	GLuint program = useProgram(programs_[PROGRAM_ADVECT], NX_, NY_);
+	fwglUniform1f(fwglGetUniformLocation(program, "dt0"), dt_ * N_);
+	bindInput(PROGRAM_ADVECT, "d0", 0, d0->tex[d0->cur]);
+	bindInput(PROGRAM_ADVECT, "u",  1, u->tex[u->cur]);
+	bindInput(PROGRAM_ADVECT, "v",  2, v->tex[v->cur]);
+	runPass(d);
+
+	gpuSetBounds(boundsFlag, d);
+}
+
+
+
+void FluidSolverGPU::gpuProject(GpuField* u, GpuField* v, GpuField* p, GpuField* div)
+{
+	float h = 1.0f / N_;
+
+	GLuint program = useProgram(programs_[PROGRAM_DIVERGENCE], NX_, NY_);
+	fwglUniform1f(fwglGetUniformLocation(program, "scale"), -0.5f * h);
+	bindInput(PROGRAM_DIVERGENCE, "u", 0, u->tex[u->cur]);
+	bindInput(PROGRAM_DIVERGENCE, "v", 1, v->tex[v->cur]);
+	runPass(div);
+
+	//the pressure starts from zero, as on the CPU
+	fwglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, p->tex[p->cur], 0);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	gpuSetBounds(0, div);
+	gpuLinearSolve(0, p, div, 1, 4);
+
+	//subtract gradient field from current velocities
+	program = useProgram(programs_[PROGRAM_GRADIENT], NX_, NY_);
+	fwglUniform1f(fwglGetUniformLocation(program, "scale"), 0.5f * N_);
+	fwglUniform2i(fwglGetUniformLocation(program, "dir"), 1, 0);
+	bindInput(PROGRAM_GRADIENT, "x", 0, u->tex[u->cur]);
+	bindInput(PROGRAM_GRADIENT, "p", 1, p->tex[p->cur]);
+	runPass(u);
+
+	fwglUniform2i(fwglGetUniformLocation(program, "dir"), 0, 1);
+	bindInput(PROGRAM_GRADIENT, "x", 0, v->tex[v->cur]);
+	runPass(v);
+
+	gpuSetBounds(1, u);
+	gpuSetBounds(2, v);
+}
+
+
+
+void FluidSolverGPU::gpuDensityStep(GpuField* x, GpuField* x0, GpuField* u, GpuField* v)
+{
+	gpuAddSource(x, x0);
+	SWAP(x0, x);
+	gpuDiffuse(0, x, x0);
+	SWAP(x0, x);
+	gpuAdvect(0, x, x0, u, v);
+}
+
+
+
+void FluidSolverGPU::gpuVelocityStep(GpuField* u, GpuField* v, GpuField* u0, GpuField* v0)
+{
+	gpuAddSource(u, u0);
+	gpuAddSource(v, v0);
+	//diffuse horizontal
+	SWAP(u0, u);
+	gpuDiffuse(1, u, u0);
+
+	//diffuse vertical
+	SWAP(v0, v);
+	gpuDiffuse(2, v, v0);
+	gpuProject(u, v, u0, v0);
+	SWAP(u0, u);
+	SWAP(v0, v);
+
+	//advect velocities
+	gpuAdvect(1, u, u0, u0, v0);
+	gpuAdvect(2, v, v0, u0, v0);
+	gpuProject(u, v, u0, v0);
+}
@@ -0,0 +1,220 @@
+/**
+ * @file      FluidSolverGPU.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "FluidSolver.h"
+#include "GlExtensions.h"
+
+/**
+ * FluidSolver that runs the simulation on the graphics card.
+ *
+ * Velocity, density, pressure and the bounds mask live in single channel float
+ * textures of (width+2) x (height+2) texels, one texel per cell including the buffer ring.
+ * Each step of the CPU solver (addSource, diffuse, advect, project and setBounds) is
+ * a fragment shader pass that renders from one texture of a ping-pong pair into the
+ * other through a framebuffer object.
+ *
+ * Sources and bounds are still written on the CPU with the usual add*At / setBoundAt
+ * calls and uploaded once per update(). The fields stay on the GPU: draw density
+ * with drawDensity(), and call syncToHost() before reading cells with the get*At
+ * accessors.
+ *
+ * Differences from the CPU solver:
+ *  - diffusion and pressure always run maxIterations Jacobi iterations. The 
+ *    residual is not measured, getSolveStats() reports it as negative
+ *  - the tolerance, solver type, pressure solver, velocity downsampling and 
+ *    advection scheme settings have no effect
+ *  - obstacle cells are filled by a single gather pass; where the CPU's row order
+ *    lets a neighbor's corner fix-up win the result can differ in solid cells
+ *  - tile tracking is ignored
+ *
+ * Every method that touches the GPU needs the OpenGL context to be current.
+ * The textures are created on the first update().
+ */
+class FluidSolverGPU :
+	public FluidSolver
+{
+public:
+	/**
+	 * Parameter constructor. Does not touch OpenGL, so it can run before the window exists.
+	 * @param N      Width (and height) of the square fluid simulation grid
+	 * @param dt     Timestep size
+	 * @param diff   Diffusion coefficient
+	 * @param visc   Viscosity coefficient
+	 */
+	FluidSolverGPU(int N, float dt, float diff, float visc);
+
+	/**
+	 * Parameter constructor for a rectangular grid, see FluidSolver.
+	 * @param width  Cells per row of the fluid simulation grid
+	 * @param height Rows of the fluid simulation grid
+	 * @param dt     Timestep size
+	 * @param diff   Diffusion coefficient
+	 * @param visc   Viscosity coefficient
+	 */
+	FluidSolverGPU(int width, int height, float dt, float diff, float visc);
+	~FluidSolverGPU(void);
+
+	/**
+	 * Tests whether the current OpenGL context can run the solver.
+	 * @return True for OpenGL 3.0 or newer with all required entry points.
+	 */
+	static bool isSupported();
+
+	/**
+	 * Uploads this frame's sources and bounds and runs one simulation step on the GPU.
+	 * Also resets u_prev, v_prev, and dens_prev. The velocity stays on the card, so
+	 * getMaxSpeed() stays 0 and SimScheduler applies no CFL limit.
+	 */
+	void update();
+
+	/**
+	 * Adds a flow texture to the velocity sources of the next update(), on the GPU.
+	 * Does the same as addVelocityField() with the flow Mat, without the upload.
+	 *
+	 * @param flow   width x height RG texture, texel (i-1, j-1) holding (u, v) for cell (i, j)
+	 * @param scale  factor applied to the flow
+	 */
+	void addVelocityTexture(GLuint flow, float scale);
+
+	/**
+	 * Resets all fields to zero, on the CPU and the GPU.
+	 */
+	void reset();
+
+	/**
+	 * Copies velocity and density back into CPU memory so the get*At accessors
+	 * reflect the last update(). Stalls until the GPU has finished.
+	 */
+	void syncToHost();
+
+	/**
+	 * Draws the density over the unit square, interpolated between cell centers
+	 * like the immediate mode renderer. Fluid cells show color * (offset + density),
+	 * bounds cells are black.
+	 *
+	 * @param r, g, b  color of a density of 1
+	 * @param offset   background value added to fluid cells
+	 */
+	void drawDensity(float r, float g, float b, float offset);
+
+	/**
+	 * Forgets all OpenGL objects without deleting them, for when the context they
+	 * belonged to is gone (e.g. after switching to fullscreen). They are recreated,
+	 * with the fields cleared, on the next update().
+	 */
+	void contextChanged();
+
+	/**
+	 * Resizes the host grids and drops the textures, which are recreated at the
+	 * new size on the next update(). Needs the solver's context to be current.
+	 */
+	void resize(int width, int height);
+
+	/**
+	 * Accessors: current density and bounds textures, 0 before the first update().
+	 * Texel (i, j) holds cell (i, j); sample with texelFetch or nearest filtering.
+	 */
+	GLuint getDensityTexture();
+	GLuint getBoundsTexture();
+
+protected:
+	/**
+	 * A field stored as two textures. Passes read tex[cur] and write the other one.
+	 */
+	struct GpuField {
+		GLuint tex[2];
+		int    cur;
+	};
+
+	enum Program {
+		PROGRAM_ADD_SOURCE,
+		PROGRAM_JACOBI,
+		PROGRAM_BOUNDS,
+		PROGRAM_ADVECT,
+		PROGRAM_DIVERGENCE,
+		PROGRAM_GRADIENT,
+		PROGRAM_DISPLAY,
+		PROGRAM_ADD_FLOW,
+		PROGRAM_COUNT
+	};
+
+	bool   glReady_;      //textures and programs exist
+	bool   glFailed_;     //setup failed, update() does nothing
+	bool   needsClear_;   //reset() ran before the textures existed
+	GLuint framebuffer_;
+	GLuint programs_[PROGRAM_COUNT];
+	GLuint boundsTex_;
+	GLuint flowTex_;      //added by the next update(), 0 for none
+	float  flowScale_;
+
+	GpuField  fields_[6];
+	GpuField* gu_;
+	GpuField* gv_;
+	GpuField* gu_prev_;
+	GpuField* gv_prev_;
+	GpuField* gdens_;
+	GpuField* gdens_prev_;
+
+	/**
+	 * Shared part of the constructors. Does not touch OpenGL.
+	 */
+	void initGpuState();
+
+	/**
+	 * Creates textures, the framebuffer and shader programs.
+	 * @return False if anything failed; the error has been printed.
+	 */
+	bool initGl();
+
+	/**
+	 * Releases all OpenGL objects.
+	 */
+	void releaseGl();
+
+	/**
+	 * Uploads a CPU array into the current texture of a field.
+	 */
+	void upload(GpuField* f, const float* x);
+
+	/**
+	 * Binds a texture to a texture unit and points a sampler uniform at it.
+	 */
+	void bindInput(Program p, const char* sampler, int unit, GLuint tex);
+
+	/**
+	 * Renders the bound program into the back texture of target, then makes it current.
+	 */
+	void runPass(GpuField* target);
+
+	/**
+	 * GPU versions of the FluidSolver steps. Same parameters, fields instead of arrays.
+	 */
+	void gpuAddSource        (GpuField* x, GpuField* s);
+	void gpuAddFlow          (GpuField* x, int component);
+	void gpuSetBounds        (int boundsFlag, GpuField* x);
+	void gpuLinearSolve      (int boundsFlag, GpuField* x, GpuField* x0, float a, float c);
+	void gpuDiffuse          (int boundsFlag, GpuField* x, GpuField* x0);
+	void gpuAdvect           (int boundsFlag, GpuField* d, GpuField* d0, GpuField* u, GpuField* v);
+	void gpuProject          (GpuField* u, GpuField* v, GpuField* p, GpuField* div);
+	void gpuDensityStep      (GpuField* x, GpuField* x0, GpuField* u, GpuField* v);
+	void gpuVelocityStep     (GpuField* u, GpuField* v, GpuField* u0, GpuField* v0);
+};
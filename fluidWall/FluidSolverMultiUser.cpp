@@ -1,109 +1,549 @@
-/**
- * @file      FluidSolverMultiUser.cpp
- * @author    Austin Hines <futurelightstudios@gmail.com>
- * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
- * @version	  1.0.0
- * 
- * This file is part of Fluid Wall. You can redistribute it and/or modify            
- * it under the terms of the GNU Lesser General Public License as published  
- * by the Free Software Foundation, either version 3 of the License, or     
- * (at your option) any later version.                                       
- *                                                                             
- * Fluid Wall is distributed in the hope that it will be useful,                 
- * but WITHOUT ANY WARRANTY; without even the implied warranty of            
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
- * GNU Lesser General Public License for more details.                       
- *                                                                            
- * You should have received a copy of the GNU Lesser General Public License  
- * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
- *
- */
-
-#include "FluidSolverMultiUser.h"
-
-#define ROW_WIDTH N_+2
-#define IX(i,j) ((i)+(ROW_WIDTH)*(j))
-#define FOR_EACH_CELL for (i=1 ; i<=N_ ; i++) { for (j=1 ; j<=N_ ; j++) {
-#define END_FOR }}
-#define SWAP(x0,x) { float* tmp=x0; x0=x; x=tmp; }
-#define SWAP2D(x0,x) {float ** tmp=x0; x0=x; x=tmp;}
-
-////// public methods
-FluidSolverMultiUser::FluidSolverMultiUser(int nUsers, int N, float dt, float diff, float visc) :
-	FluidSolver(N, dt, diff, visc)
-{
-	nUsers_ = nUsers;
-	int size = getSize();
-
-	userDensity_      = new float*[nUsers_];
-	userDensity_prev_ = new float*[nUsers_];
-
-
-	for(int i = 0; i < nUsers_; i++) {
-		userDensity_[i]      = new float[size];
-		userDensity_prev_[i] = new float[size];
-	}
-
-	reset();
-}
-
-
-
-FluidSolverMultiUser::~FluidSolverMultiUser(void)
-{
-}
-
-
-
-void FluidSolverMultiUser::addDensityAt(int userNo, int x, int y, float value)
-{
-	if(isValidCoordinate(x, y))
-		userDensity_prev_[userNo][IX(x,y)] += value * dt_;
-}
-
-
-
-float FluidSolverMultiUser::getDensityAt(int userNo, int x, int y)
-{
-	return userDensity_[userNo][IX(x,y)];
-}
-
-
-
-void FluidSolverMultiUser::update()
-{
-	for(int i = 0; i < nUsers_; i++)
-		computeDensityStep(userDensity_[i], userDensity_prev_[i], u_, v_);
-	computeVelocityStep(u_, v_, u_prev_, v_prev_);
-
-	//reset u_prev_, v_prev_, and dens_prev
-	for(int i = 0; i < getSize(); i++) { 
-		u_prev_[i] = v_prev_[i] = 0.0f;
-	}
-
-	resetUserDensities(userDensity_prev_);	
-}
-
-void FluidSolverMultiUser::reset()
-{
-	for(int i = 0 ; i < getSize(); i++) {
-		u_[i] = v_[i] = u_prev_[i] = v_prev_[i] = 0.0f;
-		bounds_[i] = false;
-	}
-
-	resetUserDensities(userDensity_);
-	resetUserDensities(userDensity_prev_);
-}
-
-
-////// protected methods
-void FluidSolverMultiUser::resetUserDensities(float** userDensity)
-{
-	for(int i = 0; i < nUsers_; i++)
-		for(int j = 0; j < getSize(); j++) {
-			if(i == 0) //the user "no user" (0) has full weight
-				userDensity[i][j] = 1.0f;
-			else
-				userDensity[i][j] = 0.0f;
-		}
-}
\ No newline at end of file
+/**
+ * @file      FluidSolverMultiUser.cpp
+ * @author    Austin Hines <futurelightstudios@gmail.com>
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ * 
+ * This file is part of Fluid Wall. You can redistribute it and/or modify            
+ * it under the terms of the GNU Lesser General Public License as published  
+ * by the Free Software Foundation, either version 3 of the License, or     
+ * (at your option) any later version.                                       
+ *                                                                             
+ * Fluid Wall is distributed in the hope that it will be useful,                 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
+ * GNU Lesser General Public License for more details.                       
+ *                                                                            
+ * You should have received a copy of the GNU Lesser General Public License  
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
+ *
+ */
+
+#include "FluidSolverMultiUser.h"
+#include "FluidKernels.h"
+#include "PackedFormats.h"
+#include "Profiler.h"
+#include <string.h>
+
+#define ROW_WIDTH stride_
+#define IX(i,j) ((i)+(ROW_WIDTH)*(j))
+#define FOR_EACH_CELL for (j=1 ; j<=NY_ ; j++) { for (i=1 ; i<=NX_ ; i++) {
+#define END_FOR }}
+#define SWAP(x0,x) { float* tmp=x0; x0=x; x=tmp; }
+#define SWAP2D(x0,x) {float ** tmp=x0; x0=x; x=tmp;}
+
+/**
+ * A PackedFormats.h format whose conversion back to float is looked up, which 
+ * is faster than converting the four samples every advected cell reads.
+ */
+typedef void (*PackedSourceKernel)(unsigned short*, const unsigned short*, const float*, float, int);
+typedef void (*PackKernel)(unsigned short*, const float*, int);
+
+template<class Format> struct TableCodec
+{
+	static float decodeTable[65536];
+
+	//fills the table, once
+	static void init()
+	{
+		static bool ready = false;
+		if (ready) return;
+		for (int x = 0; x < 65536; x++)
+			decodeTable[x] = Format::decode((unsigned short) x);
+		ready = true;
+	}
+
+	static inline unsigned short encode(float value)
+	{
+		return Format::encode(value);
+	}
+
+	static inline float decode(unsigned short x)
+	{
+		return decodeTable[x];
+	}
+};
+
+template<class Format> float TableCodec<Format>::decodeTable[65536];
+
+//and the kernels of each format
+struct HalfCodec : TableCodec<HalfFormat>
+{
+	static inline PackedSourceKernel addSource(const FluidKernels& k) { return k.addSourceHalf; }
+	static inline PackKernel         pack     (const FluidKernels& k) { return k.packHalf; }
+};
+
+struct Unorm16Codec : TableCodec<Unorm16Format>
+{
+	static inline PackedSourceKernel addSource(const FluidKernels& k) { return k.addSourceUnorm16; }
+	static inline PackKernel         pack     (const FluidKernels& k) { return k.packUnorm16; }
+};
+
+
+
+////// public methods
+FluidSolverMultiUser::FluidSolverMultiUser(int nUsers, int N, float dt, float diff, float visc,
+										   DensityStorage storage) :
+	FluidSolver(N, dt, diff, visc)
+{
+	initUsers(nUsers, storage);
+}
+
+
+
+FluidSolverMultiUser::FluidSolverMultiUser(int nUsers, int width, int height, float dt, float diff, 
+										   float visc, DensityStorage storage) :
+	FluidSolver(width, height, dt, diff, visc)
+{
+	initUsers(nUsers, storage);
+}
+
+
+
+void FluidSolverMultiUser::initUsers(int nUsers, DensityStorage storage)
+{
+	nUsers_  = nUsers;
+	storage_ = storage;
+
+	userDensity_        = new float*[nUsers_];
+	userDensity_prev_   = new float*[nUsers_];
+	packedDensity_      = new unsigned short*[nUsers_];
+	packedDensity_prev_ = new unsigned short*[nUsers_];
+
+	if(storage_ == DENSITY_HALF)
+		HalfCodec::init();
+	if(storage_ == DENSITY_UNORM16)
+		Unorm16Codec::init();
+
+	for(int i = 0; i < nUsers_; i++) {
+		userDensity_[i]   = NULL;
+		packedDensity_[i] = packedDensity_prev_[i] = NULL;
+	}
+
+	//the base constructor only laid out its own grids
+	allocateGrids();
+	reset();
+}
+
+
+
+FluidSolverMultiUser::~FluidSolverMultiUser(void)
+{
+	//the grids themselves belong to the arena
+	delete [] userDensity_;
+	delete [] userDensity_prev_;
+	delete [] packedDensity_;
+	delete [] packedDensity_prev_;
+}
+
+
+
+void FluidSolverMultiUser::addGrids(GridArena& arena)
+{
+	int size = getSize();
+
+	FluidSolver::addGrids(arena);
+
+	//a user's density next to its sources, in the order the density step walks them
+	for(int i = 0; i < nUsers_; i++) {
+		if(storage_ == DENSITY_FLOAT)
+			arena.addField(userDensity_[i], size);
+		else {
+			arena.addField(packedDensity_[i],      size);
+			arena.addField(packedDensity_prev_[i], size);
+		}
+		arena.addField(userDensity_prev_[i], size);
+	}
+
+	arena.addField(stencilIndex_,   size);
+	arena.addField(stencilWeights_, 4 * size);
+}
+
+
+
+void FluidSolverMultiUser::addDensityAt(int userNo, int x, int y, float value)
+{
+	if(isValidCoordinate(x, y))
+		userDensity_prev_[userNo][IX(x,y)] += value * dt_;
+}
+
+
+
+float* FluidSolverMultiUser::getSplatDensityTarget(int user, float& scale)
+{
+	if(user < 0 || user >= nUsers_)
+		return NULL;
+
+	scale *= dt_;
+	return userDensity_prev_[user];
+}
+
+
+
+float FluidSolverMultiUser::getDensityAt(int userNo, int x, int y)
+{
+	switch(storage_) {
+		case DENSITY_HALF:    return HalfCodec::decode(packedDensity_[userNo][IX(x,y)]);
+		case DENSITY_UNORM16: return Unorm16Codec::decode(packedDensity_[userNo][IX(x,y)]);
+		default:              return userDensity_[userNo][IX(x,y)];
+	}
+}
+
+
+
+FluidSolverMultiUser::DensityStorage FluidSolverMultiUser::getDensityStorage()
+{
+	return storage_;
+}
+
+
+
+void FluidSolverMultiUser::update()
+{
+	solveStats_.clear();
+	beginHaloStep();
+
+	//user densities keep collecting sources even while the air is still, 
+	//so only the velocity step can be skipped
+	bool moving = !trackTiles_ || buildStepTiles();
+
+	computeUserDensitySteps();
+	if(moving) {
+		stepVelocity();
+
+		clearSources(false);
+
+		if(trackTiles_)
+			refreshActiveTiles();
+		else
+			measureMaxSpeed();
+	}
+
+	resetUserDensities(userDensity_prev_);	
+}
+
+void FluidSolverMultiUser::reset()
+{
+	for(int i = 0 ; i < getSize(); i++) {
+		u_[i] = v_[i] = u_prev_[i] = v_prev_[i] = 0.0f;
+		bounds_[i] = false;
+	}
+	boundsChanged_ = true;
+	tileActive_.assign(tileActive_.size(), 0);
+	tileMarked_.assign(tileMarked_.size(), 0);
+	maxSpeed_ = 0.0f;
+	if (coarse_)
+		coarse_->reset();
+
+	resetUserDensities(userDensity_prev_);
+	if(storage_ == DENSITY_FLOAT) {
+		resetUserDensities(userDensity_);
+		return;
+	}
+
+	//user 0 at full weight, like resetUserDensities()
+	unsigned short one = storage_ == DENSITY_HALF ? HalfCodec::encode(1.0f) : Unorm16Codec::encode(1.0f);
+	for(int n = 0; n < nUsers_; n++) {
+		unsigned short value = n == 0 ? one : 0;
+		for(int j = 0; j < getSize(); j++)
+			packedDensity_[n][j] = packedDensity_prev_[n][j] = value;
+	}
+}
+
+
+////// protected methods
+void FluidSolverMultiUser::resetUserDensities(float** userDensity)
+{
+	for(int i = 0; i < nUsers_; i++)
+		for(int j = 0; j < getSize(); j++) {
+			if(i == 0) //the user "no user" (0) has full weight
+				userDensity[i][j] = 1.0f;
+			else
+				userDensity[i][j] = 0.0f;
+		}
+}
+
+
+
+void FluidSolverMultiUser::computeUserDensitySteps()
+{
+	int n;
+
+	if(storage_ == DENSITY_HALF) {
+		computePackedDensitySteps<HalfCodec>();
+		return;
+	}
+	if(storage_ == DENSITY_UNORM16) {
+		computePackedDensitySteps<Unorm16Codec>();
+		return;
+	}
+
+	//same buffer sequence as computeDensityStep(): source into x, diffuse into x0,
+	//advect back into x
+	for(n = 0; n < nUsers_; n++)
+		addSource(userDensity_[n], userDensity_prev_[n]);
+	diffuseUsers(userDensity_prev_, userDensity_);
+	advectUsers(userDensity_, userDensity_prev_, u_, v_);
+
+	if(densityAdvection_ == ADVECT_MACCORMACK) {
+		PROFILE_SCOPE(PROFILE_SOLVER_ADVECT);
+		for(n = 0; n < nUsers_; n++) {
+			advectCells(scratch_, userDensity_[n], u_, v_, -dt_ * N_);
+			correctMacCormack(userDensity_[n], userDensity_prev_[n], scratch_, u_, v_);
+			setBounds(0, userDensity_[n]);
+		}
+	}
+}
+
+
+
+void FluidSolverMultiUser::diffuseUsers(float** x, float** x0)
+{
+	int n;
+
+	if(diff_ == 0.0f) {
+		//with no diffusion the solve reduces to x = x0, no need to relax anything
+		PROFILE_SCOPE(PROFILE_SOLVER_DIFFUSE);
+		for(n = 0; n < nUsers_; n++) {
+			memcpy(x[n], x0[n], getSize() * sizeof(float));
+			setBounds(0, x[n]);
+		}
+	}
+	else {
+		for(n = 0; n < nUsers_; n++)
+			diffuse(0, x[n], x0[n]);
+	}
+}
+
+
+
+void FluidSolverMultiUser::advectUsers(float** d, float** d0, float* u, float* v)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_ADVECT);
+	int j, n;
+
+	#pragma omp parallel for schedule(static)
+	for(j = 1; j <= NY_; j++) {
+		int i, k, tx = 0;
+		int*   index   = stencilIndex_   + IX(0,j);
+		float* weights = stencilWeights_ + 4 * IX(0,j);
+
+		while(tx < tilesX_) {
+			bool step = isStepTile(tx, j);
+			int  run  = tx + 1;
+			while(run < tilesX_ && isStepTile(run, j) == step)
+				run++;
+
+			int iBegin = 1 + tx * TILE_SIZE;
+			int iEnd   = run * TILE_SIZE < NX_ ? run * TILE_SIZE : NX_;
+			tx = run;
+
+			//no motion near these tiles, every backtrace lands on its own cell
+			if(!step) {
+				for(k = 0; k < nUsers_; k++)
+					memcpy(d[k] + IX(iBegin,j), d0[k] + IX(iBegin,j), (iEnd - iBegin + 1) * sizeof(float));
+				continue;
+			}
+
+			computeStencil(j, iBegin, iEnd, u, v);
+
+			//then gather every user with the stencil
+			for(k = 0; k < nUsers_; k++) {
+				float*       dn  = d[k];
+				const float* d0n = d0[k];
+
+				for(i = iBegin; i <= iEnd; i++) {
+					const float* w   = weights + 4 * i;
+					const float* src = d0n + index[i];
+					dn[IX(i,j)] = w[0] * (w[2] * src[0] + w[3] * src[ROW_WIDTH]) +
+								  w[1] * (w[2] * src[1] + w[3] * src[1 + ROW_WIDTH]);
+				}
+			}
+		}
+	}
+
+	for(n = 0; n < nUsers_; n++)
+		setBounds(0, d[n]);
+}
+
+
+
+void FluidSolverMultiUser::computeStencil(int j, int iBegin, int iEnd, const float* u, const float* v)
+{
+	float dt0      = dt_ * N_;
+	float maxX     = NX_ + 0.5f;
+	float maxY     = NY_ + 0.5f;
+	int*   index   = stencilIndex_   + IX(0,j);
+	float* weights = stencilWeights_ + 4 * IX(0,j);
+
+	//backtrace once per cell, same arithmetic as FluidKernels::advectRow
+	for(int i = iBegin; i <= iEnd; i++) {
+		int c = IX(i,j);
+		float x = i - dt0 * u[c];
+		float y = j - dt0 * v[c];
+
+		if (x < 0.5f) x = 0.5f;
+		if (x > maxX) x = maxX;
+		if (y < 0.5f) y = 0.5f;
+		if (y > maxY) y = maxY;
+
+		int i0 = (int)x;
+		int j0 = (int)y;
+		float s1 = x - i0;
+		float t1 = y - j0;
+
+		index[i]           = IX(i0,j0);
+		weights[4 * i]     = 1 - s1;
+		weights[4 * i + 1] = s1;
+		weights[4 * i + 2] = 1 - t1;
+		weights[4 * i + 3] = t1;
+	}
+}
+
+
+
+template<class Codec> void FluidSolverMultiUser::computePackedDensitySteps()
+{
+	int c, j, n, size = getSize();
+	PackedSourceKernel addSourcePacked = Codec::addSource(*kernels_);
+	PackKernel         pack            = Codec::pack(*kernels_);
+
+	//sources and diffusion, packedDensity_ into packedDensity_prev_
+	for(n = 0; n < nUsers_; n++) {
+		const unsigned short* x  = packedDensity_[n];
+		unsigned short*       x0 = packedDensity_prev_[n];
+		const float*          s  = userDensity_prev_[n];
+
+		if(diff_ == 0.0f) {
+			PROFILE_SCOPE(PROFILE_SOLVER_ADD_SOURCE);
+			#pragma omp parallel for schedule(static)
+			for(j = 0; j <= NY_ + 1; j++)
+				addSourcePacked(x0 + IX(0,j), x + IX(0,j), s + IX(0,j), sourceDt_, ROW_WIDTH);
+			setPackedBounds<Codec>(x0);
+		}
+		else {
+			//the solve starts from this user's density, not the last user's result
+			for(c = 0; c < size; c++)
+				dens_[c] = dens_prev_[c] = Codec::decode(x[c]) + sourceDt_ * s[c];
+			diffuse(0, dens_, dens_prev_);
+			pack(x0, dens_, size);
+		}
+	}
+
+	//advection back into packedDensity_, same traversal as advectUsers()
+	{
+		PROFILE_SCOPE(PROFILE_SOLVER_ADVECT);
+
+		#pragma omp parallel for schedule(static)
+		for(j = 1; j <= NY_; j++) {
+			int i, k, tx = 0;
+			const int*   index   = stencilIndex_   + IX(0,j);
+			const float* weights = stencilWeights_ + 4 * IX(0,j);
+
+			while(tx < tilesX_) {
+				bool step = isStepTile(tx, j);
+				int  run  = tx + 1;
+				while(run < tilesX_ && isStepTile(run, j) == step)
+					run++;
+
+				int iBegin = 1 + tx * TILE_SIZE;
+				int iEnd   = run * TILE_SIZE < NX_ ? run * TILE_SIZE : NX_;
+				tx = run;
+
+				if(!step) {
+					for(k = 0; k < nUsers_; k++)
+						memcpy(packedDensity_[k] + IX(iBegin,j), packedDensity_prev_[k] + IX(iBegin,j), 
+							   (iEnd - iBegin + 1) * sizeof(unsigned short));
+					continue;
+				}
+
+				computeStencil(j, iBegin, iEnd, u_, v_);
+
+				//gathered in float into this row of scratch_, then packed a row at a time
+				float* row = scratch_ + IX(0,j);
+				for(k = 0; k < nUsers_; k++) {
+					const unsigned short* d0n = packedDensity_prev_[k];
+
+					for(i = iBegin; i <= iEnd; i++) {
+						const float*          w   = weights + 4 * i;
+						const unsigned short* src = d0n + index[i];
+						row[i] = w[0] * (w[2] * Codec::decode(src[0]) + w[3] * Codec::decode(src[ROW_WIDTH])) +
+								 w[1] * (w[2] * Codec::decode(src[1]) + w[3] * Codec::decode(src[1 + ROW_WIDTH]));
+					}
+					pack(packedDensity_[k] + IX(iBegin,j), row + iBegin, iEnd - iBegin + 1);
+				}
+			}
+		}
+	}
+
+	for(n = 0; n < nUsers_; n++)
+		setPackedBounds<Codec>(packedDensity_[n]);
+
+	//MacCormack in float: the forward result into dens_, its input into dens_prev_
+	if(densityAdvection_ == ADVECT_MACCORMACK) {
+		PROFILE_SCOPE(PROFILE_SOLVER_ADVECT);
+		for(n = 0; n < nUsers_; n++) {
+			for(c = 0; c < size; c++) {
+				dens_[c]      = Codec::decode(packedDensity_[n][c]);
+				dens_prev_[c] = Codec::decode(packedDensity_prev_[n][c]);
+			}
+			advectCells(scratch_, dens_, u_, v_, -dt_ * N_);
+			correctMacCormack(dens_, dens_prev_, scratch_, u_, v_);
+			pack(packedDensity_[n], dens_, size);
+			setPackedBounds<Codec>(packedDensity_[n]);
+		}
+	}
+
+	//dens_ held float copies of the users; cleared, refreshActiveTiles() sees only
+	//the velocity, as with float storage
+	if(diff_ != 0.0f || densityAdvection_ == ADVECT_MACCORMACK)
+		memset(dens_, 0, size * sizeof(float));
+}
+
+
+
+template<class Codec> void FluidSolverMultiUser::setPackedBounds(unsigned short* x)
+{
+	PROFILE_SCOPE(PROFILE_SOLVER_SET_BOUNDS);
+	int i, k;
+
+	if (boundsChanged_)
+		compileBounds();
+
+	//the steps of setBounds(0, x): nothing to negate, so all but the averages are copies
+	bool wallLeft   = !hasHaloNeighbor(HaloExchange::SIDE_LEFT);
+	bool wallRight  = !hasHaloNeighbor(HaloExchange::SIDE_RIGHT);
+	bool wallBottom = !hasHaloNeighbor(HaloExchange::SIDE_BOTTOM);
+	bool wallTop    = !hasHaloNeighbor(HaloExchange::SIDE_TOP);
+
+	for ( i=1 ; i<=NY_; i++ ) {
+		if (wallLeft)   x[IX(0    ,i)] = x[IX(1  ,i)];
+		if (wallRight)  x[IX(NX_+1,i)] = x[IX(NX_,i)];
+	}
+	for ( i=1 ; i<=NX_; i++ ) {
+		if (wallBottom) x[IX(i,0    )] = x[IX(i,1  )];
+		if (wallTop)    x[IX(i,NY_+1)] = x[IX(i,NY_)];
+	}
+
+	//zero is all bits clear in both formats
+	for ( k=0 ; k<(int)boundsZero_.size() ; k++ )
+		memset(x + boundsZero_[k].start, 0, boundsZero_[k].count * sizeof(unsigned short));
+
+	for ( k=0 ; k<(int)boundsCopyRight_.size() ; k++ )
+		x[boundsCopyRight_[k].dst] = x[boundsCopyRight_[k].src];
+
+	for ( k=0 ; k<(int)boundsCopyUp_.size() ; k++ )
+		x[boundsCopyUp_[k].dst] = x[boundsCopyUp_[k].src];
+
+	exchangeHalo(x, sizeof(unsigned short));
+
+	for ( k=0 ; k<(int)boundsCorners_.size() ; k++ ) {
+		const BoundsCorner& c = boundsCorners_[k];
+		x[c.dst] = Codec::encode(0.5f * (Codec::decode(x[c.a]) + Codec::decode(x[c.b])));
+	}
+
+	x[IX(0,       0      )] = Codec::encode(0.5f * (Codec::decode(x[IX(1,   0    )]) + Codec::decode(x[IX(0,       1  )])));
+	x[IX(0,       NY_ + 1)] = Codec::encode(0.5f * (Codec::decode(x[IX(1,   NY_+1)]) + Codec::decode(x[IX(0,       NY_)])));
+	x[IX(NX_ + 1, 0      )] = Codec::encode(0.5f * (Codec::decode(x[IX(NX_, 0    )]) + Codec::decode(x[IX(NX_ + 1, 1  )])));
+	x[IX(NX_ + 1, NY_ + 1)] = Codec::encode(0.5f * (Codec::decode(x[IX(NX_, NY_+1)]) + Codec::decode(x[IX(NX_ + 1, NY_)])));
+}
@@ -1,97 +1,193 @@
-/**
- * @file      FluidSolverMultiUser.h
- * @author    Austin Hines <futurelightstudios@gmail.com>
- * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
- * @version	  1.0.0
- *
- * This file is part of Fluid Wall. You can redistribute it and/or modify            
- * it under the terms of the GNU Lesser General Public License as published  
- * by the Free Software Foundation, either version 3 of the License, or     
- * (at your option) any later version.                                       
- *                                                                             
- * Fluid Wall is distributed in the hope that it will be useful,                 
- * but WITHOUT ANY WARRANTY; without even the implied warranty of            
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
- * GNU Lesser General Public License for more details.                       
- *                                                                            
- * You should have received a copy of the GNU Lesser General Public License  
- * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
- *
- */
-
-#pragma once
-#include "fluidsolver.h"
-
-/**
- * Extends the 2D FluidSolver to support simulation of densities that represent various 
- * users in the Fluid Wall simulation
- *
- */
-class FluidSolverMultiUser :
-	public FluidSolver
-{
-public:
-	/**
-	 * Parameter constructor
-	 * @param nUsers Number of users that the solver will calculate.
-	 * @param N      Width (and height) of the square fluid simulation grid
-	 * @param dt     Timestep size
-	 * @param diff   Diffusion coefficient
-	 * @param visc   Viscosity coefficient
-	 */
-	FluidSolverMultiUser(int nUsers, int N, float dt, float diff, float visc);
-	~FluidSolverMultiUser(void);
-
-	/**
-	 * Adds density values at a particular coordinate. 
-	 *
-	 * The system is designed to add values from multiple other sources using this method, 
-	 * and then commit them to the simulation using update(). Valid indicies range from 
-	 * 1 to N. Indicies 0 and N+1 are buffer rows for algorithms.
-	 *
-	 * @param userNo User number to add density to
-	 * @param x     x-coordinate, valid values: 1 - N
-	 * @param y     y-coordinate, valid values: 1 - N
-	 * @param value  Density value to be added
-	 */
-	void addDensityAt(int userNo, int x, int y, float value);
-
-	/**
-	 * Accessor: returns density value for given user at given coordinate. Valid indicies range 
-	 * from 1 to N. Indicies 0 and N+1 are buffer rows for algorithms.
-	 *
-	 * @param userNo  User ID.
-	 * @param x		  X-coordinate, valid values: 1 - N
-	 * @param y		  y-coordinate, valid values: 1 - N
-	 * @return		  Density value at coordinate.
-	 */
-	float getDensityAt(int userNo, int x, int y);
-
-	/**
-	 * Runs an iteration of the simulation, updating density and velocity values.
-	 * Also resets u_prev, v_prev, and dens_prev.
-	 *
-	 */
-	void update(); 
-
-
-	/**
-	 * Resets all public array values to zero.
-	 */
-	void reset();
-
-protected:
-	int     nUsers_;
-	float** userDensity_;
-	float** userDensity_prev_;
-
-	/**
-	 * Resets values in userDensity so that user 0 
-	 * has 1.0 density.
-	 */
-	void resetUserDensities(float** userDensity);
-	//normalize
-
-
-};
-
+/**
+ * @file      FluidSolverMultiUser.h
+ * @author    Austin Hines <futurelightstudios@gmail.com>
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify            
+ * it under the terms of the GNU Lesser General Public License as published  
+ * by the Free Software Foundation, either version 3 of the License, or     
+ * (at your option) any later version.                                       
+ *                                                                             
+ * Fluid Wall is distributed in the hope that it will be useful,                 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
+ * GNU Lesser General Public License for more details.                       
+ *                                                                            
+ * You should have received a copy of the GNU Lesser General Public License  
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.            
+ *
+ */
+
+#pragma once
+#include "fluidsolver.h"
+
+/**
+ * Extends the 2D FluidSolver to support simulation of densities that represent various 
+ * users in the Fluid Wall simulation
+ *
+ */
+class FluidSolverMultiUser :
+	public FluidSolver
+{
+public:
+	/**
+	 * Storage of the user densities. The density step always computes in float; 
+	 * the packed formats only change what is kept between steps, halving the memory 
+	 * traffic of the density step and of reading the densities back.
+	 *
+	 * DENSITY_HALF keeps IEEE half floats, about three significant digits at any
+	 * magnitude. DENSITY_UNORM16 keeps 16 bit fixed point over [0, FLUID_UNORM16_RANGE],
+	 * clamping values outside. Sources added with addDensityAt() stay in float.
+	 */
+	enum DensityStorage {
+		DENSITY_FLOAT,
+		DENSITY_HALF,
+		DENSITY_UNORM16
+	};
+
+	/**
+	 * Parameter constructor
+	 * @param nUsers  Number of users that the solver will calculate.
+	 * @param N       Width (and height) of the square fluid simulation grid
+	 * @param dt      Timestep size
+	 * @param diff    Diffusion coefficient
+	 * @param visc    Viscosity coefficient
+	 * @param storage Format the user densities are kept in
+	 */
+	FluidSolverMultiUser(int nUsers, int N, float dt, float diff, float visc, 
+						 DensityStorage storage = DENSITY_FLOAT);
+
+	/**
+	 * Parameter constructor for a rectangular grid, see FluidSolver.
+	 * @param nUsers  Number of users that the solver will calculate.
+	 * @param width   Cells per row of the fluid simulation grid
+	 * @param height  Rows of the fluid simulation grid
+	 * @param dt      Timestep size
+	 * @param diff    Diffusion coefficient
+	 * @param visc    Viscosity coefficient
+	 * @param storage Format the user densities are kept in
+	 */
+	FluidSolverMultiUser(int nUsers, int width, int height, float dt, float diff, float visc, 
+						 DensityStorage storage = DENSITY_FLOAT);
+	~FluidSolverMultiUser(void);
+
+	/**
+	 * Adds density values at a particular coordinate. 
+	 *
+	 * The system is designed to add values from multiple other sources using this method, 
+	 * and then commit them to the simulation using update(). Valid indicies range from 
+	 * 1 to width (or height). Indicies 0 and width+1 are buffer rows for algorithms.
+	 *
+	 * @param userNo User number to add density to
+	 * @param x     x-coordinate, valid values: 1 - width
+	 * @param y     y-coordinate, valid values: 1 - height
+	 * @param value  Density value to be added
+	 */
+	void addDensityAt(int userNo, int x, int y, float value);
+
+	/**
+	 * Accessor: returns density value for given user at given coordinate. Valid indicies range 
+	 * from 1 to width (or height). Indicies 0 and width+1 are buffer rows for algorithms.
+	 *
+	 * @param userNo  User ID.
+	 * @param x		  X-coordinate, valid values: 1 - width
+	 * @param y		  y-coordinate, valid values: 1 - height
+	 * @return		  Density value at coordinate.
+	 */
+	float getDensityAt(int userNo, int x, int y);
+
+	/**
+	 * Runs an iteration of the simulation, updating density and velocity values.
+	 * Also resets u_prev, v_prev, and dens_prev.
+	 *
+	 * All user densities advance together: the advection stencil is computed once
+	 * per cell and applied to every user, so the cost of extra users is small.
+	 */
+	void update(); 
+
+
+	/**
+	 * Resets all public array values to zero.
+	 */
+	void reset();
+
+
+	/**
+	 * Accessor: format the user densities are kept in.
+	 */
+	DensityStorage getDensityStorage();
+
+protected:
+	int     nUsers_;
+	float** userDensity_;         //DENSITY_FLOAT only
+	float** userDensity_prev_;    //sources, always float
+	DensityStorage   storage_;
+	unsigned short** packedDensity_;       //packed formats: density of each user
+	unsigned short** packedDensity_prev_;  //packed formats: advection input
+	int*    stencilIndex_;    //per cell: index of the lower left backtrace sample
+	float*  stencilWeights_;  //per cell: s0, s1, t0, t1 bilinear weights
+
+	/**
+	 * Shared part of the constructors: allocates the per user arrays and grids.
+	 */
+	void initUsers(int nUsers, DensityStorage storage);
+
+	/**
+	 * Resets values in userDensity so that user 0 
+	 * has 1.0 density.
+	 */
+	void resetUserDensities(float** userDensity);
+	//normalize
+
+	/**
+	 * Adds the user densities and the advection stencil to the base grids.
+	 */
+	void addGrids(GridArena& arena);
+
+	/**
+	 * Density step of every user at once. Equivalent to calling computeDensityStep()
+	 * on each user density, but shares the backtrace between users and skips the
+	 * diffusion solve when the diffusion rate is zero.
+	 */
+	void computeUserDensitySteps();
+
+	/**
+	 * Diffuses x0 into x for every user.
+	 */
+	void diffuseUsers(float** x, float** x0);
+
+	/**
+	 * Advects d0 into d for every user along the same velocity field. Each row's 
+	 * stencil is computed once and applied to all users while it is still in cache.
+	 */
+	void advectUsers(float** d, float** d0, float* u, float* v);
+
+	/**
+	 * Backtraces cells iBegin..iEnd of row j into stencilIndex_ and stencilWeights_.
+	 */
+	void computeStencil(int j, int iBegin, int iEnd, const float* u, const float* v);
+
+	/**
+	 * computeUserDensitySteps() for the packed formats, Codec being the format's 
+	 * conversions and kernels. Adding the sources and the zero diffusion copy are 
+	 * one pass from packedDensity_ to packedDensity_prev_; the advection reads that
+	 * back into packedDensity_, gathering each row in float in dens_. A nonzero 
+	 * diffusion goes through dens_ and dens_prev_, which this solver has no other
+	 * use for.
+	 */
+	template<class Codec> void computePackedDensitySteps();
+
+	/**
+	 * setBounds(0, x) on a packed density.
+	 */
+	template<class Codec> void setPackedBounds(unsigned short* x);
+
+	/**
+	 * Splat density goes to user Splat::user, scaled by the timestep like addDensityAt().
+	 */
+	float* getSplatDensityTarget(int user, float& scale);
+
+
+};
+
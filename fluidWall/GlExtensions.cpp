@@ -0,0 +1,139 @@
+/**
+ * @file      GlExtensions.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GlExtensions.h"
+#include <GL/freeglut_ext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+
+FWGLCREATESHADER           fwglCreateShader           = NULL;
+FWGLSHADERSOURCE           fwglShaderSource           = NULL;
+FWGLCOMPILESHADER          fwglCompileShader          = NULL;
+FWGLGETSHADERIV            fwglGetShaderiv            = NULL;
+FWGLGETSHADERINFOLOG       fwglGetShaderInfoLog       = NULL;
+FWGLDELETESHADER           fwglDeleteShader           = NULL;
+FWGLCREATEPROGRAM          fwglCreateProgram          = NULL;
+FWGLATTACHSHADER           fwglAttachShader           = NULL;
+FWGLLINKPROGRAM            fwglLinkProgram            = NULL;
+FWGLGETPROGRAMIV           fwglGetProgramiv           = NULL;
+FWGLGETPROGRAMINFOLOG      fwglGetProgramInfoLog      = NULL;
+FWGLDELETEPROGRAM          fwglDeleteProgram          = NULL;
+FWGLUSEPROGRAM             fwglUseProgram             = NULL;
+FWGLGETUNIFORMLOCATION     fwglGetUniformLocation     = NULL;
+FWGLUNIFORM1I              fwglUniform1i              = NULL;
+FWGLUNIFORM2I              fwglUniform2i              = NULL;
+FWGLUNIFORM1F              fwglUniform1f              = NULL;
+FWGLUNIFORM3F              fwglUniform3f              = NULL;
+FWGLACTIVETEXTURE          fwglActiveTexture          = NULL;
+FWGLGENFRAMEBUFFERS        fwglGenFramebuffers        = NULL;
+FWGLDELETEFRAMEBUFFERS     fwglDeleteFramebuffers     = NULL;
+FWGLBINDFRAMEBUFFER        fwglBindFramebuffer        = NULL;
+FWGLFRAMEBUFFERTEXTURE2D   fwglFramebufferTexture2D   = NULL;
+FWGLCHECKFRAMEBUFFERSTATUS fwglCheckFramebufferStatus = NULL;
+
+#define LOAD_GL(ptr, type, name) { ptr = (type) glutGetProcAddress(name); ok = ok && (ptr != NULL); }
+
+
+
+bool loadGlExtensions()
+{
+	static bool loaded = false, supported = false;
+	if (loaded)
+		return supported;
+	loaded = true;
+
+	//single channel float render targets and integer texel fetches need OpenGL 3.0
+	const char* version = (const char*) glGetString(GL_VERSION);
+	if (!version || atoi(version) < 3) {
+		printf("OpenGL 3.0 is required for the GPU solver, found %s\n", version ? version : "none");
+		return false;
+	}
+
+	bool ok = true;
+	LOAD_GL(fwglCreateShader,           FWGLCREATESHADER,           "glCreateShader");
+	LOAD_GL(fwglShaderSource,           FWGLSHADERSOURCE,           "glShaderSource");
+	LOAD_GL(fwglCompileShader,          FWGLCOMPILESHADER,          "glCompileShader");
+	LOAD_GL(fwglGetShaderiv,            FWGLGETSHADERIV,            "glGetShaderiv");
+	LOAD_GL(fwglGetShaderInfoLog,       FWGLGETSHADERINFOLOG,       "glGetShaderInfoLog");
+	LOAD_GL(fwglDeleteShader,           FWGLDELETESHADER,           "glDeleteShader");
+	LOAD_GL(fwglCreateProgram,          FWGLCREATEPROGRAM,          "glCreateProgram");
+	LOAD_GL(fwglAttachShader,           FWGLATTACHSHADER,           "glAttachShader");
+	LOAD_GL(fwglLinkProgram,            FWGLLINKPROGRAM,            "glLinkProgram");
+	LOAD_GL(fwglGetProgramiv,           FWGLGETPROGRAMIV,           "glGetProgramiv");
+	LOAD_GL(fwglGetProgramInfoLog,      FWGLGETPROGRAMINFOLOG,      "glGetProgramInfoLog");
+	LOAD_GL(fwglDeleteProgram,          FWGLDELETEPROGRAM,          "glDeleteProgram");
+	LOAD_GL(fwglUseProgram,             FWGLUSEPROGRAM,             "glUseProgram");
+	LOAD_GL(fwglGetUniformLocation,     FWGLGETUNIFORMLOCATION,     "glGetUniformLocation");
+	LOAD_GL(fwglUniform1i,              FWGLUNIFORM1I,              "glUniform1i");
+	LOAD_GL(fwglUniform2i,              FWGLUNIFORM2I,              "glUniform2i");
+	LOAD_GL(fwglUniform1f,              FWGLUNIFORM1F,              "glUniform1f");
+	LOAD_GL(fwglUniform3f,              FWGLUNIFORM3F,              "glUniform3f");
+	LOAD_GL(fwglActiveTexture,          FWGLACTIVETEXTURE,          "glActiveTexture");
+	LOAD_GL(fwglGenFramebuffers,        FWGLGENFRAMEBUFFERS,        "glGenFramebuffers");
+	LOAD_GL(fwglDeleteFramebuffers,     FWGLDELETEFRAMEBUFFERS,     "glDeleteFramebuffers");
+	LOAD_GL(fwglBindFramebuffer,        FWGLBINDFRAMEBUFFER,        "glBindFramebuffer");
+	LOAD_GL(fwglFramebufferTexture2D,   FWGLFRAMEBUFFERTEXTURE2D,   "glFramebufferTexture2D");
+	LOAD_GL(fwglCheckFramebufferStatus, FWGLCHECKFRAMEBUFFERSTATUS, "glCheckFramebufferStatus");
+
+	if (!ok)
+		printf("OpenGL driver is missing shader or framebuffer entry points\n");
+	supported = ok;
+	return supported;
+}
+
+
+
+GLuint compileFragmentProgram(const char* source, const char* name)
+{
+	GLint status, length;
+
+	GLuint shader = fwglCreateShader(GL_FRAGMENT_SHADER);
+	fwglShaderSource(shader, 1, &source, NULL);
+	fwglCompileShader(shader);
+	fwglGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		fwglGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+		vector<char> log(length + 1, 0);
+		fwglGetShaderInfoLog(shader, length, NULL, &log[0]);
+		printf("Failed to compile shader %s:\n%s\n", name, &log[0]);
+		fwglDeleteShader(shader);
+		return 0;
+	}
+
+	GLuint program = fwglCreateProgram();
+	fwglAttachShader(program, shader);
+	fwglLinkProgram(program);
+	fwglDeleteShader(shader); //stays alive while attached
+
+	fwglGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status) {
+		fwglGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		vector<char> log(length + 1, 0);
+		fwglGetProgramInfoLog(program, length, NULL, &log[0]);
+		printf("Failed to link shader %s:\n%s\n", name, &log[0]);
+		fwglDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
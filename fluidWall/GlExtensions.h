@@ -0,0 +1,126 @@
+/**
+ * @file      GlExtensions.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * The OpenGL headers that ship with Windows stop at version 1.1. This declares the
+ * handful of OpenGL 2.0 / 3.0 entry points Fluid Wall uses (shaders, framebuffer
+ * objects, multitexture) and loads them through freeglut once a context exists.
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <GL/glut.h>
+
+#ifndef APIENTRY
+	#define APIENTRY
+#endif
+
+#ifndef GL_CLAMP_TO_EDGE
+	#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_TEXTURE0
+	#define GL_TEXTURE0 0x84C0
+#endif
+#ifndef GL_FRAGMENT_SHADER
+	#define GL_FRAGMENT_SHADER  0x8B30
+	#define GL_COMPILE_STATUS   0x8B81
+	#define GL_LINK_STATUS      0x8B82
+	#define GL_INFO_LOG_LENGTH  0x8B84
+#endif
+#ifndef GL_FRAMEBUFFER
+	#define GL_FRAMEBUFFER          0x8D40
+	#define GL_COLOR_ATTACHMENT0    0x8CE0
+	#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+	#define GL_FRAMEBUFFER_BINDING  0x8CA6
+#endif
+#ifndef GL_R32F
+	#define GL_R8   0x8229
+	#define GL_R32F 0x822E
+#endif
+#ifndef GL_RG32F
+	#define GL_RG    0x8227
+	#define GL_RG32F 0x8230
+#endif
+
+typedef GLuint (APIENTRY *FWGLCREATESHADER)      (GLenum type);
+typedef void   (APIENTRY *FWGLSHADERSOURCE)      (GLuint shader, GLsizei count, const char** string, const GLint* length);
+typedef void   (APIENTRY *FWGLCOMPILESHADER)     (GLuint shader);
+typedef void   (APIENTRY *FWGLGETSHADERIV)       (GLuint shader, GLenum pname, GLint* params);
+typedef void   (APIENTRY *FWGLGETSHADERINFOLOG)  (GLuint shader, GLsizei bufSize, GLsizei* length, char* infoLog);
+typedef void   (APIENTRY *FWGLDELETESHADER)      (GLuint shader);
+typedef GLuint (APIENTRY *FWGLCREATEPROGRAM)     (void);
+typedef void   (APIENTRY *FWGLATTACHSHADER)      (GLuint program, GLuint shader);
+typedef void   (APIENTRY *FWGLLINKPROGRAM)       (GLuint program);
+typedef void   (APIENTRY *FWGLGETPROGRAMIV)      (GLuint program, GLenum pname, GLint* params);
+typedef void   (APIENTRY *FWGLGETPROGRAMINFOLOG) (GLuint program, GLsizei bufSize, GLsizei* length, char* infoLog);
+typedef void   (APIENTRY *FWGLDELETEPROGRAM)     (GLuint program);
+typedef void   (APIENTRY *FWGLUSEPROGRAM)        (GLuint program);
+typedef GLint  (APIENTRY *FWGLGETUNIFORMLOCATION)(GLuint program, const char* name);
+typedef void   (APIENTRY *FWGLUNIFORM1I)         (GLint location, GLint v0);
+typedef void   (APIENTRY *FWGLUNIFORM2I)         (GLint location, GLint v0, GLint v1);
+typedef void   (APIENTRY *FWGLUNIFORM1F)         (GLint location, GLfloat v0);
+typedef void   (APIENTRY *FWGLUNIFORM3F)         (GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+typedef void   (APIENTRY *FWGLACTIVETEXTURE)     (GLenum texture);
+typedef void   (APIENTRY *FWGLGENFRAMEBUFFERS)   (GLsizei n, GLuint* framebuffers);
+typedef void   (APIENTRY *FWGLDELETEFRAMEBUFFERS)(GLsizei n, const GLuint* framebuffers);
+typedef void   (APIENTRY *FWGLBINDFRAMEBUFFER)   (GLenum target, GLuint framebuffer);
+typedef void   (APIENTRY *FWGLFRAMEBUFFERTEXTURE2D)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef GLenum (APIENTRY *FWGLCHECKFRAMEBUFFERSTATUS)(GLenum target);
+
+extern FWGLCREATESHADER           fwglCreateShader;
+extern FWGLSHADERSOURCE           fwglShaderSource;
+extern FWGLCOMPILESHADER          fwglCompileShader;
+extern FWGLGETSHADERIV            fwglGetShaderiv;
+extern FWGLGETSHADERINFOLOG       fwglGetShaderInfoLog;
+extern FWGLDELETESHADER           fwglDeleteShader;
+extern FWGLCREATEPROGRAM          fwglCreateProgram;
+extern FWGLATTACHSHADER           fwglAttachShader;
+extern FWGLLINKPROGRAM            fwglLinkProgram;
+extern FWGLGETPROGRAMIV           fwglGetProgramiv;
+extern FWGLGETPROGRAMINFOLOG      fwglGetProgramInfoLog;
+extern FWGLDELETEPROGRAM          fwglDeleteProgram;
+extern FWGLUSEPROGRAM             fwglUseProgram;
+extern FWGLGETUNIFORMLOCATION     fwglGetUniformLocation;
+extern FWGLUNIFORM1I              fwglUniform1i;
+extern FWGLUNIFORM2I              fwglUniform2i;
+extern FWGLUNIFORM1F              fwglUniform1f;
+extern FWGLUNIFORM3F              fwglUniform3f;
+extern FWGLACTIVETEXTURE          fwglActiveTexture;
+extern FWGLGENFRAMEBUFFERS        fwglGenFramebuffers;
+extern FWGLDELETEFRAMEBUFFERS     fwglDeleteFramebuffers;
+extern FWGLBINDFRAMEBUFFER        fwglBindFramebuffer;
+extern FWGLFRAMEBUFFERTEXTURE2D   fwglFramebufferTexture2D;
+extern FWGLCHECKFRAMEBUFFERSTATUS fwglCheckFramebufferStatus;
+
+/**
+ * Loads the entry points above. Needs a current OpenGL context.
+ *
+ * @return True if the context is OpenGL 3.0 or newer and every entry point was found.
+ *         Safe to call repeatedly, only the first call does any work.
+ */
+bool loadGlExtensions();
+
+/**
+ * Compiles and links a program made of a single fragment shader. Compile and link
+ * errors are printed to stdout.
+ *
+ * @param source  GLSL source of the fragment shader
+ * @param name    name used in error messages
+ * @return        Program object, or 0 on failure
+ */
+GLuint compileFragmentProgram(const char* source, const char* name);
@@ -0,0 +1,152 @@
+/**
+ * @file      GridArena.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "GridArena.h"
+#include "FluidKernels.h"
+
+
+
+GridArena::GridArena(void)
+{
+	block_    = NULL;
+	capacity_ = 0;
+	bytes_    = 0;
+}
+
+
+
+GridArena::~GridArena(void)
+{
+	//the registered pointers may already be gone along with their owner
+	if (block_)
+		fluidAlignedFree(block_);
+}
+
+
+
+void GridArena::clear()
+{
+	fields_.clear();
+	bytes_ = 0;
+}
+
+
+
+void GridArena::addField(float*& field, size_t count)
+{
+	addField(&field, FIELD_FLOAT, count * sizeof(float));
+}
+
+
+
+void GridArena::addField(int*& field, size_t count)
+{
+	addField(&field, FIELD_INT, count * sizeof(int));
+}
+
+
+
+void GridArena::addField(bool*& field, size_t count)
+{
+	addField(&field, FIELD_BOOL, count * sizeof(bool));
+}
+
+
+
+void GridArena::addField(unsigned short*& field, size_t count)
+{
+	addField(&field, FIELD_UINT16, count * sizeof(unsigned short));
+}
+
+
+
+void GridArena::addField(void* target, FieldType type, size_t bytes)
+{
+	Field f;
+	f.target = target;
+	f.type   = type;
+	f.bytes  = bytes;
+	fields_.push_back(f);
+}
+
+
+
+bool GridArena::commit()
+{
+	//every field rounded up to whole lines, plus a line of padding
+	bytes_ = 0;
+	for (size_t k = 0; k < fields_.size(); k++)
+		bytes_ += (fields_[k].bytes + 2 * FLUID_GRID_ALIGNMENT - 1) / FLUID_GRID_ALIGNMENT * FLUID_GRID_ALIGNMENT;
+
+	if (bytes_ > capacity_) {
+		if (block_)
+			fluidAlignedFree(block_);
+		block_    = (char*) fluidAlignedAlloc(bytes_);
+		capacity_ = block_ ? bytes_ : 0;
+	}
+
+	pointFields(block_);
+	return block_ != NULL || bytes_ == 0;
+}
+
+
+
+void GridArena::pointFields(char* block)
+{
+	size_t offset = 0;
+
+	for (size_t k = 0; k < fields_.size(); k++) {
+		char* p = block ? block + offset : NULL;
+		switch (fields_[k].type) {
+			case FIELD_FLOAT: *(float**) fields_[k].target = (float*) p; break;
+			case FIELD_INT:   *(int**)   fields_[k].target = (int*)   p; break;
+			case FIELD_BOOL:  *(bool**)  fields_[k].target = (bool*)  p; break;
+			case FIELD_UINT16: *(unsigned short**) fields_[k].target = (unsigned short*) p; break;
+		}
+		offset += (fields_[k].bytes + 2 * FLUID_GRID_ALIGNMENT - 1) / FLUID_GRID_ALIGNMENT * FLUID_GRID_ALIGNMENT;
+	}
+}
+
+
+
+void GridArena::release()
+{
+	if (block_)
+		fluidAlignedFree(block_);
+	block_    = NULL;
+	capacity_ = 0;
+	pointFields(NULL);
+}
+
+
+
+size_t GridArena::getBytes()
+{
+	return bytes_;
+}
+
+
+
+size_t GridArena::getCapacity()
+{
+	return capacity_;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file      GridArena.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A single aligned block of memory the grids of a solver are carved from.
+ *
+ * Fields are registered with addField() and placed by commit() back to back, each
+ * starting on a FLUID_GRID_ALIGNMENT boundary and followed by one cache line of
+ * padding. No two fields share a cache line, and fields whose size is a multiple
+ * of the page size do not all start at the same offset within a page, which would
+ * make loops reading several of them at the same index evict each other's lines.
+ *
+ * commit() keeps the block when the new layout fits in it, so a solver that is 
+ * resized to the same or a smaller grid does not go back to the allocator.
+ */
+class GridArena
+{
+public:
+	GridArena(void);
+	~GridArena(void);
+
+	/**
+	 * Forgets the registered fields. The block is kept for the next commit().
+	 */
+	void clear();
+
+	/**
+	 * Registers a field of count elements. The pointer is written by commit(),
+	 * and stays valid until the next commit() or release().
+	 */
+	void addField(float*& field, size_t count);
+	void addField(int*&   field, size_t count);
+	void addField(bool*&  field, size_t count);
+	void addField(unsigned short*& field, size_t count);
+
+	/**
+	 * Lays out the registered fields and points them into the block, allocating a 
+	 * bigger one if they do not fit. Field contents are undefined afterwards.
+	 * @return False if the allocation failed; the fields are then NULL.
+	 */
+	bool commit();
+
+	/**
+	 * Frees the block. Registered fields are set to NULL.
+	 */
+	void release();
+
+	/**
+	 * Accessor: bytes the committed layout uses, padding included.
+	 */
+	size_t getBytes();
+
+	/**
+	 * Accessor: bytes allocated, at least getBytes().
+	 */
+	size_t getCapacity();
+
+protected:
+	enum FieldType { FIELD_FLOAT, FIELD_INT, FIELD_BOOL, FIELD_UINT16 };
+
+	struct Field {
+		void*     target;   //the float**, int**, bool** or unsigned short** to set
+		FieldType type;
+		size_t    bytes;
+	};
+
+	vector<Field> fields_;
+	char*  block_;
+	size_t capacity_;
+	size_t bytes_;
+
+	void addField(void* target, FieldType type, size_t bytes);
+	void pointFields(char* block);
+};
@@ -0,0 +1,139 @@
+/**
+ * @file      GridDownsampler.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GridDownsampler.h"
+#include <string.h>
+
+
+
+GridDownsampler::GridDownsampler(int srcWidth, int srcHeight, int gridWidth, int gridHeight)
+{
+	int k;
+
+	srcWidth_   = srcWidth;
+	srcHeight_  = srcHeight;
+	gridWidth_  = gridWidth;
+	gridHeight_ = gridHeight;
+
+	//box edges at k * size / n, so boxes differ by at most one pixel. Upsampling
+	//would leave some boxes empty, those take the pixel under the cell center.
+	//The label pixel is kept inside the box so depth and label agree.
+	colStart_.resize(gridWidth);
+	colEnd_.resize(gridWidth);
+	rowStart_.resize(gridHeight);
+	rowEnd_.resize(gridHeight);
+	colCenter_.resize(gridWidth);
+	rowCenter_.resize(gridHeight);
+	for (k = 0; k < gridWidth; k++) {
+		colCenter_[k] = ((2 * k + 1) * srcWidth) / (2 * gridWidth);
+		colStart_[k]  = k * srcWidth / gridWidth;
+		colEnd_[k]    = (k + 1) * srcWidth / gridWidth;
+		if (colEnd_[k] <= colStart_[k]) {
+			colStart_[k] = colCenter_[k];
+			colEnd_[k]   = colCenter_[k] + 1;
+		}
+		else if (colCenter_[k] >= colEnd_[k])
+			colCenter_[k] = colEnd_[k] - 1;
+	}
+	for (k = 0; k < gridHeight; k++) {
+		rowCenter_[k] = ((2 * k + 1) * srcHeight) / (2 * gridHeight);
+		rowStart_[k]  = k * srcHeight / gridHeight;
+		rowEnd_[k]    = (k + 1) * srcHeight / gridHeight;
+		if (rowEnd_[k] <= rowStart_[k]) {
+			rowStart_[k] = rowCenter_[k];
+			rowEnd_[k]   = rowCenter_[k] + 1;
+		}
+		else if (rowCenter_[k] >= rowEnd_[k])
+			rowCenter_[k] = rowEnd_[k] - 1;
+	}
+
+	columnSum_.resize(srcWidth);
+}
+
+
+
+void GridDownsampler::downsample(const Mat& depth, const Mat& labels, Mat& image, Mat& users, Mat& bounds)
+{
+	int x, y, gx, gy;
+
+	image.create(gridHeight_, gridWidth_, CV_8UC1);
+	users.create(gridHeight_, gridWidth_, CV_8UC1);
+	bounds.create(gridHeight_, gridWidth_, CV_8UC1);
+
+	for (gy = 0; gy < gridHeight_; gy++) {
+		int y0 = rowStart_[gy], y1 = rowEnd_[gy];
+		int outRow = gridHeight_ - 1 - gy;
+
+		//sum the band of rows column by column, a plain loop the compiler vectorizes
+		memset(&columnSum_[0], 0, srcWidth_ * sizeof(unsigned));
+		for (y = y0; y < y1; y++) {
+			const uchar* src = depth.ptr<uchar>(y);
+			unsigned*    sum = &columnSum_[0];
+			for (x = 0; x < srcWidth_; x++)
+				sum[x] += src[x];
+		}
+
+		uchar*       imageOut  = image.ptr<uchar>(outRow);
+		uchar*       usersOut  = users.ptr<uchar>(outRow);
+		uchar*       boundsOut = bounds.ptr<uchar>(outRow);
+		const uchar* labelRow  = labels.ptr<uchar>(rowCenter_[gy]);
+
+		for (gx = 0; gx < gridWidth_; gx++) {
+			int x0 = colStart_[gx], x1 = colEnd_[gx];
+			unsigned area  = (x1 - x0) * (y1 - y0);
+			unsigned total = 0;
+			for (x = x0; x < x1; x++)
+				total += columnSum_[x];
+
+			imageOut[gx]  = area ? (uchar)((total + area / 2) / area) : 0;
+			boundsOut[gx] = total > 0 ? 1 : 0;
+			usersOut[gx]  = labelRow[colCenter_[gx]];
+		}
+	}
+}
+
+
+
+int GridDownsampler::getWidth()
+{
+	return srcWidth_;
+}
+
+
+
+int GridDownsampler::getHeight()
+{
+	return srcHeight_;
+}
+
+
+
+int GridDownsampler::getGridWidth()
+{
+	return gridWidth_;
+}
+
+
+
+int GridDownsampler::getGridHeight()
+{
+	return gridHeight_;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file      GridDownsampler.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+#include <cv.h>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Reduces sensor frames to the simulation grid in one pass, flipping them
+ * upside down on the way (sensor rows run top to bottom, grid rows bottom to top).
+ *
+ * Each grid cell covers a box of sensor pixels. Depth is averaged over the box,
+ * user labels are taken from the pixel at its center (averaging IDs would invent
+ * users), and the bounds mask marks every cell whose box has any nonzero depth.
+ * A grid finer than the frame gets boxes of one pixel, shared by neighboring cells.
+ */
+class GridDownsampler
+{
+public:
+	/**
+	 * @param srcWidth, srcHeight    sensor frame size
+	 * @param gridWidth, gridHeight  grid size; a grid with the sensor's aspect ratio
+	 *                               keeps the boxes square
+	 */
+	GridDownsampler(int srcWidth, int srcHeight, int gridWidth, int gridHeight);
+
+	/**
+	 * @param depth   srcHeight x srcWidth CV_8UC1 depth image, 0 where nothing is in range
+	 * @param labels  srcHeight x srcWidth CV_8UC1 user IDs
+	 * @param image   output, gridHeight x gridWidth averaged depth (allocated if needed)
+	 * @param users   output, gridHeight x gridWidth user IDs
+	 * @param bounds  output, gridHeight x gridWidth, 1 where the cell should be a bound, else 0
+	 */
+	void downsample(const Mat& depth, const Mat& labels, Mat& image, Mat& users, Mat& bounds);
+
+	int getWidth();
+	int getHeight();
+	int getGridWidth();
+	int getGridHeight();
+
+protected:
+	int srcWidth_;
+	int srcHeight_;
+	int gridWidth_;
+	int gridHeight_;
+
+	vector<int>      colStart_;   //box of cell column x spans colStart_[x] .. colEnd_[x]-1
+	vector<int>      colEnd_;
+	vector<int>      rowStart_;
+	vector<int>      rowEnd_;
+	vector<int>      colCenter_;  //pixel sampled for labels
+	vector<int>      rowCenter_;
+	vector<unsigned> columnSum_;  //depth summed down the current band of rows
+};
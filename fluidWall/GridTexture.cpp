@@ -0,0 +1,131 @@
+/**
+ * @file      GridTexture.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GridTexture.h"
+
+
+
+GridTexture::GridTexture(void)
+{
+	width_        = 0;
+	height_       = 0;
+	linear_       = false;
+	tex_          = 0;
+	texSizeValid_ = false;
+}
+
+
+
+GridTexture::~GridTexture(void)
+{
+	//the context is usually gone by the time static objects are destroyed,
+	//so the texture is left to the driver
+}
+
+
+
+void GridTexture::resize(int width, int height, bool linear)
+{
+	if (width != width_ || height != height_)
+		texSizeValid_ = false;
+
+	width_  = width;
+	height_ = height;
+	linear_ = linear;
+	pixels_.assign(4 * width * height, 0);
+}
+
+
+
+void GridTexture::upload()
+{
+	if (width_ == 0 || height_ == 0)
+		return;
+
+	if (!tex_) {
+		glGenTextures(1, &tex_);
+		texSizeValid_ = false;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, tex_);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linear_ ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linear_ ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	//allocate once, then only replace the contents
+	if (!texSizeValid_) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels_[0]);
+		texSizeValid_ = true;
+	}
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, &pixels_[0]);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+
+void GridTexture::draw(float x0, float y0, float x1, float y1, float s0, float t0, float s1, float t1)
+{
+	if (!tex_)
+		return;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+	glEnable(GL_TEXTURE_2D);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glBindTexture(GL_TEXTURE_2D, tex_);
+
+	glBegin(GL_QUADS);
+		glTexCoord2f(s0, t0); glVertex2f(x0, y0);
+		glTexCoord2f(s1, t0); glVertex2f(x1, y0);
+		glTexCoord2f(s1, t1); glVertex2f(x1, y1);
+		glTexCoord2f(s0, t1); glVertex2f(x0, y1);
+	glEnd();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPopAttrib();
+}
+
+
+
+void GridTexture::contextChanged()
+{
+	tex_          = 0;
+	texSizeValid_ = false;
+}
+
+
+
+int GridTexture::getWidth()
+{
+	return width_;
+}
+
+
+
+int GridTexture::getHeight()
+{
+	return height_;
+}
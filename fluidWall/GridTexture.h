@@ -0,0 +1,91 @@
+/**
+ * @file      GridTexture.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+#include "GlExtensions.h"
+
+using namespace std;
+
+/**
+ * An RGBA image with one texel per grid cell, filled on the CPU and drawn as a
+ * single textured quad. Replaces drawing one quad per cell: the cost on the GL side
+ * no longer depends on the grid size.
+ *
+ * Texel (i, j) is cell (i, j). Fill pixels with setPixel(), then upload() once per
+ * frame and draw() as often as needed.
+ */
+class GridTexture
+{
+public:
+	GridTexture(void);
+	~GridTexture(void);
+
+	/**
+	 * Sets the image size and clears every texel to transparent black.
+	 * @param width  texels per row
+	 * @param height texel rows
+	 * @param linear true to interpolate between texel centers, false for square cells
+	 */
+	void resize(int width, int height, bool linear);
+
+	/**
+	 * Writes one texel. Colors are clamped to [0, 1].
+	 */
+	inline void setPixel(int i, int j, float r, float g, float b, float a = 1.0f)
+	{
+		unsigned char* p = &pixels_[4 * (i + width_ * j)];
+		p[0] = toByte(r); p[1] = toByte(g); p[2] = toByte(b); p[3] = toByte(a);
+	}
+
+	/**
+	 * Sends the pixels to the texture, creating it on first use. Needs a current context.
+	 */
+	void upload();
+
+	/**
+	 * Draws the texture on the rectangle (x0, y0) - (x1, y1), showing texture
+	 * coordinates (s0, t0) - (s1, t1). Blends with what is already drawn using
+	 * the texel alpha.
+	 */
+	void draw(float x0, float y0, float x1, float y1, float s0, float t0, float s1, float t1);
+
+	/**
+	 * Forgets the texture without deleting it, for when its context is gone.
+	 */
+	void contextChanged();
+
+	int getWidth();
+	int getHeight();
+
+protected:
+	int    width_;
+	int    height_;
+	bool   linear_;
+	GLuint tex_;
+	bool   texSizeValid_; //tex_ has storage of the current size
+	vector<unsigned char> pixels_;
+
+	static inline unsigned char toByte(float c)
+	{
+		return c <= 0.0f ? 0 : c >= 1.0f ? 255 : (unsigned char)(c * 255.0f + 0.5f);
+	}
+};
@@ -0,0 +1,75 @@
+/**
+ * @file      HaloExchange.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+/**
+ * Trades the edge rows of neighboring solver tiles, so several FluidSolvers
+ * side by side behave like one wider grid.
+ *
+ * Each tile sends the outermost row of cells on every side that has a neighbor
+ * and stores what the neighbor sends into its buffer ring, where the solver 
+ * would otherwise mirror its own cells. A message sent on SIDE_RIGHT arrives 
+ * on the neighbor's SIDE_LEFT, and so on.
+ */
+class HaloExchange
+{
+public:
+	enum Side {
+		SIDE_LEFT,
+		SIDE_RIGHT,
+		SIDE_BOTTOM,
+		SIDE_TOP,
+		SIDE_COUNT
+	};
+
+	virtual ~HaloExchange(void) {}
+
+	/**
+	 * Tests whether a tile is connected on a side. A side without a neighbor is a wall.
+	 */
+	virtual bool hasNeighbor(Side side) = 0;
+
+	/**
+	 * Sends send[side] to every neighbor, then waits for each neighbor's message
+	 * and copies it into recv[side]. Sides without a neighbor are skipped.
+	 *
+	 * Neighbors have to make the same calls in the same order. Every message carries
+	 * its size and a tag; a neighbor whose message differs in either is out of step,
+	 * so its link is closed and the side reports no neighbor from then on.
+	 *
+	 * @param send  one buffer per side, bytes[side] long
+	 * @param recv  one buffer per side, bytes[side] long
+	 * @param bytes size of the message on each side; rows and columns of a 
+	 *              rectangular tile differ
+	 * @param tag   call identifier, the same on both tiles of a link
+	 * @return      False if a link was closed by this call.
+	 */
+	virtual bool exchange(const void* const* send, void* const* recv, const int* bytes, int tag) = 0;
+
+	/**
+	 * The side a message sent on side arrives on.
+	 */
+	static Side opposite(Side side)
+	{
+		return (Side)(side ^ 1);
+	}
+};
@@ -0,0 +1,281 @@
+/**
+ * @file      MultigridSolver.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MultigridSolver.h"
+#include <math.h>
+
+#define LX(l,i,j) ((i)+((l).nx+2)*(j))
+
+//smallest grid the hierarchy coarsens down to
+#define MIN_COARSE_N   4
+#define PRE_SWEEPS     2
+#define POST_SWEEPS    2
+#define COARSE_SWEEPS  40
+//grids smaller than this are not worth splitting across threads
+#define PARALLEL_MIN_N 64
+
+
+
+MultigridSolver::MultigridSolver(int width, int height)
+{
+	int nx = width, ny = height;
+	while (true) {
+		Level l;
+		int size = (nx + 2) * (ny + 2);
+		l.nx = nx;
+		l.ny = ny;
+		l.x.assign(size, 0.0f);
+		l.b.assign(size, 0.0f);
+		l.r.assign(size, 0.0f);
+		l.diag.assign(size, 0.0f);
+		l.fluid.assign(size, 0);
+		levels_.push_back(l);
+
+		//cell-centered coarsening needs an even number of cells on both sides
+		if (nx % 2 != 0 || ny % 2 != 0 || nx / 2 < MIN_COARSE_N || ny / 2 < MIN_COARSE_N)
+			break;
+		nx /= 2;
+		ny /= 2;
+	}
+}
+
+
+
+MultigridSolver::~MultigridSolver(void)
+{
+}
+
+
+
+int MultigridSolver::solve(float* p, const float* div, const bool* bounds, int stride,
+						   int maxCycles, float tolerance, float* residual)
+{
+	Level& fine = levels_[0];
+	int nx = fine.nx, ny = fine.ny;
+	int i, j, cycles = 0;
+	int fluidCells = 0;
+	double mean = 0.0, rhs = 0.0;
+
+	buildMasks(bounds, stride);
+
+	for (j = 1; j <= ny; j++)
+		for (i = 1; i <= nx; i++) {
+			int c = LX(fine, i, j);
+			if (fine.fluid[c]) {
+				fine.x[c] = p[i + stride * j];
+				fine.b[c] = div[i + stride * j];
+				mean += fine.b[c];
+				fluidCells++;
+			}
+			else
+				fine.x[c] = fine.b[c] = 0.0f;
+		}
+
+	//with solid walls all around, the system only has a solution if the right hand
+	//side sums to zero. Remove the constant part so the residual can actually converge.
+	if (fluidCells > 0)
+		mean /= fluidCells;
+	for (j = 1; j <= ny; j++)
+		for (i = 1; i <= nx; i++) {
+			int c = LX(fine, i, j);
+			if (fine.fluid[c]) {
+				fine.b[c] -= (float) mean;
+				rhs += fine.b[c] * fine.b[c];
+			}
+		}
+	float rhsNorm = (float) sqrt(rhs / (nx * ny));
+	float res = 0.0f;
+
+	if (rhsNorm > 0.0f) {
+		for (cycles = 0; cycles < maxCycles; ) {
+			vCycle(0);
+			cycles++;
+			res = computeResidual(fine);
+			if (tolerance > 0.0f && res <= tolerance * rhsNorm)
+				break;
+		}
+	}
+	*residual = rhsNorm > 0.0f ? res / rhsNorm : 0.0f;
+
+	for (j = 1; j <= ny; j++)
+		for (i = 1; i <= nx; i++)
+			p[i + stride * j] = fine.x[LX(fine, i, j)];
+
+	return cycles;
+}
+
+
+
+///protected functions
+void MultigridSolver::buildMasks(const bool* bounds, int stride)
+{
+	int i, j;
+	size_t l;
+
+	Level& fine = levels_[0];
+	for (j = 1; j <= fine.ny; j++)
+		for (i = 1; i <= fine.nx; i++)
+			fine.fluid[LX(fine, i, j)] = bounds[i + stride * j] ? 0 : 1;
+
+	for (l = 1; l < levels_.size(); l++) {
+		Level& f = levels_[l - 1];
+		Level& c = levels_[l];
+		for (j = 1; j <= c.ny; j++)
+			for (i = 1; i <= c.nx; i++) {
+				int fi = 2 * i - 1, fj = 2 * j - 1;
+				c.fluid[LX(c, i, j)] = f.fluid[LX(f, fi, fj)]     | f.fluid[LX(f, fi + 1, fj)] |
+									   f.fluid[LX(f, fi, fj + 1)] | f.fluid[LX(f, fi + 1, fj + 1)];
+			}
+	}
+
+	//solid neighbors drop out of the stencil, so the diagonal is the fluid neighbor count
+	for (l = 0; l < levels_.size(); l++) {
+		Level& lv = levels_[l];
+		for (j = 1; j <= lv.ny; j++)
+			for (i = 1; i <= lv.nx; i++) {
+				int c = LX(lv, i, j);
+				lv.diag[c] = lv.fluid[c] ? (float)(lv.fluid[c - 1] + lv.fluid[c + 1] +
+								lv.fluid[c - (lv.nx + 2)] + lv.fluid[c + (lv.nx + 2)]) : 0.0f;
+			}
+	}
+}
+
+
+
+void MultigridSolver::smooth(Level& l, int sweeps)
+{
+	int j, k, color;
+	int nx = l.nx, ny = l.ny, w = l.nx + 2;
+	float* x = &l.x[0];
+	const float* b = &l.b[0];
+	const float* d = &l.diag[0];
+
+	//solid cells hold zero, so summing all four neighbors only picks up fluid ones
+	for (k = 0; k < sweeps; k++)
+		for (color = 0; color < 2; color++) {
+			#pragma omp parallel for schedule(static) if(ny >= PARALLEL_MIN_N)
+			for (j = 1; j <= ny; j++)
+				for (int i = 1 + ((j + color) & 1); i <= nx; i += 2) {
+					int c = i + w * j;
+					if (d[c] > 0.0f)
+						x[c] = (b[c] + x[c - 1] + x[c + 1] + x[c - w] + x[c + w]) / d[c];
+				}
+		}
+}
+
+
+
+float MultigridSolver::computeResidual(Level& l)
+{
+	int j;
+	int nx = l.nx, ny = l.ny, w = l.nx + 2;
+	double sum = 0.0;
+	const float* x = &l.x[0];
+	const float* b = &l.b[0];
+	const float* d = &l.diag[0];
+	float* r = &l.r[0];
+
+	#pragma omp parallel for schedule(static) reduction(+:sum) if(ny >= PARALLEL_MIN_N)
+	for (j = 1; j <= ny; j++)
+		for (int i = 1; i <= nx; i++) {
+			int c = i + w * j;
+			float rc = 0.0f;
+			if (d[c] > 0.0f)
+				rc = b[c] - (d[c] * x[c] - (x[c - 1] + x[c + 1] + x[c - w] + x[c + w]));
+			r[c] = rc;
+			sum += rc * rc;
+		}
+
+	return (float) sqrt(sum / (nx * ny));
+}
+
+
+
+void MultigridSolver::restrictResidual(Level& fine, Level& coarse)
+{
+	int i, j;
+
+	for (j = 1; j <= coarse.ny; j++)
+		for (i = 1; i <= coarse.nx; i++) {
+			int fi = 2 * i - 1, fj = 2 * j - 1;
+			int c  = LX(coarse, i, j);
+			//the stencil is unscaled, so doubling the cell size turns the average
+			//of the four children into their sum
+			coarse.b[c] = coarse.fluid[c] ? fine.r[LX(fine, fi, fj)]     + fine.r[LX(fine, fi + 1, fj)] +
+											fine.r[LX(fine, fi, fj + 1)] + fine.r[LX(fine, fi + 1, fj + 1)] : 0.0f;
+			coarse.x[c] = 0.0f;
+		}
+}
+
+
+
+void MultigridSolver::prolongate(Level& coarse, Level& fine)
+{
+	int j;
+	int nx = fine.nx, ny = fine.ny;
+
+	#pragma omp parallel for schedule(static) if(ny >= PARALLEL_MIN_N)
+	for (j = 1; j <= ny; j++) {
+		int J  = (j + 1) / 2;
+		int dj = (j & 1) ? -1 : 1; //odd fine rows lean on the coarse row below
+
+		for (int i = 1; i <= nx; i++) {
+			int f = LX(fine, i, j);
+			if (!fine.fluid[f])
+				continue;
+
+			int I  = (i + 1) / 2;
+			int di = (i & 1) ? -1 : 1;
+
+			int c00 = LX(coarse, I, J);
+			int c10 = LX(coarse, I + di, J);
+			int c01 = LX(coarse, I, J + dj);
+			int c11 = LX(coarse, I + di, J + dj);
+
+			//solid coarse neighbors carry no correction, substitute the parent value
+			float e00 = coarse.x[c00];
+			float e10 = coarse.fluid[c10] ? coarse.x[c10] : e00;
+			float e01 = coarse.fluid[c01] ? coarse.x[c01] : e00;
+			float e11 = coarse.fluid[c11] ? coarse.x[c11] : e00;
+
+			fine.x[f] += 0.5625f * e00 + 0.1875f * (e10 + e01) + 0.0625f * e11;
+		}
+	}
+}
+
+
+
+void MultigridSolver::vCycle(int l)
+{
+	Level& lv = levels_[l];
+
+	if (l == (int) levels_.size() - 1) {
+		smooth(lv, COARSE_SWEEPS);
+		return;
+	}
+
+	smooth(lv, PRE_SWEEPS);
+	computeResidual(lv);
+	restrictResidual(lv, levels_[l + 1]);
+	vCycle(l + 1);
+	prolongate(levels_[l + 1], lv);
+	smooth(lv, POST_SWEEPS);
+}
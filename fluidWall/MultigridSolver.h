@@ -0,0 +1,112 @@
+/**
+ * @file      MultigridSolver.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+
+using namespace std;
+
+/**
+ * Geometric multigrid solver for the pressure Poisson equation used by
+ * FluidSolver::project().
+ *
+ * Solves 4p - (sum of the four neighbors) = div on a width x height grid of cells. Walls and
+ * obstacle cells are treated as solid: the pressure gradient across a solid face is
+ * zero, so solid neighbors drop out of the stencil. Each V-cycle costs a small constant
+ * times the number of cells, which keeps high resolution grids converged where a fixed
+ * number of Gauss-Seidel sweeps would not be.
+ *
+ * Arrays passed in use the FluidSolver layout: (width+2) x (height+2) cells including
+ * the buffer ring, addressed as i + stride * j.
+ */
+class MultigridSolver
+{
+public:
+	/**
+	 * Parameter constructor. The hierarchy coarsens while both sides are even.
+	 * @param width   Cells per row of the fluid simulation grid
+	 * @param height  Rows of the fluid simulation grid
+	 */
+	MultigridSolver(int width, int height);
+	~MultigridSolver(void);
+
+	/**
+	 * Solves for pressure.
+	 *
+	 * @param p         - pointer to an array receiving the solution, used as the initial guess
+	 * @param div       - pointer to an array containing the divergence (right hand side)
+	 * @param bounds    - pointer to an array of obstacle flags, true = solid
+	 * @param stride    - row stride of p, div and bounds
+	 * @param maxCycles - maximum number of V-cycles to run
+	 * @param tolerance - stop once the residual drops below tolerance * RMS(div).
+	 *                    Zero always runs maxCycles.
+	 * @param residual  - receives the final residual relative to RMS(div)
+	 * @return            Number of V-cycles run
+	 */
+	int solve(float* p, const float* div, const bool* bounds, int stride,
+			  int maxCycles, float tolerance, float* residual);
+
+protected:
+	/**
+	 * One level of the grid hierarchy. Level 0 is the finest.
+	 */
+	struct Level {
+		int nx, ny;                 //interior cells per row and rows
+		vector<float> x;            //solution (pressure or correction)
+		vector<float> b;            //right hand side
+		vector<float> r;            //residual
+		vector<float> diag;         //number of fluid neighbors of each fluid cell
+		vector<unsigned char> fluid;//1 = fluid cell, 0 = solid or buffer cell
+	};
+
+	vector<Level> levels_;
+
+	/**
+	 * Builds the fluid masks of every level. A coarse cell is fluid if any of its
+	 * four children is fluid, so thin channels between obstacles stay connected.
+	 */
+	void buildMasks(const bool* bounds, int stride);
+
+	/**
+	 * Runs red-black Gauss-Seidel sweeps on a level.
+	 */
+	void smooth(Level& l, int sweeps);
+
+	/**
+	 * Computes residual r = b - Ax on a level and returns its RMS.
+	 */
+	float computeResidual(Level& l);
+
+	/**
+	 * Sums the residual of each 2x2 block of fine cells into the coarse right hand side.
+	 */
+	void restrictResidual(Level& fine, Level& coarse);
+
+	/**
+	 * Bilinearly interpolates the coarse correction and adds it to the fine solution.
+	 */
+	void prolongate(Level& coarse, Level& fine);
+
+	/**
+	 * Recursive V-cycle starting at level l.
+	 */
+	void vCycle(int l);
+};
@@ -0,0 +1,108 @@
+/**
+ * @file      PackedFormats.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+
+//upper end of the DENSITY_UNORM16 range of FluidSolverMultiUser: steps of about 
+//1/1000, finer than the 8 bit colors densities end up as, with room for user 0,
+//which gains weight every step
+#define FLUID_UNORM16_RANGE 64.0f
+
+/**
+ * 16 bit storage formats for density grids, converted to and from float one value
+ * at a time. The packed kernels in FluidKernels give bit for bit the same results.
+ */
+union FloatBits {
+	float        f;
+	unsigned int u;
+};
+
+/**
+ * IEEE half floats, rounded to nearest even. Overflow goes to infinity.
+ */
+struct HalfFormat
+{
+	static inline unsigned short encode(float value)
+	{
+		FloatBits f, denormMagic;
+		unsigned int sign, h;
+
+		f.f  = value;
+		sign = f.u & 0x80000000u;
+		f.u ^= sign;
+
+		denormMagic.u = ((127 - 15) + (23 - 10) + 1) << 23;
+		if (f.u >= (127 + 16) << 23)        //too big for a half, or not a number
+			h = f.u > 0x7f800000u ? 0x7e00 : 0x7c00;
+		else if (f.u < (127 - 14) << 23) {  //a half denormal, the FPU does the rounding
+			f.f += denormMagic.f;
+			h = f.u - denormMagic.u;
+		}
+		else {
+			unsigned int odd = (f.u >> 13) & 1;
+			f.u += ((unsigned int)(15 - 127) << 23) + 0xfff + odd;
+			h = f.u >> 13;
+		}
+		return (unsigned short)(h | (sign >> 16));
+	}
+
+	static inline float decode(unsigned short h)
+	{
+		FloatBits f, magic;
+		unsigned int exponent;
+
+		magic.u  = 113 << 23;
+		f.u      = (h & 0x7fffu) << 13;
+		exponent = f.u & (0x7c00u << 13);
+		f.u     += (127 - 15) << 23;
+
+		if (exponent == 0x7c00u << 13)      //infinity or not a number
+			f.u += (128 - 16) << 23;
+		else if (exponent == 0) {           //denormal, renormalized by the FPU
+			f.u += 1 << 23;
+			f.f -= magic.f;
+		}
+		f.u |= (unsigned int)(h & 0x8000u) << 16;
+		return f.f;
+	}
+};
+
+/**
+ * Fixed point over [0, FLUID_UNORM16_RANGE], rounded to nearest. Values outside
+ * are clamped.
+ */
+struct Unorm16Format
+{
+	static inline unsigned short encode(float value)
+	{
+		//clamped with selects rather than branches, densities are noisy near zero
+		float scaled = value * (65535.0f / FLUID_UNORM16_RANGE) + 0.5f;
+		scaled = scaled > 0.0f     ? scaled : 0.0f;
+		scaled = scaled < 65535.0f ? scaled : 65535.0f;
+		return (unsigned short)(int) scaled;
+	}
+
+	static inline float decode(unsigned short x)
+	{
+		return x * (FLUID_UNORM16_RANGE / 65535.0f);
+	}
+};
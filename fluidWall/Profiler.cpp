@@ -0,0 +1,189 @@
+/**
+ * @file      Profiler.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Profiler.h"
+#include "TripleBuffer.h"
+#include <algorithm>
+
+using namespace std;
+
+struct StageInfo {
+	const char*  name;
+	ProfileGroup group;
+};
+
+static const StageInfo STAGES[PROFILE_STAGE_COUNT] = {
+	{ "capture",              PROFILE_GROUP_CAPTURE },
+	{ "capture.kinect",       PROFILE_GROUP_CAPTURE },
+
+	{ "sim.step",             PROFILE_GROUP_SIM },
+	{ "sim.bounds",           PROFILE_GROUP_SIM },
+	{ "sim.opticalFlow",      PROFILE_GROUP_SIM },
+	{ "sim.emitters",         PROFILE_GROUP_SIM },
+	{ "sim.solver",           PROFILE_GROUP_SIM },
+	{ "sim.snapshot",         PROFILE_GROUP_SIM },
+
+	{ "solver.addSource",     PROFILE_GROUP_SIM },
+	{ "solver.diffuse",       PROFILE_GROUP_SIM },
+	{ "solver.advect",        PROFILE_GROUP_SIM },
+	{ "solver.project",       PROFILE_GROUP_SIM },
+	{ "solver.linearSolve",   PROFILE_GROUP_SIM },
+	{ "solver.setBounds",     PROFILE_GROUP_SIM },
+
+	{ "render.frame",         PROFILE_GROUP_RENDER },
+	{ "render.draw",          PROFILE_GROUP_RENDER },
+	{ "render.flow",          PROFILE_GROUP_RENDER },
+};
+
+struct StageHistory {
+	double current;					//total of the frame in progress
+	float  frames[PROFILE_HISTORY];	//ring of finished frames
+	int    next;					//ring slot written next
+	int    count;					//finished frames, up to PROFILE_HISTORY
+};
+
+//owned by the threads of the groups, readers only see the published copies
+static StageHistory history[PROFILE_STAGE_COUNT];
+
+//finished frames of a stage as readers see them, in no particular order
+struct PublishedStage {
+	float frames[PROFILE_HISTORY];
+	int   count;
+};
+
+//one group's stages; the slots of the other groups stay empty
+struct PublishedGroup {
+	PublishedStage stages[PROFILE_STAGE_COUNT];
+
+	PublishedGroup(void)
+	{
+		for (int s = 0; s < PROFILE_STAGE_COUNT; s++)
+			stages[s].count = 0;
+	}
+};
+
+static TripleBuffer<PublishedGroup> published[PROFILE_GROUP_COUNT][PROFILE_READER_COUNT];
+
+
+
+void profileAdd(ProfileStage stage, double ms)
+{
+	history[stage].current += ms;
+}
+
+
+
+void profileEndFrame(ProfileGroup group)
+{
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		if (STAGES[s].group != group)
+			continue;
+
+		StageHistory& h = history[s];
+		h.frames[h.next] = (float) h.current;
+		h.current = 0;
+		h.next    = (h.next + 1) % PROFILE_HISTORY;
+		if (h.count < PROFILE_HISTORY)
+			h.count++;
+	}
+
+	//until the ring wraps the filled slots are [0, count), after that all of them
+	for (int r = 0; r < PROFILE_READER_COUNT; r++) {
+		PublishedGroup& out = published[group][r].writeBuffer();
+		for (int s = 0; s < PROFILE_STAGE_COUNT; s++)
+			if (STAGES[s].group == group) {
+				copy(history[s].frames, history[s].frames + history[s].count, out.stages[s].frames);
+				out.stages[s].count = history[s].count;
+			}
+		published[group][r].publish();
+	}
+}
+
+
+
+void profileReset(ProfileGroup group)
+{
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++)
+		if (STAGES[s].group == group) {
+			history[s].current = 0;
+			history[s].next    = 0;
+			history[s].count   = 0;
+		}
+}
+
+
+
+void profileGetStats(ProfileStage stage, ProfileStats* stats, ProfileReader reader)
+{
+	TripleBuffer<PublishedGroup>& group = published[STAGES[stage].group][reader];
+	group.update();
+
+	const PublishedStage& h = group.readBuffer().stages[stage];
+	float sorted[PROFILE_HISTORY];
+	int   n = h.count;
+
+	stats->frames = n;
+	if (n == 0) {
+		stats->min = stats->avg = stats->p50 = stats->p99 = stats->max = 0.0f;
+		return;
+	}
+
+	double sum = 0;
+	for (int k = 0; k < n; k++) {
+		sorted[k] = h.frames[k];
+		sum += sorted[k];
+	}
+
+	int p99 = (int)(0.99f * (n - 1) + 0.5f);
+	nth_element(sorted, sorted + p99, sorted + n);
+	stats->p99 = sorted[p99];
+	//the median is among the values below the p99 one now
+	int p50 = (n - 1) / 2;
+	nth_element(sorted, sorted + p50, sorted + p99);
+	stats->p50 = sorted[p50];
+	stats->min = *min_element(sorted, sorted + n);
+	stats->max = *max_element(sorted, sorted + n);
+	stats->avg = (float)(sum / n);
+}
+
+
+
+const char* profileStageName(ProfileStage stage)
+{
+	return STAGES[stage].name;
+}
+
+
+
+void profileWriteCsv(FILE* file, double timeSeconds, bool header)
+{
+	ProfileStats stats;
+
+	if (header)
+		fprintf(file, "time,stage,min_ms,avg_ms,p99_ms,max_ms,frames\n");
+
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		profileGetStats((ProfileStage) s, &stats);
+		fprintf(file, "%.1f,%s,%.3f,%.3f,%.3f,%.3f,%d\n", timeSeconds, STAGES[s].name,
+				stats.min, stats.avg, stats.p99, stats.max, stats.frames);
+	}
+	fflush(file);
+}
@@ -0,0 +1,147 @@
+/**
+ * @file      Profiler.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * Per stage frame timing. Code marks a stage with PROFILE_SCOPE; the time spent in
+ * the scope is added to the stage's total for the current frame. Each pipeline
+ * thread ends its frame with profileEndFrame(), which moves the totals of its
+ * stages into a ring of the last PROFILE_HISTORY frames. Stats over that ring
+ * (min / avg / p99 / max) feed the on-screen overlay and the CSV log.
+ *
+ * Stages are recorded by one thread at a time (the one running that part of the
+ * pipeline), so recording takes no locks. Readers on other threads may see a
+ * frame that is being written, which only skews one sample.
+ *
+ * Build with FLUID_PROFILING set to 0 to compile every timer out.
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <stdio.h>
+#include "Threading.h"
+
+#ifndef FLUID_PROFILING
+	#define FLUID_PROFILING 1
+#endif
+
+//frames of history kept per stage
+#define PROFILE_HISTORY 256
+
+//the pipeline thread whose frame a stage belongs to
+enum ProfileGroup {
+	PROFILE_GROUP_CAPTURE,
+	PROFILE_GROUP_SIM,
+	PROFILE_GROUP_RENDER,
+	PROFILE_GROUP_COUNT
+};
+
+//everything that can be timed. Keep in sync with the table in Profiler.cpp.
+enum ProfileStage {
+	PROFILE_CAPTURE,			//loadImage
+	PROFILE_KINECT_UPDATE,		//waiting for and reading the sensor
+
+	PROFILE_SIM_STEP,			//simulateStep
+	PROFILE_SIM_BOUNDS,			//defineBoundsFromImage
+	PROFILE_SIM_OPTICAL_FLOW,	//computeOpticalFlow
+	PROFILE_SIM_EMITTERS,		//emitSplashes and renderEmitters
+	PROFILE_SIM_SOLVER,			//FluidSolver::update
+	PROFILE_SIM_SNAPSHOT,		//publishSnapshot
+
+	PROFILE_SOLVER_ADD_SOURCE,
+	PROFILE_SOLVER_DIFFUSE,
+	PROFILE_SOLVER_ADVECT,
+	PROFILE_SOLVER_PROJECT,
+	PROFILE_SOLVER_LINEAR_SOLVE,	//includes its setBounds calls
+	PROFILE_SOLVER_SET_BOUNDS,
+
+	PROFILE_RENDER_FRAME,		//drawFunction
+	PROFILE_RENDER_DRAW,		//texture fill, upload and draw calls
+	PROFILE_RENDER_FLOW,		//GPU optical flow for the simulation thread
+
+	PROFILE_STAGE_COUNT
+};
+
+//threads that read stats, while the pipeline writes them. Each one has its own copy
+//of the history, handed over through a TripleBuffer, so nobody ever waits.
+enum ProfileReader {
+	PROFILE_READER_DISPLAY,		//the GLUT thread: overlay and log, or fluidBench
+	PROFILE_READER_TELEMETRY,	//TelemetryExporter
+	PROFILE_READER_COUNT
+};
+
+struct ProfileStats {
+	float min, avg, p50, p99, max;	//milliseconds per frame
+	int   frames;				//frames in the history, up to PROFILE_HISTORY
+};
+
+/**
+ * Adds ms to the current frame of a stage. Normally called by ScopedTimer.
+ */
+void profileAdd(ProfileStage stage, double ms);
+
+/**
+ * Ends the current frame for every stage of a group, storing their totals in the
+ * history, even ones that did not run (as 0), and publishes the history to the 
+ * readers. Call once per loop of the group's thread.
+ */
+void profileEndFrame(ProfileGroup group);
+
+/**
+ * Forgets the history of every stage of a group, e.g. between benchmark runs.
+ * Readers see it at the next profileEndFrame(). Call from the group's thread.
+ */
+void profileReset(ProfileGroup group);
+
+/**
+ * Stats over the history of a stage, as of the last profileEndFrame() of its group.
+ * Safe from any thread, as long as each reader is used by one thread only.
+ */
+void profileGetStats(ProfileStage stage, ProfileStats* stats, ProfileReader reader = PROFILE_READER_DISPLAY);
+
+/**
+ * Short name of a stage, e.g. "solver.advect".
+ */
+const char* profileStageName(ProfileStage stage);
+
+/**
+ * Writes one line per stage: time (s), stage, min, avg, p99, max, frames.
+ * @param header true to write the column names first
+ */
+void profileWriteCsv(FILE* file, double timeSeconds, bool header);
+
+/**
+ * Times the enclosing scope into a stage.
+ */
+class ScopedTimer
+{
+public:
+	ScopedTimer(ProfileStage stage) : stage_(stage), start_(timeMs()) {}
+	~ScopedTimer() { profileAdd(stage_, timeMs() - start_); }
+
+protected:
+	ProfileStage stage_;
+	double       start_;
+};
+
+#if FLUID_PROFILING
+	#define PROFILE_CONCAT_(a, b) a##b
+	#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+	#define PROFILE_SCOPE(stage)  ScopedTimer PROFILE_CONCAT(scopedTimer_, __LINE__)(stage)
+#else
+	#define PROFILE_SCOPE(stage)
+#endif
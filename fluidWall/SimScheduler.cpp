@@ -0,0 +1,151 @@
+/**
+ * @file      SimScheduler.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SimScheduler.h"
+#include "Threading.h"
+#include <math.h>
+
+//weight of the newest substep in the running average cost
+static const double COST_SMOOTHING = 0.2;
+
+
+
+SimScheduler::SimScheduler(float stepDt, double stepMs, double budgetMs)
+{
+	stepDt_        = stepDt;
+	stepMs_        = stepMs;
+	budgetMs_      = budgetMs;
+	cflLimit_      = 5.0f;
+	maxSubsteps_   = 4;
+	minIterations_ = 4;
+	maxIterations_ = 20;
+
+	solver_    = NULL;
+	lastTime_  = 0;
+	substepMs_ = 0;
+	stepTime_  = stepDt;
+	substeps_  = 0;
+}
+
+
+
+void SimScheduler::setCflLimit(float cells)
+{
+	cflLimit_ = cells > 0.0f ? cells : 1.0f;
+}
+
+
+
+void SimScheduler::setMaxSubsteps(int substeps)
+{
+	maxSubsteps_ = substeps > 0 ? substeps : 1;
+}
+
+
+
+void SimScheduler::setIterationRange(int minIterations, int maxIterations)
+{
+	minIterations_ = minIterations > 0 ? minIterations : 1;
+	maxIterations_ = maxIterations > minIterations_ ? maxIterations : minIterations_;
+}
+
+
+
+int SimScheduler::step(FluidSolver* solver, double spentMs)
+{
+	double now     = timeMs();
+	double elapsed = lastTime_ > 0 ? now - lastTime_ : stepMs_;
+	if (elapsed > MAX_CATCH_UP * stepMs_)
+		elapsed = MAX_CATCH_UP * stepMs_;
+	lastTime_ = now;
+
+	if (solver != solver_) {
+		solver_    = solver;
+		substepMs_ = 0;
+	}
+
+	float time = (float)(stepDt_ * elapsed / stepMs_);
+	int   n    = solver->getWidth() > solver->getHeight() ? solver->getWidth() : solver->getHeight();
+
+	//as many substeps as the CFL limit asks for...
+	int substeps = (int)ceil(time * n * solver->getMaxSpeed() / cflLimit_);
+	if (substeps < 1)            substeps = 1;
+	if (substeps > maxSubsteps_) substeps = maxSubsteps_;
+
+	//...and the budget has room for
+	if (substepMs_ > 0) {
+		int room = (int)((budgetMs_ - spentMs) / substepMs_);
+		if (substeps > room)
+			substeps = room > 1 ? room : 1;
+	}
+
+	float  dt    = time / substeps;
+	double start = timeMs();
+	for (int k = 0; k < substeps; k++) {
+		solver->setTimestep(dt, k == 0 ? time : dt);
+		solver->update();
+	}
+	double updateMs = timeMs() - start;
+	solver->setTimestep(time);
+
+	double cost = updateMs / substeps;
+	substepMs_  = substepMs_ > 0 ? substepMs_ + COST_SMOOTHING * (cost - substepMs_) : cost;
+	stepTime_   = time;
+	substeps_   = substeps;
+
+	//sweeps go only once substeps cannot make room; they come back with headroom
+	int    iters = solver->getMaxIterations();
+	double total = spentMs + updateMs;
+	if (substeps == 1 && total > budgetMs_ && iters > minIterations_)
+		solver->setMaxIterations(iters - 2 > minIterations_ ? iters - 2 : minIterations_);
+	else if (total < budgetMs_ * 3 / 4 && iters < maxIterations_)
+		solver->setMaxIterations(iters + 1);
+
+	return substeps;
+}
+
+
+
+void SimScheduler::restart()
+{
+	lastTime_ = 0;
+}
+
+
+
+float SimScheduler::getStepTime()
+{
+	return stepTime_;
+}
+
+
+
+int SimScheduler::getSubsteps()
+{
+	return substeps_;
+}
+
+
+
+double SimScheduler::getSubstepMs()
+{
+	return substepMs_;
+}
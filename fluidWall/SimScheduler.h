@@ -0,0 +1,110 @@
+/**
+ * @file      SimScheduler.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "FluidSolver.h"
+
+/**
+ * Advances a FluidSolver by the wall clock time that passed since the last step,
+ * instead of by one fixed timestep per step, so the fluid moves at the same speed
+ * whether steps run on time or late.
+ *
+ * Each step is split into the fewest substeps that keep the fluid from moving more
+ * than the CFL limit of cells per substep, at the speed the solver measured on its
+ * last update (FluidSolverGPU measures none, it always takes one substep). The 
+ * substeps then have to fit in the frame budget: the cost of one substep is tracked
+ * as a running average, and when the budget cannot hold all of them the step takes
+ * fewer, longer substeps (semi-Lagrangian advection stays stable, it only gets less
+ * accurate). When even one substep goes over the budget the solver loses relaxation
+ * sweeps, and gets them back slowly once there is headroom again.
+ *
+ * Sources added before step() are scaled by the whole step's time and go in with the
+ * first substep. Between steps the solver's timestep is the last step's, so sources
+ * scaled when they are added (like the multi user densities) match the step rate.
+ */
+class SimScheduler
+{
+public:
+	/**
+	 * @param stepDt    simulated time of one step that takes stepMs
+	 * @param stepMs    nominal wall clock time between steps, in milliseconds
+	 * @param budgetMs  time a whole simulation step may take, in milliseconds
+	 */
+	SimScheduler(float stepDt, double stepMs, double budgetMs);
+
+	/**
+	 * Sets the largest number of cells the fluid should move in one substep.
+	 * @param cells  CFL limit, greater than 0
+	 */
+	void setCflLimit(float cells);
+
+	/**
+	 * Sets the most substeps one step may be split into.
+	 */
+	void setMaxSubsteps(int substeps);
+
+	/**
+	 * Sets the range the solver's maximum sweep count is adapted in.
+	 */
+	void setIterationRange(int minIterations, int maxIterations);
+
+	/**
+	 * Advances the solver by the time since the last call, at most MAX_CATCH_UP
+	 * nominal steps; longer pauses slow the fluid down rather than letting it jump.
+	 * The first call, and the first after restart(), advances one nominal step.
+	 *
+	 * @param solver   solver to update; switching solvers restarts the cost estimate
+	 * @param spentMs  time this step already spent before the update, e.g. on input
+	 * @return number of substeps run
+	 */
+	int step(FluidSolver* solver, double spentMs);
+
+	/**
+	 * Makes the next step advance one nominal step, e.g. after the fields were cleared
+	 * or the simulation was paused.
+	 */
+	void restart();
+
+	/**
+	 * Accessors: the last step's simulated time, substeps, and cost of one substep in 
+	 * milliseconds.
+	 */
+	float  getStepTime();
+	int    getSubsteps();
+	double getSubstepMs();
+
+	static const int MAX_CATCH_UP = 4;
+
+private:
+	float  stepDt_;
+	double stepMs_;
+	double budgetMs_;
+	float  cflLimit_;
+	int    maxSubsteps_;
+	int    minIterations_;
+	int    maxIterations_;
+
+	FluidSolver* solver_;   //solver of the last step, its cost is the one tracked
+	double lastTime_;       //timeMs() of the last step, 0 after restart()
+	double substepMs_;      //running average cost of one substep, 0 before the first
+	float  stepTime_;
+	int    substeps_;
+};
@@ -0,0 +1,373 @@
+/**
+ * @file      SocketHaloExchange.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SocketHaloExchange.h"
+#include "Threading.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+
+	typedef SOCKET SocketHandle;
+	typedef int    SocketLength;
+	#define closeSocket closesocket
+	#define SHUT_RDWR   SD_BOTH
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <sys/select.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <arpa/inet.h>
+	#include <netdb.h>
+	#include <unistd.h>
+
+	typedef int       SocketHandle;
+	typedef socklen_t SocketLength;
+	#define closeSocket ::close
+	#define INVALID_SOCKET (-1)
+#endif
+
+//bytes in front of every message: payload size and tag, in network order
+#define MESSAGE_HEADER_BYTES 8
+//socket buffers hold a whole message of every side, so a send never waits for the
+//neighbor to start receiving
+#define SOCKET_BUFFER_BYTES  (256 * 1024)
+//pause between attempts to reach a neighbor that is not listening yet
+#define CONNECT_RETRY_MS     250
+//a neighbor that sends nothing for this long has hung, its side becomes a wall
+#define LINK_TIMEOUT_MS      2000
+
+//a neighbor that disconnects must not kill the process with SIGPIPE
+#if defined(MSG_NOSIGNAL)
+	#define SEND_FLAGS MSG_NOSIGNAL
+#else
+	#define SEND_FLAGS 0
+#endif
+
+
+
+static bool sendAll(SocketHandle s, const char* data, int bytes)
+{
+	while (bytes > 0) {
+		int sent = send(s, data, bytes, SEND_FLAGS);
+		if (sent <= 0)
+			return false;
+		data  += sent;
+		bytes -= sent;
+	}
+	return true;
+}
+
+
+
+static bool receiveAll(SocketHandle s, char* data, int bytes)
+{
+	while (bytes > 0) {
+		int received = recv(s, data, bytes, 0);
+		if (received <= 0)
+			return false;
+		data  += received;
+		bytes -= received;
+	}
+	return true;
+}
+
+
+
+/**
+ * Sets up a connected socket for small messages sent back and forth. Sends and
+ * receives give up after LINK_TIMEOUT_MS, so a hung neighbor cannot block a step.
+ */
+static void configureSocket(SocketHandle s)
+{
+	int on = 1, size = SOCKET_BUFFER_BYTES;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+	setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&size, sizeof(size));
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+#if defined(SO_NOSIGPIPE)
+	setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&on, sizeof(on));
+#endif
+
+#if defined(_WIN32)
+	DWORD timeout = LINK_TIMEOUT_MS;
+#else
+	timeval timeout;
+	timeout.tv_sec  = LINK_TIMEOUT_MS / 1000;
+	timeout.tv_usec = (LINK_TIMEOUT_MS % 1000) * 1000;
+#endif
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+
+
+static SocketHandle openListener(int port)
+{
+	SocketHandle s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	int on = 1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family      = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port        = htons((unsigned short)port);
+
+	if (bind(s, (sockaddr*)&address, sizeof(address)) != 0 || listen(s, 1) != 0) {
+		closeSocket(s);
+		return INVALID_SOCKET;
+	}
+	return s;
+}
+
+
+
+static SocketHandle connectOnce(const char* host, int port)
+{
+	char service[16];
+	addrinfo hints, *found = NULL;
+	SocketHandle s = INVALID_SOCKET;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	sprintf(service, "%d", port);
+	if (getaddrinfo(host, service, &hints, &found) != 0)
+		return INVALID_SOCKET;
+
+	for (addrinfo* a = found; a && s == INVALID_SOCKET; a = a->ai_next) {
+		s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (s != INVALID_SOCKET && connect(s, a->ai_addr, (SocketLength)a->ai_addrlen) != 0) {
+			closeSocket(s);
+			s = INVALID_SOCKET;
+		}
+	}
+	freeaddrinfo(found);
+	return s;
+}
+
+
+
+SocketHaloExchange::SocketHaloExchange(void)
+{
+#if defined(_WIN32)
+	WSADATA data;
+	WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+
+	for (int s = 0; s < SIDE_COUNT; s++) {
+		links_[s].mode     = LINK_NONE;
+		links_[s].port     = 0;
+		links_[s].socket   = -1;
+		links_[s].listener = -1;
+	}
+}
+
+
+
+SocketHaloExchange::~SocketHaloExchange(void)
+{
+	close();
+
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+}
+
+
+
+void SocketHaloExchange::listenOn(Side side, int port)
+{
+	closeLink(side);
+	links_[side].mode = LINK_LISTEN;
+	links_[side].host.clear();
+	links_[side].port = port;
+}
+
+
+
+void SocketHaloExchange::connectTo(Side side, const char* host, int port)
+{
+	closeLink(side);
+	links_[side].mode = LINK_CONNECT;
+	links_[side].host = host;
+	links_[side].port = port;
+}
+
+
+
+bool SocketHaloExchange::open(int timeoutMs)
+{
+	int s;
+	bool ok = true;
+	double deadline = timeMs() + timeoutMs;
+
+	for (s = 0; s < SIDE_COUNT; s++)
+		if (links_[s].mode == LINK_LISTEN && links_[s].socket == -1 && links_[s].listener == -1) {
+			SocketHandle listener = openListener(links_[s].port);
+			if (listener == INVALID_SOCKET)
+				printf("Halo: cannot listen on port %d\n", links_[s].port);
+			links_[s].listener = listener == INVALID_SOCKET ? -1 : (long long)listener;
+		}
+
+	//connections complete as soon as the neighbor listens, accepted or not
+	for (s = 0; s < SIDE_COUNT; s++) {
+		if (links_[s].mode != LINK_CONNECT || links_[s].socket != -1)
+			continue;
+
+		SocketHandle c = connectOnce(links_[s].host.c_str(), links_[s].port);
+		while (c == INVALID_SOCKET && timeMs() < deadline) {
+			sleepMs(CONNECT_RETRY_MS);
+			c = connectOnce(links_[s].host.c_str(), links_[s].port);
+		}
+		if (c == INVALID_SOCKET)
+			printf("Halo: cannot reach %s:%d\n", links_[s].host.c_str(), links_[s].port);
+		else
+			configureSocket(c);
+		links_[s].socket = c == INVALID_SOCKET ? -1 : (long long)c;
+	}
+
+	for (s = 0; s < SIDE_COUNT; s++) {
+		if (links_[s].listener == -1)
+			continue;
+
+		SocketHandle listener = (SocketHandle)links_[s].listener;
+		double remaining = deadline - timeMs();
+		timeval wait;
+		wait.tv_sec  = remaining > 0 ? (long)(remaining / 1000) : 0;
+		wait.tv_usec = remaining > 0 ? (long)(remaining - 1000.0 * wait.tv_sec) * 1000 : 0;
+
+		fd_set ready;
+		FD_ZERO(&ready);
+		FD_SET(listener, &ready);
+
+		SocketHandle c = INVALID_SOCKET;
+		if (select((int)listener + 1, &ready, NULL, NULL, &wait) > 0)
+			c = accept(listener, NULL, NULL);
+		if (c == INVALID_SOCKET)
+			printf("Halo: no neighbor connected on port %d\n", links_[s].port);
+		else
+			configureSocket(c);
+
+		closeSocket(listener);
+		links_[s].listener = -1;
+		links_[s].socket   = c == INVALID_SOCKET ? -1 : (long long)c;
+	}
+
+	for (s = 0; s < SIDE_COUNT; s++)
+		ok = ok && (links_[s].mode == LINK_NONE || links_[s].socket != -1);
+	return ok;
+}
+
+
+
+void SocketHaloExchange::close()
+{
+	for (int s = 0; s < SIDE_COUNT; s++)
+		closeLink((Side)s);
+}
+
+
+
+void SocketHaloExchange::interrupt()
+{
+	//shutdown() leaves the handles valid, so the thread in exchange() can still close them
+	for (int s = 0; s < SIDE_COUNT; s++)
+		if (links_[s].socket != -1)
+			shutdown((SocketHandle)links_[s].socket, SHUT_RDWR);
+}
+
+
+
+void SocketHaloExchange::closeLink(Side side)
+{
+	if (links_[side].socket != -1)
+		closeSocket((SocketHandle)links_[side].socket);
+	if (links_[side].listener != -1)
+		closeSocket((SocketHandle)links_[side].listener);
+	links_[side].socket   = -1;
+	links_[side].listener = -1;
+}
+
+
+
+bool SocketHaloExchange::hasNeighbor(Side side)
+{
+	return links_[side].socket != -1;
+}
+
+
+
+bool SocketHaloExchange::exchange(const void* const* send, void* const* recv, const int* bytes, int tag)
+{
+	int s;
+	bool ok = true;
+	unsigned int header[2];
+
+	header[1] = htonl((unsigned int)tag);
+
+	//all sends first: the socket buffers hold them, and every neighbor does the same
+	for (s = 0; s < SIDE_COUNT; s++) {
+		if (links_[s].socket == -1) continue;
+
+		header[0] = htonl((unsigned int)bytes[s]);
+		message_.resize(MESSAGE_HEADER_BYTES + bytes[s]);
+		memcpy(&message_[0], header, MESSAGE_HEADER_BYTES);
+		memcpy(&message_[MESSAGE_HEADER_BYTES], send[s], bytes[s]);
+		if (!sendAll((SocketHandle)links_[s].socket, &message_[0], (int)message_.size())) {
+			printf("Halo: lost the neighbor on side %d\n", s);
+			closeLink((Side)s);
+			ok = false;
+		}
+	}
+
+	for (s = 0; s < SIDE_COUNT; s++) {
+		if (links_[s].socket == -1) continue;
+
+		unsigned int received[2];
+		SocketHandle c = (SocketHandle)links_[s].socket;
+		bool linked = receiveAll(c, (char*)received, MESSAGE_HEADER_BYTES);
+
+		if (!linked)
+			printf("Halo: lost the neighbor on side %d\n", s);
+		else if (received[0] != htonl((unsigned int)bytes[s]) || received[1] != header[1]) {
+			printf("Halo: the neighbor on side %d is out of step\n", s);
+			linked = false;
+		}
+		else if (!receiveAll(c, (char*)recv[s], bytes[s])) {
+			printf("Halo: lost the neighbor on side %d\n", s);
+			linked = false;
+		}
+		if (!linked) {
+			closeLink((Side)s);
+			ok = false;
+		}
+	}
+
+	return ok;
+}
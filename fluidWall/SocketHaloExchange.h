@@ -0,0 +1,102 @@
+/**
+ * @file      SocketHaloExchange.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "HaloExchange.h"
+#include <string>
+#include <vector>
+
+/**
+ * Halo exchange between processes, usually one per PC of the wall, over one TCP
+ * connection per neighbor. 
+ *
+ * Each link has one listening end and one connecting end; a simple rule is that
+ * every process listens for its right and top neighbors and connects to its left
+ * and bottom ones. Messages are the raw cells, so every tile has to run on a
+ * machine of the same byte order.
+ */
+class SocketHaloExchange : public HaloExchange
+{
+public:
+	SocketHaloExchange(void);
+	~SocketHaloExchange(void);
+
+	/**
+	 * The neighbor on side connects to this process on port.
+	 */
+	void listenOn(Side side, int port);
+
+	/**
+	 * This process connects to the neighbor on side at host:port.
+	 */
+	void connectTo(Side side, const char* host, int port);
+
+	/**
+	 * Establishes the links set up above. Every listening socket opens before the
+	 * first connection attempt, so processes that wait on each other in a chain 
+	 * still get connected. A link that is not up after timeoutMs stays a wall.
+	 *
+	 * @param timeoutMs  how long to keep trying, in milliseconds
+	 * @return           False if any link could not be established.
+	 */
+	bool open(int timeoutMs);
+
+	/**
+	 * Closes every link. Neighbors see their side turn into a wall.
+	 */
+	void close();
+
+	/**
+	 * Wakes a thread waiting in exchange(), which then closes the links. Unlike
+	 * close() this can be called from any thread.
+	 */
+	void interrupt();
+
+	bool hasNeighbor(Side side);
+	bool exchange(const void* const* send, void* const* recv, const int* bytes, int tag);
+
+protected:
+	enum LinkMode {
+		LINK_NONE,
+		LINK_LISTEN,
+		LINK_CONNECT
+	};
+
+	struct Link {
+		LinkMode    mode;
+		std::string host;
+		int         port;
+		long long   socket;     //SOCKET on Windows, a file descriptor elsewhere, -1 while closed
+		long long   listener;
+	};
+
+	Link              links_[SIDE_COUNT];
+	std::vector<char> message_;    //header and cells of the message being sent
+
+	/**
+	 * Closes the connection of a side, if any. The side becomes a wall.
+	 */
+	void closeLink(Side side);
+
+private:
+	SocketHaloExchange(const SocketHaloExchange&);
+	SocketHaloExchange& operator=(const SocketHaloExchange&);
+};
@@ -0,0 +1,316 @@
+/**
+ * @file      Telemetry.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Telemetry.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+
+	typedef SOCKET SocketHandle;
+	typedef int    SocketLength;
+	#define closeSocket closesocket
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <netdb.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+
+	typedef int       SocketHandle;
+	typedef socklen_t SocketLength;
+	#define closeSocket ::close
+	#define INVALID_SOCKET (-1)
+#endif
+
+using namespace std;
+
+//payload that fits one Ethernet frame, the size StatsD suggests for a local network
+#define DATAGRAM_BYTES 1432
+//longest wait before the reporting thread sees a close()
+#define POLL_MS        100
+
+static const char* COUNTER_NAMES[TELEMETRY_COUNTER_COUNT] = {
+	"kinect.restarts",
+	"kinect.resets",
+	"kinect.failedUpdates",
+};
+
+static const char* GAUGE_NAMES[TELEMETRY_GAUGE_COUNT] = {
+	"kinect.users",
+	"sim.emitterCount",	//not sim.emitters, that is a stage
+	"solver.iterations",
+	"solver.residual",
+};
+
+static volatile long counters[TELEMETRY_COUNTER_COUNT];
+static volatile long gauges[TELEMETRY_GAUGE_COUNT];	//bits of a float, negative while unknown
+
+
+
+void telemetryCount(TelemetryCounter counter, long delta)
+{
+	atomicAdd(&counters[counter], delta);
+}
+
+
+
+void telemetrySet(TelemetryGauge gauge, float value)
+{
+	long bits = 0;
+	memcpy(&bits, &value, sizeof(value));
+	atomicExchange(&gauges[gauge], bits);
+}
+
+
+
+void telemetryClear(TelemetryGauge gauge)
+{
+	telemetrySet(gauge, -1.0f);
+}
+
+
+
+long telemetryTakeCount(TelemetryCounter counter)
+{
+	return atomicExchange(&counters[counter], 0);
+}
+
+
+
+float telemetryGetGauge(TelemetryGauge gauge)
+{
+	long  bits = atomicAdd(&gauges[gauge], 0);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+
+const char* telemetryCounterName(TelemetryCounter counter)
+{
+	return COUNTER_NAMES[counter];
+}
+
+
+
+const char* telemetryGaugeName(TelemetryGauge gauge)
+{
+	return GAUGE_NAMES[gauge];
+}
+
+
+
+TelemetryExporter::TelemetryExporter(void)
+{
+	running_    = 0;
+	socket_     = -1;
+	intervalMs_ = 0;
+	dropped_    = 0;
+}
+
+
+
+TelemetryExporter::~TelemetryExporter(void)
+{
+	close();
+}
+
+
+
+bool TelemetryExporter::open(const char* host, int port, const char* prefix, int intervalMs)
+{
+	char service[16], machine[64];
+	addrinfo hints, *found = NULL;
+	SocketHandle s = INVALID_SOCKET;
+
+	if (isOpen())
+		return false;
+
+#if defined(_WIN32)
+	WSADATA data;
+	WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	sprintf(service, "%d", port);
+	if (getaddrinfo(host, service, &hints, &found) == 0) {
+		//a connected datagram socket, so send() needs no address
+		for (addrinfo* a = found; a && s == INVALID_SOCKET; a = a->ai_next) {
+			s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+			if (s != INVALID_SOCKET && connect(s, a->ai_addr, (SocketLength)a->ai_addrlen) != 0) {
+				closeSocket(s);
+				s = INVALID_SOCKET;
+			}
+		}
+		freeaddrinfo(found);
+	}
+	if (s == INVALID_SOCKET) {
+#if defined(_WIN32)
+		WSACleanup();
+#endif
+		return false;
+	}
+
+#if defined(_WIN32)
+	u_long on = 1;
+	ioctlsocket(s, FIONBIO, &on);
+#else
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+	//dots would split the machine name into levels of the metric tree
+	if (gethostname(machine, sizeof(machine)) != 0)
+		strcpy(machine, "unknown");
+	machine[sizeof(machine) - 1] = 0;
+	for (char* c = machine; *c; c++)
+		if (*c == '.' || *c == ':' || *c == '|' || *c == ' ')
+			*c = '_';
+
+	socket_     = (long long)s;
+	prefix_     = string(prefix) + "." + machine + ".";
+	intervalMs_ = intervalMs > POLL_MS ? intervalMs : POLL_MS;
+	dropped_    = 0;
+	atomicExchange(&running_, 1);
+	if (!thread_.start(run, this)) {
+		atomicExchange(&running_, 0);
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+
+void TelemetryExporter::close()
+{
+	if (socket_ == -1)
+		return;
+
+	atomicExchange(&running_, 0);
+	thread_.join();
+	closeSocket((SocketHandle)socket_);
+	socket_ = -1;
+
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+}
+
+
+
+bool TelemetryExporter::isOpen()
+{
+	return socket_ != -1;
+}
+
+
+
+void TelemetryExporter::run(void* self)
+{
+	TelemetryExporter* e = (TelemetryExporter*) self;
+	double nextReport = timeMs() + e->intervalMs_;
+
+	while (e->running_) {
+		sleepMs(POLL_MS);
+		if (timeMs() >= nextReport) {
+			nextReport += e->intervalMs_;
+			e->report();
+		}
+	}
+	e->report();
+}
+
+
+
+void TelemetryExporter::report()
+{
+	char line[160];
+	ProfileStats stats;
+
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		profileGetStats((ProfileStage) s, &stats, PROFILE_READER_TELEMETRY);
+		if (stats.frames == 0)
+			continue;
+		const char* name = profileStageName((ProfileStage) s);
+		sprintf(line, "%s%s.p50:%.3f|g", prefix_.c_str(), name, stats.p50);
+		addLine(line);
+		sprintf(line, "%s%s.p99:%.3f|g", prefix_.c_str(), name, stats.p99);
+		addLine(line);
+		sprintf(line, "%s%s.max:%.3f|g", prefix_.c_str(), name, stats.max);
+		addLine(line);
+	}
+
+	for (int g = 0; g < TELEMETRY_GAUGE_COUNT; g++) {
+		float value = telemetryGetGauge((TelemetryGauge) g);
+		if (value < 0)
+			continue;
+		sprintf(line, "%s%s:%g|g", prefix_.c_str(), GAUGE_NAMES[g], value);
+		addLine(line);
+	}
+
+	//zero counts too, so a quiet sensor shows up as 0 instead of missing data
+	for (int c = 0; c < TELEMETRY_COUNTER_COUNT; c++) {
+		sprintf(line, "%s%s:%ld|c", prefix_.c_str(), COUNTER_NAMES[c], telemetryTakeCount((TelemetryCounter) c));
+		addLine(line);
+	}
+
+	if (dropped_ > 0) {
+		sprintf(line, "%stelemetry.dropped:%d|c", prefix_.c_str(), dropped_);
+		dropped_ = 0;
+		addLine(line);
+	}
+	flush();
+}
+
+
+
+void TelemetryExporter::addLine(const char* line)
+{
+	int length = (int)strlen(line);
+	if (!datagram_.empty() && (int)datagram_.size() + 1 + length > DATAGRAM_BYTES)
+		flush();
+
+	if (!datagram_.empty())
+		datagram_ += '\n';
+	datagram_ += line;
+}
+
+
+
+void TelemetryExporter::flush()
+{
+	if (datagram_.empty())
+		return;
+
+	int sent = send((SocketHandle)socket_, datagram_.c_str(), (int)datagram_.size(), 0);
+	if (sent != (int)datagram_.size())
+		dropped_++;
+	datagram_.clear();
+}
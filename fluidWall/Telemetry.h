@@ -0,0 +1,130 @@
+/**
+ * @file      Telemetry.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <string>
+#include "Threading.h"
+
+//counters add up events between two reports
+enum TelemetryCounter {
+	TELEMETRY_KINECT_RESTARTS,			//user tracking restarted, see KinectController
+	TELEMETRY_KINECT_RESETS,			//whole sensor reset
+	TELEMETRY_KINECT_FAILED_UPDATES,	//WaitOneUpdateAll without a frame
+	TELEMETRY_COUNTER_COUNT
+};
+
+//gauges keep the last value set. Keep both in sync with the tables in Telemetry.cpp.
+enum TelemetryGauge {
+	TELEMETRY_TRACKED_USERS,
+	TELEMETRY_EMITTERS,
+	TELEMETRY_SOLVER_ITERATIONS,		//sweeps of every linear solve of the last update
+	TELEMETRY_SOLVER_RESIDUAL,			//largest relative residual of the last update
+	TELEMETRY_GAUGE_COUNT
+};
+
+/**
+ * Adds delta to a counter. Lock free, so any thread can count without waiting.
+ */
+void telemetryCount(TelemetryCounter counter, long delta = 1);
+
+/**
+ * Sets a gauge. Lock free, so any thread can set one without waiting. Gauges are 
+ * never negative, StatsD would read the sign as a change of the last value.
+ */
+void telemetrySet(TelemetryGauge gauge, float value);
+
+/**
+ * Marks a gauge as unknown, so reports leave it out instead of showing a made up
+ * value.
+ */
+void telemetryClear(TelemetryGauge gauge);
+
+/**
+ * Returns a counter and starts it over from zero.
+ */
+long telemetryTakeCount(TelemetryCounter counter);
+
+/**
+ * Last value of a gauge.
+ */
+float telemetryGetGauge(TelemetryGauge gauge);
+
+/**
+ * Metric names, e.g. "kinect.restarts".
+ */
+const char* telemetryCounterName(TelemetryCounter counter);
+const char* telemetryGaugeName(TelemetryGauge gauge);
+
+/**
+ * Reports the counters, gauges and profiler stage timings to a StatsD server over 
+ * UDP, from a thread of its own.
+ *
+ * Every interval the exporter sends the p50, p99 and max of each ProfileStage over
+ * its history as gauges, e.g. prefix.host.render.frame.p99, along with the telemetry
+ * gauges and the counts since the last report. Metric names carry the name of the 
+ * machine, so a fleet of walls can report to one server. The socket never blocks:
+ * a report that does not go out right away is dropped, and nothing else waits on
+ * the exporter.
+ */
+class TelemetryExporter
+{
+public:
+	TelemetryExporter(void);
+	~TelemetryExporter(void);
+
+	/**
+	 * Starts reporting to host:port.
+	 * @param prefix      first part of every metric name
+	 * @param intervalMs  time between two reports, in milliseconds
+	 * @return            False if the address cannot be resolved or the socket fails.
+	 */
+	bool open(const char* host, int port, const char* prefix, int intervalMs);
+
+	/**
+	 * Sends a last report and stops the reporting thread.
+	 */
+	void close();
+
+	bool isOpen();
+
+protected:
+	static void run(void* self);
+
+	/**
+	 * Sends one report, in as many datagrams as it takes.
+	 */
+	void report();
+
+	/**
+	 * Appends one metric line to the pending datagram, sending it first when the
+	 * line does not fit anymore.
+	 */
+	void addLine(const char* line);
+	void flush();
+
+	Thread        thread_;
+	volatile long running_;
+	long long     socket_;		//SOCKET on Windows, a file descriptor elsewhere, -1 while closed
+	std::string   prefix_;		//prefix.host
+	int           intervalMs_;
+	std::string   datagram_;	//metric lines not sent yet
+	int           dropped_;		//datagrams the socket refused
+};
@@ -0,0 +1,171 @@
+/**
+ * @file      Threading.cpp
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Threading.h"
+#include <stddef.h>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <process.h>
+#else
+	#include <pthread.h>
+	#include <time.h>
+	#include <unistd.h>
+#endif
+
+
+
+#if defined(_WIN32)
+
+long atomicExchange(volatile long* target, long value)
+{
+	return InterlockedExchange(target, value);
+}
+
+long atomicAdd(volatile long* target, long delta)
+{
+	return InterlockedExchangeAdd(target, delta);
+}
+
+void sleepMs(int ms)
+{
+	Sleep(ms);
+}
+
+double timeMs()
+{
+	static LARGE_INTEGER frequency = {0};
+	LARGE_INTEGER now;
+
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return 1000.0 * (double) now.QuadPart / (double) frequency.QuadPart;
+}
+
+#else
+
+long atomicExchange(volatile long* target, long value)
+{
+	//__sync_lock_test_and_set is only an acquire barrier, add the release half
+	__sync_synchronize();
+	return __sync_lock_test_and_set(target, value);
+}
+
+long atomicAdd(volatile long* target, long delta)
+{
+	return __sync_fetch_and_add(target, delta);
+}
+
+void sleepMs(int ms)
+{
+	usleep(ms * 1000);
+}
+
+double timeMs()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return 1000.0 * now.tv_sec + now.tv_nsec / 1000000.0;
+}
+
+#endif
+
+
+
+Thread::Thread(void)
+{
+	function_ = NULL;
+	arg_      = NULL;
+	handle_   = NULL;
+	running_  = false;
+}
+
+
+
+Thread::~Thread(void)
+{
+	join();
+}
+
+
+
+bool Thread::start(Function function, void* arg)
+{
+	if (running_)
+		return false;
+
+	function_ = function;
+	arg_      = arg;
+
+#if defined(_WIN32)
+	handle_ = (void*) _beginthreadex(NULL, 0, entry, this, 0, NULL);
+	running_ = (handle_ != NULL);
+#else
+	pthread_t* thread = new pthread_t;
+	running_ = (pthread_create(thread, NULL, entry, this) == 0);
+	if (running_)
+		handle_ = thread;
+	else
+		delete thread;
+#endif
+	return running_;
+}
+
+
+
+void Thread::join()
+{
+	if (!running_)
+		return;
+
+#if defined(_WIN32)
+	WaitForSingleObject((HANDLE) handle_, INFINITE);
+	CloseHandle((HANDLE) handle_);
+#else
+	pthread_t* thread = (pthread_t*) handle_;
+	pthread_join(*thread, NULL);
+	delete thread;
+#endif
+	handle_  = NULL;
+	running_ = false;
+}
+
+
+
+bool Thread::isRunning()
+{
+	return running_;
+}
+
+
+
+#if defined(_WIN32)
+unsigned __stdcall Thread::entry(void* self)
+#else
+void* Thread::entry(void* self)
+#endif
+{
+	Thread* t = (Thread*) self;
+	t->function_(t->arg_);
+	return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file      Threading.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * Minimal threading support for the capture / simulation / render pipeline:
+ * a joinable thread, atomic exchange on a long, sleeping, and a monotonic clock.
+ * Win32 is used on Windows, POSIX threads everywhere else.
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+/**
+ * Atomically stores value in *target and returns the previous value.
+ * Acts as a full memory barrier.
+ */
+long atomicExchange(volatile long* target, long value);
+
+/**
+ * Atomically adds delta to *target and returns the previous value.
+ * Acts as a full memory barrier.
+ */
+long atomicAdd(volatile long* target, long delta);
+
+/**
+ * Blocks the calling thread for about ms milliseconds.
+ */
+void sleepMs(int ms);
+
+/**
+ * Milliseconds since an arbitrary fixed point. Monotonic, safe to call from any thread.
+ */
+double timeMs();
+
+/**
+ * A thread running a plain function. Start it with start() and wait for it with join();
+ * the function is expected to return on its own, typically by polling a flag.
+ */
+class Thread
+{
+public:
+	typedef void (*Function)(void* arg);
+
+	Thread(void);
+	~Thread(void);
+
+	/**
+	 * Runs function(arg) on a new thread.
+	 * @return False if the thread could not be created.
+	 */
+	bool start(Function function, void* arg);
+
+	/**
+	 * Waits for the function to return. Does nothing if the thread is not running.
+	 */
+	void join();
+
+	bool isRunning();
+
+protected:
+	Function function_;
+	void*    arg_;
+	void*    handle_;    //HANDLE on Windows, pthread_t* elsewhere
+	bool     running_;
+
+#if defined(_WIN32)
+	static unsigned __stdcall entry(void* self);
+#else
+	static void* entry(void* self);
+#endif
+
+private:
+	Thread(const Thread&);
+	Thread& operator=(const Thread&);
+};
@@ -0,0 +1,96 @@
+/**
+ * @file      TripleBuffer.h
+ * @author    Fluid Wall contributors
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.0
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fluid Wall is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "Threading.h"
+
+/**
+ * Lock-free hand-off of the latest value from one producer thread to one consumer
+ * thread.
+ *
+ * There are three slots. The producer owns one (writeBuffer), the consumer owns one
+ * (readBuffer), and the third holds the most recently published value. publish() and
+ * update() swap a private slot with the shared one using a single atomic exchange,
+ * so neither side ever waits for the other: a slow consumer simply skips values, and
+ * a slow producer leaves the consumer looking at the last one.
+ *
+ * Slots are reused, never reallocated, so T can keep its own buffers between frames.
+ */
+template <class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer(void)
+	{
+		write_  = 0;
+		shared_ = 1;
+		read_   = 2;
+	}
+
+	/**
+	 * Producer: slot to fill. Stays the same until publish().
+	 */
+	T& writeBuffer()
+	{
+		return slots_[write_];
+	}
+
+	/**
+	 * Producer: makes the filled slot the latest value and takes a new one to write.
+	 */
+	void publish()
+	{
+		write_ = atomicExchange(&shared_, write_ | FRESH) & INDEX_MASK;
+	}
+
+	/**
+	 * Consumer: picks up the latest published value, if there is one it has not seen.
+	 * @return True if readBuffer() changed.
+	 */
+	bool update()
+	{
+		if (!(shared_ & FRESH))
+			return false;
+		read_ = atomicExchange(&shared_, read_) & INDEX_MASK;
+		return true;
+	}
+
+	/**
+	 * Consumer: latest value picked up by update(). Stays the same until the next update().
+	 */
+	T& readBuffer()
+	{
+		return slots_[read_];
+	}
+
+protected:
+	static const long INDEX_MASK = 3;
+	static const long FRESH      = 4; //set in shared_ when it holds an unread value
+
+	T             slots_[3];
+	long          write_;
+	long          read_;
+	volatile long shared_;
+
+private:
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+};
@@ -1,1240 +1,2238 @@
-/**
- * @file      fluidWall.cpp
- * @author    Austin Hines <futurelightstudios@gmail.com>
- * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
- * @version	  1.0.1
- * 
- * The main executable for Fluid Wall. Contains functions that define how the
- * KinectController class effects the FluidSolver classes. This defines the general
- * behavior of the simulation. 
- *
- * This file is part of Fluid Wall. You can redistribute it and/or modify            
- * it under the terms of the GNU Lesser General Public License as published  
- * by the Free Software Foundation, either version 3 of the License, or     
- * (at your option) any later version.                                       
- *                                                                             
- * Fluid Wall is distributed in the hope that it will be useful,                 
- * but WITHOUT ANY WARRANTY; without even the implied warranty of            
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
- * GNU Lesser General Public License for more details.                       
- *                                                                            
- * You should have received a copy of the GNU Lesser General Public License  
- * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.     
- *
- * Version History:
- * 1.0.1
- *	 - Added fullscreen toggle mode, bound to 'q' key. 
- *   - Removed 'q' key as quit.
- *   - Added Version tag to GLUT window and command line output.
- * 1.0.0
- *   - Initial Release
- *
- */
-
-#include <stdlib.h>
-#include <math.h>
-#include <stdio.h>
-#include <iostream>
-#include <ctype.h>
-
-#include <opencv2/video/tracking.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
-#include <opencv2/highgui/highgui.hpp>
-
-#include <GL/glut.h>
-
-#include "FluidSolver.h"
-#include "FluidSolverMultiUser.h"
-#include "KinectController.h"
-
-static const char* VERSION = "1.0.1 BETA";
-
-#ifndef GL_BGR //fix omission from windows OpenGL implementation
-	#define GL_BGR GL_BGR_EXT
-#endif
-#ifndef GL_BGRA
-	#define GL_BGRA GL_BGRA_EXT
-#endif
-
-#define USE_WEBCAM 0
-#define WEBCAM_ID 0
-#define USE_KINECT 1
-#define DEBUG 0
-
-// macros 
-#define ROW_WIDTH N+2
-#define IX(i, j) ((i) + (ROW_WIDTH) * (j))
-#define FOR_EACH_CELL for(i = 1; i <= N; i++) { for(j = 1; j <= N; j++) {
-#define END_FOR }}
-#define SWAP(x0, x) { float* tmp = x0; x0 = x; x = tmp; }
-
-
-///// constants
-const static int   N_DEF           = 128;
-const static float FLOW_SCALAR     = 0.1;
-const static int   NUM_SPLASH_ROWS = 80;
-const static float BG_OFFSET	   = 0.1;
-
-using namespace std;
-using namespace cv; 
-
-typedef struct { 
-	Point2f center;
-	Point2f vel; 
-	int lifespan, life_elapsed;
-	int radius;
-	int userNo;
-} Emitter;
-
-// =============================================================================
-// GLOBAL VARIABLES
-// =============================================================================
-
-FluidSolver *solver; 
-FluidSolverMultiUser *userSolver;
-bool useUserSolver = false;
-
-#if USE_KINECT
-KinectController *kinect;
-
-Mat depthMatrix;
-Mat usersMatrix;
-Mat usersMatrixResize;
-
-GLfloat Colors[][3] =                     // user colors for fluid emission
-{
-	//{0.02f,0.02f,0.02f},
-	{0.0f,0.0f,0.0f},
-	{0.0f,1.0f,1.0f},
-	{0.5f,1.0f,0.0f},
-	{0.5f,0.5f,0.0f},
-	{0.0f,0.4f,0.6f},
-	{0.0f,1.0f,0.0f},
-	{1.0f,0.5f,0.0f},
-	{1.0f,1.0f,0.0f},
-	{1.0f,0.0f,0.0f},
-	{0.0f,0.5f,1.0f},
-	{1.0f,1.0f,0.5f},
-	{1.0f,1.0f,1.0f}
-};
-
-GLfloat ColorsWhiteBG[][3] =               // user colors for fluid emission
-{
-	{0.02f,0.02f,0.02f},
-	{0.0f,1.0f,1.0f},
-	{0.5f,1.0f,0.0f},
-	{1.0f,0.5f,0.0f},
-	{0.0f,0.0f,1.0f},
-	{0.0f,1.0f,0.0f},
-	{1.0f,1.0f,0.0f},
-	{1.0f,0.0f,0.0f},
-	{0.0f,0.5f,1.0f},
-	{0.5f,0.0f,1.0f},
-	{1.0f,1.0f,0.5f},
-	{1.0f,1.0f,1.0f}
-};
-
-const static int MAX_USERS               = 6;
-const static int ITERATIONS_BEFORE_RESET = 10000;
-const static int INIT_DEPTH	             = 3000;
-const static int INIT_MOTOR	             = 10000;
-const static int DEF_WINDOW_SIZE		 = 512;
-
-#endif
-
-//particle system variables
-static int N;
-static float force  = 5.0f;
-static float source = 20.0f;
-static int MAX_EMITTERS = 200;
-
-static bool useFlow;					//use optical flow
-vector<Emitter> emitters(MAX_EMITTERS);
-
-//OpenCV
-VideoCapture cap = NULL; //capture img from webcam
-
-Mat image;
-Mat flow; //optical flow matrix
-Mat flowImg, prevFlowImg;
-
-//OpenGL
-static int win_id;
-static int win_x, win_y;
-static int mouse_down[3];
-static int omx, omy, mx, my;
-
-//display flags
-static int dvel, dbound, dusers;
-
-//mode change variables
-bool autoChangeMode = false;
-bool useWhiteBackground = false;
-int mode = 0;
-int max_mode = 0;
-int iterations = 0;
-int iterations_per_mode = 500; //frames per mode
-
-//forward method declarations
-static void changeMode(int newMode);
-static void open_glut_window ( void );
-static void initOpenGl();
-static void toggleFullscreen();
-
-
-/*
-  ----------------------------------------------------------------------
-   free/clear/allocate simulation data
-  ----------------------------------------------------------------------
-*/
-
-/**
- * Clears all solver data.
- */
-static void clearData(void)
-{
-	if(useUserSolver) 
-		userSolver->reset();
-	else
-		solver->reset();
-
-	emitters.clear();
-}
-
-/**
- * Initializes all objects and defines constant variables used in main program.
- * TODO: relegate this code to a singleton class.
- */
-static int allocateData ( void )
-{
-	solver = new FluidSolver(N_DEF, 0.1f, 0.00f, 0.0f);
-	userSolver = new FluidSolverMultiUser(MAX_USERS, N_DEF,0.1f, 0.00f, 0.0f);
-	kinect = new KinectController(MAX_USERS, ITERATIONS_BEFORE_RESET, INIT_DEPTH, INIT_MOTOR);
-	emitters.reserve(MAX_EMITTERS);
-	for(int i = 0; i < MAX_EMITTERS; i++) {
-		Emitter newEmit = {Point(0, 0), Point2f(0, 0), 1, 2, 1, 0};
-		emitters.push_back(newEmit);
-	}
-
-	N = N_DEF;
-	flow = Mat::zeros(N, N, CV_32FC2);
-
-	useFlow = true;
-
-	#if DEBUG
-		namedWindow("Users",1);
-		namedWindow("flow", 1);
-	#endif
-	#if USE_WEBCAM
-		cap.open(WEBCAM_ID);
-		if( !cap.isOpened() )
-		{
-			cout << "***Could not initialize capturing...***\n";
-		}
-	#endif
-
-	return ( 1 );
-}
-
-
-/**
- * Cleans up any allocated memory.
- */
-void cleanupExit()
-{
-	if (glutGameModeGet(GLUT_GAME_MODE_ACTIVE))
-		glutLeaveGameMode();
-	exit(0);
-}
-
-
-
-/**
- * Used for debug and basic testing of fluid simulation. Drives fluid simulation based on
- * mouse input. 
- * - Left Mouse Button + Drag adds velocity
- * - Middle Mouse Button adds boundaries, 
- * - Right Mouse Button adds density. 
- *
- */
-static void getForcesFromMouse(FluidSolver* flSolver)
-{
-	int x, y;
-
-	bool noButtonsPressed = !mouse_down[0] && !mouse_down[2] && !mouse_down[1];
-	if (noButtonsPressed) return;
-
-	// determine mouse position on the fluid grid by divide screenspace by N gridspaces
-	x = (int)((         mx  / (float)win_x) * N + 1);
-	y = (int)(((win_y - my) / (float)win_y) * N + 1);
-
-	bool isMouseOutsideFluidGrid = (x < 1) || (x > N) || (y < 1) || (y > N);
-	if (isMouseOutsideFluidGrid) return;
-
-	if (mouse_down[0]) {	//left mouse button
-		flSolver->addHorzVelocityAt(x, y, force * (mx - omx));
-		flSolver->addVertVelocityAt(x, y, force * (omy - my));
-	}
-
-	if (mouse_down[1])		// middle mouse button
-		flSolver->setBoundAt(x, y, true);
-
-	if (mouse_down[2])		// right mouse button
-		if(useUserSolver)
-			userSolver->addDensityAt(1, x, y, source);
-		else
-			flSolver->addDensityAt(x, y, source);
-
-	omx = mx;
-	omy = my;
-
-	return;
-}
-
-
-
-/**
- * Loads texture kinect, or webcam and flips image
- * horizontally and vertically. Upon output, image contains user silhouettes.
- * 
- * usersMatrixResize = NxN matrix. 
- */
-int loadImage() {
-	// TODO: clean up redundant names since we are now only supporting kinect input
-	Mat frame, flippedFrame, flippedUsersMatrix;
-	Mat frameResize = Mat::zeros(N, N, CV_8UC1);
-
-	#if USE_WEBCAM
-		Mat threshImg, webcamImage;
-
-		cap >> webcamImage;
-		cvtColor(webcamImage, threshImg, CV_BGR2GRAY);
-		threshold(threshImg, frame, 180, 200, CV_THRESH_BINARY_INV);
-	#endif
-
-	// depth tracking
-	kinect->update();
-	depthMatrix = kinect->getDepthMat();
-	depthMatrix.copyTo(frame);
-	
-	if(frame.empty()) {
-		cout<<"ERROR: Cannot load frame"<<endl;
-        return -1;
-	}
-
-	// Process image, resize to simulation size.
-	flip( frame, flippedFrame, 0 ); 
-	resize(flippedFrame,frameResize,frameResize.size(),0,0,INTER_CUBIC);
-	image = frameResize;
-
-	// Copy filtered image for optical flow to use.
-	frameResize.copyTo(flowImg);
-
-	if(useUserSolver) {
-		// Process UserID matrix.
-		usersMatrix = kinect->getUsersMat();
-		flip(usersMatrix, flippedUsersMatrix,0);
-		resize(flippedUsersMatrix, usersMatrixResize, frameResize.size(), 0, 0, INTER_CUBIC);
-		//imshow("Users", usersMatrixResize*100);
-	}
-	
-    return 0;
-}
-
-/**
- * Translates image values into boundaries in the FluidSolver. 
- * Currently set to define a boundary at any pixel in the image with a value greater than zero
- */
-static void defineBoundsFromImage(FluidSolver* flSolver, Mat &img)
-{
-    for( int y = 0; y < img.rows; y++ )
-        for( int x = 0; x < img.cols; x++ ) {
-
-			uchar &pixelVal = img.at<uchar>(y, x);
-			//add + 1 to coordinates because fluid matrix indicies range from 1 - N
-			if( pixelVal > 0)
-				flSolver->setBoundAt(x, y, true);
-			else
-				flSolver->setBoundAt(x, y, false);
-        }
-}
-
-
-/**
- * Draws and displays a graphical representation of the optical flow results using OpenCV.
- * @param flow		- Matrix of type CV_32FC2 containing results of optical flow calculation.
- * @param cflowmap	- Color image representing the input of optical flow
- * @param step		- number of pixels to skip when drawing each vector. (drawing a vector for 
- *                    every pixel would be too dense and graphically noisy.
- * @param color		- CV_RGB scalar specifying color to draw the optical flow vectors.
- */
-void drawOptFlowMap(const Mat& flow, Mat& cflowmap, int step,
-                    double, const Scalar& color)
-{
-    for(int y = 0; y < cflowmap.rows; y += step)
-        for(int x = 0; x < cflowmap.cols; x += step)
-        {
-            const Point2f& fxy = flow.at<Point2f>(y, x);
-            line(cflowmap, Point(x,y), Point(cvRound(x+fxy.x), cvRound(y+fxy.y)),
-                 color);
-            circle(cflowmap, Point(x,y), 2, color, -1);
-        }
-}
-
-
-
-/**
- * Translates optical flow into velocity values. Flow values are 
- * rounded with cvRound to eliminate noise. Results are added directly into FluidSolver.
- */
-static void computeOpticalFlow(FluidSolver* flSolver, Mat& flow)
-{
-	Mat cflow;
-
-	if(prevFlowImg.data) 
-	{
-		calcOpticalFlowFarneback(prevFlowImg, flowImg, flow, 0.5, 3, 15, 3, 5, 1.2, 0);
-		#if DEBUG 
-			cvtColor(prevFlowImg, cflow, CV_GRAY2BGR);
-			drawOptFlowMap(flow, cflow, 16, 1.5, CV_RGB(0, 255, 0));
-			imshow("flow", cflow);
-		#endif
-
-		for(int y = 1; y < N; y++)
-			for(int x = 1; x < N; x++)
-			{
-				const Point2f& fxy = flow.at<Point2f>(y, x);
-				flSolver->addHorzVelocityAt(x, y, FLOW_SCALAR * fxy.x);
-				flSolver->addVertVelocityAt(x, y, FLOW_SCALAR * fxy.y);
-			}
-	}
-
-	std::swap(prevFlowImg, flowImg);
-}
-
-/**
- * Iterates through Emitters vector and adds forces to fluid simulation for each emitter.
- * Also kills emitters that have expired.
- * @param e		- Reference to a vector containing Emitters to render.
- */
-static void renderEmitters(FluidSolver* flSolver, vector<Emitter> &e)
-{
-	//TODO: convert emitters to fixed array. Bug being caught in loop right now.
-	int i = 0;
-	while (i < e.size()) {
-
-		bool emitterHasExpired = (e[i].lifespan - e[i].life_elapsed == 0);
-		if(emitterHasExpired) {
-			e.erase(e.begin() + i);
-		}
-		else {
-
-			Point lowerCoord, upperCoord;
-
-			//calculate scalar for temporal falloff overlifespan
-			float lifescalar = (e[i].lifespan - e[i].life_elapsed) / e[i].lifespan;
-
-			//prevent radius from referencing cells outside simulation matrix
-			//TODO: clean up line breaks here
-			lowerCoord.y = (e[i].center.y - e[i].radius) < 1 ? 1 : (e[i].center.y - e[i].radius);
-			lowerCoord.x = (e[i].center.x - e[i].radius) < 1 ? 1 : (e[i].center.x - e[i].radius);
-			upperCoord.y = (e[i].center.y + e[i].radius) > N ? N : (e[i].center.y + e[i].radius);
-			upperCoord.x = (e[i].center.x + e[i].radius) > N ? N : (e[i].center.x + e[i].radius);
-
-			for(int y = lowerCoord.y; y <= upperCoord.y; y++)
-				for(int x = lowerCoord.x; x <= upperCoord.x; x++) {
-					//calculate falloff from center
-					float vscalar = fabs(y - e[i].center.y) / e[i].radius;
-					float uscalar = fabs(x - e[i].center.x) / e[i].radius;
-					float dscalar = (vscalar+uscalar) / 2;
-					
-					float horzVel = e[i].vel.x * uscalar;
-					float vertVel = e[i].vel.y * vscalar;
-					float density = source * dscalar * lifescalar;
-
-					flSolver->addHorzVelocityAt(x, y, horzVel);
-					flSolver->addVertVelocityAt(x, y, vertVel);
-
-					if(useUserSolver) 
-						userSolver->addDensityAt(e[i].userNo, x, y, density);
-					else
-						flSolver->addDensityAt(x, y, density);
-				}
-			e[i].life_elapsed++;
-			i++;
-		}
-	}
-}
-
-
-
-/**
- * Creates an emitter object with given properties.
- */
-static void createEmitterAt(int center_x, int center_y, float force_u, float force_v, int lifespan, int radius, int userNo = 1)
-{
-	Emitter newEmit = {Point(center_x, center_y), Point2f(force_u, force_v), lifespan, 0, radius, userNo};
-	emitters.push_back(newEmit);
-
-	#if DEBUG
-		cout<<"Emitter created: "<<emitters.size()<<endl;
-	#endif
-}
-
-
-
-/**
- * Creates emitter objects based on optical flow velocity. If vertical velocity is negative at boundaries,
- * an emitter is created. An emission threshold prevents negative velocities due to noise from creating 
- * emitters. In the call tree, we assume this function is called after computeOpticalFlow.
- *
- * @param flsolver	Fulid Solver to emit splashes into
- * @param flow		Reference to a matrix containing optical flow velocities.
- */
-static void emitSplashes(FluidSolver* flSolver, Mat &flow)
-{
-	//precondition: optical flow has been calculated
-	float fu, fv;
-	fu = fv = 0.0;
-	int emitter_lifespan = 15;
-	int emitter_radius = 6;
-	int velocityEmissionThreshold = -0.05; //creates emitters based on velocity emission
-
-	if(useFlow) {
-		// Only look for emitters in splash rows.
-		for( int j = 1; j < NUM_SPLASH_ROWS; j++) { 
-			for(int i = 1; i <= N; i++) {
-													
-				bool vertBoundChangesToYes = !flSolver->isBoundAt(i, j) && flSolver->isBoundAt(i, j+1);
-				if(vertBoundChangesToYes) { 
-					const Point2f& opticalFlowVelocity = flow.at<Point2f>(i, j);
-					fu = .8 *  opticalFlowVelocity.x;
-					fv = .8 *  opticalFlowVelocity.y;
-
-					if(opticalFlowVelocity.y < velocityEmissionThreshold) 
-						if(useUserSolver) {
-							int userNo = usersMatrixResize.at<uchar>(i, j+1);
-							createEmitterAt(i, j-1, fu, fv, 6, 3, userNo);
-						}
-						else
-							createEmitterAt(i, j-1, fu, fv, 6, 3, 1);
-				}
-			}
-		}
-		renderEmitters(flSolver, emitters);
-	}
-	else {
-		// TODO: move this code into a separate function?
-		// emit splashes on either side of whole silhouette
-		for (int j = 1; j <= N; j++) { 
-			for (int i = 1; i <= N; i++) {
-				bool horzBoundChangesToYes = !flSolver->isBoundAt(i, j) && flSolver->isBoundAt(i+1, j);
-				bool horzBoundChangesToNo  = flSolver->isBoundAt(i, j) && !flSolver->isBoundAt(i+1, j);
-
-				if(horzBoundChangesToYes) {
-					fu = -0.05; // emit velocity in negative direction
-					fv = 0.1;
-					flSolver->addHorzVelocityAt(i, j, force * fu);
-					flSolver->addVertVelocityAt(i, j, force * fv);
-				}
-				else if(horzBoundChangesToNo) { 
-					fu = 0.05; // emit velocity in positive direction
-					fv = 0.1;
-					flSolver->addHorzVelocityAt(i+1, j, force * fu);
-					flSolver->addVertVelocityAt(i+1, j, force * fv);
-				}
-			}
-		}
-	}
-}
-
-
-
-/**
- * Changes various modes. Modes are given integer numbers to work with auto switcher function.
- * @param newMode	Mode number to change to. Valid values 0-3.
- */
-static void changeMode(int newMode)
-{
-	mode = newMode;
-	//we have changed modes, initialize new modes
-	clearData();
-	switch(newMode)
-	{
-		case 0:
-			source  = 20.0f;
-			dvel    = false;
-			dbound  = false;
-			dusers  = false;
-			useFlow = true;
-			useUserSolver      = false;
-			useWhiteBackground = false;
-			cout<<"Changing to mode 0: Single color density"<<endl;
-			break;
-		case 1:
-			source  = 20.0f;
-			dvel    = true;
-			dbound  = false;
-			dusers  = false;
-			useFlow = false;
-			useUserSolver      = false;
-			useWhiteBackground = false;
-			cout<<"Changing to mode 1: Vectors without optical flow"<<endl;
-			break;
-		case 2:
-			source  = 20.0f;
-			dvel    = false;
-			dbound  = false;
-			dusers  = true;
-			useFlow = true;
-			useUserSolver      = true;
-			useWhiteBackground = false;
-			cout<<"Changing to mode 2: Multi-color user emission"<<endl;
-			break;
-		case 3:
-			source  = 20.0f;
-			dvel    = false;
-			dbound  = false;
-			dusers  = false;
-			useFlow = true;
-			useUserSolver      = true;
-			useWhiteBackground = true;
-			cout<<"Changing to mode 3: White background"<<endl;
-			break;
-	}
-}
-
-
-
-/**
- * Tries to change the mode if iterations have reached iterations_per_mode.
- */
-static void tryChangeMode()
-{
-	if(autoChangeMode && (iterations > iterations_per_mode))
-	{
-		iterations = 0;
-		mode++;
-		if(mode > max_mode)
-			mode = 0;
-
-		changeMode(mode);
-	}
-	else
-		iterations++;
-}
-
-
-////////////////////////////////////////////////////////////////////////
-/*
-  ----------------------------------------------------------------------
-   OpenGL specific drawing routines
-  ----------------------------------------------------------------------
-*/
-
-/**
- * Draws fluid velocity vectors in OpenGL.
- * @param flSolver	FluidSolver containing the velocity to draw.
- *
- */
-static void drawVelocity(FluidSolver* flSolver)
-{
-	int i, j;
-	float x, y, h;
-
-	h = 1.0f / N;
-
-	glColor3f(1.0f, 1.0f, 1.0f);
-	glLineWidth(1.0f);
-
-	glBegin(GL_LINES);
-		for (i = 1; i <= N; i++) {
-			x = (i - 0.5f) * h;
-
-			for (j = 1; j <= N; j++) {
-				y = (j - 0.5f) * h;
-				glVertex2f(x, y);
-				glVertex2f(x + flSolver->getHorzVelocityAt(i,j), 
-					       y + flSolver->getVertVelocityAt(i,j));
-			}
-		}
-	glEnd();
-}
-
-
-/**
- * Draws bounding cells in OpenGL.
- * @param flSolver	FluidSolver containing the bounds to draw.
- *
- */
-static void drawBounds(FluidSolver* flSolver)
-{
-	int i, j;
-	float x, y, h;
-	h = 1.0f / N; //calculate unit length of each cell
-
-	glBegin(GL_QUADS);
-		for (i = 0; i <= N; i++) {
-			x = i * h;
-			for (j = 0; j <= N; j++) {
-				y = j * h;
-
-				if(flSolver->isBoundAt(i,j)) {
-					glColor3f (0.30f, 0.30f, 0.30f); glVertex2f (x,   y);
-					glColor3f (0.30f, 0.30f, 0.30f); glVertex2f (x+h, y);
-					glColor3f (0.30f, 0.30f, 0.30f); glVertex2f (x+h, y+h);
-					glColor3f (0.30f, 0.30f, 0.30f); glVertex2f (x,   y+h);
-				}
-			}
-		}
-	glEnd();
-}
-
-
-typedef struct {float R, G, B;} RGBType;
-typedef struct {float H, S, V;} HSVType;
-
-#define RETURN_RGB(r, g, b) {RGB.R = r; RGB.G = g; RGB.B = b; return RGB;}
-#define RETURN_HSV(h, s, v) {HSV.H = h; HSV.S = s; HSV.V = v; return HSV;}
-#define UNDEFINED -1
-
-/**
- *  Converts an HSV color into RGB color space. 
- *
- *  @param HSV	HSV color variable to convert into RGB.
- */
-RGBType HSV_to_RGB( HSVType HSV ) 
-{
-	// H is given on [0, 6] or UNDEFINED. S and V are given on [0, 1].
-	// RGB are each returned on [0, 1].
-	float h = HSV.H, s = HSV.S, v = HSV.V, m, n, f;
-	int i;
-	RGBType RGB;
-	if (h == UNDEFINED) 
-		RETURN_RGB(v, v, v);
-	i = floor(h);
-	f = h - i;
-	if ( !(i&1) ) 
-		f = 1 - f; // if i is even
-	m = v * (1 - s);
-	n = v * (1 - s * f);
-
-	switch (i) 
-	{
-		case 6 :
-		case 0 : RETURN_RGB(v, n, m);
-		case 1 : RETURN_RGB(n, v, m);
-		case 2 : RETURN_RGB(m, v, n)
-		case 3 : RETURN_RGB(m, n, v);
-		case 4 : RETURN_RGB(n, m, v);
-		case 5 : RETURN_RGB(v, m, n);
-	}
-}
-
-
-#if USE_KINECT
-/**
- *  Computes the weighted color of all the user densities at a particular 
- *  pixel coordinate.
- *  @param x	x-coordinate 
- *  @param y	y-coordinate
- */
-RGBType getWeightedColor(int x, int y)
-{
-	RGBType RGB;
-	float R, G, B;
-	R=G=B=0;
-
-	for(int i = 0; i < MAX_USERS; i++) {
-		float densityVal = userSolver->getDensityAt(i, x, y);
-		
-		if(useWhiteBackground) {
-			R += ColorsWhiteBG[i][0] * densityVal;
-			G += ColorsWhiteBG[i][1] * densityVal;
-			B += ColorsWhiteBG[i][2] * densityVal;
-		}
-		else {
-			R += Colors[i][0] * densityVal;
-			G += Colors[i][1] * densityVal;
-			B += Colors[i][2] * densityVal;
-		}
-	} 
-
-	RGB.R = R; RGB.B = B; RGB.G = G; 
-	return RGB;
-}
-#endif
-
-
-
-/**
- * Render density grids as OpenGL quads with vertex shading.
- *
- * @param flSolver	fluid solver 
- */
-static void drawDensity ( FluidSolver* flSolver )
-{
-	int i, j;
-	float x, y, h;
-	RGBType rgb00, rgb10, rgb11, rgb01;
-	float	d00,   d10,   d11,   d01;
-	float hue = 3.25;
-	float sat = 1.0;
-	h = 1.0f/N;
-
-	
-	glBegin ( GL_QUADS );
-		for ( i=1 ; i<=N ; i++ ) 
-		{
-			x = (i-0.5f)*h;
-			for ( j=1 ; j<=N ; j++ ) 
-			{
-				y = (j-0.5f)*h;
-
-				if(useUserSolver) {
-					//render density color for each point based on blending user values
-					rgb00 = getWeightedColor(i,j);
-					rgb10 = getWeightedColor(i+1,j);
-					rgb11 = getWeightedColor(i+1,j+1);
-					rgb01 = getWeightedColor(i,j+1);
-				}
-				else {
-					//if a cell is a bounds cell, do not apply a background offset
-					d00 = flSolver->isBoundAt(i,j)     ? 0 : BG_OFFSET + flSolver->getDensityAt(i,j);
-					d10 = flSolver->isBoundAt(i+1,j)   ? 0 : BG_OFFSET + flSolver->getDensityAt(i+1,j);
-					d11 = flSolver->isBoundAt(i+1,j+1) ? 0 : BG_OFFSET + flSolver->getDensityAt(i+1,j+1); 
-					d01 = flSolver->isBoundAt(i,j+1)   ? 0 : BG_OFFSET + flSolver->getDensityAt(i,j+1); 
-
-					//hsv to rgb using the density in the cell
-					HSVType hsv00 = {hue, sat, d00};
-					rgb00 = HSV_to_RGB(hsv00);
-					HSVType hsv10 = {hue, sat, d10};
-					rgb10 = HSV_to_RGB(hsv10);
-					HSVType hsv11 = {hue, sat, d11};
-					rgb11 = HSV_to_RGB(hsv11);
-					HSVType hsv01 = {hue, sat, d01};
-					rgb01 = HSV_to_RGB(hsv01);
-				}
-
-				glColor3f (rgb00.R, rgb00.G, rgb00.B); glVertex2f ( x,   y   );
-				glColor3f (rgb10.R, rgb10.G, rgb10.B); glVertex2f ( x+h, y   );
-				glColor3f (rgb11.R, rgb11.G, rgb11.B); glVertex2f ( x+h, y+h );
-				glColor3f (rgb01.R, rgb01.G, rgb01.B); glVertex2f ( x,   y+h );
-			}
-		}
-	glEnd ();
-}
-
-
-
-#if USE_KINECT
-/**
- * Draws user silhouettes in unique colors per user in OpenGL. 
- * Uses the usersMatrix from kinect.
- *
- */
-static void drawUsers(void)
-{
-	int i, j;
-	float x, y, h;
-	int d00, index;
-
-	h = 1.0f/N;
-
-	glBegin ( GL_QUADS );
-		for ( i=0 ; i<=N ; i++ ) 
-		{
-			x = i*h;
-			for ( j=0 ; j<=N ; j++ ) 
-			{
-				y = j*h;
-				index = j * N + i;
-				d00 = usersMatrixResize.data[index];		
-				
-				if(d00 != 0) {
-					GLfloat R = Colors[d00][0];
-					GLfloat G = Colors[d00][1];
-					GLfloat B = Colors[d00][2];
-
-					//cout<<"found a color for user: "<<d00<<": ("<<R<<", "<<G<<", "<<B<<")"<<endl;
-
-					glColor3f ( R, G, B ); glVertex2f ( x, y );
-					glColor3f ( R, G, B ); glVertex2f ( x+h, y );
-					glColor3f ( R, G, B ); glVertex2f ( x+h, y+h );
-					glColor3f ( R, G, B ); glVertex2f ( x, y+h );
-				}
-			}
-		}
-	glEnd ();
-
-}
-#endif
-////////////////////////////////////////////////////////////////////////
-
-/*
-  ----------------------------------------------------------------------
-   GLUT callback routines
-  ----------------------------------------------------------------------
-*/
-
-/**
- *  GLUT keyboard listener function.
- *
- *  @param key	key that is pressed
- *  @param x	x-coordinate of mouse at time of key press
- *  @param y	y-coordinate of mouse at time of keey press
- */
-static void key_func ( unsigned char key, int x, int y )
-{
-	switch ( key )
-	{
-		case 'c':
-		case 'C':
-			clearData();
-			break;
-		case 27 : //escape key
-			cleanupExit();
-			break;
-		case 'f':
-		case 'F':
-			//toggle optical flow
-			useFlow = !useFlow;
-			cout<<"Optical Flow: "<<useFlow<<endl;
-			break;
-		case 'v':
-		case 'V':
-			dvel = !dvel;
-			cout<<"Display Velocity"<<endl;
-			break;
-		case 'b':
-		case 'B':
-			dbound = !dbound;
-			break;
-		case '1': //single color fluid
-			changeMode(0);
-			break;
-		case '2': //vectors without optical flow
-			changeMode(1);
-			break;
-		case '3': //multi color fluid
-			changeMode(2);
-			break;
-		case '4': //white bg
-			changeMode(3);
-			break;
-		case '0': //toggle auto mode change
-			autoChangeMode = !autoChangeMode;
-			cout<<"Auto Change Mode: "<<autoChangeMode<<endl;
-			break;
-		#if USE_KINECT
-		case 'u':
-		case 'U':
-			dusers = !dusers;
-			cout<<"Draw Users: "<<dusers<<endl;
-			break;
-		case 'w':
-			kinect->setMotorAngle(50);
-			break;
-		case 's':
-			kinect->setMotorAngle(-50);
-			break;
-		case ' ':
-			kinect->resetMotorAngle();
-			break;
-		case '+':
-			kinect->reset();
-			break;
-		case 'o':
-		case 'O':
-			kinect->setDepth(+200);
-			break;
-		case 'k':
-		case 'K':
-			kinect->setDepth (-200);
-			break;
-
-		#endif
-
-		case 'Q' :
-		case 'q' :
-			toggleFullscreen();
-			break;
-
-	}
-}
-
-
-
-/**
- *  GLUT mouse listener function. Called when mouse button is pressed or 
- *  released.
- *
- *  @param button ID of button event that is presssed.
- *  @param state  A GLUT constant indicating mouse down or up
- *  @param x	  x-coordinate of mouse at time of button event
- *  @param y	  y-coordinate of mouse at time of button event
- */
-static void mouse_func ( int button, int state, int x, int y )
-{
-	omx = mx = x;
-	omx = my = y;
-
-	mouse_down[button] = state == GLUT_DOWN;
-}
-
-
-
-/**
- *  GLUT mouse movement function. Called when mouse is moved
- *
- *  @param x	  x-coordinate of mouse 
- *  @param y	  y-coordinate of mouse
- */
-static void motion_func ( int x, int y )
-{
-	mx = x;
-	my = y;
-}
-
-
-
-/**
- *  GLUT window reshaping function. Called whenever a window is resized.
- *
- *  @param width	New width of window
- *  @param height	New height of window.
- */
-static void reshape_func ( int width, int height )
-{
-
-	glutReshapeWindow ( width, height );
-
-	win_x = width;
-	win_y = height;
-}
-
-
-
-/**
- *  Called when OpenGL is not drawing. Calls for another draw frame
- */
-static void idle_func ( void )
-{
-	bool fullscreen = glutGameModeGet(GLUT_GAME_MODE_ACTIVE);
-	if(!fullscreen)
-		glutSetWindow(win_id);
-	glutPostRedisplay();
-}
-
-
-
-/**
- *  Prepares OpenGL canvas to draw a new frame.
- */
-static void pre_display ( void )
-{		
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
-	glViewport ( 0, 0, win_x, win_y );
-	glMatrixMode ( GL_PROJECTION );
-	glLoadIdentity ();
-	gluOrtho2D ( 0.0, 1.0, 0.0, 1.0 );
-	glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
-	glClear ( GL_COLOR_BUFFER_BIT );
-}
-
-
-
-/**
- *  Posts the drawn frame to the screen.
- */
-static void post_display ( void )
-{
-	glutSwapBuffers ();
-}
-////////////////////////////////////////////////////////////////////////////
-
-
-
-/**
- *  Draws OpenGL polygons that represent the fluid simulation. Also calles
- *  methods that trigger simulation steps. Most of the behavior of the 
- *  program is defined in this method. 
- *
- */
-static void drawFunction ( void )
-{
-	FluidSolver* flSolver;
-	bool dispUsr = useUserSolver && dusers;
-
-	if(useUserSolver)
-		flSolver = userSolver;
-	else 
-		flSolver = solver;
-
-	tryChangeMode();
-	pre_display();
-		loadImage();
-
-		defineBoundsFromImage          (flSolver, image);
-		getForcesFromMouse             (flSolver);
-		if(useFlow)  computeOpticalFlow(flSolver, flow);
-		emitSplashes                   (flSolver, flow);
-
-		if(useUserSolver)
-			userSolver->update();
-		else
-			solver->update();
-
-
-		if(dvel)     drawVelocity(flSolver);
-		else		 drawDensity(flSolver);
-
-		if(dbound)   drawBounds(flSolver);
-		if(dispUsr)  drawUsers();
-	post_display();
-}
-
-
-
-/**
- *  Sets OpenGL Callbacks
- *
- */
-static void initOpenGl() 
-{
-	glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
-	glClear ( GL_COLOR_BUFFER_BIT );
-	glutSwapBuffers ();
-	glClear ( GL_COLOR_BUFFER_BIT );
-	glutSwapBuffers ();
-
-	pre_display ();
-
-	glutKeyboardFunc (key_func     );
-	glutMouseFunc    (mouse_func   );
-	glutMotionFunc   (motion_func  );
-	glutReshapeFunc  (reshape_func );
-	glutIdleFunc     (idle_func    );
-	glutDisplayFunc  (drawFunction );
-
-}
-
-
-
-/**
- * Switches between fullscreen and windowed mode.
- */
-static void toggleFullscreen()
-{
-	bool fullscreen = glutGameModeGet(GLUT_GAME_MODE_ACTIVE);
-	if(fullscreen) {
-		win_x = win_y = DEF_WINDOW_SIZE;
-		glutLeaveGameMode();
-		open_glut_window();
-	}
-	else {
-		glutGameModeString("640x480:16@60");
-
-		if (glutGameModeGet(GLUT_GAME_MODE_POSSIBLE)) {
-			glutEnterGameMode();
-			//glutDestroyWindow(win_id);
-			win_x = glutGameModeGet(GLUT_GAME_MODE_WIDTH);
-			win_y = glutGameModeGet(GLUT_GAME_MODE_HEIGHT);
-			initOpenGl();
-		}
-
-		else {
-			printf("The select fullscreen mode is not available\n");
-		}
-	}
-
-}
-
-
-
-/**
- *  Opens a GLUT compatible window and sets OpenGL callbacks.
- *
- */
-static void open_glut_window ( void )
-{
-	glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE);
-	glutInitWindowPosition ( 0, 0 );
-	glutInitWindowSize ( win_x, win_y );
-
-	char* windowName;
-	sprintf(windowName, "Fluid Wall %s", VERSION);	
-	win_id = glutCreateWindow(windowName);
-
-	//register callbacks
-	initOpenGl();
-
-}
-
-
-
-//////////////////////////////////////////////////////////////////////////
-/*
-  ----------------------------------------------------------------------
-   main --- main routine
-  ----------------------------------------------------------------------
-*/
-int main ( int argc, char ** argv )
-{
-	glutInit ( &argc, argv);
-
-	if ( argc != 1 && argc != 6 ) {
-		fprintf ( stderr, "usage : %s N dt diff visc force source\n", argv[0] );
-		fprintf ( stderr, "where:\n" );\
-		fprintf ( stderr, "\t N      : grid resolution\n" );
-		fprintf ( stderr, "\t dt     : time step\n" );
-		fprintf ( stderr, "\t diff   : diffusion rate of the density\n" );
-		fprintf ( stderr, "\t visc   : viscosity of the fluid\n" );
-		fprintf ( stderr, "\t force  : scales the mouse movement that generate a force\n" );
-		fprintf ( stderr, "\t source : amount of density that will be deposited\n" );
-		exit ( 1 );
-	}
-
-	printf ( "\n\n ==== Fluid Wall %s ==== \n", VERSION);
-	printf ( " SIMULATION:\n");
-	printf ( "\t Add densities with the right mouse button\n" );
-	printf ( "\t Add bounds with the middle mouse button\n" );
-	printf ( "\t Add velocities with the left mouse button and dragging the mouse\n" );
-	printf ( "\t Toggle use of optical flow with the 'f' key.\n" );
-	printf ( "\t Clear the simulation with the 'c' key\n" );
-	printf ( " DISPLAY:\n");
-	printf ( "\t Toggle fullscreen mode with the 'q' key.\n" );
-	printf ( "\t Toggle density/velocity display with the 'v' key.\n" );
-	printf ( "\t Toggle bounds display with the 'b' key.\n" );
-	printf ( "\t Toggle users display with the 'u' key.\n" );
-	printf ( " MODES:\n");
-	printf ( "\t '0' key: Toggle Automatic Mode Change.\n" );
-	printf ( "\t '1' key: Switch to mode 1: Single user, blue fluid.\n" );
-	printf ( "\t '2' key: Switch to mode 2: Velocity Vector, no optical flow.\n" );
-	printf ( "\t '3' key: Switch to mode 3: Multi-user, multicolor fluid.\n" );
-	printf ( "\t '4' key: Switch to mode 4: Multi-user, white background.\n" );
-	printf ( " KINECT:\n");
-	printf ( "\t Increase Kinect motor angle with the 'w' key.\n" );
-	printf ( "\t Decrease Kinect motor angle with the 's' key.\n" );
-	printf ( "\t Reset Kinect motor angle with the SPACEBAR key.\n" );
-	printf ( "\t Increase Kinect depth thrshold angle with the 'o' key.\n" );
-	printf ( "\t Decrease Kinect depth thrshold angle with the 'k' key.\n" );
-	printf ( "\t Reset the Kinect with the + key \n\n" );
-	printf ( " Quit with the 'ESC' key.\n" );
-
-	dvel = false;
-	dusers = false;
-	dbound = false;
-
-	if ( !allocateData() ) 
-		exit ( 1 );
-	
-	clearData();
-
-	win_x = DEF_WINDOW_SIZE;
-	win_y = DEF_WINDOW_SIZE;
-
-	open_glut_window();
-
-	glutMainLoop();
+/**
+ * @file      fluidWall.cpp
+ * @author    Austin Hines <futurelightstudios@gmail.com>
+ * @copyright 2011 Austin Hines, Naureen Mahmood, and Texas A&M Dept. of Visualization
+ * @version	  1.0.1
+ * 
+ * The main executable for Fluid Wall. Contains functions that define how the
+ * KinectController class effects the FluidSolver classes. This defines the general
+ * behavior of the simulation. 
+ *
+ * This file is part of Fluid Wall. You can redistribute it and/or modify            
+ * it under the terms of the GNU Lesser General Public License as published  
+ * by the Free Software Foundation, either version 3 of the License, or     
+ * (at your option) any later version.                                       
+ *                                                                             
+ * Fluid Wall is distributed in the hope that it will be useful,                 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              
+ * GNU Lesser General Public License for more details.                       
+ *                                                                            
+ * You should have received a copy of the GNU Lesser General Public License  
+ * along with Fluid Wall. If not, see <http://www.gnu.org/licenses/>.     
+ *
+ * Version History:
+ * 1.0.1
+ *	 - Added fullscreen toggle mode, bound to 'q' key. 
+ *   - Removed 'q' key as quit.
+ *   - Added Version tag to GLUT window and command line output.
+ * 1.0.0
+ *   - Initial Release
+ *
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <ctype.h>
+
+#include <opencv2/video/tracking.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <GL/glut.h>
+
+#include "FluidSolver.h"
+#include "FluidSolverMultiUser.h"
+#include "FluidKernels.h"
+#include "KinectController.h"
+#include "GridDownsampler.h"
+#include "FluidSolverGPU.h"
+#include "GridTexture.h"
+#include "Threading.h"
+#include "TripleBuffer.h"
+#include "Profiler.h"
+#include "EmitterPool.h"
+#include "FlowProvider.h"
+#include "FlowProviderGPU.h"
+#include "SocketHaloExchange.h"
+#include "SimScheduler.h"
+#include "Telemetry.h"
+
+static const char* VERSION = "1.0.1 BETA";
+
+#ifndef GL_BGR //fix omission from windows OpenGL implementation
+	#define GL_BGR GL_BGR_EXT
+#endif
+#ifndef GL_BGRA
+	#define GL_BGRA GL_BGRA_EXT
+#endif
+
+#define USE_WEBCAM 0
+#define WEBCAM_ID 0
+#define USE_KINECT 1
+#define USE_GPU_SOLVER 0 //run the single user solver on the graphics card when it can
+#define DEBUG 0
+
+// macros 
+#define ROW_WIDTH NX+2
+#define IX(i, j) ((i) + (ROW_WIDTH) * (j))
+#define FOR_EACH_CELL for(i = 1; i <= NX; i++) { for(j = 1; j <= NY; j++) {
+#define END_FOR }}
+#define SWAP(x0, x) { float* tmp = x0; x0 = x; x = tmp; }
+
+
+///// constants
+const static int   N_DEF           = 128;   //grid cells per row, rows follow the sensor's aspect ratio
+const static float FLOW_SCALAR     = 0.1;
+const static int   NUM_SPLASH_ROWS = 80;
+const static float BG_OFFSET	   = 0.1;
+const static float SOR_RELAXATION  = 1.5f;
+const static float SOLVER_TOLERANCE     = 0.01f;  //relative residual
+const static float SOLVER_ABS_TOLERANCE = 1e-6f;  //lets quiet frames exit early
+const static int   MIN_SOLVER_ITERATIONS = 4;
+const static int   MAX_SOLVER_ITERATIONS = 20;
+const static int   FRAME_BUDGET_MS       = 16;    //time allowed for one simulation step
+const static float SIM_DT                = 0.1f;  //simulated time of one on-time step
+const static float SIM_CFL_CELLS         = 5.0f;  //cells the fluid may move per substep
+const static int   MAX_SIM_SUBSTEPS      = 4;
+const static int   MULTIGRID_MIN_N       = 256;   //grid size at which multigrid beats relaxation
+const static int   SIM_STEP_MS           = 33;    //simulation steps at the sensor's 30 Hz
+const static float DENSITY_HUE           = 3.25f; //single user fluid color
+const static float DENSITY_SAT           = 1.0f;
+const static char* PROFILE_LOG_PATH      = "fluidWall_profile.csv";
+const static int   PROFILE_LOG_MS        = 10000; //interval between stage timing dumps
+const static char* TELEMETRY_PREFIX      = "fluidwall";
+const static int   TELEMETRY_INTERVAL_MS = 10000; //StatsD's own flush interval
+const static int   FLOW_CHANGE_THRESHOLD = 8;     //depth change that counts as motion
+const static int   FLOW_ROI_MARGIN       = 16;    //cells the motion box is grown by, about one flow window
+const static int   FLOW_COLD_ITERATIONS  = 3;     //Farneback iterations from a zero guess
+const static int   FLOW_WARM_ITERATIONS  = 1;     //when starting from the previous flow
+const static int   TILE_CONNECT_MS       = 60000; //time the neighbor tiles have to start up
+const static int   TILE_MODE_DELAY_STEPS = 64;    //a mode key switches tiles this many steps later
+const static int   TILE_MODE_TAG         = -1;    //exchange tag of the mode messages, solver tags count from 0
+
+using namespace std;
+using namespace cv; 
+
+//one sensor frame, resized to the simulation grid. Written by the capture thread.
+struct CaptureFrame {
+	Mat image;	//silhouettes, nonzero where there is a user
+	Mat users;	//user ID at each pixel
+	Mat bounds;	//1 where the cell is a bound
+};
+
+//everything the render thread needs to draw one simulation step. Written by the
+//simulation thread; arrays are (NX+2) x (NY+2) cells, users is NX x NY.
+struct SimSnapshot {
+	vector<GLfloat>       color;		//RGB density color per cell
+	vector<GLfloat>       u, v;			//velocity per cell
+	vector<unsigned char> bounds;		//1 for bounds cells
+	vector<unsigned char> users;		//user IDs, filled in user modes
+	bool   userMode;					//taken from the multi user solver
+	bool   gpuDensity;					//density is drawn by the GPU solver, color is not filled
+	double time;						//timeMs() at the end of the step, 0 if never written
+
+	SimSnapshot() : userMode(false), gpuDensity(false), time(0) {}
+};
+
+// =============================================================================
+// GLOBAL VARIABLES
+// =============================================================================
+
+//only the solver of the current mode exists, see changeMode()
+FluidSolver *solver = NULL;
+FluidSolverMultiUser *userSolver = NULL;
+FluidSolverGPU *gpuSolver = NULL;
+bool useUserSolver = false;
+//-density half|unorm16 keeps the user densities in 16 bits
+static FluidSolverMultiUser::DensityStorage userDensityStorage = FluidSolverMultiUser::DENSITY_FLOAT;
+//-velocity 2|4 runs velocity and pressure on a grid that many times coarser
+static int velocityDownsampling = 1;
+//-advect mc|mcv keeps splashes crisp with MacCormack advection of the density, and of the velocity
+static FluidSolver::AdvectionScheme densityAdvection  = FluidSolver::ADVECT_SEMI_LAGRANGIAN;
+static FluidSolver::AdvectionScheme velocityAdvection = FluidSolver::ADVECT_SEMI_LAGRANGIAN;
+//-tile side port|host:port makes this wall one tile of a wider one, one PC per tile
+static SocketHaloExchange tileLinks;
+static bool tiled = false;
+//advances the solvers by the time that passed, in as many substeps as the fluid's speed needs
+static SimScheduler simScheduler(SIM_DT, SIM_STEP_MS, FRAME_BUDGET_MS);
+//-statsd host:port reports the stage timings and telemetry counters for monitoring
+static TelemetryExporter telemetry;
+static const char*       statsdAddress = NULL;
+
+#if USE_KINECT
+KinectController *kinect = NULL;	//NULL when playing a recording
+CaptureSource    *captureSource;	//the kinect or the player
+
+//-record saves every captured frame, -play replays a recording instead of the sensor
+static CaptureRecorder captureRecorder;
+static CapturePlayer   capturePlayer;
+static const char*     recordPath = NULL;
+static const char*     playPath   = NULL;
+static bool            playFast   = false;	//no waiting for the recorded frame times
+
+Mat depthMatrix;			//views of the kinect's buffers, valid until its next update
+Mat usersMatrix;
+Mat usersMatrixResize;
+GridDownsampler *downsampler;	//sensor frames to grid cells
+
+GLfloat Colors[][3] =                     // user colors for fluid emission
+{
+	//{0.02f,0.02f,0.02f},
+	{0.0f,0.0f,0.0f},
+	{0.0f,1.0f,1.0f},
+	{0.5f,1.0f,0.0f},
+	{0.5f,0.5f,0.0f},
+	{0.0f,0.4f,0.6f},
+	{0.0f,1.0f,0.0f},
+	{1.0f,0.5f,0.0f},
+	{1.0f,1.0f,0.0f},
+	{1.0f,0.0f,0.0f},
+	{0.0f,0.5f,1.0f},
+	{1.0f,1.0f,0.5f},
+	{1.0f,1.0f,1.0f}
+};
+
+GLfloat ColorsWhiteBG[][3] =               // user colors for fluid emission
+{
+	{0.02f,0.02f,0.02f},
+	{0.0f,1.0f,1.0f},
+	{0.5f,1.0f,0.0f},
+	{1.0f,0.5f,0.0f},
+	{0.0f,0.0f,1.0f},
+	{0.0f,1.0f,0.0f},
+	{1.0f,1.0f,0.0f},
+	{1.0f,0.0f,0.0f},
+	{0.0f,0.5f,1.0f},
+	{0.5f,0.0f,1.0f},
+	{1.0f,1.0f,0.5f},
+	{1.0f,1.0f,1.0f}
+};
+
+const static int MAX_USERS               = 6;
+const static int ITERATIONS_BEFORE_RESET = 10000;
+const static int INIT_DEPTH	             = 3000;
+const static int INIT_MOTOR	             = 10000;
+const static int DEF_WINDOW_SIZE		 = 512;
+
+#endif
+
+//particle system variables
+static int NX, NY;						//grid size: cells per row, rows
+static float force  = 5.0f;
+static float source = 20.0f;
+static const int MAX_EMITTERS = 200;
+static const float EMITTER_MERGE_DISTANCE = 3.0f; //cells, for splashes spawned into a full pool
+
+static bool useFlow;					//use optical flow
+static EmitterPool emitters(MAX_EMITTERS, EmitterPool::MERGE_NEAREST, EMITTER_MERGE_DISTANCE);
+static vector<FluidSolver::SplatStamp> emitterStamps;	//falloff per emitter radius
+static vector<FluidSolver::Splat>      emitterSplats;	//emitters of the current step
+
+//OpenCV
+VideoCapture cap = NULL; //capture img from webcam
+
+Mat flow; //optical flow matrix
+Mat flowImg, prevFlowImg;
+
+//dense flow runs Farneback inside the box around what changed, sparse flow tracks
+//only the silhouette points emitSplashes looks at, GPU flow runs Lucas-Kanade in
+//shaders on the GLUT thread
+enum FlowMode { FLOW_DENSE, FLOW_SPARSE, FLOW_GPU, NUM_FLOW_MODES };
+static FlowMode flowMode = FLOW_DENSE;
+static FarnebackFlowProvider   denseFlow(FLOW_CHANGE_THRESHOLD, FLOW_ROI_MARGIN, 
+										 FLOW_COLD_ITERATIONS, FLOW_WARM_ITERATIONS);
+static LucasKanadeFlowProvider sparseFlow;
+static GpuFlowProvider*        gpuFlow = NULL;	//GLUT thread only
+static volatile long           gpuFlowState = 0;	//0 untested, 1 working, -1 unsupported
+
+//GPU flow for solvers on the simulation thread: frames go to the GLUT thread and
+//the flow comes back one sensor frame later
+struct FlowJob    { Mat prev, next; };
+struct FlowResult { Mat flow; };
+static TripleBuffer<FlowJob>    flowJobs;
+static TripleBuffer<FlowResult> flowResults;
+
+//OpenGL
+static int win_id;
+static int win_x, win_y;
+static int mouse_down[3];
+static int omx, omy, mx, my;
+
+//per frame images of the grids, each drawn as one textured quad
+static GridTexture densityTexture;
+static GridTexture boundsTexture;
+static GridTexture usersTexture;
+static vector<GLfloat> velocityLines;   //x0, y0, x1, y1 per vector
+
+//pipeline: the capture thread fills captureFrames, the simulation thread reads them
+//and fills simSnapshots, the GLUT thread draws between the last two snapshots
+static TripleBuffer<CaptureFrame> captureFrames;
+static TripleBuffer<SimSnapshot>  simSnapshots;
+static SimSnapshot  snapshotA, snapshotB;
+static SimSnapshot* prevSnapshot = &snapshotA;	//render thread copies
+static SimSnapshot* curSnapshot  = &snapshotB;
+static Thread captureThread;
+static Thread simThread;
+static volatile long pipelineRunning = 0;
+static bool   simOnRenderThread = false;		//the GPU solver needs the OpenGL context
+static double nextSimStep = 0;
+
+//mode changes: the next mode's solver is built on modeThread while the current
+//mode keeps running, then the simulation switches over
+static Thread        modeThread;
+static volatile long modeBuildDone = 0;
+static bool          modeBuilding  = false;
+static int           builtMode;				//mode the solver being built is for
+static FluidSolver*  builtSolver   = NULL;	//NULL for gpuSolver
+static int           requestedMode = -1;	//latest mode asked for while building
+
+//requests from the GLUT thread, applied by the thread that owns the data
+static volatile long pendingMode        = -1;
+static volatile long pendingClear       = 0;
+static volatile long pendingDepthDelta  = 0;
+static volatile long pendingKinectReset = 0;
+static volatile long pendingMotorDelta  = 0;
+static volatile long pendingMotorReset  = 0;
+static volatile long pendingFlowToggle  = 0;
+
+//display flags
+static int dvel, dbound, dusers, dprofile;
+
+//stage timing log, appended to every PROFILE_LOG_MS
+static FILE*  profileLog = NULL;
+static double nextProfileLog = 0;
+
+//mode change variables
+bool autoChangeMode = false;
+bool useWhiteBackground = false;
+int mode = 0;
+int max_mode = 0;
+int iterations = 0;
+int iterations_per_mode = 500; //frames per mode
+//mode change agreed on with the neighbor tiles, see syncTileMode()
+static long tileStep         = 0;
+static int  tileModeNext     = -1;	//mode to switch to, -1 for none
+static long tileModeStep     = 0;	//tileStep it switches on
+
+//forward method declarations
+static void changeMode(int newMode);
+static void open_glut_window ( void );
+static void initOpenGl();
+static void toggleFullscreen();
+static void stopPipeline();
+
+
+/*
+  ----------------------------------------------------------------------
+   free/clear/allocate simulation data
+  ----------------------------------------------------------------------
+*/
+
+/**
+ * Clears all solver data.
+ */
+static void clearData(void)
+{
+	if(useUserSolver && userSolver) 
+		userSolver->reset();
+	else if(!useUserSolver && solver)
+		solver->reset();
+
+	emitters.clear();
+}
+
+
+
+/**
+ * Tells whether a mode runs on the multi user solver.
+ */
+static bool modeUsesUserSolver(int m)
+{
+	return m == 2 || m == 3;
+}
+
+
+
+/**
+ * Creates a cleared solver with the wall's settings. Touches nothing shared, so it
+ * can run on any thread.
+ * @param userMode	true for the multi user solver
+ */
+static FluidSolver* createSolver(bool userMode)
+{
+	FluidSolver* flSolver;
+	if(userMode)
+		flSolver = new FluidSolverMultiUser(MAX_USERS, NX, NY, SIM_DT, 0.00f, 0.0f, userDensityStorage);
+	else
+		flSolver = new FluidSolver(NX, NY, SIM_DT, 0.00f, 0.0f);
+
+	flSolver->setSolverType(FluidSolver::RED_BLACK_SOR);
+	flSolver->setRelaxation(SOR_RELAXATION);
+	flSolver->setTolerance(SOLVER_TOLERANCE, SOLVER_ABS_TOLERANCE);
+	flSolver->setMaxIterations(MAX_SOLVER_ITERATIONS);
+	if(max(NX, NY) >= MULTIGRID_MIN_N)
+		flSolver->setPressureSolver(FluidSolver::PRESSURE_MULTIGRID);
+	flSolver->setActiveTileTracking(true);
+	flSolver->setVelocityDownsampling(velocityDownsampling);
+	flSolver->setAdvectionScheme(densityAdvection, velocityAdvection);
+	//only one solver runs at a time, so they can all share the links
+	if(tiled)
+		flSolver->setHaloExchange(&tileLinks);
+
+	//writes every cell, so the first step does not pay for fresh pages
+	flSolver->reset();
+	return flSolver;
+}
+
+
+
+/**
+ * Body of modeThread: builds the solver for builtMode.
+ */
+static void buildModeSolver(void*)
+{
+	builtSolver = createSolver(modeUsesUserSolver(builtMode));
+	atomicExchange(&modeBuildDone, 1);
+}
+
+
+
+/**
+ * Starts building the solver for a mode. Single user modes on the graphics card keep
+ * gpuSolver, which belongs to the OpenGL context. Tiles have to switch on the same 
+ * step as their neighbors, so they build in place, as does a failed thread start.
+ */
+static void startModeBuild(int newMode)
+{
+	builtMode    = newMode;
+	builtSolver  = NULL;
+	modeBuilding = true;
+	atomicExchange(&modeBuildDone, 0);
+
+	if(!modeUsesUserSolver(newMode) && gpuSolver)
+		atomicExchange(&modeBuildDone, 1);
+	else if(tiled || !modeThread.start(buildModeSolver, NULL))
+		buildModeSolver(NULL);
+}
+
+
+
+/**
+ * Initializes all objects and defines constant variables used in main program.
+ * TODO: relegate this code to a singleton class.
+ */
+static int allocateData ( void )
+{
+	//square cells over the whole sensor frame
+	NX = N_DEF;
+	NY = N_DEF * Y_RES / X_RES;
+	//red/black sweeps color cells by local index, tiles need even sizes to agree
+	if(tiled) {
+		NX += NX & 1;
+		NY += NY & 1;
+	}
+
+	//the solvers follow the mode, the first one is built by startPipeline()
+	simScheduler.setCflLimit(SIM_CFL_CELLS);
+	simScheduler.setMaxSubsteps(MAX_SIM_SUBSTEPS);
+	simScheduler.setIterationRange(MIN_SOLVER_ITERATIONS, MAX_SOLVER_ITERATIONS);
+	if(tiled) {
+		//every tile has to run the same mode and iteration count, see syncTileMode()
+		cout<<"Waiting for the neighbor tiles..."<<endl;
+		if(!tileLinks.open(TILE_CONNECT_MS))
+			cout<<"Not every neighbor tile connected, those sides stay walls"<<endl;
+	}
+	if(playPath) {
+		if(!capturePlayer.open(playPath) || capturePlayer.getWidth() != X_RES || capturePlayer.getHeight() != Y_RES) {
+			cout<<"Cannot play "<<playPath<<", it needs "<<X_RES<<"x"<<Y_RES<<" frames"<<endl;
+			return ( 0 );
+		}
+		capturePlayer.setPlayback(!playFast, true);
+		captureSource = &capturePlayer;
+		cout<<"Playing "<<capturePlayer.getFrameCount()<<" frames from "<<playPath<<endl;
+	}
+	else {
+		kinect = new KinectController(MAX_USERS, ITERATIONS_BEFORE_RESET, INIT_DEPTH, INIT_MOTOR);
+		captureSource = kinect;
+	}
+	if(recordPath && !captureRecorder.open(recordPath, X_RES, Y_RES))
+		cout<<"Cannot record to "<<recordPath<<endl;
+
+	downsampler = new GridDownsampler(X_RES, Y_RES, NX, NY);
+	flow = Mat::zeros(NY, NX, CV_32FC2);
+
+	useFlow = true;
+
+	#if DEBUG
+		namedWindow("Users",1);
+		namedWindow("flow", 1);
+	#endif
+	#if USE_WEBCAM
+		cap.open(WEBCAM_ID);
+		if( !cap.isOpened() )
+		{
+			cout << "***Could not initialize capturing...***\n";
+		}
+	#endif
+
+	return ( 1 );
+}
+
+
+/**
+ * Cleans up any allocated memory.
+ */
+void cleanupExit()
+{
+	stopPipeline();
+	telemetry.close();
+	captureRecorder.close();
+	if (glutGameModeGet(GLUT_GAME_MODE_ACTIVE))
+		glutLeaveGameMode();
+	exit(0);
+}
+
+
+
+/**
+ * Finds the largest rectangle of the window with the grid's aspect ratio, centered.
+ * The grid is drawn into it, so cells stay square whatever the shape of the window.
+ */
+static void getGridViewport(int& x, int& y, int& width, int& height)
+{
+	width  = win_x;
+	height = win_x * NY / NX;
+	if(height > win_y) {
+		height = win_y;
+		width  = win_y * NX / NY;
+	}
+	x = (win_x - width)  / 2;
+	y = (win_y - height) / 2;
+}
+
+
+
+/**
+ * Used for debug and basic testing of fluid simulation. Drives fluid simulation based on
+ * mouse input. 
+ * - Left Mouse Button + Drag adds velocity
+ * - Middle Mouse Button adds boundaries, 
+ * - Right Mouse Button adds density. 
+ *
+ */
+static void getForcesFromMouse(FluidSolver* flSolver)
+{
+	int x, y, gx, gy, gw, gh;
+
+	bool noButtonsPressed = !mouse_down[0] && !mouse_down[2] && !mouse_down[1];
+	if (noButtonsPressed) return;
+
+	// determine mouse position on the fluid grid by dividing the grid's part of the
+	// window into NX x NY gridspaces
+	getGridViewport(gx, gy, gw, gh);
+	x = (int)(((        mx  - gx) / (float)gw) * NX + 1);
+	y = (int)(((win_y - my  - gy) / (float)gh) * NY + 1);
+
+	bool isMouseOutsideFluidGrid = (x < 1) || (x > NX) || (y < 1) || (y > NY);
+	if (isMouseOutsideFluidGrid) return;
+
+	if (mouse_down[0]) {	//left mouse button
+		flSolver->addHorzVelocityAt(x, y, force * (mx - omx));
+		flSolver->addVertVelocityAt(x, y, force * (omy - my));
+	}
+
+	if (mouse_down[1])		// middle mouse button
+		flSolver->setBoundAt(x, y, true);
+
+	if (mouse_down[2])		// right mouse button
+		if(useUserSolver)
+			userSolver->addDensityAt(1, x, y, source);
+		else
+			flSolver->addDensityAt(x, y, source);
+
+	omx = mx;
+	omy = my;
+
+	return;
+}
+
+
+
+/**
+ * Loads texture kinect, recording or webcam and flips image
+ * horizontally and vertically, resizes it to the simulation grid and
+ * publishes it in captureFrames. Blocks until the sensor has a new frame.
+ * Records the frame when -record was given. Runs on the capture thread.
+ */
+int loadImage() {
+	PROFILE_SCOPE(PROFILE_CAPTURE);
+	// TODO: clean up redundant names since we are now only supporting kinect input
+	Mat frame;
+	CaptureFrame& out = captureFrames.writeBuffer();
+
+	#if USE_WEBCAM
+		Mat threshImg, webcamImage;
+
+		cap >> webcamImage;
+		cvtColor(webcamImage, threshImg, CV_BGR2GRAY);
+		threshold(threshImg, frame, 180, 200, CV_THRESH_BINARY_INV);
+	#endif
+
+	// depth tracking. Without a frame, e.g. while user tracking restarts, nothing is
+	// published and the simulation keeps the last good one
+	{
+		PROFILE_SCOPE(PROFILE_KINECT_UPDATE);
+		if(!captureSource->grabFrame())
+			return -1;
+	}
+	depthMatrix = captureSource->getDepthMat();	//no copy, only read before the next update
+	frame = depthMatrix;
+	
+	if(frame.empty()) {
+		cout<<"ERROR: Cannot load frame"<<endl;
+        return -1;
+	}
+
+	// Reduce depth, user IDs and bounds to the simulation grid, flipped vertically.
+	// User IDs are always done, so a switch to a user mode has them ready.
+	usersMatrix = captureSource->getUsersMat();
+	if(captureRecorder.isOpen())
+		captureRecorder.writeFrame(depthMatrix, usersMatrix, timeMs());
+	downsampler->downsample(frame, usersMatrix, out.image, out.users, out.bounds);
+	//imshow("Users", out.users*100);
+
+	captureFrames.publish();
+    return 0;
+}
+
+/**
+ * Translates a bounds mask into boundaries in the FluidSolver. 
+ * Any pixel of the mask with a value greater than zero becomes a boundary.
+ * Pixel (x, y) is cell (x + 1, y + 1) because fluid matrix indicies start at 1.
+ */
+static void defineBoundsFromImage(FluidSolver* flSolver, const Mat &mask)
+{
+	flSolver->setBoundsFromMask(mask.data, (int) mask.step);
+}
+
+
+/**
+ * Draws and displays a graphical representation of the optical flow results using OpenCV.
+ * @param flow		- Matrix of type CV_32FC2 containing results of optical flow calculation.
+ * @param cflowmap	- Color image representing the input of optical flow
+ * @param step		- number of pixels to skip when drawing each vector. (drawing a vector for 
+ *                    every pixel would be too dense and graphically noisy.
+ * @param color		- CV_RGB scalar specifying color to draw the optical flow vectors.
+ */
+void drawOptFlowMap(const Mat& flow, Mat& cflowmap, int step,
+                    double, const Scalar& color)
+{
+    for(int y = 0; y < cflowmap.rows; y += step)
+        for(int x = 0; x < cflowmap.cols; x += step)
+        {
+            const Point2f& fxy = flow.at<Point2f>(y, x);
+            line(cflowmap, Point(x,y), Point(cvRound(x+fxy.x), cvRound(y+fxy.y)),
+                 color);
+            circle(cflowmap, Point(x,y), 2, color, -1);
+        }
+}
+
+
+
+/**
+ * Runs the GPU flow provider, creating it on first use. Marks the GPU path as
+ * unsupported if the context cannot run it, so later frames fall back to dense flow.
+ * GLUT thread only.
+ *
+ * @return False if no flow was computed.
+ */
+static bool computeGpuFlow(const Mat& prev, const Mat& next, Mat& flow)
+{
+	if(gpuFlowState < 0)
+		return false;
+	if(!gpuFlow) {
+		if(!GpuFlowProvider::isSupported()) {
+			cout<<"GPU optical flow is not supported, using dense flow"<<endl;
+			atomicExchange(&gpuFlowState, -1);
+			return false;
+		}
+		gpuFlow = new GpuFlowProvider();
+	}
+
+	gpuFlow->computeFlow(prev, next, flow);
+	if(gpuFlow->hasFailed()) {
+		atomicExchange(&gpuFlowState, -1);
+		return false;
+	}
+	atomicExchange(&gpuFlowState, 1);
+	return true;
+}
+
+
+
+/**
+ * Computes the flow of the frame pair the simulation thread posted, if there is a
+ * new one, and posts the result back. GLUT thread only.
+ */
+static void serveFlowJobs()
+{
+	if(!flowJobs.update())
+		return;
+
+	FlowJob& job = flowJobs.readBuffer();
+	FlowResult& result = flowResults.writeBuffer();
+	if(!computeGpuFlow(job.prev, job.next, result.flow))
+		result.flow = Mat::zeros(job.next.size(), CV_32FC2);
+	flowResults.publish();
+}
+
+
+
+/**
+ * GPU flow from the simulation thread: posts the current frame pair to the GLUT
+ * thread and picks up the flow of the pair before, if it is ready. Otherwise the
+ * flow is zero for this frame.
+ */
+static void requestGpuFlow(Mat& flow)
+{
+	FlowJob& job = flowJobs.writeBuffer();
+	prevFlowImg.copyTo(job.prev);
+	flowImg.copyTo(job.next);
+	flowJobs.publish();
+
+	if(flowResults.update() && flowResults.readBuffer().flow.size() == flow.size())
+		flowResults.readBuffer().flow.copyTo(flow);
+	else
+		flow.setTo(Scalar::all(0));
+}
+
+
+
+/**
+ * Sparse flow: Lucas-Kanade at the silhouette cells emitSplashes tests,
+ * open cells right below a bound cell in the splash rows. The rest of the flow is zero.
+ */
+static void computeSparseFlow(FluidSolver* flSolver, Mat& flow)
+{
+	int i, j;
+	vector<Point2f>& points = sparseFlow.getPoints();
+	
+	points.clear();
+	for(j = 1; j < NUM_SPLASH_ROWS && j < NY; j++)
+		for(i = 1; i <= NX; i++)
+			if(!flSolver->isBoundAt(i, j) && flSolver->isBoundAt(i, j+1))
+				points.push_back(Point2f((float)(i - 1), (float)(j - 1)));
+
+	sparseFlow.computeFlow(prevFlowImg, flowImg, flow);
+}
+
+
+
+/**
+ * Translates optical flow into velocity values. Results are added directly into 
+ * FluidSolver; the GPU solver takes GPU flow straight from its texture.
+ */
+static void computeOpticalFlow(FluidSolver* flSolver, Mat& flow)
+{
+	Mat cflow;
+
+	if(prevFlowImg.data && prevFlowImg.size() == flowImg.size() && flow.size() == flowImg.size()) 
+	{
+		bool flowOnGpu = false;
+		FlowMode usedMode = flowMode;
+		if(usedMode == FLOW_GPU && gpuFlowState < 0)
+			usedMode = FLOW_DENSE;
+
+		if(usedMode == FLOW_SPARSE)
+			computeSparseFlow(flSolver, flow);
+		else if(usedMode == FLOW_GPU && simOnRenderThread) {
+			flowOnGpu = computeGpuFlow(prevFlowImg, flowImg, flow);
+			if(!flowOnGpu)
+				denseFlow.computeFlow(prevFlowImg, flowImg, flow);
+		}
+		else if(usedMode == FLOW_GPU)
+			requestGpuFlow(flow);
+		else
+			denseFlow.computeFlow(prevFlowImg, flowImg, flow);
+		#if DEBUG 
+			cvtColor(prevFlowImg, cflow, CV_GRAY2BGR);
+			drawOptFlowMap(flow, cflow, 16, 1.5, CV_RGB(0, 255, 0));
+			imshow("flow", cflow);
+		#endif
+
+		//flow row y-1 drives solver row y, like the bounds mask
+		if(flowOnGpu && gpuSolver && flSolver == gpuSolver)
+			gpuSolver->addVelocityTexture(gpuFlow->getFlowTexture(), FLOW_SCALAR);
+		else if(flow.rows == NY && flow.cols == NX)
+			flSolver->addVelocityField(flow.ptr<float>(), (int)flow.step, FLOW_SCALAR);
+	}
+
+	std::swap(prevFlowImg, flowImg);
+}
+
+/**
+ * Returns the falloff of emitters of a given radius as a solver stamp, built on first use.
+ * Velocity grows linearly from the center to the rim, along its own axis only; density
+ * averages the two.
+ */
+static const FluidSolver::SplatStamp* getEmitterStamp(int radius)
+{
+	if(radius < 1)
+		return NULL;
+	if(radius >= (int)emitterStamps.size())
+		emitterStamps.resize(radius + 1);
+
+	FluidSolver::SplatStamp& stamp = emitterStamps[radius];
+	if(stamp.radius != radius) {
+		int width = 2 * radius + 1;
+		stamp.radius = radius;
+		stamp.u.resize(width * width);
+		stamp.v.resize(width * width);
+		stamp.density.resize(width * width);
+
+		for(int dy = -radius; dy <= radius; dy++)
+			for(int dx = -radius; dx <= radius; dx++) {
+				int k = (dx + radius) + width * (dy + radius);
+				stamp.u[k]       = (float)abs(dx) / radius;
+				stamp.v[k]       = (float)abs(dy) / radius;
+				stamp.density[k] = (stamp.u[k] + stamp.v[k]) / 2;
+			}
+	}
+	return &stamp;
+}
+
+
+
+/**
+ * Iterates through the emitter pool and adds forces to fluid simulation for each emitter,
+ * in one batch. Also kills emitters that have expired.
+ * @param e		- Reference to the pool of emitters to render.
+ */
+static void renderEmitters(FluidSolver* flSolver, EmitterPool &e)
+{
+	e.removeExpired();
+
+	const int*   cx       = e.getCenterX();
+	const int*   cy       = e.getCenterY();
+	const float* eu       = e.getVelocityX();
+	const float* ev       = e.getVelocityY();
+	const int*   lifespan = e.getLifespan();
+	const int*   elapsed  = e.getLifeElapsed();
+	const int*   radius   = e.getRadius();
+	const int*   userNo   = e.getUserNo();
+
+	emitterSplats.resize(e.size());
+	for (int i = 0; i < e.size(); i++) {
+		//calculate scalar for temporal falloff overlifespan
+		float lifescalar = (lifespan[i] - elapsed[i]) / lifespan[i];
+
+		FluidSolver::Splat& s = emitterSplats[i];
+		s.x       = cx[i];
+		s.y       = cy[i];
+		s.u       = eu[i];
+		s.v       = ev[i];
+		s.density = source * lifescalar;
+		s.user    = useUserSolver ? userNo[i] : 0;
+		s.stamp   = getEmitterStamp(radius[i]);
+	}
+
+	if(!emitterSplats.empty())
+		flSolver->addSplats(&emitterSplats[0], (int)emitterSplats.size());
+	e.age();
+}
+
+
+
+/**
+ * Creates an emitter object with given properties. When the pool is full the 
+ * new emitter is merged into a nearby one, or replaces the oldest.
+ */
+static void createEmitterAt(int center_x, int center_y, float force_u, float force_v, int lifespan, int radius, int userNo = 1)
+{
+	emitters.spawn(center_x, center_y, force_u, force_v, lifespan, radius, userNo);
+
+	#if DEBUG
+		cout<<"Emitter created: "<<emitters.size()<<endl;
+	#endif
+}
+
+
+
+/**
+ * Creates emitter objects based on optical flow velocity. If vertical velocity is negative at boundaries,
+ * an emitter is created. An emission threshold prevents negative velocities due to noise from creating 
+ * emitters. In the call tree, we assume this function is called after computeOpticalFlow.
+ * Only called for new sensor frames; renderEmitters applies the emitters every step.
+ *
+ * @param flsolver	Fulid Solver to emit splashes into
+ * @param flow		Reference to a matrix containing optical flow velocities.
+ */
+static void emitSplashes(FluidSolver* flSolver, Mat &flow)
+{
+	//precondition: optical flow has been calculated
+	float fu, fv;
+	fu = fv = 0.0;
+	int emitter_lifespan = 15;
+	int emitter_radius = 6;
+	int velocityEmissionThreshold = -0.05; //creates emitters based on velocity emission
+
+	if(useFlow) {
+		// Only look for emitters in splash rows.
+		for( int j = 1; j < NUM_SPLASH_ROWS && j < NY; j++) { 
+			for(int i = 1; i <= NX; i++) {
+													
+				bool vertBoundChangesToYes = !flSolver->isBoundAt(i, j) && flSolver->isBoundAt(i, j+1);
+				if(vertBoundChangesToYes) { 
+					//flow and user rows are one below the grid rows
+					const Point2f& opticalFlowVelocity = flow.at<Point2f>(j-1, i-1);
+					fu = .8 *  opticalFlowVelocity.x;
+					fv = .8 *  opticalFlowVelocity.y;
+
+					if(opticalFlowVelocity.y < velocityEmissionThreshold) 
+						if(useUserSolver) {
+							int userNo = usersMatrixResize.at<uchar>(j, i-1);
+							createEmitterAt(i, j-1, fu, fv, 6, 3, userNo);
+						}
+						else
+							createEmitterAt(i, j-1, fu, fv, 6, 3, 1);
+				}
+			}
+		}
+	}
+	else {
+		// TODO: move this code into a separate function?
+		// emit splashes on either side of whole silhouette
+		for (int j = 1; j <= NY; j++) { 
+			for (int i = 1; i <= NX; i++) {
+				bool horzBoundChangesToYes = !flSolver->isBoundAt(i, j) && flSolver->isBoundAt(i+1, j);
+				bool horzBoundChangesToNo  = flSolver->isBoundAt(i, j) && !flSolver->isBoundAt(i+1, j);
+
+				if(horzBoundChangesToYes) {
+					fu = -0.05; // emit velocity in negative direction
+					fv = 0.1;
+					flSolver->addHorzVelocityAt(i, j, force * fu);
+					flSolver->addVertVelocityAt(i, j, force * fv);
+				}
+				else if(horzBoundChangesToNo) { 
+					fu = 0.05; // emit velocity in positive direction
+					fv = 0.1;
+					flSolver->addHorzVelocityAt(i+1, j, force * fu);
+					flSolver->addVertVelocityAt(i+1, j, force * fv);
+				}
+			}
+		}
+	}
+}
+
+
+
+/**
+ * Switches to a mode whose solver is ready. The solver the last mode ran on is 
+ * released; gpuSolver stays with its context and is cleared instead.
+ * @param built  the mode's new solver, NULL to use gpuSolver
+ */
+static void applyMode(int newMode, FluidSolver* built)
+{
+	if(solver != gpuSolver)
+		delete solver;
+	delete userSolver;
+	solver     = NULL;
+	userSolver = NULL;
+
+	if(modeUsesUserSolver(newMode))
+		userSolver = (FluidSolverMultiUser*) built;
+	else if(built)
+		solver = built;
+	else {
+		solver = gpuSolver;
+		gpuSolver->reset();
+	}
+	emitters.clear();
+
+	mode = newMode;
+	useUserSolver = modeUsesUserSolver(newMode);
+	switch(newMode)
+	{
+		case 0:
+			source  = 20.0f;
+			dvel    = false;
+			dbound  = false;
+			dusers  = false;
+			useFlow = true;
+			useWhiteBackground = false;
+			cout<<"Changing to mode 0: Single color density"<<endl;
+			break;
+		case 1:
+			source  = 20.0f;
+			dvel    = true;
+			dbound  = false;
+			dusers  = false;
+			useFlow = false;
+			useWhiteBackground = false;
+			cout<<"Changing to mode 1: Vectors without optical flow"<<endl;
+			break;
+		case 2:
+			source  = 20.0f;
+			dvel    = false;
+			dbound  = false;
+			dusers  = true;
+			useFlow = true;
+			useWhiteBackground = false;
+			cout<<"Changing to mode 2: Multi-color user emission"<<endl;
+			break;
+		case 3:
+			source  = 20.0f;
+			dvel    = false;
+			dbound  = false;
+			dusers  = false;
+			useFlow = true;
+			useWhiteBackground = true;
+			cout<<"Changing to mode 3: White background"<<endl;
+			break;
+	}
+}
+
+
+
+/**
+ * Changes various modes. Modes are given integer numbers to work with auto switcher function.
+ * The switch happens in finishModeChange(), once the mode's solver has been built, so
+ * the current mode keeps running meanwhile. Runs on the thread that simulates.
+ * @param newMode	Mode number to change to. Valid values 0-3.
+ */
+static void changeMode(int newMode)
+{
+	requestedMode = newMode;
+	if(!modeBuilding)
+		startModeBuild(newMode);
+}
+
+
+
+/**
+ * Completes a mode change whose solver is ready, or starts over when another mode
+ * was asked for in the meantime.
+ */
+static void finishModeChange()
+{
+	if(!modeBuilding || !atomicExchange(&modeBuildDone, 0))
+		return;
+	modeThread.join();
+	modeBuilding = false;
+
+	if(builtMode != requestedMode) {
+		delete builtSolver;
+		startModeBuild(requestedMode);
+		return;
+	}
+	applyMode(builtMode, builtSolver);
+	builtSolver = NULL;
+}
+
+
+
+/**
+ * Tries to change the mode if iterations have reached iterations_per_mode.
+ */
+static void tryChangeMode()
+{
+	if(autoChangeMode && (iterations > iterations_per_mode))
+	{
+		iterations = 0;
+		mode++;
+		if(mode > max_mode)
+			mode = 0;
+
+		changeMode(mode);
+	}
+	else
+		iterations++;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+/*
+  ----------------------------------------------------------------------
+   OpenGL specific drawing routines
+  ----------------------------------------------------------------------
+*/
+
+/**
+ * Draws fluid velocity vectors in OpenGL, interpolated between two simulation steps.
+ * @param a, b	snapshots to interpolate between
+ * @param t		weight of b
+ *
+ */
+static void drawVelocity(const SimSnapshot& a, const SimSnapshot& b, float t)
+{
+	int i, j, k;
+	float x, y, hx, hy, u, v;
+
+	hx = 1.0f / NX;
+	hy = 1.0f / NY;
+	//velocities are in units of the longer side
+	float sx = max(NX, NY) * hx, sy = max(NX, NY) * hy;
+
+	velocityLines.clear();
+	for (i = 1; i <= NX; i++) {
+		x = (i - 0.5f) * hx;
+
+		for (j = 1; j <= NY; j++) {
+			k = i + (NX + 2) * j;
+			u = a.u[k] + t * (b.u[k] - a.u[k]);
+			v = a.v[k] + t * (b.v[k] - a.v[k]);
+
+			//inactive tiles hold no velocity, nothing to draw
+			if(u == 0.0f && v == 0.0f)
+				continue;
+
+			y = (j - 0.5f) * hy;
+			velocityLines.push_back(x);
+			velocityLines.push_back(y);
+			velocityLines.push_back(x + sx * u);
+			velocityLines.push_back(y + sy * v);
+		}
+	}
+
+	if(velocityLines.empty())
+		return;
+
+	glColor3f(1.0f, 1.0f, 1.0f);
+	glLineWidth(1.0f);
+
+	//one draw call for all vectors
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, &velocityLines[0]);
+	glDrawArrays(GL_LINES, 0, (GLsizei)(velocityLines.size() / 2));
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+
+/**
+ * Draws bounding cells in OpenGL, as a grey overlay with square cells.
+ * @param snap	simulation step containing the bounds to draw.
+ *
+ */
+static void drawBounds(const SimSnapshot& snap)
+{
+	int i, j;
+	float hx, hy;
+	hx = 1.0f / NX; //calculate unit length of each cell
+	hy = 1.0f / NY;
+
+	//one texel per cell including the buffer ring, transparent where there is fluid
+	if(boundsTexture.getWidth() != NX + 2 || boundsTexture.getHeight() != NY + 2)
+		boundsTexture.resize(NX + 2, NY + 2, false);
+
+	for (j = 0; j <= NY + 1; j++)
+		for (i = 0; i <= NX + 1; i++)
+			boundsTexture.setPixel(i, j, 0.30f, 0.30f, 0.30f, snap.bounds[i + (NX + 2) * j] ? 1.0f : 0.0f);
+	boundsTexture.upload();
+
+	//cell i covers [i*hx, (i+1)*hx]
+	boundsTexture.draw(0.0f, 0.0f, (NX + 2) * hx, (NY + 2) * hy, 0.0f, 0.0f, 1.0f, 1.0f);
+}
+
+
+typedef struct {float R, G, B;} RGBType;
+typedef struct {float H, S, V;} HSVType;
+
+#define RETURN_RGB(r, g, b) {RGB.R = r; RGB.G = g; RGB.B = b; return RGB;}
+#define RETURN_HSV(h, s, v) {HSV.H = h; HSV.S = s; HSV.V = v; return HSV;}
+#define UNDEFINED -1
+
+/**
+ *  Converts an HSV color into RGB color space. 
+ *
+ *  @param HSV	HSV color variable to convert into RGB.
+ */
+RGBType HSV_to_RGB( HSVType HSV ) 
+{
+	// H is given on [0, 6] or UNDEFINED. S and V are given on [0, 1].
+	// RGB are each returned on [0, 1].
+	float h = HSV.H, s = HSV.S, v = HSV.V, m, n, f;
+	int i;
+	RGBType RGB;
+	if (h == UNDEFINED) 
+		RETURN_RGB(v, v, v);
+	i = floor(h);
+	f = h - i;
+	if ( !(i&1) ) 
+		f = 1 - f; // if i is even
+	m = v * (1 - s);
+	n = v * (1 - s * f);
+
+	switch (i) 
+	{
+		case 6 :
+		case 0 : RETURN_RGB(v, n, m);
+		case 1 : RETURN_RGB(n, v, m);
+		case 2 : RETURN_RGB(m, v, n)
+		case 3 : RETURN_RGB(m, n, v);
+		case 4 : RETURN_RGB(n, m, v);
+		case 5 : RETURN_RGB(v, m, n);
+	}
+}
+
+
+#if USE_KINECT
+/**
+ *  Computes the weighted color of all the user densities at a particular 
+ *  pixel coordinate.
+ *  @param x	x-coordinate 
+ *  @param y	y-coordinate
+ */
+RGBType getWeightedColor(int x, int y)
+{
+	RGBType RGB;
+	float R, G, B;
+	R=G=B=0;
+
+	for(int i = 0; i < MAX_USERS; i++) {
+		float densityVal = userSolver->getDensityAt(i, x, y);
+		
+		if(useWhiteBackground) {
+			R += ColorsWhiteBG[i][0] * densityVal;
+			G += ColorsWhiteBG[i][1] * densityVal;
+			B += ColorsWhiteBG[i][2] * densityVal;
+		}
+		else {
+			R += Colors[i][0] * densityVal;
+			G += Colors[i][1] * densityVal;
+			B += Colors[i][2] * densityVal;
+		}
+	} 
+
+	RGB.R = R; RGB.B = B; RGB.G = G; 
+	return RGB;
+}
+#endif
+
+
+
+/**
+ * Captures what the render thread needs from the solver into simSnapshots and
+ * publishes it. Density is stored as color, computed once per cell here.
+ *
+ * @param flSolver	fluid solver that just ran a step
+ */
+static void publishSnapshot ( FluidSolver* flSolver )
+{
+	int i, j, k;
+	float d;
+	RGBType rgb;
+	SimSnapshot& snap = simSnapshots.writeBuffer();
+	int size = (NX + 2) * (NY + 2);
+
+	snap.color.resize(3 * size);
+	snap.u.resize(size);
+	snap.v.resize(size);
+	snap.bounds.resize(size);
+	snap.userMode   = useUserSolver;
+	snap.gpuDensity = !useUserSolver && gpuSolver && flSolver == gpuSolver;
+
+	//the GPU solver keeps its fields in textures, only velocity has to come back
+	if(snap.gpuDensity && dvel)
+		gpuSolver->syncToHost();
+
+	//the solver pads its rows, the snapshot does not
+	const float* u      = flSolver->getHorzVelocityData();
+	const float* v      = flSolver->getVertVelocityData();
+	const float* dens   = flSolver->getDensityData();
+	const bool*  bounds = flSolver->getBoundsData();
+	int stride = flSolver->getStride();
+
+	for ( j=0 ; j<=NY+1 ; j++ ) 
+	{
+		memcpy(&snap.u[(NX + 2) * j], u + stride * j, (NX + 2) * sizeof(float));
+		memcpy(&snap.v[(NX + 2) * j], v + stride * j, (NX + 2) * sizeof(float));
+
+		for ( i=0 ; i<=NX+1 ; i++ ) 
+		{
+			k = i + (NX + 2) * j;
+			snap.bounds[k] = bounds[i + stride * j] ? 1 : 0;
+
+			if(snap.gpuDensity)
+				continue;
+
+			if(useUserSolver) {
+				//render density color for each point based on blending user values
+				rgb = getWeightedColor(i,j);
+			}
+			else {
+				//if a cell is a bounds cell, do not apply a background offset
+				d = snap.bounds[k] ? 0 : BG_OFFSET + dens[i + stride * j];
+
+				//hsv to rgb using the density in the cell
+				HSVType hsv = {DENSITY_HUE, DENSITY_SAT, d};
+				rgb = HSV_to_RGB(hsv);
+			}
+			snap.color[3*k    ] = rgb.R;
+			snap.color[3*k + 1] = rgb.G;
+			snap.color[3*k + 2] = rgb.B;
+		}
+	}
+
+	if(useUserSolver && usersMatrixResize.rows == NY && usersMatrixResize.cols == NX) {
+		snap.users.resize(NX * NY);
+		for ( j=0 ; j<NY ; j++ ) 
+			memcpy(&snap.users[j * NX], usersMatrixResize.ptr<uchar>(j), NX);
+	}
+	else
+		snap.users.clear();
+
+	snap.time = timeMs();
+	simSnapshots.publish();
+}
+
+
+
+/**
+ * Render density grids as a texture, interpolated between cell centers
+ * and between two simulation steps.
+ *
+ * @param a, b	snapshots to interpolate between
+ * @param t		weight of b
+ */
+static void drawDensity ( const SimSnapshot& a, const SimSnapshot& b, float t )
+{
+	int i, j, k;
+	float hx, hy;
+	hx = 1.0f/NX;
+	hy = 1.0f/NY;
+
+	//the GPU solver keeps density in a texture, draw it from there
+	if(b.gpuDensity) {
+		HSVType hsv = {DENSITY_HUE, DENSITY_SAT, 1.0f};
+		RGBType rgb = HSV_to_RGB(hsv);
+		gpuSolver->drawDensity(rgb.R, rgb.G, rgb.B, BG_OFFSET);
+		return;
+	}
+
+	//one texel per cell including the buffer ring
+	if(densityTexture.getWidth() != NX + 2 || densityTexture.getHeight() != NY + 2)
+		densityTexture.resize(NX + 2, NY + 2, true);
+
+	for ( j=1 ; j<=NY+1 ; j++ ) 
+	{
+		for ( i=1 ; i<=NX+1 ; i++ ) 
+		{
+			k = 3 * (i + (NX + 2) * j);
+			densityTexture.setPixel(i, j, a.color[k    ] + t * (b.color[k    ] - a.color[k    ]),
+			                              a.color[k + 1] + t * (b.color[k + 1] - a.color[k + 1]),
+			                              a.color[k + 2] + t * (b.color[k + 2] - a.color[k + 2]));
+		}
+	}
+	densityTexture.upload();
+
+	//cell i is drawn at (i - 0.5) * hx, so the quad runs from the center of cell 1
+	//to the center of cell NX+1. Texel centers sit at (i + 0.5) / (NX+2).
+	float s0 = 1.5f / (NX + 2),         t0 = 1.5f / (NY + 2);
+	float s1 = (NX + 1.5f) / (NX + 2),  t1 = (NY + 1.5f) / (NY + 2);
+	densityTexture.draw(0.5f * hx, 0.5f * hy, (NX + 0.5f) * hx, (NY + 0.5f) * hy, s0, t0, s1, t1);
+}
+
+
+
+#if USE_KINECT
+/**
+ * Draws user silhouettes in unique colors per user in OpenGL. 
+ * Uses the users matrix from kinect, as of the given simulation step.
+ *
+ */
+static void drawUsers(const SimSnapshot& snap)
+{
+	int i, j;
+	int d00;
+	const int numColors = sizeof(Colors) / sizeof(Colors[0]);
+
+	//nothing to show before the first frame from the sensor
+	if((int)snap.users.size() < NX * NY)
+		return;
+
+	//one texel per pixel of the NX x NY users matrix, transparent where there is no user
+	if(usersTexture.getWidth() != NX || usersTexture.getHeight() != NY)
+		usersTexture.resize(NX, NY, false);
+
+	for ( j=0 ; j<NY ; j++ ) 
+	{
+		for ( i=0 ; i<NX ; i++ ) 
+		{
+			d00 = snap.users[j * NX + i];
+			if(d00 != 0 && d00 < numColors)
+				usersTexture.setPixel(i, j, Colors[d00][0], Colors[d00][1], Colors[d00][2]);
+			else
+				usersTexture.setPixel(i, j, 0.0f, 0.0f, 0.0f, 0.0f);
+		}
+	}
+	usersTexture.upload();
+
+	usersTexture.draw(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+}
+#endif
+
+
+
+/**
+ * Draws the per stage timings (milliseconds per frame over the last PROFILE_HISTORY
+ * frames) as text over the top left of the window.
+ */
+static void drawProfile(void)
+{
+	char line[128];
+	ProfileStats stats;
+	float lineHeight = 15.0f / win_y;
+	float x = 8.0f / win_x;
+	float y = 1.0f - lineHeight;
+
+	//laid out in window pixels, over the bars next to the grid as well
+	glViewport(0, 0, win_x, win_y);
+
+	//darken the area behind the text
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
+	glRectf(0.0f, 1.0f - (PROFILE_STAGE_COUNT + 1.5f) * lineHeight, 400.0f / win_x, 1.0f);
+	glPopAttrib();
+
+	glColor3f(1.0f, 1.0f, 1.0f);
+	for(int s = -1; s < PROFILE_STAGE_COUNT; s++) {
+		if(s < 0)
+			sprintf(line, "%-20s %7s %7s %7s %7s", "stage (ms)", "min", "avg", "p99", "max");
+		else {
+			profileGetStats((ProfileStage) s, &stats);
+			sprintf(line, "%-20s %7.2f %7.2f %7.2f %7.2f", profileStageName((ProfileStage) s),
+					stats.min, stats.avg, stats.p99, stats.max);
+		}
+
+		glRasterPos2f(x, y);
+		for(const char* c = line; *c; c++)
+			glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+		y -= lineHeight;
+	}
+}
+
+
+
+/**
+ * Appends the stage timings to PROFILE_LOG_PATH every PROFILE_LOG_MS.
+ * The first call only schedules the first dump.
+ */
+static void logProfile(void)
+{
+	double now = timeMs();
+
+	if(nextProfileLog == 0) {
+		nextProfileLog = now + PROFILE_LOG_MS;
+		return;
+	}
+	if(now < nextProfileLog)
+		return;
+	nextProfileLog = now + PROFILE_LOG_MS;
+
+	bool header = false;
+	if(!profileLog) {
+		profileLog = fopen(PROFILE_LOG_PATH, "a");
+		if(!profileLog) {
+			cout<<"ERROR: Cannot open "<<PROFILE_LOG_PATH<<", stage timings will not be logged"<<endl;
+			nextProfileLog = 1e300;
+			return;
+		}
+		fseek(profileLog, 0, SEEK_END);
+		header = (ftell(profileLog) == 0);
+	}
+	profileWriteCsv(profileLog, now / 1000.0, header);
+}
+
+
+
+/*
+  ----------------------------------------------------------------------
+   capture / simulation pipeline
+  ----------------------------------------------------------------------
+*/
+
+/**
+ * Sets the telemetry gauges the simulation owns, from the last solver update.
+ */
+static void reportSolverTelemetry(FluidSolver* flSolver)
+{
+	const vector<FluidSolver::SolveStats>& solves = flSolver->getSolveStats();
+	int   iterations = 0;
+	float residual   = -1.0f;	//the GPU solver does not measure it
+	for(size_t k = 0; k < solves.size(); k++) {
+		iterations += solves[k].iterations;
+		residual    = max(residual, solves[k].residual);
+	}
+	telemetrySet(TELEMETRY_SOLVER_ITERATIONS, (float) iterations);
+	if(residual >= 0)
+		telemetrySet(TELEMETRY_SOLVER_RESIDUAL, residual);
+	else
+		telemetryClear(TELEMETRY_SOLVER_RESIDUAL);
+	telemetrySet(TELEMETRY_EMITTERS, (float) emitters.size());
+}
+
+
+
+/**
+ * Agrees on mode changes with the neighbor tiles. Every tile has to switch on the
+ * same step or their exchanges fall out of step, so a mode asked for on one tile 
+ * is scheduled TILE_MODE_DELAY_STEPS ahead and passed from neighbor to neighbor 
+ * once per step; walls up to that many tiles across all hear of it in time. Of two
+ * schedules the earlier one wins, so every tile ends up with the same one, and a 
+ * key pressed while a change is on its way is dropped. Tiles step in lockstep from
+ * the start, which keeps their step counts equal.
+ * @param requested  mode asked for on this tile, -1 for none
+ * @return           mode to change to on this step, -1 for none
+ */
+static int syncTileMode(long requested)
+{
+	int s;
+	int message[HaloExchange::SIDE_COUNT][2];
+	const void* send[HaloExchange::SIDE_COUNT];
+	void*       recv[HaloExchange::SIDE_COUNT];
+	int         bytes[HaloExchange::SIDE_COUNT];
+
+	if(requested >= 0 && tileModeNext < 0) {
+		tileModeNext = (int)requested;
+		tileModeStep = tileStep + TILE_MODE_DELAY_STEPS;
+	}
+
+	//the step is sent as an offset, it fits the message either way
+	int own[2] = { tileModeNext, (int)(tileModeStep - tileStep) };
+	for(s = 0; s < HaloExchange::SIDE_COUNT; s++) {
+		message[s][0] = -1;
+		send[s]  = own;
+		recv[s]  = message[s];
+		bytes[s] = sizeof(own);
+	}
+	tileLinks.exchange(send, recv, bytes, TILE_MODE_TAG);
+
+	for(s = 0; s < HaloExchange::SIDE_COUNT; s++) {
+		if(message[s][0] < 0 || !tileLinks.hasNeighbor((HaloExchange::Side)s))
+			continue;
+		long step = tileStep + message[s][1];
+		if(tileModeNext < 0 || step < tileModeStep || (step == tileModeStep && message[s][0] < tileModeNext)) {
+			tileModeNext = message[s][0];
+			tileModeStep = step;
+		}
+	}
+
+	int newMode = -1;
+	if(tileModeNext >= 0 && tileStep >= tileModeStep) {
+		newMode      = tileModeNext;
+		tileModeNext = -1;
+	}
+	tileStep++;
+	return newMode;
+}
+
+
+
+/**
+ * Runs one simulation step: applies requests from the GLUT thread, feeds the newest
+ * sensor frame into the solver if one arrived, advances the solver by the time since
+ * the last step and publishes a snapshot for drawing. Without a new frame the fluid keeps moving around the last
+ * bounds, so a stalled sensor does not freeze the wall.
+ *
+ * Runs on the simulation thread, or on the GLUT thread when the GPU solver is in use.
+ */
+static void simulateStep()
+{
+	FluidSolver* flSolver;
+	double stepStart = timeMs();
+
+	long newMode = atomicExchange(&pendingMode, -1);
+	if(tiled)
+		newMode = syncTileMode(newMode);
+	if(newMode >= 0)
+		changeMode(newMode);
+	if(atomicExchange(&pendingClear, 0))
+		clearData();
+	if(atomicExchange(&pendingFlowToggle, 0)) {
+		flowMode = (FlowMode)((flowMode + 1) % NUM_FLOW_MODES);
+		if(flowMode == FLOW_GPU && gpuFlowState < 0)
+			flowMode = FLOW_DENSE;
+		denseFlow.reset();
+		cout<<"Optical Flow: "<<(flowMode == FLOW_DENSE ? "dense" : flowMode == FLOW_SPARSE ? "sparse" : "gpu")<<endl;
+	}
+	tryChangeMode();
+	finishModeChange();
+
+	if(useUserSolver)
+		flSolver = userSolver;
+	else 
+		flSolver = solver;
+
+	bool newFrame = captureFrames.update();
+	if(newFrame) {
+		CaptureFrame& frame = captureFrames.readBuffer();
+		{
+			PROFILE_SCOPE(PROFILE_SIM_BOUNDS);
+			defineBoundsFromImage(flSolver, frame.bounds);
+		}
+
+		// Copy filtered image for optical flow to use.
+		frame.image.copyTo(flowImg);
+		frame.users.copyTo(usersMatrixResize);
+	}
+
+	getForcesFromMouse(flSolver);
+	if(newFrame && useFlow) {
+		PROFILE_SCOPE(PROFILE_SIM_OPTICAL_FLOW);
+		computeOpticalFlow(flSolver, flow);
+	}
+	{
+		PROFILE_SCOPE(PROFILE_SIM_EMITTERS);
+		if(newFrame) emitSplashes(flSolver, flow);
+		if(useFlow)  renderEmitters(flSolver, emitters);
+	}
+	{
+		PROFILE_SCOPE(PROFILE_SIM_SOLVER);
+		//tiles trade cells every sweep, they all keep the same timestep and sweep count
+		if(tiled)
+			flSolver->update();
+		else
+			simScheduler.step(flSolver, timeMs() - stepStart);
+	}
+	reportSolverTelemetry(flSolver);
+	{
+		PROFILE_SCOPE(PROFILE_SIM_SNAPSHOT);
+		publishSnapshot(flSolver);
+	}
+
+	double stepMs = timeMs() - stepStart;
+	profileAdd(PROFILE_SIM_STEP, stepMs);
+	profileEndFrame(PROFILE_GROUP_SIM);
+}
+
+
+
+/**
+ * Capture thread: waits for sensor frames and publishes them, and applies Kinect
+ * requests that must not interleave with a frame update.
+ */
+static void captureLoop(void*)
+{
+	while(pipelineRunning) {
+		long depthDelta = atomicExchange(&pendingDepthDelta, 0);
+		long motorDelta = atomicExchange(&pendingMotorDelta, 0);
+		bool reset      = atomicExchange(&pendingKinectReset, 0) != 0;
+		bool motorReset = atomicExchange(&pendingMotorReset, 0) != 0;
+
+		if(kinect) {
+			if(depthDelta != 0)
+				kinect->setDepth(depthDelta);
+			if(reset)
+				kinect->reset();	//also recreates the motor
+			if(motorDelta != 0)
+				kinect->setMotorAngle(motorDelta);
+			if(motorReset)
+				kinect->resetMotorAngle();
+		}
+
+		int status = loadImage();
+		profileEndFrame(PROFILE_GROUP_CAPTURE);
+		if(status != 0)
+			sleepMs(SIM_STEP_MS); //no sensor, do not spin
+	}
+}
+
+
+
+/**
+ * Simulation thread: runs simulateStep every SIM_STEP_MS. When a step runs late the
+ * schedule restarts from now instead of running several steps back to back; the 
+ * scheduler makes the late step cover the time that passed.
+ */
+static void simulationLoop(void*)
+{
+	double next = timeMs();
+
+	while(pipelineRunning) {
+		simulateStep();
+
+		next += SIM_STEP_MS;
+		double wait = next - timeMs();
+		if(wait > 0)
+			sleepMs((int)wait);
+		else
+			next = timeMs();
+	}
+}
+
+
+
+/**
+ * Starts the capture and simulation threads. Call once the window exists, so the
+ * GPU solver has been created if it is going to be used.
+ */
+static void startPipeline()
+{
+	simOnRenderThread = (gpuSolver != NULL);
+	nextSimStep       = timeMs();
+
+	//the first mode's solver is ready before anything runs
+	changeMode(mode);
+	modeThread.join();
+	finishModeChange();
+
+	atomicExchange(&pipelineRunning, 1);
+
+	captureThread.start(captureLoop, NULL);
+	if(!simOnRenderThread)
+		simThread.start(simulationLoop, NULL);
+}
+
+
+
+/**
+ * Stops the capture and simulation threads and waits for them to finish.
+ */
+static void stopPipeline()
+{
+	atomicExchange(&pipelineRunning, 0);
+	//a step waiting on a neighbor tile returns right away instead of timing out
+	if(tiled)
+		tileLinks.interrupt();
+	simThread.join();
+	captureThread.join();
+	modeThread.join();
+	tileLinks.close();
+}
+
+
+
+/**
+ * Picks up the newest snapshot, if any, keeping the previous one for interpolation.
+ * @return Weight of curSnapshot when blending it with prevSnapshot for this frame.
+ */
+static float updateSnapshots()
+{
+	if(simSnapshots.update()) {
+		std::swap(prevSnapshot, curSnapshot);
+		*curSnapshot = simSnapshots.readBuffer();
+	}
+
+	//the displayed state trails the simulation by one step and moves from the
+	//previous snapshot to the current one over the time between them
+	bool comparable = prevSnapshot->time > 0
+	               && prevSnapshot->userMode   == curSnapshot->userMode
+	               && prevSnapshot->gpuDensity == curSnapshot->gpuDensity
+	               && prevSnapshot->color.size() == curSnapshot->color.size();
+	if(!comparable) {
+		//nothing to blend with yet, e.g. right after a mode change
+		*prevSnapshot = *curSnapshot;
+		return 1.0f;
+	}
+
+	double period = curSnapshot->time - prevSnapshot->time;
+	if(period <= 0)
+		return 1.0f;
+
+	double t = (timeMs() - curSnapshot->time) / period;
+	return t < 0 ? 0.0f : t > 1 ? 1.0f : (float)t;
+}
+////////////////////////////////////////////////////////////////////////
+
+/*
+  ----------------------------------------------------------------------
+   GLUT callback routines
+  ----------------------------------------------------------------------
+*/
+
+/**
+ *  GLUT keyboard listener function.
+ *
+ *  @param key	key that is pressed
+ *  @param x	x-coordinate of mouse at time of key press
+ *  @param y	y-coordinate of mouse at time of keey press
+ */
+static void key_func ( unsigned char key, int x, int y )
+{
+	switch ( key )
+	{
+		case 'c':
+		case 'C':
+			atomicExchange(&pendingClear, 1);
+			break;
+		case 27 : //escape key
+			cleanupExit();
+			break;
+		case 'f':
+		case 'F':
+			//toggle optical flow
+			useFlow = !useFlow;
+			cout<<"Optical Flow: "<<useFlow<<endl;
+			break;
+		case 'l':
+		case 'L':
+			//cycle dense, sparse (Lucas-Kanade) and GPU optical flow
+			atomicExchange(&pendingFlowToggle, 1);
+			break;
+		case 'v':
+		case 'V':
+			dvel = !dvel;
+			cout<<"Display Velocity"<<endl;
+			break;
+		case 'b':
+		case 'B':
+			dbound = !dbound;
+			break;
+		case '1': //single color fluid
+			atomicExchange(&pendingMode, 0);
+			break;
+		case '2': //vectors without optical flow
+			atomicExchange(&pendingMode, 1);
+			break;
+		case '3': //multi color fluid
+			atomicExchange(&pendingMode, 2);
+			break;
+		case '4': //white bg
+			atomicExchange(&pendingMode, 3);
+			break;
+		case '0': //toggle auto mode change
+			if(tiled) {
+				cout<<"Auto Change Mode is off on tiled walls, the mode keys switch every tile"<<endl;
+				break;
+			}
+			autoChangeMode = !autoChangeMode;
+			cout<<"Auto Change Mode: "<<autoChangeMode<<endl;
+			break;
+		#if USE_KINECT
+		case 'u':
+		case 'U':
+			dusers = !dusers;
+			cout<<"Draw Users: "<<dusers<<endl;
+			break;
+		case 'w':
+			atomicAdd(&pendingMotorDelta, +50);
+			break;
+		case 's':
+			atomicAdd(&pendingMotorDelta, -50);
+			break;
+		case ' ':
+			atomicExchange(&pendingMotorReset, 1);
+			break;
+		case '+':
+			atomicExchange(&pendingKinectReset, 1);
+			break;
+		case 'o':
+		case 'O':
+			atomicAdd(&pendingDepthDelta, +200);
+			break;
+		case 'k':
+		case 'K':
+			atomicAdd(&pendingDepthDelta, -200);
+			break;
+
+		#endif
+
+		case 'p':
+		case 'P':
+			dprofile = !dprofile;
+			break;
+
+		case 'Q' :
+		case 'q' :
+			toggleFullscreen();
+			break;
+
+	}
+}
+
+
+
+/**
+ *  GLUT mouse listener function. Called when mouse button is pressed or 
+ *  released.
+ *
+ *  @param button ID of button event that is presssed.
+ *  @param state  A GLUT constant indicating mouse down or up
+ *  @param x	  x-coordinate of mouse at time of button event
+ *  @param y	  y-coordinate of mouse at time of button event
+ */
+static void mouse_func ( int button, int state, int x, int y )
+{
+	omx = mx = x;
+	omx = my = y;
+
+	mouse_down[button] = state == GLUT_DOWN;
+}
+
+
+
+/**
+ *  GLUT mouse movement function. Called when mouse is moved
+ *
+ *  @param x	  x-coordinate of mouse 
+ *  @param y	  y-coordinate of mouse
+ */
+static void motion_func ( int x, int y )
+{
+	mx = x;
+	my = y;
+}
+
+
+
+/**
+ *  GLUT window reshaping function. Called whenever a window is resized.
+ *
+ *  @param width	New width of window
+ *  @param height	New height of window.
+ */
+static void reshape_func ( int width, int height )
+{
+
+	glutReshapeWindow ( width, height );
+
+	win_x = width;
+	win_y = height;
+}
+
+
+
+/**
+ *  Called when OpenGL is not drawing. Calls for another draw frame
+ */
+static void idle_func ( void )
+{
+	bool fullscreen = glutGameModeGet(GLUT_GAME_MODE_ACTIVE);
+	if(!fullscreen)
+		glutSetWindow(win_id);
+	glutPostRedisplay();
+}
+
+
+
+/**
+ *  Prepares OpenGL canvas to draw a new frame.
+ */
+static void pre_display ( void )
+{		
+	int x, y, width, height;
+
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+	getGridViewport(x, y, width, height);
+	glViewport ( x, y, width, height );
+	glMatrixMode ( GL_PROJECTION );
+	glLoadIdentity ();
+	gluOrtho2D ( 0.0, 1.0, 0.0, 1.0 );
+	glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
+	glClear ( GL_COLOR_BUFFER_BIT );
+}
+
+
+
+/**
+ *  Posts the drawn frame to the screen.
+ */
+static void post_display ( void )
+{
+	glutSwapBuffers ();
+}
+////////////////////////////////////////////////////////////////////////////
+
+
+
+/**
+ *  Draws OpenGL polygons that represent the fluid simulation. The simulation
+ *  runs on its own thread; this draws the latest steps it has published,
+ *  at whatever rate the display runs. With the GPU solver the steps run
+ *  here instead, on the SIM_STEP_MS schedule.
+ *
+ */
+static void drawFunction ( void )
+{
+	double frameStart = timeMs();
+
+	if(simOnRenderThread) {
+		double now = timeMs();
+		if(now >= nextSimStep) {
+			simulateStep();
+			nextSimStep = (nextSimStep + SIM_STEP_MS > now) ? nextSimStep + SIM_STEP_MS : now + SIM_STEP_MS;
+		}
+	}
+	else {
+		PROFILE_SCOPE(PROFILE_RENDER_FLOW);
+		serveFlowJobs();
+	}
+
+	pre_display();
+		float t = updateSnapshots();
+
+		if(curSnapshot->time > 0) {
+			PROFILE_SCOPE(PROFILE_RENDER_DRAW);
+			bool dispUsr = curSnapshot->userMode && dusers;
+
+			if(dvel)     drawVelocity(*prevSnapshot, *curSnapshot, t);
+			else		 drawDensity(*prevSnapshot, *curSnapshot, t);
+
+			if(dbound)   drawBounds(*curSnapshot);
+			if(dispUsr)  drawUsers(*curSnapshot);
+		}
+		if(dprofile) drawProfile();
+	post_display();
+
+	profileAdd(PROFILE_RENDER_FRAME, timeMs() - frameStart);
+	profileEndFrame(PROFILE_GROUP_RENDER);
+	logProfile();
+}
+
+
+
+/**
+ *  Sets OpenGL Callbacks
+ *
+ */
+static void initOpenGl() 
+{
+	glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
+	glClear ( GL_COLOR_BUFFER_BIT );
+	glutSwapBuffers ();
+	glClear ( GL_COLOR_BUFFER_BIT );
+	glutSwapBuffers ();
+
+	pre_display ();
+
+	//textures belonged to the previous context, if any
+	densityTexture.contextChanged();
+	boundsTexture.contextChanged();
+	usersTexture.contextChanged();
+
+#if USE_GPU_SOLVER
+	//the solver can only be created once a context exists. Fullscreen opens a new
+	//context, so the textures are rebuilt on the next update.
+	if(gpuFlow)
+		gpuFlow->contextChanged();
+	if(gpuSolver)
+		gpuSolver->contextChanged();
+	else if(velocityDownsampling > 1 || densityAdvection != FluidSolver::ADVECT_SEMI_LAGRANGIAN) {
+		//said once, fullscreen comes back here
+		static bool told = false;
+		if(!told)
+			cout<<"The GPU solver has no -velocity or -advect, using the CPU solver"<<endl;
+		told = true;
+	}
+	else if(FluidSolverGPU::isSupported() && !tiled) {
+		gpuSolver = new FluidSolverGPU(NX, NY, SIM_DT, 0.00f, 0.0f);
+		gpuSolver->setMaxIterations(MAX_SOLVER_ITERATIONS);
+		gpuSolver->reset();
+	}
+#endif
+
+	glutKeyboardFunc (key_func     );
+	glutMouseFunc    (mouse_func   );
+	glutMotionFunc   (motion_func  );
+	glutReshapeFunc  (reshape_func );
+	glutIdleFunc     (idle_func    );
+	glutDisplayFunc  (drawFunction );
+
+}
+
+
+
+/**
+ * Switches between fullscreen and windowed mode.
+ */
+static void toggleFullscreen()
+{
+	bool fullscreen = glutGameModeGet(GLUT_GAME_MODE_ACTIVE);
+	if(fullscreen) {
+		win_x = DEF_WINDOW_SIZE;
+		win_y = DEF_WINDOW_SIZE * NY / NX;
+		glutLeaveGameMode();
+		open_glut_window();
+	}
+	else {
+		glutGameModeString("640x480:16@60");
+
+		if (glutGameModeGet(GLUT_GAME_MODE_POSSIBLE)) {
+			glutEnterGameMode();
+			//glutDestroyWindow(win_id);
+			win_x = glutGameModeGet(GLUT_GAME_MODE_WIDTH);
+			win_y = glutGameModeGet(GLUT_GAME_MODE_HEIGHT);
+			initOpenGl();
+		}
+
+		else {
+			printf("The select fullscreen mode is not available\n");
+		}
+	}
+
+}
+
+
+
+/**
+ *  Opens a GLUT compatible window and sets OpenGL callbacks.
+ *
+ */
+static void open_glut_window ( void )
+{
+	glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE);
+	glutInitWindowPosition ( 0, 0 );
+	glutInitWindowSize ( win_x, win_y );
+
+	char* windowName;
+	sprintf(windowName, "Fluid Wall %s", VERSION);	
+	win_id = glutCreateWindow(windowName);
+
+	//register callbacks
+	initOpenGl();
+
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////
+/*
+  ----------------------------------------------------------------------
+   main --- main routine
+  ----------------------------------------------------------------------
+*/
+/**
+ * Adds a link to a neighbor tile from the arguments of -tile.
+ * @param side     left, right, bottom or top
+ * @param address  port to listen on, or host:port of a neighbor that listens
+ * @return         False if side is not one of the above.
+ */
+static bool addTileLink(const char* side, const char* address)
+{
+	static const char* SIDE_NAMES[HaloExchange::SIDE_COUNT] = { "left", "right", "bottom", "top" };
+	int s = 0;
+	while(s < HaloExchange::SIDE_COUNT && strcmp(side, SIDE_NAMES[s]))
+		s++;
+	if(s == HaloExchange::SIDE_COUNT)
+		return false;
+
+	const char* colon = strrchr(address, ':');
+	if(colon)
+		tileLinks.connectTo((HaloExchange::Side)s, string(address, colon).c_str(), atoi(colon + 1));
+	else
+		tileLinks.listenOn((HaloExchange::Side)s, atoi(address));
+	tiled = true;
+	return true;
+}
+
+
+
+int main ( int argc, char ** argv )
+{
+	glutInit ( &argc, argv);
+
+	//capture stream and storage options, removed from argv before the checks below
+	int kept = 1;
+	for ( int k = 1; k < argc; k++ ) {
+		if ( !strcmp(argv[k], "-record") && k + 1 < argc )
+			recordPath = argv[++k];
+		else if ( !strcmp(argv[k], "-play") && k + 1 < argc )
+			playPath = argv[++k];
+		else if ( !strcmp(argv[k], "-fast") )
+			playFast = true;
+		else if ( !strcmp(argv[k], "-density") && k + 1 < argc && !strcmp(argv[k + 1], "half") ) {
+			userDensityStorage = FluidSolverMultiUser::DENSITY_HALF;
+			k++;
+		}
+		else if ( !strcmp(argv[k], "-density") && k + 1 < argc && !strcmp(argv[k + 1], "unorm16") ) {
+			userDensityStorage = FluidSolverMultiUser::DENSITY_UNORM16;
+			k++;
+		}
+		else if ( !strcmp(argv[k], "-velocity") && k + 1 < argc && atoi(argv[k + 1]) >= 1 )
+			velocityDownsampling = atoi(argv[++k]);
+		else if ( !strcmp(argv[k], "-advect") && k + 1 < argc && 
+				  (!strcmp(argv[k + 1], "mc") || !strcmp(argv[k + 1], "mcv")) ) {
+			densityAdvection = FluidSolver::ADVECT_MACCORMACK;
+			if ( !strcmp(argv[k + 1], "mcv") )
+				velocityAdvection = FluidSolver::ADVECT_MACCORMACK;
+			k++;
+		}
+		else if ( !strcmp(argv[k], "-tile") && k + 2 < argc && addTileLink(argv[k + 1], argv[k + 2]) )
+			k += 2;
+		else if ( !strcmp(argv[k], "-statsd") && k + 1 < argc && strrchr(argv[k + 1], ':') )
+			statsdAddress = argv[++k];
+		else
+			argv[kept++] = argv[k];
+	}
+	argc = kept;
+
+	if ( argc != 1 && argc != 6 ) {
+		fprintf ( stderr, "usage : %s [-record file] [-play file [-fast]] [-density half|unorm16] [-velocity 2|4] [-advect mc|mcv] [-tile side port|host:port]... [-statsd host:port] [N dt diff visc force source]\n", argv[0] );
+		fprintf ( stderr, "where:\n" );\
+		fprintf ( stderr, "\t N      : grid resolution, cells per row\n" );
+		fprintf ( stderr, "\t dt     : time step\n" );
+		fprintf ( stderr, "\t diff   : diffusion rate of the density\n" );
+		fprintf ( stderr, "\t visc   : viscosity of the fluid\n" );
+		fprintf ( stderr, "\t force  : scales the mouse movement that generate a force\n" );
+		fprintf ( stderr, "\t source : amount of density that will be deposited\n" );
+		fprintf ( stderr, "\t -record: saves the sensor frames to file\n" );
+		fprintf ( stderr, "\t -play  : replays a recording instead of the sensor, in a loop\n" );
+		fprintf ( stderr, "\t -fast  : plays the recording as fast as it is read\n" );
+		fprintf ( stderr, "\t -density: stores the user densities in 16 bits\n" );
+		fprintf ( stderr, "\t -velocity: runs velocity and pressure on a coarser grid, density stays sharp\n" );
+		fprintf ( stderr, "\t -advect: MacCormack advection of the density (mc), and of the velocity (mcv)\n" );
+		fprintf ( stderr, "\t -tile  : joins a neighbor tile on side (left, right, bottom, top),\n" );
+		fprintf ( stderr, "\t          waiting for it on port or connecting to it at host:port\n" );
+		fprintf ( stderr, "\t -statsd: reports timings, sensor and solver health to a StatsD server\n" );
+		exit ( 1 );
+	}
+
+	printf ( "\n\n ==== Fluid Wall %s ==== \n", VERSION);
+	printf ( " SIMULATION:\n");
+	printf ( "\t Add densities with the right mouse button\n" );
+	printf ( "\t Add bounds with the middle mouse button\n" );
+	printf ( "\t Add velocities with the left mouse button and dragging the mouse\n" );
+	printf ( "\t Toggle use of optical flow with the 'f' key.\n" );
+	printf ( "\t Cycle dense, sparse (Lucas-Kanade) and GPU optical flow with the 'l' key.\n" );
+	printf ( "\t Clear the simulation with the 'c' key\n" );
+	printf ( " DISPLAY:\n");
+	printf ( "\t Toggle fullscreen mode with the 'q' key.\n" );
+	printf ( "\t Toggle density/velocity display with the 'v' key.\n" );
+	printf ( "\t Toggle bounds display with the 'b' key.\n" );
+	printf ( "\t Toggle users display with the 'u' key.\n" );
+	printf ( "\t Toggle stage timings with the 'p' key.\n" );
+	printf ( " MODES:\n");
+	printf ( "\t '0' key: Toggle Automatic Mode Change.\n" );
+	printf ( "\t '1' key: Switch to mode 1: Single user, blue fluid.\n" );
+	printf ( "\t '2' key: Switch to mode 2: Velocity Vector, no optical flow.\n" );
+	printf ( "\t '3' key: Switch to mode 3: Multi-user, multicolor fluid.\n" );
+	printf ( "\t '4' key: Switch to mode 4: Multi-user, white background.\n" );
+	printf ( " KINECT:\n");
+	printf ( "\t Increase Kinect motor angle with the 'w' key.\n" );
+	printf ( "\t Decrease Kinect motor angle with the 's' key.\n" );
+	printf ( "\t Reset Kinect motor angle with the SPACEBAR key.\n" );
+	printf ( "\t Increase Kinect depth thrshold angle with the 'o' key.\n" );
+	printf ( "\t Decrease Kinect depth thrshold angle with the 'k' key.\n" );
+	printf ( "\t Reset the Kinect with the + key \n\n" );
+	printf ( " Quit with the 'ESC' key.\n" );
+
+	dvel = false;
+	dprofile = false;
+	dusers = false;
+	dbound = false;
+
+	if ( !allocateData() ) 
+		exit ( 1 );
+	cout<<"Solver kernels: "<<getFluidKernels().name<<endl;
+	if ( statsdAddress ) {
+		const char* colon = strrchr(statsdAddress, ':');
+		if ( !telemetry.open(string(statsdAddress, colon).c_str(), atoi(colon + 1), TELEMETRY_PREFIX, TELEMETRY_INTERVAL_MS) )
+			cout<<"Cannot report to StatsD at "<<statsdAddress<<endl;
+	}
+	
+	clearData();
+
+	win_x = DEF_WINDOW_SIZE;
+	win_y = DEF_WINDOW_SIZE * NY / NX;
+
+	open_glut_window();
+	startPipeline();
+
+	glutMainLoop();
 }
\ No newline at end of file